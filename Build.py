@@ -73,6 +73,13 @@ FLAGS.AddString(
   help='Base directory to build from.'
 )
 
+FLAGS.AddString(
+  'mode',
+  default='debug',
+  help=('Build mode: debug or release. Release builds are optimized and'
+        ' compile the debug-only checks (DCHECK) out.')
+)
+
 # ------------------------------------------------------------------------------
 
 
@@ -288,12 +295,22 @@ class Environment(object):
   DEFAULT_SOURCE_DIR = 'src'
   METADATA_FILE = '.metadata'
 
+  # Compiler flags specific to each build mode.
+  # Release builds keep the CHECKs, which guard memory safety against values
+  # and indexes computed by the programs, but not the DCHECKs, which assert
+  # invariants of the store and of the interpreter.
+  MODE_CXX_FLAGS = {
+    'debug': [],
+    'release': ['-O2', '-DNDEBUG'],
+  }
+
   def __init__(
       self,
       base_dir,
       output_dir=None,
       source_dir=None,
-      metadata_file=None
+      metadata_file=None,
+      mode='debug'
   ):
     """Initializes the build environment.
 
@@ -302,10 +319,15 @@ class Environment(object):
       output_dir: Output directory, relative to base_dir.
       source_dir: Source directory, relative to base_dir.
       metadata_file: Metadata file name, relative to base_dir.
+      mode: Build mode, one of MODE_CXX_FLAGS.
+          Modes other than debug build in their own output directory.
     """
-    output_dir = output_dir or Environment.DEFAULT_OUTPUT_DIR
+    assert mode in Environment.MODE_CXX_FLAGS, (
+      'Unknown build mode: %r' % mode)
+    suffix = '' if (mode == 'debug') else ('-' + mode)
+    output_dir = output_dir or (Environment.DEFAULT_OUTPUT_DIR + suffix)
     source_dir = source_dir or Environment.DEFAULT_SOURCE_DIR
-    metadata_file = metadata_file or Environment.METADATA_FILE
+    metadata_file = metadata_file or (Environment.METADATA_FILE + suffix)
     self._base_dir = base_dir
     assert os.path.exists(self._base_dir), (
       'Base directory does not exist: %s' % base_dir)
@@ -323,6 +345,7 @@ class Environment(object):
     logging.info('Source directory: %s', self._source_dir)
     logging.info('Output directory: %s', self._output_dir)
     logging.info('Metadata file: %s', self._metadata_file)
+    logging.info('Build mode: %s', mode)
 
     # ----------------------------------------------------------------------
 
@@ -335,13 +358,15 @@ class Environment(object):
     self.vars.CXX_COMPILER_COMMAND = [self.vars.CXX_COMPILER]
     if FLAGS.use_distcc:
       self.vars.CXX_COMPILER_COMMAND.insert(0, 'distcc')
-    self.vars.CXX_FLAGS = [ '-Wall', '-g', '-fPIC', '-std=c++0x' ]
+    self.vars.CXX_FLAGS = [ '-Wall', '-g', '-fPIC', '-std=c++0x', '-pthread' ]
+    self.vars.CXX_FLAGS.extend(Environment.MODE_CXX_FLAGS[mode])
 
     self.vars.AR = '/usr/bin/ar'
     self.vars.RANLIB = '/usr/bin/ranlib'
 
     self.vars.LINKER = self.vars.CXX_COMPILER
-    self.vars.LINK_OPTIONS = ['-g', '-std=c++0x', '-lstdc++', '-lboost_regex']
+    self.vars.LINK_OPTIONS = [
+        '-g', '-std=c++0x', '-pthread', '-lstdc++', '-lboost_regex']
 
     self.vars.PROTO_COMPILER = '/usr/bin/protoc'
     self.vars.PROTO_COMPILER_FLAGS = []
@@ -673,7 +698,7 @@ def WorkerPool(queue, process, nworkers):
 class Action(cli.Action):
   def __init__(self):
     super(Action, self).__init__()
-    self._env = Environment(base_dir=FLAGS.base_dir)
+    self._env = Environment(base_dir=FLAGS.base_dir, mode=FLAGS.mode)
 
   @property
   def env(self):
@@ -29,6 +29,7 @@ Library(
     'store/array.cc',
     'store/atom.cc',
     'store/boolean.cc',
+    'store/byte_string.cc',
     'store/bytecode.cc',
     'store/cell.cc',
     'store/closure.cc',
@@ -38,11 +39,16 @@ Library(
     'store/float.cc',
     'store/heap_value.cc',
     'store/integer.cc',
+    'store/jit.cc',
     'store/list.cc',
     'store/literal.cc',
     'store/moved_value.cc',
     'store/name.cc',
+    'store/numeric_array.cc',
+    'store/numeric_kernels.cc',
+    'store/opcode_profile.cc',
     'store/open_record.cc',
+    'store/packed_code.cc',
     'store/ozvalue.cc',
     'store/record.cc',
     'store/store.cc',
@@ -51,6 +57,7 @@ Library(
     'store/tuple.cc',
     'store/value.cc',
     'store/variable.cc',
+    'store/verifier.cc',
   ],
   dependencies=[
     'base_lib',
@@ -104,6 +111,128 @@ Binary(
   ],
 )
 
+Binary(
+  name='number_benchmark',
+  sources=[
+    'store/number_benchmark.cc',
+  ],
+  dependencies=[
+    'base_lib',
+    'proto_lib',
+    'store_lib',
+  ],
+)
+
+Binary(
+  name='unification_benchmark',
+  sources=[
+    'store/unification_benchmark.cc',
+  ],
+  dependencies=[
+    'base_lib',
+    'proto_lib',
+    'store_lib',
+  ],
+)
+
+Binary(
+  name='thread_benchmark',
+  sources=[
+    'store/thread_benchmark.cc',
+  ],
+  dependencies=[
+    'base_lib',
+    'proto_lib',
+    'store_lib',
+  ],
+)
+
+Binary(
+  name='call_benchmark',
+  sources=[
+    'store/call_benchmark.cc',
+  ],
+  dependencies=[
+    'base_lib',
+    'proto_lib',
+    'store_lib',
+  ],
+)
+
+Binary(
+  name='record_access_benchmark',
+  sources=[
+    'store/record_access_benchmark.cc',
+  ],
+  dependencies=[
+    'base_lib',
+    'proto_lib',
+    'store_lib',
+  ],
+)
+
+Binary(
+  name='dispatch_benchmark',
+  sources=[
+    'store/dispatch_benchmark.cc',
+  ],
+  dependencies=[
+    'base_lib',
+    'combinators_lib',
+    'proto_lib',
+    'store_lib',
+  ],
+)
+
+Binary(
+  name='opcode_benchmark',
+  sources=[
+    'store/opcode_benchmark.cc',
+  ],
+  dependencies=[
+    'base_lib',
+    'proto_lib',
+    'store_lib',
+  ],
+)
+
+Binary(
+  name='scheduler_benchmark',
+  sources=[
+    'store/scheduler_benchmark.cc',
+  ],
+  dependencies=[
+    'base_lib',
+    'proto_lib',
+    'store_lib',
+  ],
+)
+
+Binary(
+  name='engines_benchmark',
+  sources=[
+    'store/engines_benchmark.cc',
+  ],
+  dependencies=[
+    'base_lib',
+    'proto_lib',
+    'store_lib',
+  ],
+)
+
+Binary(
+  name='superinstruction_generator',
+  sources=[
+    'store/superinstruction_generator.cc',
+  ],
+  dependencies=[
+    'base_lib',
+    'combinators_lib',
+    'proto_lib',
+    'store_lib',
+  ],
+)
+
 # ------------------------------------------------------------------------------
 #Tests
 
@@ -174,14 +303,22 @@ Test(
   sources=[
     "store/arity_test.cc",
     "store/atom_test.cc",
+    "store/byte_string_test.cc",
+    "store/engine_test.cc",
     "store/equality_test.cc",
     "store/integer_test.cc",
+    "store/jit_test.cc",
     "store/list_test.cc",
+    "store/numeric_array_test.cc",
     "store/open_record_test.cc",
+    "store/packed_code_test.cc",
     "store/ozvalue_test.cc",
+    "store/small_float_test.cc",
     "store/small_integer_test.cc",
+    "store/thread_test.cc",
     "store/unification_test.cc",
-    "store/values_test.cc"
+    "store/values_test.cc",
+    "store/verifier_test.cc"
   ],
   dependencies=[
     'combinators_lib',
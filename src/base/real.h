@@ -57,6 +57,10 @@ class Real {
     return s;
   }
 
+  double ToDouble(Rounding rounding = Rounding::NEAREST) const {
+    return mpfr_get_d(real_, mpfr_rnd_t(rounding));
+  }
+
   // Note: resets the float to NaN.
   void SetPrecision(mpfr_prec_t precision) {
     mpfr_set_prec(real_, precision);
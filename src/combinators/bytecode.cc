@@ -583,9 +583,16 @@ ProcParser::ProcParser(Stream stream, ParsingContext* context)
     nclosures = store::IntValue(op.value);
   }
 
-  proc_ = store::New::Closure(
-      context->store, bc->bytecode, nparams, nlocals, nclosures)
-      .as<store::Closure>();
+  vector<string> errors;
+  proc_ = store::Closure::New(
+      context->store, bc->bytecode, nparams, nlocals, nclosures, &errors);
+  if (proc_ == NULL) {
+    LOG(INFO) << "Discarding proc mnemonic with invalid bytecode.";
+    for (const string& error : errors)
+      LOG(INFO) << "  " << error;
+    SetFailure();
+    return;
+  }
 
   SetOK(mnemonic);
 }
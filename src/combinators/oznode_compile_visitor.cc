@@ -6,6 +6,40 @@ using namespace store;
 
 namespace combinators { namespace oz {
 
+namespace {
+
+// @returns True if the expression is statically known to evaluate to a float,
+//     ie. if it is a float literal or an arithmetic operation on a float.
+//     Other operands use the integer instructions, which compute on floats
+//     too when both operands turn out to be floats.
+bool IsFloatExpression(const AbstractOzNode* node) {
+  if (node->type == OzLexemType::REAL) return true;
+
+  if (const OzNodeUnaryOp* op = dynamic_cast<const OzNodeUnaryOp*>(node)) {
+    return (op->operation.type == OzLexemType::NUMERIC_NEG)
+        && IsFloatExpression(op->operand.get());
+  }
+
+  if (const OzNodeBinaryOp* op = dynamic_cast<const OzNodeBinaryOp*>(node)) {
+    return ((op->operation.type == OzLexemType::NUMERIC_MINUS)
+            || (op->operation.type == OzLexemType::NUMERIC_DIV))
+        && (IsFloatExpression(op->lop.get())
+            || IsFloatExpression(op->rop.get()));
+  }
+
+  if (const OzNodeNaryOp* op = dynamic_cast<const OzNodeNaryOp*>(node)) {
+    if ((op->operation.type != OzLexemType::NUMERIC_MUL)
+        && (op->operation.type != OzLexemType::NUMERIC_ADD))
+      return false;
+    for (auto operand : op->operands)
+      if (IsFloatExpression(operand.get())) return true;
+  }
+
+  return false;
+}
+
+}  // namespace
+
 store::Value Compile(const string& code, store::Store* store) {
   OzParser parser;
   CHECK(parser.Parse(code)) << "Error parsing: " << code;
@@ -46,9 +80,8 @@ void CompileVisitor::Visit(OzNodeGeneric* node) {
   CHECK_EQ(0, environment_->nparams());
   CHECK_EQ(0, environment_->nclosures());
 
-  top_level_ =
-      New::Closure(store_, segment_, 0, environment_->nlocals(), 0)
-      .as<Closure>();
+  top_level_ = CHECK_NOTNULL(
+      Closure::New(store_, segment_, 0, environment_->nlocals(), 0));
 
   LOG(INFO) << "Top-level procedure:\n" << top_level_->ToString();
 }
@@ -171,9 +204,8 @@ void CompileVisitor::Visit(OzNodeProc* node) {
   const uint64 nparams = environment_->nparams();
   const uint64 nlocals = environment_->nlocals();
   const uint64 nclosures = environment_->nclosures();
-  Closure* const closure =
-      New::Closure(store_, segment_, nparams, nlocals, nclosures)
-      .as<Closure>();
+  Closure* const closure = CHECK_NOTNULL(
+      Closure::New(store_, segment_, nparams, nlocals, nclosures));
 
   LOG(INFO) << "Compiled procedure:\n" << closure->ToString();
 
@@ -307,6 +339,10 @@ void CompileVisitor::Visit(OzNodeBinaryOp* node) {
   shared_ptr<ExpressionResult> lop = CompileExpression(node->lop);
   shared_ptr<ExpressionResult> rop = CompileExpression(node->rop);
 
+  // Numeric operations and comparisons on floats have dedicated instructions.
+  const bool is_float =
+      IsFloatExpression(node->lop.get()) || IsFloatExpression(node->rop.get());
+
   switch (node->operation.type) {
     case OzLexemType::LIST_CONS: {
       CHECK(IsExpression()) << "Invalid use of binary expression as statement.";
@@ -332,7 +368,9 @@ void CompileVisitor::Visit(OzNodeBinaryOp* node) {
       CHECK(IsExpression()) << "Invalid use of binary expression as statement.";
       result_->SetupValuePlaceholder("LessThanTestResult");
       segment_->push_back(
-          Bytecode(Bytecode::TEST_LESS_THAN,
+          Bytecode(is_float
+                   ? Bytecode::NUMBER_FLOAT_LESS_THAN
+                   : Bytecode::TEST_LESS_THAN,
                    result_->value(),
                    lop->value(),
                    rop->value()));
@@ -342,7 +380,9 @@ void CompileVisitor::Visit(OzNodeBinaryOp* node) {
       CHECK(IsExpression()) << "Invalid use of binary expression as statement.";
       result_->SetupValuePlaceholder("LessOrEqualTestResult");
       segment_->push_back(
-          Bytecode(Bytecode::TEST_LESS_OR_EQUAL,
+          Bytecode(is_float
+                   ? Bytecode::NUMBER_FLOAT_LESS_OR_EQUAL
+                   : Bytecode::TEST_LESS_OR_EQUAL,
                    result_->value(),
                    lop->value(),
                    rop->value()));
@@ -353,7 +393,9 @@ void CompileVisitor::Visit(OzNodeBinaryOp* node) {
       result_->SetupValuePlaceholder("GreaterThanTestResult");
       // Switch left and right operands on purpose:
       segment_->push_back(
-          Bytecode(Bytecode::TEST_LESS_THAN,
+          Bytecode(is_float
+                   ? Bytecode::NUMBER_FLOAT_LESS_THAN
+                   : Bytecode::TEST_LESS_THAN,
                    result_->value(),
                    rop->value(),
                    lop->value()));
@@ -364,7 +406,9 @@ void CompileVisitor::Visit(OzNodeBinaryOp* node) {
       result_->SetupValuePlaceholder("GreaterOrEqualTestResult");
       // Switch left and right operands on purpose:
       segment_->push_back(
-          Bytecode(Bytecode::TEST_LESS_OR_EQUAL,
+          Bytecode(is_float
+                   ? Bytecode::NUMBER_FLOAT_LESS_OR_EQUAL
+                   : Bytecode::TEST_LESS_OR_EQUAL,
                    result_->value(),
                    rop->value(),
                    lop->value()));
@@ -393,7 +437,9 @@ void CompileVisitor::Visit(OzNodeBinaryOp* node) {
       CHECK(IsExpression()) << "Invalid use of binary expression as statement.";
       result_->SetupValuePlaceholder("NumericMinusResult");
       segment_->push_back(
-          Bytecode(Bytecode::NUMBER_INT_SUBTRACT,
+          Bytecode(is_float
+                   ? Bytecode::NUMBER_FLOAT_SUBTRACT
+                   : Bytecode::NUMBER_INT_SUBTRACT,
                    result_->value(),
                    lop->value(),
                    rop->value()));
@@ -403,7 +449,9 @@ void CompileVisitor::Visit(OzNodeBinaryOp* node) {
       CHECK(IsExpression()) << "Invalid use of binary expression as statement.";
       result_->SetupValuePlaceholder("NumericDivResult");
       segment_->push_back(
-          Bytecode(Bytecode::NUMBER_INT_DIVIDE,
+          Bytecode(is_float
+                   ? Bytecode::NUMBER_FLOAT_DIVIDE
+                   : Bytecode::NUMBER_INT_DIVIDE,
                    result_->value(),
                    lop->value(),
                    rop->value()));
@@ -425,9 +473,12 @@ void CompileVisitor::Visit(OzNodeUnaryOp* node) {
       Compile(node->operand, result_);
       segment_->push_back(
           Bytecode(
-              Bytecode::NUMBER_INT_INVERSE,
+              IsFloatExpression(node->operand.get())
+              ? Bytecode::NUMBER_FLOAT_INVERSE
+              : Bytecode::NUMBER_INT_INVERSE,
               result_->into(),     // in
               result_->value()));  // number
+      result_->SetValue(result_->into());
       break;
     }
     case OzLexemType::VAR_NODEF: {
@@ -524,14 +575,20 @@ void CompileVisitor::CompileTupleCons(OzNodeNaryOp* node) {
 void CompileVisitor::CompileMulOrAdd(OzNodeNaryOp* node) {
   CHECK(IsExpression()) << "Invalid use of numeric operation as statement.";
 
+  const bool is_float = IsFloatExpression(node);
+
   Bytecode::OpcodeType opcode;
   switch (node->operation.type) {
     case OzLexemType::NUMERIC_MUL: {
-      opcode = Bytecode::NUMBER_INT_MULTIPLY;
+      opcode = is_float
+          ? Bytecode::NUMBER_FLOAT_MULTIPLY
+          : Bytecode::NUMBER_INT_MULTIPLY;
       break;
     }
     case OzLexemType::NUMERIC_ADD: {
-      opcode = Bytecode::NUMBER_INT_ADD;
+      opcode = is_float
+          ? Bytecode::NUMBER_FLOAT_ADD
+          : Bytecode::NUMBER_INT_ADD;
       break;
     }
     default: LOG(FATAL) << "Unsupported operation: " << node->operation.type;
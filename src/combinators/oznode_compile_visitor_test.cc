@@ -52,6 +52,15 @@ class CompileVisitorTest : public testing::Test {
     return visitor_.Compile(root.get());
   }
 
+  // Compiles the definition of a procedure.
+  // @returns The procedure, bound by the first instruction of the top-level.
+  Closure* CompileProc(const string& source) {
+    const Value top_level = Compile(source).Deref();
+    const Bytecode& define = top_level.as<Closure>()->bytecode().at(0);
+    CHECK_EQ(Bytecode::UNIFY, define.opcode);
+    return define.operand2.value.as<Closure>();
+  }
+
   store::StaticStore store_;
   CompileVisitor visitor_;
   Engine engine_;
@@ -208,6 +217,49 @@ TEST_F(CompileVisitorTest, NumberAddPlenty) {
   );
 }
 
+TEST_F(CompileVisitorTest, FloatArithmetic) {
+  Value top_level = Compile(
+      "{print 1.5 * 2.0 + 0.25}\n"
+      "{print 3.0 / 2.0 - ~1.0}\n"
+      "{print 1.5 < 1.0}\n"
+  );
+  New::Thread(&store_, &engine_, top_level.Deref(), Array::EmptyArray,
+              &store_);
+  engine_.Run();
+  EXPECT_EQ("3.2500002.500000false", test_print_.output());
+}
+
+TEST_F(CompileVisitorTest, FloatVariables) {
+  // The operands are not known to be floats when compiled.
+  Closure* const run = CompileProc(
+      "proc {Run X Y Id}\n"
+      "  {print X + Y}\n"
+      "  {print X * Y - X}\n"
+      "  {print ~X}\n"
+      "  {print X / Y}\n"
+      "  {print {Id X} + {Id Y}}\n"
+      "  {print {Id X} + 1.0}\n"
+      "  {print X * 2.0}\n"
+      "  {print Y < X}\n"
+      "end\n");
+  // Id(X Result): Result = X
+  shared_ptr<vector<Bytecode> > id_code(new vector<Bytecode>);
+  id_code->push_back(
+      Bytecode(Bytecode::UNIFY,
+               Operand(Register(Register::PARAM, 1)),
+               Operand(Register(Register::PARAM, 0))));
+  id_code->push_back(Bytecode(Bytecode::RETURN));
+  Closure* const id = Closure::New(&store_, id_code, 2, 0, 0);
+
+  Array* const params = Array::New(&store_, 3, New::Float(&store_, 1.5));
+  params->Assign(1, New::Float(&store_, 0.5));
+  params->Assign(2, id);
+  New::Thread(&store_, &engine_, run, params, &store_);
+  engine_.Run();
+  EXPECT_EQ("2.000000-0.750000-1.5000003.0000002.0000002.5000003.000000true",
+            test_print_.output());
+}
+
 TEST_F(CompileVisitorTest, NestedLocals) {
   Value top_level = Compile(
       "local\n"
@@ -44,9 +44,7 @@ class EvalVisitor : public AbstractOzNodeVisitor {
         break;
       }
       case OzLexemType::REAL: {
-        LOG(FATAL) << "Not implemented";
-        // value_ =
-        //     store::New::Real(store_, boost::get<real::Real>(lexem.value));
+        value_ = store::New::Real(store_, boost::get<real::Real>(lexem.value));
         break;
       }
       case OzLexemType::VAR_ANON: {
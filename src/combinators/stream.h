@@ -103,9 +103,9 @@ class TVectorStream : public TStream<Elt> {
 
   inline
   const ElementType& Get(int64 i) const {
-    CHECK_GE(i, 0);
-    CHECK_LT(i, last_ - first_);
-    return elements_->at(first_ + i);
+    DCHECK_GE(i, 0);
+    DCHECK_LT(i, last_ - first_);
+    return (*elements_)[first_ + i];
   }
 
   inline
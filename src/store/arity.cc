@@ -14,6 +14,17 @@ namespace store {
 
 const Value::ValueType Arity::kType;
 Arity::ArityMap Arity::arity_map_;
+std::mutex Arity::arity_map_mutex_;
+
+namespace {
+
+// Tuple arities up to this size are cached by size, by each OS thread.
+const uint64 kMaxCachedTupleSize = 256;
+
+// Number of arities cached by each OS thread, direct-mapped by hash.
+const uint64 kArityCacheSize = 1024;
+
+}  // namespace
 
 uint64 ArityHashCode(const vector<Value>& literals) {
   // TODO: Clean this const mess.
@@ -39,33 +50,57 @@ Arity* Arity::Get(uint64 size, Value const * literals) {
 }
 
 Arity* Arity::GetTuple(uint64 size) {
-  // TODO: Maybe specializes a little bit for tuple arities.
+  // Tuple arities already looked up by this OS thread, by size.
+  static thread_local vector<Arity*> tuples;
+  if ((size < tuples.size()) && (tuples[size] != NULL))
+    return tuples[size];
+
   vector<Value> sorted(size);
   for (uint64 i = 0; i < size; ++i)
     sorted[i] = Value::Integer(i + 1);
-  return GetFromSorted(sorted);
+  Arity* const arity = GetFromSorted(sorted);
+  if (size < kMaxCachedTupleSize) {
+    if (size >= tuples.size()) tuples.resize(size + 1, NULL);
+    tuples[size] = arity;
+  }
+  return arity;
 }
 
 Arity* Arity::GetFromSorted(const vector<Value>& sorted) {
   uint64 hash = ArityHashCode(sorted);
+  // Arities last looked up by this OS thread, by hash.
+  static thread_local Arity* cache[kArityCacheSize];
+  Arity** const cached = &cache[hash % kArityCacheSize];
+  if ((*cached != NULL) && ((*cached)->hash() == hash)
+      && (*cached)->HasFeatures(sorted))
+    return *cached;
+  *cached = Intern(sorted, hash);
+  return *cached;
+}
+
+// static
+Arity* Arity::Intern(const vector<Value>& sorted, uint64 hash) {
+  std::lock_guard<std::mutex> lock(arity_map_mutex_);
   pair<ArityMap::iterator, ArityMap::iterator> range =
       arity_map_.equal_range(hash);
   ArityMap::iterator it;
   for (it = range.first; it != range.second; ++it) {
     Arity* const arity = &it->second;
     // Checks that this is the right arity and not a collision.
-    if (arity->size() != sorted.size()) continue;
-    if (!equal(sorted.begin(), sorted.end(),
-               arity->features().begin(),
-               Literal::Equals))
-      continue;
-    return arity;
+    if (arity->HasFeatures(sorted))
+      return arity;
   }
   Arity new_arity(sorted, hash);
   it = arity_map_.insert(ArityMap::value_type(hash, new_arity));
   return &it->second;
 }
 
+bool Arity::HasFeatures(const vector<Value>& sorted) const {
+  return (features_.size() == sorted.size())
+      && equal(sorted.begin(), sorted.end(), features_.begin(),
+               Literal::Equals);
+}
+
 Arity::Arity(const vector<Value>& literals, uint64 hash)
     : hash_(hash),
       features_(literals) {
@@ -73,14 +108,21 @@ Arity::Arity(const vector<Value>& literals, uint64 hash)
   //   fmap_[features_[i]] = i;
 }
 
-uint64 Arity::Map(Value feature) throw(FeatureNotFound) {
+uint64 Arity::Map(Value feature) {
+  uint64 index;
+  if (!TryMap(feature, &index))
+    throw FeatureNotFound(feature, this);
+  return index;
+}
+
+bool Arity::TryMap(Value feature, uint64* index) const {
   auto bounds = std::equal_range(features_.begin(), features_.end(),
                                  feature, Literal::LessThan);
   const uint64 nmatches = int(bounds.second - bounds.first);
-  if (nmatches == 0)
-    throw FeatureNotFound(feature, this);
+  if (nmatches == 0) return false;
   CHECK_EQ(1UL, nmatches);
-  return uint64(bounds.first - features_.begin());
+  *index = uint64(bounds.first - features_.begin());
+  return true;
 }
 
 // int64 Arity::Map(Value* feature) const {
@@ -2,6 +2,7 @@
 #define STORE_ARITY_H_
 
 #include <exception>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -59,7 +60,15 @@ class Arity : public HeapValue {
   vector<Value>& features() { return features_; }
   uint64 size() const { return features_.size(); }
 
-  uint64 Map(Value feature) throw(FeatureNotFound);
+  // @returns The index of a feature in the arity.
+  // @throws FeatureNotFound
+  uint64 Map(Value feature);
+
+  // Finds the index of a feature in the arity, without throwing.
+  // @param index Returns the index of the feature, when found.
+  // @returns True if the arity has the feature.
+  bool TryMap(Value feature, uint64* index) const;
+
   bool Has(Value value) const throw();
 
   // @returns If this is a tuple arity.
@@ -95,8 +104,8 @@ class Arity : public HeapValue {
   Value ComputeSubsetMask(Store* store, Arity* arity) const;
 
   // Convenience
-  uint64 Map(int64 integer) throw(FeatureNotFound);
-  uint64 Map(const StringPiece& atom) throw(FeatureNotFound);
+  uint64 Map(int64 integer);
+  uint64 Map(const StringPiece& atom);
   bool Has(int64 integer) const throw();
   bool Has(const StringPiece& atom) const throw();
 
@@ -161,8 +170,18 @@ class Arity : public HeapValue {
   };
 
   // Global interned map of all known arities indexed by their hash.
+  // Shared by the engines of all the OS threads: each OS thread caches the
+  // arities it last looked up, in a table of fixed size, so that the map is
+  // locked mostly when an OS thread looks an arity up for the first time.
   typedef unordered_multimap<uint64, Arity, UInt64Hash> ArityMap;
   static ArityMap arity_map_;
+  static std::mutex arity_map_mutex_;
+
+  // @returns The arity with the given sorted literals and hash, from the map.
+  static Arity* Intern(const vector<Value>& sorted, uint64 hash);
+
+  // @returns True if the arity has exactly the given sorted literals.
+  bool HasFeatures(const vector<Value>& sorted) const;
 
   // Initializes a new arity object from the given in-order literals set.
   // @param literals In-order vector of the literals. Copied.
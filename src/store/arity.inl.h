@@ -36,12 +36,12 @@ Arity* Arity::New(Store* store, uint64 size, Value const * literals) {
 }
 
 inline
-uint64 Arity::Map(int64 integer) throw(FeatureNotFound) {
+uint64 Arity::Map(int64 integer) {
   return Map(Value::Integer(integer));
 }
 
 inline
-uint64 Arity::Map(const StringPiece& atom) throw(FeatureNotFound) {
+uint64 Arity::Map(const StringPiece& atom) {
   return Map(Atom::Get(atom));
 }
 
@@ -19,6 +19,8 @@ namespace store {
 class Array : public HeapValue {
  public:
   static const ValueType kType = Value::ARRAY;
+  // The empty array, shared by the engines of all the OS threads: it has no
+  // element to assign.
   static Array* const EmptyArray;
 
   // ---------------------------------------------------------------------------
@@ -30,24 +32,31 @@ class Array : public HeapValue {
 
   // ---------------------------------------------------------------------------
   // Array specific API
+  //
+  // Indexes are only checked in debug builds: indexes computed by the program
+  // must be checked by the caller. Workers access elements in parallel: see
+  // Value::AtomicLoad().
 
   inline
   Value Access(uint64 index) const {
-    CHECK_LT(index, size_);
-    return values_[index];
+    DCHECK_LT(index, size_);
+    return Value::AtomicLoad(&values_[index]);
   }
 
   inline
   void Assign(uint64 index, Value value) {
-    CHECK_LT(index, size_);
+    DCHECK_LT(index, size_);
     // VLOG(1) << (format("array@%p[%lld/%lld] := %p")
     //             % this % index % size_ % value);
-    values_[index] = value;
+    Value::AtomicStore(&values_[index], value);
   }
 
   uint64 size() const { return size_; }
   const Value* values() const { return values_; }
 
+  // Used by threads whose local registers are promoted to an array.
+  Value* mutable_values() { return values_; }
+
   // ---------------------------------------------------------------------------
   // Value API
   virtual ValueType type() const throw() { return kType; }
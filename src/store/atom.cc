@@ -20,6 +20,14 @@ const Value::ValueType Atom::kType;
 const boost::regex Atom::kSimpleAtomRegexp("[a-z][A-Za-z0-9_]*");
 
 Atom::AtomMap Atom::atom_map_;
+std::mutex Atom::atom_map_mutex_;
+
+namespace {
+
+// Number of atoms cached by each OS thread, direct-mapped by hash.
+const uint64 kAtomCacheSize = 1024;
+
+}  // namespace
 
 // static
 string Atom::Escape(const StringPiece& raw_atom) {
@@ -41,6 +49,19 @@ string Atom::Unescape(const StringPiece& escaped_atom) {
 // static
 Atom* Atom::Get(const StringPiece& atom) {
   const uint64 hash = StringHashCode(atom);
+  // Atoms last looked up by this OS thread, by hash.
+  static thread_local Atom* cache[kAtomCacheSize];
+  Atom** const cached = &cache[hash % kAtomCacheSize];
+  if ((*cached != NULL) && ((*cached)->hash() == hash)
+      && ((*cached)->value() == atom))
+    return *cached;
+  *cached = Intern(atom, hash);
+  return *cached;
+}
+
+// static
+Atom* Atom::Intern(const StringPiece& atom, uint64 hash) {
+  std::lock_guard<std::mutex> lock(atom_map_mutex_);
   pair<AtomMap::iterator, AtomMap::iterator> range =
       atom_map_.equal_range(hash);
 
@@ -3,6 +3,7 @@
 #ifndef STORE_ATOM_H_
 #define STORE_ATOM_H_
 
+#include <mutex>
 #include <string>
 #include <unordered_map>
 using std::pair;
@@ -20,7 +21,10 @@ namespace store {
 // -----------------------------------------------------------------------------
 // Atom
 //
-// Atoms are interned in a table.
+// Atoms are interned in a table, shared by the engines of all the OS threads:
+// see Engine. Each OS thread caches the atoms it last looked up, in a table of
+// fixed size, so that the table is locked mostly when an OS thread looks an
+// atom up for the first time.
 //
 class Atom : public HeapValue {
  public:
@@ -60,6 +64,9 @@ class Atom : public HeapValue {
   virtual uint64 RecordWidth() { return 0; }
   virtual bool RecordHas(Value feature) { return false; }
   virtual Value RecordGet(Value feature);
+  virtual LookupStatus TryRecordGet(Value feature, Value* value) {
+    return LOOKUP_NOT_FOUND;
+  }
 
   virtual Iterator<ValuePair>* RecordIterItems() {
     return new EmptyItemIterator();
@@ -119,6 +126,10 @@ class Atom : public HeapValue {
 
   typedef unordered_multimap<uint64, Atom, UInt64Hash> AtomMap;
   static AtomMap atom_map_;
+  static std::mutex atom_map_mutex_;
+
+  // @returns The atom with the specified text and hash, from the table.
+  static Atom* Intern(const StringPiece& atom, uint64 hash);
 
   // ---------------------------------------------------------------------------
   // Memory layout
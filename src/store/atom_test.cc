@@ -3,6 +3,7 @@
 #include <memory>
 using std::unique_ptr;
 
+#include <boost/format.hpp>
 #include <gtest/gtest.h>
 
 namespace store {
@@ -27,4 +28,18 @@ TEST(Atom, Basics) {
   EXPECT_EQ(coucou1, coucou2);
 }
 
+TEST(Atom, MoreAtomsThanCached) {
+  // More atoms than the cache of an OS thread holds: evicted atoms are
+  // looked up in the table again.
+  const int kNumAtoms = 5000;
+  vector<Atom*> atoms;
+  for (int i = 0; i < kNumAtoms; ++i)
+    atoms.push_back(Atom::Get((boost::format("atom%d") % i).str()));
+  for (int i = kNumAtoms - 1; i >= 0; --i) {
+    Atom* const atom = Atom::Get((boost::format("atom%d") % i).str());
+    EXPECT_EQ(atoms[i], atom);
+    EXPECT_EQ((boost::format("atom%d") % i).str(), atom->value());
+  }
+}
+
 }  // namespace store
@@ -0,0 +1,164 @@
+#include "store/values.h"
+
+#include <string.h>
+
+#include "base/escaping.h"
+
+namespace store {
+
+// -----------------------------------------------------------------------------
+// ByteString
+
+const Value::ValueType ByteString::kType;
+
+// static
+ByteString* ByteString::NewUninitialized(Store* store, uint64 size) {
+  void* block = store->AllocWithNestedArray<ByteString, char>(size);
+  return new(CHECK_NOTNULL(block)) ByteString(size);
+}
+
+// static
+ByteString* ByteString::New(Store* store, const StringPiece& bytes) {
+  ByteString* bs = NewUninitialized(store, bytes.size());
+  memcpy(bs->bytes_, bytes.data(), bytes.size());
+  return bs;
+}
+
+// static
+ByteString* ByteString::Concat(Store* store,
+                               ByteString* bs1, ByteString* bs2) {
+  CHECK_NOTNULL(bs1);
+  CHECK_NOTNULL(bs2);
+  if (bs1->size_ == 0) return bs2;
+  if (bs2->size_ == 0) return bs1;
+  ByteString* bs = NewUninitialized(store, bs1->size_ + bs2->size_);
+  memcpy(bs->bytes_, bs1->data_, bs1->size_);
+  memcpy(bs->bytes_ + bs1->size_, bs2->data_, bs2->size_);
+  return bs;
+}
+
+// static
+ByteString* ByteString::FromList(Store* store, Value list) {
+  // First pass: validate the list and count the bytes.
+  // The hare moves twice as fast to detect cyclic lists.
+  uint64 size = 0;
+  Value value = list.Deref();
+  Value hare = value;
+  while (value.type() == Value::LIST) {
+    List* cell = value.as<List>();
+    Value head = cell->head().Deref();
+    if (head.type() != Value::SMALL_INTEGER) return NULL;
+    const int64 code = IntValue(head);
+    if ((code < 0) || (code > 255)) return NULL;
+    ++size;
+    value = cell->tail().Deref();
+
+    for (int i = 0; i < 2; ++i)
+      if (hare.type() == Value::LIST)
+        hare = hare.as<List>()->tail().Deref();
+    if ((hare == value) && (value.type() == Value::LIST)) return NULL;
+  }
+  if (value != KAtomNil()) return NULL;
+
+  // Second pass: copy the bytes.
+  ByteString* bs = NewUninitialized(store, size);
+  value = list.Deref();
+  for (uint64 i = 0; i < size; ++i) {
+    List* cell = value.as<List>();
+    bs->bytes_[i] = static_cast<char>(IntValue(cell->head().Deref()));
+    value = cell->tail().Deref();
+  }
+  return bs;
+}
+
+ByteString* ByteString::Slice(Store* store, uint64 begin, uint64 end) {
+  CHECK_LE(begin, end);
+  CHECK_LE(end, size_);
+  if ((begin == 0) && (end == size_)) return this;
+  ByteString* owner = IsSlice() ? owner_ : this;
+  return new(CHECK_NOTNULL(store->Alloc<ByteString>()))
+      ByteString(owner, data_ + begin, end - begin);
+}
+
+int ByteString::Compare(const ByteString* other) const {
+  CHECK_NOTNULL(other);
+  const uint64 size = std::min(size_, other->size_);
+  const int cmp = memcmp(data_, other->data_, size);
+  if (cmp != 0) return cmp;
+  if (size_ == other->size_) return 0;
+  return (size_ < other->size_) ? -1 : 1;
+}
+
+uint64 ByteString::Hash() const {
+  // 64 bits FNV-1a
+  uint64 hash = 14695981039346656037ULL;
+  for (uint64 i = 0; i < size_; ++i) {
+    hash ^= static_cast<uint8>(data_[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+Value ByteString::ToList(Store* store) const {
+  // Builds the list from the end, one chunk at a time.
+  Value list = KAtomNil();
+  Value codes[List::kChunkSize];
+  uint64 end = size_;
+  while (end > 0) {
+    const uint64 begin =
+        (end > List::kChunkSize) ? (end - List::kChunkSize) : 0;
+    for (uint64 i = begin; i < end; ++i)
+      codes[i - begin] = Value::Integer(Get(i));
+    list = List::New(store, end - begin, codes, list);
+    end = begin;
+  }
+  return list;
+}
+
+// virtual
+bool ByteString::UnifyWith(UnificationContext* context, Value value) {
+  CHECK_NOTNULL(context);
+  return (value.type() == Value::BYTE_STRING)
+      && (Compare(value.as<ByteString>()) == 0);
+}
+
+// virtual
+bool ByteString::Equals(EqualityContext* context, Value value) {
+  return Compare(value.as<ByteString>()) == 0;
+}
+
+// virtual
+bool ByteString::StructuralHash(uint32* hash) {
+  *hash = MixHash(kType, Hash());
+  return true;
+}
+
+// virtual
+HeapValue* ByteString::MoveInternal(Store* store) {
+  if (!IsSlice()) return New(store, piece());
+
+  // The owner may already be a MovedValue: only use its address.
+  const uint64 offset = data_ - owner_->bytes_;
+  ByteString* owner = Value(owner_).Move(store).as<ByteString>();
+  return new(CHECK_NOTNULL(store->Alloc<ByteString>()))
+      ByteString(owner, owner->data_ + offset, size_);
+}
+
+// virtual
+void ByteString::ToASCII(ToASCIIContext* context, string* repr) {
+  CHECK_NOTNULL(repr);
+  repr->append("<ByteString \"");
+  repr->append(base::Escape(piece(), "\""));
+  repr->append("\">");
+}
+
+// virtual
+void ByteString::ToProtoBuf(oz_pb::Value* pb) {
+  CHECK_NOTNULL(pb);
+  pb->mutable_primitive()->set_type(oz_pb::Primitive::BYTE_STRING);
+  pb->mutable_primitive()->set_data(data_, size_);
+}
+
+// -----------------------------------------------------------------------------
+
+}  // namespace store
@@ -0,0 +1,122 @@
+#ifndef STORE_BYTE_STRING_H_
+#define STORE_BYTE_STRING_H_
+
+#include <string>
+using std::string;
+
+#include <glog/logging.h>
+
+#include "base/string_piece.h"
+using base::StringPiece;
+
+namespace store {
+
+// -----------------------------------------------------------------------------
+// ByteString
+//
+// Immutable sequence of bytes, stored inline in the store block.
+//
+// A slice does not copy any byte: it references the byte-string that owns the
+// buffer, and a window in this buffer. Slicing a slice references the
+// original owner directly, hence there is never more than one indirection.
+//
+class ByteString : public HeapValue {
+ public:
+  static const ValueType kType = Value::BYTE_STRING;
+
+  // ---------------------------------------------------------------------------
+  // Factory methods
+
+  // Copies the given bytes into a new byte-string.
+  static ByteString* New(Store* store, const StringPiece& bytes);
+
+  // Concatenates two byte-strings into a new byte-string.
+  static ByteString* Concat(Store* store, ByteString* bs1, ByteString* bs2);
+
+  // Builds a byte-string from a list of character codes.
+  //
+  // @param list A list of integers in the range 0..255, terminated by nil.
+  // @returns The new byte-string, or NULL if the value is not a determined
+  //     list of character codes.
+  static ByteString* FromList(Store* store, Value list);
+
+  // ---------------------------------------------------------------------------
+  // ByteString specific interface
+
+  uint64 size() const { return size_; }
+  const char* data() const { return data_; }
+  StringPiece piece() const { return StringPiece(data_, size_); }
+  uint8 Get(uint64 index) const {
+    CHECK_LT(index, size_);
+    return static_cast<uint8>(data_[index]);
+  }
+
+  // @returns True if this byte-string is a window on another byte-string.
+  bool IsSlice() const { return owner_ != NULL; }
+
+  // Slices this byte-string in O(1): the new byte-string shares this buffer.
+  // @param begin Index of the first byte of the slice.
+  // @param end Index past the last byte of the slice.
+  ByteString* Slice(Store* store, uint64 begin, uint64 end);
+
+  // Compares the content of this byte-string with another, byte-wise.
+  // @returns A negative, null or positive number, as memcmp().
+  int Compare(const ByteString* other) const;
+
+  // @returns A hash of the byte-string content.
+  uint64 Hash() const;
+
+  // @returns The list of character codes in this byte-string.
+  Value ToList(Store* store) const;
+
+  // ---------------------------------------------------------------------------
+  // Value API
+  virtual ValueType type() const throw() { return kType; }
+  virtual bool UnifyWith(UnificationContext* context, Value value);
+  virtual bool Equals(EqualityContext* context, Value value);
+  virtual bool StructuralHash(uint32* hash);
+  virtual HeapValue* MoveInternal(Store* store);
+
+  // ---------------------------------------------------------------------------
+  // Serialization
+  virtual void ToASCII(ToASCIIContext* context, string* repr);
+  virtual void ToProtoBuf(oz_pb::Value* pb);
+
+ private:  // ------------------------------------------------------------------
+
+  // Allocates a new byte-string with an uninitialized inline buffer.
+  static ByteString* NewUninitialized(Store* store, uint64 size);
+
+  // Initializes a byte-string owning its buffer.
+  explicit ByteString(uint64 size)
+      : size_(size), data_(bytes_), owner_(NULL) {
+  }
+
+  // Initializes a slice of the given owner.
+  ByteString(ByteString* owner, const char* data, uint64 size)
+      : size_(size), data_(data), owner_(CHECK_NOTNULL(owner)) {
+  }
+
+  virtual ~ByteString() {}
+
+  // ---------------------------------------------------------------------------
+  // Memory layout
+
+  const uint64 size_;
+
+  // First byte of this byte-string.
+  // Points into bytes_, or into the owner's buffer for a slice.
+  const char* const data_;
+
+  // For a slice, the byte-string owning the buffer, NULL otherwise.
+  ByteString* const owner_;
+
+  // Inline buffer, empty for slices.
+  char bytes_[];
+};
+
+// -----------------------------------------------------------------------------
+
+}  // namespace store
+
+#endif  // STORE_BYTE_STRING_H_
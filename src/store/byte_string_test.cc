@@ -0,0 +1,170 @@
+// Tests for byte-strings.
+#include "store/values.h"
+
+#include <gtest/gtest.h>
+
+namespace store {
+
+const uint64 kStoreSize = 1024 * 1024;
+
+class ByteStringTest : public testing::Test {
+ protected:
+  ByteStringTest()
+      : store_(kStoreSize) {
+  }
+
+  StaticStore store_;
+};
+
+TEST_F(ByteStringTest, Basic) {
+  ByteString* bs = ByteString::New(&store_, "hello");
+  EXPECT_EQ(5UL, bs->size());
+  EXPECT_FALSE(bs->IsSlice());
+  EXPECT_EQ('h', bs->Get(0));
+  EXPECT_EQ('o', bs->Get(4));
+  EXPECT_EQ("hello", bs->piece().as_string());
+  EXPECT_EQ("<ByteString \"hello\">", Value(bs).ToString());
+
+  ByteString* empty = ByteString::New(&store_, "");
+  EXPECT_EQ(0UL, empty->size());
+}
+
+TEST_F(ByteStringTest, InlineStorage) {
+  const uint64 free_before = store_.free();
+  ByteString::New(&store_, string(1000, 'x'));
+  EXPECT_GE(free_before - store_.free(), 1000UL);
+  EXPECT_LT(free_before - store_.free(), 1100UL);
+}
+
+TEST_F(ByteStringTest, Slice) {
+  ByteString* bs = ByteString::New(&store_, "hello world");
+  ByteString* world = bs->Slice(&store_, 6, 11);
+  EXPECT_TRUE(world->IsSlice());
+  EXPECT_EQ("world", world->piece().as_string());
+  EXPECT_EQ(bs->data() + 6, world->data());
+
+  // Slices of slices share the same buffer.
+  ByteString* orl = world->Slice(&store_, 1, 4);
+  EXPECT_EQ("orl", orl->piece().as_string());
+  EXPECT_EQ(bs->data() + 7, orl->data());
+
+  EXPECT_EQ(bs, bs->Slice(&store_, 0, bs->size()));
+  EXPECT_EQ(0UL, bs->Slice(&store_, 3, 3)->size());
+}
+
+TEST_F(ByteStringTest, Concat) {
+  ByteString* bs1 = ByteString::New(&store_, "foo");
+  ByteString* bs2 = ByteString::New(&store_, "barbaz");
+  ByteString* bs = ByteString::Concat(&store_, bs1, bs2->Slice(&store_, 0, 3));
+  EXPECT_EQ("foobar", bs->piece().as_string());
+  EXPECT_FALSE(bs->IsSlice());
+
+  ByteString* empty = ByteString::New(&store_, "");
+  EXPECT_EQ(bs1, ByteString::Concat(&store_, bs1, empty));
+  EXPECT_EQ(bs1, ByteString::Concat(&store_, empty, bs1));
+}
+
+TEST_F(ByteStringTest, CompareAndHash) {
+  ByteString* abc = ByteString::New(&store_, "abc");
+  ByteString* abd = ByteString::New(&store_, "abd");
+  ByteString* ab = ByteString::New(&store_, "ab");
+  ByteString* xabcx = ByteString::New(&store_, "xabcx");
+  ByteString* abc2 = xabcx->Slice(&store_, 1, 4);
+
+  EXPECT_EQ(0, abc->Compare(abc2));
+  EXPECT_LT(abc->Compare(abd), 0);
+  EXPECT_GT(abd->Compare(abc), 0);
+  EXPECT_LT(ab->Compare(abc), 0);
+  EXPECT_GT(abc->Compare(ab), 0);
+
+  EXPECT_EQ(abc->Hash(), abc2->Hash());
+  EXPECT_NE(abc->Hash(), abd->Hash());
+}
+
+TEST_F(ByteStringTest, Lists) {
+  ByteString* bs = ByteString::New(&store_, "Oz");
+  Value list = bs->ToList(&store_);
+  EXPECT_EQ("[79 122]", list.ToString());
+
+  ByteString* bs2 = ByteString::FromList(&store_, list);
+  ASSERT_TRUE(bs2 != NULL);
+  EXPECT_EQ("Oz", bs2->piece().as_string());
+
+  ByteString* empty = ByteString::FromList(&store_, KAtomNil());
+  ASSERT_TRUE(empty != NULL);
+  EXPECT_EQ(0UL, empty->size());
+
+  // Not a character.
+  Value values[2] = { Value::Integer(65), Value::Integer(256) };
+  EXPECT_TRUE(
+      ByteString::FromList(&store_, New::List(&store_, 2, values)) == NULL);
+
+  // Unterminated list.
+  Value stream = New::List(&store_, Value::Integer(65), New::Free(&store_));
+  EXPECT_TRUE(ByteString::FromList(&store_, stream) == NULL);
+
+  // Cyclic list.
+  Variable* tail = Variable::New(&store_);
+  Value cycle = New::List(&store_, Value::Integer(65), tail);
+  ASSERT_TRUE(Unify(tail, cycle));
+  EXPECT_TRUE(ByteString::FromList(&store_, cycle) == NULL);
+}
+
+TEST_F(ByteStringTest, Unify) {
+  Value bs1 = New::ByteString(&store_, "text");
+  Value bs2 = ByteString::New(&store_, "context")->Slice(&store_, 3, 7);
+  Value bs3 = New::ByteString(&store_, "test");
+
+  EXPECT_TRUE(Unify(bs1, bs2));
+  EXPECT_TRUE(Equals(bs1, bs2));
+  EXPECT_FALSE(Unify(bs1, bs3));
+  EXPECT_FALSE(Equals(bs1, bs3));
+  EXPECT_FALSE(Unify(bs1, New::String(&store_, "text")));
+
+  Value var = New::Free(&store_);
+  EXPECT_TRUE(Unify(var, bs1));
+  EXPECT_TRUE(Unify(var, bs2));
+}
+
+TEST_F(ByteStringTest, MoveKeepsSharing) {
+  ByteString* bs = ByteString::New(&store_, "hello world");
+  Value values[2] = {
+    bs->Slice(&store_, 0, 5),
+    bs->Slice(&store_, 6, 11),
+  };
+  Value tuple = New::Tuple(&store_, 2, values);
+
+  StaticStore store2(kStoreSize);
+  Value moved = tuple.Move(&store2);
+  ByteString* hello = moved.TupleGet(0).as<ByteString>();
+  ByteString* world = moved.TupleGet(1).as<ByteString>();
+  EXPECT_TRUE(store2.Contains(hello));
+  EXPECT_TRUE(store2.Contains(hello->data()));
+  EXPECT_EQ("hello", hello->piece().as_string());
+  EXPECT_EQ("world", world->piece().as_string());
+  EXPECT_EQ(hello->data() + 6, world->data());
+}
+
+TEST_F(ByteStringTest, ToProtoBuf) {
+  const string bytes("a\0\xffz", 4);
+  ByteString* bs = ByteString::New(&store_, bytes);
+  oz_pb::Value pb;
+  bs->ToProtoBuf(&pb);
+  EXPECT_EQ(oz_pb::Primitive::BYTE_STRING, pb.primitive().type());
+  EXPECT_FALSE(pb.primitive().has_text());
+  EXPECT_EQ(bytes, pb.primitive().data());
+
+  // A slice only serializes its own bytes.
+  oz_pb::Value slice_pb;
+  bs->Slice(&store_, 1, 3)->ToProtoBuf(&slice_pb);
+  EXPECT_EQ(oz_pb::Primitive::BYTE_STRING, slice_pb.primitive().type());
+  EXPECT_EQ(bytes.substr(1, 2), slice_pb.primitive().data());
+
+  // Strings remain text.
+  oz_pb::Value string_pb;
+  String::Get(&store_, "ab")->ToProtoBuf(&string_pb);
+  EXPECT_EQ(oz_pb::Primitive::STRING, string_pb.primitive().type());
+  EXPECT_EQ("ab", string_pb.primitive().text());
+}
+
+}  // namespace store
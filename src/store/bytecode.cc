@@ -95,6 +95,56 @@ static const OpcodeSpec kOpcodeSpecTable[] = {
   OpcodeSpec("number_int_divide",
              Bytecode::NUMBER_INT_DIVIDE,
              "in", "int1", "int2"),
+  OpcodeSpec("number_int_modulo",
+             Bytecode::NUMBER_INT_MODULO,
+             "in", "int1", "int2"),
+  OpcodeSpec("number_int_power",
+             Bytecode::NUMBER_INT_POWER,
+             "in", "base", "exponent"),
+  OpcodeSpec("number_int_bit_and",
+             Bytecode::NUMBER_INT_BIT_AND,
+             "in", "int1", "int2"),
+  OpcodeSpec("number_int_bit_or",
+             Bytecode::NUMBER_INT_BIT_OR,
+             "in", "int1", "int2"),
+  OpcodeSpec("number_int_bit_xor",
+             Bytecode::NUMBER_INT_BIT_XOR,
+             "in", "int1", "int2"),
+  OpcodeSpec("number_int_shift_left",
+             Bytecode::NUMBER_INT_SHIFT_LEFT,
+             "in", "int", "nbits"),
+  OpcodeSpec("number_int_shift_right",
+             Bytecode::NUMBER_INT_SHIFT_RIGHT,
+             "in", "int", "nbits"),
+
+  // Float operations:
+  OpcodeSpec("number_float_inverse",
+             Bytecode::NUMBER_FLOAT_INVERSE,
+             "in", "float"),
+  OpcodeSpec("number_float_add",
+             Bytecode::NUMBER_FLOAT_ADD,
+             "in", "float1", "float2"),
+  OpcodeSpec("number_float_subtract",
+             Bytecode::NUMBER_FLOAT_SUBTRACT,
+             "in", "float1", "float2"),
+  OpcodeSpec("number_float_multiply",
+             Bytecode::NUMBER_FLOAT_MULTIPLY,
+             "in", "float1", "float2"),
+  OpcodeSpec("number_float_divide",
+             Bytecode::NUMBER_FLOAT_DIVIDE,
+             "in", "float1", "float2"),
+  OpcodeSpec("number_float_less_than",
+             Bytecode::NUMBER_FLOAT_LESS_THAN,
+             "in", "float1", "float2"),
+  OpcodeSpec("number_float_less_or_equal",
+             Bytecode::NUMBER_FLOAT_LESS_OR_EQUAL,
+             "in", "float1", "float2"),
+  OpcodeSpec("number_int_to_float",
+             Bytecode::NUMBER_INT_TO_FLOAT,
+             "in", "int"),
+  OpcodeSpec("number_float_to_int",
+             Bytecode::NUMBER_FLOAT_TO_INT,
+             "in", "float"),
 
   OpcodeSpec("number_bool_negate",
              Bytecode::NUMBER_BOOL_NEGATE,
@@ -110,12 +160,23 @@ static const OpcodeSpec kOpcodeSpecTable[] = {
              "in", "bool1", "bool2"),
 };
 
+// The opcodes listed by STORE_BYTECODE_OPCODES.
+static const Bytecode::OpcodeType kOpcodeList[] = {
+#define OPCODE_LIST_ENTRY(Opcode) Bytecode::Opcode,
+  STORE_BYTECODE_OPCODES(OPCODE_LIST_ENTRY)
+#undef OPCODE_LIST_ENTRY
+};
+
 OpcodeSpecMap::OpcodeSpecMap() {
   CHECK_EQ(static_cast<uint64>(Bytecode::OPCODE_TYPE_COUNT),
            ArraySize(kOpcodeSpecTable));
+  CHECK_EQ(static_cast<uint64>(Bytecode::OPCODE_TYPE_COUNT),
+           ArraySize(kOpcodeList));
   for (uint i = 0; i < ArraySize(kOpcodeSpecTable); ++i) {
     const OpcodeSpec& spec = kOpcodeSpecTable[i];
     CHECK_EQ(Bytecode::OpcodeType(i), spec.opcode);
+    CHECK_EQ(Bytecode::OpcodeType(i), kOpcodeList[i])
+        << "STORE_BYTECODE_OPCODES is out of order";
     (*this)[spec.name] = spec;
   }
 }
@@ -11,6 +11,29 @@ using std::vector;
 
 namespace store {
 
+// The opcodes, in the order of Bytecode::OpcodeType, for building tables
+// indexed by opcode.
+#define STORE_BYTECODE_OPCODES(V)                                             \
+  V(NO_OPERATION) V(LOAD) V(UNIFY) V(TRY_UNIFY) V(UNIFY_RECORD_FIELD)         \
+  V(BRANCH) V(BRANCH_IF) V(BRANCH_UNLESS) V(BRANCH_SWITCH_LITERAL) V(CALL)    \
+  V(CALL_TAIL) V(CALL_NATIVE) V(RETURN) V(EXN_PUSH_CATCH)                     \
+  V(EXN_PUSH_FINALLY) V(EXN_POP) V(EXN_RAISE) V(EXN_RESET) V(EXN_RERAISE)     \
+  V(NEW_VARIABLE) V(NEW_NAME) V(NEW_CELL) V(NEW_ARRAY) V(NEW_ARITY)           \
+  V(NEW_LIST) V(NEW_TUPLE) V(NEW_RECORD) V(NEW_PROC) V(NEW_THREAD)            \
+  V(GET_VALUE_TYPE) V(ACCESS_CELL) V(ACCESS_ARRAY) V(ACCESS_RECORD)           \
+  V(ACCESS_RECORD_LABEL) V(ACCESS_RECORD_ARITY) V(ACCESS_OPEN_RECORD_ARITY)   \
+  V(ASSIGN_CELL) V(ASSIGN_ARRAY) V(TEST_IS_DET) V(TEST_IS_RECORD)             \
+  V(TEST_EQUALITY) V(TEST_LESS_THAN) V(TEST_LESS_OR_EQUAL)                    \
+  V(TEST_ARITY_EXTENDS) V(NUMBER_INT_INVERSE) V(NUMBER_INT_ADD)               \
+  V(NUMBER_INT_SUBTRACT) V(NUMBER_INT_MULTIPLY) V(NUMBER_INT_DIVIDE)          \
+  V(NUMBER_INT_MODULO) V(NUMBER_INT_POWER) V(NUMBER_INT_BIT_AND)              \
+  V(NUMBER_INT_BIT_OR) V(NUMBER_INT_BIT_XOR) V(NUMBER_INT_SHIFT_LEFT)         \
+  V(NUMBER_INT_SHIFT_RIGHT) V(NUMBER_FLOAT_INVERSE) V(NUMBER_FLOAT_ADD)       \
+  V(NUMBER_FLOAT_SUBTRACT) V(NUMBER_FLOAT_MULTIPLY) V(NUMBER_FLOAT_DIVIDE)    \
+  V(NUMBER_FLOAT_LESS_THAN) V(NUMBER_FLOAT_LESS_OR_EQUAL)                     \
+  V(NUMBER_INT_TO_FLOAT) V(NUMBER_FLOAT_TO_INT) V(NUMBER_BOOL_NEGATE)         \
+  V(NUMBER_BOOL_AND_THEN) V(NUMBER_BOOL_OR_ELSE) V(NUMBER_BOOL_XOR)
+
 // Bytecode representation
 struct Bytecode {
  public:
@@ -81,11 +104,31 @@ struct Bytecode {
 
     TEST_ARITY_EXTENDS,
 
+    // The inverse, add, subtract, multiply and divide instructions compute on
+    // floats too, when both operands are floats, as do TEST_LESS_THAN and
+    // TEST_LESS_OR_EQUAL.
     NUMBER_INT_INVERSE,
     NUMBER_INT_ADD,
     NUMBER_INT_SUBTRACT,
     NUMBER_INT_MULTIPLY,
     NUMBER_INT_DIVIDE,
+    NUMBER_INT_MODULO,
+    NUMBER_INT_POWER,
+    NUMBER_INT_BIT_AND,
+    NUMBER_INT_BIT_OR,
+    NUMBER_INT_BIT_XOR,
+    NUMBER_INT_SHIFT_LEFT,
+    NUMBER_INT_SHIFT_RIGHT,
+
+    NUMBER_FLOAT_INVERSE,
+    NUMBER_FLOAT_ADD,
+    NUMBER_FLOAT_SUBTRACT,
+    NUMBER_FLOAT_MULTIPLY,
+    NUMBER_FLOAT_DIVIDE,
+    NUMBER_FLOAT_LESS_THAN,
+    NUMBER_FLOAT_LESS_OR_EQUAL,
+    NUMBER_INT_TO_FLOAT,
+    NUMBER_FLOAT_TO_INT,  // truncates
 
     NUMBER_BOOL_NEGATE,
     NUMBER_BOOL_AND_THEN,  // lazy
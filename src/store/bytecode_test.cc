@@ -136,20 +136,23 @@ TEST_F(BytecodeTest, Loop) {
   const string source =
       "X = {NewCell 5}"
       "Main = proc("
-      "  nlocals: 3"
+      "  nlocals: 4"
       "  bytecode: segment("
       "    l0 := array(size:1 init:_)"
+      "    l3 := array(size:2 init:_)"
       "  Loop:"
       "    l1 := @X"
       "    l0[0] := l1"
       "    call_native(name:print params:l0)"
-      "    call_native(name:is_zero params:l0)"
-      "    l2 := l0[0]"
+      "    l3[0] := l1"
+      "    var(in:l2)"
+      "    l3[1] := l2"
+      "    call_native(name:is_zero params:l3)"
       "    cond_branch(to:End cond:l2)"
-      "    l0[0] := l1"
-      "    call_native(name:decrement params:l0)"
-      "    l1 := l0[0]"
-      "    @X := l1"
+      "    var(in:l2)"
+      "    l3[1] := l2"
+      "    call_native(name:decrement params:l3)"
+      "    @X := l2"
       "    branch(to:Loop)"
       "  End:"
       "    return()"
@@ -0,0 +1,408 @@
+// Benchmarks procedure calls of the interpreter, on deep recursions:
+//  - a recursive factorial, one call per level;
+//  - a doubly recursive Fibonacci, dominated by calls and returns;
+//  - a parallel Fibonacci, spawning a thread for one of the recursive calls
+//    above a cutoff, on one engine with --workers workers;
+// native calls, in a loop decrementing a counter with a native;
+// and try blocks, in a loop decrementing a counter in a try block.
+// Reports the store space allocated per call.
+// With several workers, each other benchmark runs on several engines in
+// parallel.
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "store/engine.h"
+#include "store/values.h"
+
+DEFINE_int64(
+    factorial_of,
+    20,
+    "Computes the factorial of this number, recursively."
+);
+
+DEFINE_int64(
+    factorial_runs,
+    100000,
+    "How many times to compute the factorial."
+);
+
+DEFINE_int64(
+    fibonacci_of,
+    25,
+    "Computes this Fibonacci number, with a doubly recursive procedure."
+);
+
+DEFINE_int64(
+    fibonacci_cutoff,
+    15,
+    "The parallel Fibonacci computes the numbers up to this one sequentially."
+);
+
+DEFINE_int64(
+    native_calls,
+    10000000,
+    "Number of calls of the native decrement."
+);
+
+DEFINE_int64(
+    try_blocks,
+    10000000,
+    "Number of try blocks entered."
+);
+
+DEFINE_int64(
+    workers,
+    1,
+    "Number of OS threads running each benchmark, each with its own engine, "
+    "or the threads of the parallel Fibonacci, on one engine."
+);
+
+namespace store {
+
+const uint64 kStoreSize = 1024 * 1024 * 1024;  // 1GB
+
+namespace {
+
+Operand Local(int index) {
+  return Operand(Register(Register::LOCAL, index));
+}
+
+Operand Param(int index) {
+  return Operand(Register(Register::PARAM, index));
+}
+
+Operand ArrayRegister(int index) {
+  return Operand(Register(Register::ARRAY, index));
+}
+
+Operand Immediate(int64 integer) {
+  return Operand(Value::Integer(integer));
+}
+
+// Appends a recursive call {Self Self N Result}, where Self is p0.
+void AppendRecursiveCall(const Operand& n, const Operand& result,
+                         vector<Bytecode>* code) {
+  const Operand array_array(Register(Register::ARRAY_ARRAY));
+  code->push_back(Bytecode(Bytecode::NEW_VARIABLE, result));
+  code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, array_array, Immediate(3), Immediate(0)));
+  code->push_back(Bytecode(Bytecode::LOAD, ArrayRegister(0), Param(0)));
+  code->push_back(Bytecode(Bytecode::LOAD, ArrayRegister(1), n));
+  code->push_back(Bytecode(Bytecode::LOAD, ArrayRegister(2), result));
+  code->push_back(Bytecode(Bytecode::CALL, Param(0), array_array));
+}
+
+// Builds a procedure Factorial(Self N Result):
+//   if 0 < N:
+//     {Self Self N-1 R}
+//     Result = N * R
+//   else:
+//     Result = 1
+Closure* NewFactorialProc(Store* store) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(0), Immediate(0), Param(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH_IF, Local(0), Immediate(4)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(2), Immediate(1)));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(1), Param(1),
+               Immediate(1)));
+  AppendRecursiveCall(Local(1), Local(2), code.get());
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_MULTIPLY, Local(3), Param(1), Local(2)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(2), Local(3)));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  return Closure::New(store, code, 3, 4, 0);
+}
+
+// Builds a procedure Fibonacci(Self N Result):
+//   if 1 < N:
+//     {Self Self N-1 R1}
+//     {Self Self N-2 R2}
+//     Result = R1 + R2
+//   else:
+//     Result = N
+Closure* NewFibonacciProc(Store* store) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(0), Immediate(1), Param(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH_IF, Local(0), Immediate(4)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(2), Param(1)));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(1), Param(1),
+               Immediate(1)));
+  AppendRecursiveCall(Local(1), Local(2), code.get());
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(3), Param(1),
+               Immediate(2)));
+  AppendRecursiveCall(Local(3), Local(4), code.get());
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD, Local(5), Local(2), Local(4)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(2), Local(5)));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  return Closure::New(store, code, 3, 6, 0);
+}
+
+// Builds a procedure ParallelFibonacci(Self N Result), where Fibonacci is the
+// sequential procedure built by NewFibonacciProc():
+//   if Cutoff < N:
+//     R1 := new variable
+//     thread {Self Self N-1 R1}
+//     {Self Self N-2 R2}
+//     Result = R1 + R2
+//   else:
+//     {Fibonacci Fibonacci N Result}
+Closure* NewParallelFibonacciProc(Store* store, Closure* fibonacci,
+                                  int64 cutoff) {
+  const Operand array_array(Register(Register::ARRAY_ARRAY));
+  const Operand sequential = Operand(Value(fibonacci));
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(0), Immediate(cutoff),
+               Param(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH_IF, Local(0), Immediate(8)));
+  code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, array_array, Immediate(3), Immediate(0)));
+  code->push_back(Bytecode(Bytecode::LOAD, ArrayRegister(0), sequential));
+  code->push_back(Bytecode(Bytecode::LOAD, ArrayRegister(1), Param(1)));
+  code->push_back(Bytecode(Bytecode::LOAD, ArrayRegister(2), Param(2)));
+  code->push_back(Bytecode(Bytecode::CALL, sequential, array_array));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(1), Param(1),
+               Immediate(1)));
+  code->push_back(Bytecode(Bytecode::NEW_VARIABLE, Local(2)));
+  code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Local(3), Immediate(3), Param(0)));
+  code->push_back(
+      Bytecode(Bytecode::ASSIGN_ARRAY, Local(3), Immediate(1), Local(1)));
+  code->push_back(
+      Bytecode(Bytecode::ASSIGN_ARRAY, Local(3), Immediate(2), Local(2)));
+  code->push_back(Bytecode(Bytecode::NEW_THREAD, Local(4), Param(0), Local(3)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(5), Param(1),
+               Immediate(2)));
+  AppendRecursiveCall(Local(5), Local(6), code.get());
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD, Local(7), Local(2), Local(6)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(2), Local(7)));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  return Closure::New(store, code, 3, 8, 0);
+}
+
+// Builds a procedure Countdown(N Result), calling the native decrement
+// until the counter reaches 0. The result parameter of the native holds the
+// expected result: the native call checks it without allocating a variable.
+//   l0 := array(size:2 init:N)
+//   l1 := N
+//   do:
+//     l1 := l1 - 1
+//     l0[1] := l1
+//     call_native(name:decrement params:l0)
+//     l0[0] := l1
+//   while 0 < l1
+//   Result = l1
+Closure* NewCountdownProc(Store* store) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Local(0), Immediate(2), Param(0)));
+  code->push_back(Bytecode(Bytecode::LOAD, Local(1), Param(0)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(1), Local(1),
+               Immediate(1)));
+  code->push_back(
+      Bytecode(Bytecode::ASSIGN_ARRAY, Local(0), Immediate(1), Local(1)));
+  code->push_back(
+      Bytecode(Bytecode::CALL_NATIVE, Operand(Atom::Get("decrement")),
+               Local(0)));
+  code->push_back(
+      Bytecode(Bytecode::ASSIGN_ARRAY, Local(0), Immediate(0), Local(1)));
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(2), Immediate(0), Local(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH_IF, Local(2), Immediate(2)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(1)));
+  return Closure::New(store, code, 2, 3, 0);
+}
+
+// Builds a procedure Countdown(N Result), decrementing the counter in a try
+// block until it reaches 0:
+//   l0 := N
+//   do:
+//     try: l0 := l0 - 1
+//     catch: Result = l0
+//   while 0 < l0
+//   Result = l0
+Closure* NewTryCountdownProc(Store* store) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(Bytecode(Bytecode::LOAD, Local(0), Param(0)));
+  code->push_back(Bytecode(Bytecode::EXN_PUSH_CATCH, Immediate(6)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(0), Local(0),
+               Immediate(1)));
+  code->push_back(Bytecode(Bytecode::EXN_POP));
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(1), Immediate(0), Local(0)));
+  code->push_back(Bytecode(Bytecode::BRANCH_IF, Local(1), Immediate(1)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(0)));
+  return Closure::New(store, code, 2, 2, 0);
+}
+
+// Runs the procedure P(Self N Result) in a new thread until it terminates.
+// @returns The result.
+Value Run(Store* store, Engine* engine, Closure* proc, int64 n) {
+  Value result = New::Free(store);
+  Array* params = Array::New(store, 3, proc);
+  params->Assign(1, Value::Integer(n));
+  params->Assign(2, result);
+
+  New::Thread(store, engine, proc, params, store);
+  engine->Run();
+  return result.Deref();
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+int64 Fibonacci(int64 n) {
+  return (n < 2) ? n : Fibonacci(n - 1) + Fibonacci(n - 2);
+}
+
+void Report(const char* name, int64 ncalls, double seconds,
+            uint64 allocated) {
+  printf("%s: %ld calls in %.3fs, %.1f ns per call, %.1f bytes per call\n",
+         name, ncalls, seconds, seconds * 1e9 / ncalls,
+         static_cast<double>(allocated) / ncalls);
+}
+
+}  // namespace
+
+void RecursiveFactorialBenchmark(StaticStore* store) {
+  Closure* const factorial = NewFactorialProc(store);
+  const int64 n = FLAGS_factorial_of;
+  int64 expected = 1;
+  for (int64 i = 2; i <= n; ++i) expected *= i;
+
+  Engine engine;
+  const uint64 free = store->free();
+  const auto start = std::chrono::steady_clock::now();
+  for (int64 i = 0; i < FLAGS_factorial_runs; ++i) {
+    const Value result = Run(store, &engine, factorial, n);
+    CHECK_EQ(expected, IntValue(result));
+  }
+  const double seconds = SecondsSince(start);
+  Report("recursive factorial", (n + 1) * FLAGS_factorial_runs, seconds,
+         free - store->free());
+}
+
+void FibonacciBenchmark(StaticStore* store) {
+  Closure* const fibonacci = NewFibonacciProc(store);
+  const int64 n = FLAGS_fibonacci_of;
+  // Fibonacci(N) makes 2 * Fibonacci(N + 1) - 1 calls.
+  const int64 ncalls = 2 * Fibonacci(n + 1) - 1;
+
+  Engine engine;
+  const uint64 free = store->free();
+  const auto start = std::chrono::steady_clock::now();
+  const Value result = Run(store, &engine, fibonacci, n);
+  const double seconds = SecondsSince(start);
+  CHECK_EQ(Fibonacci(n), IntValue(result));
+  Report("fibonacci", ncalls, seconds, free - store->free());
+}
+
+// Runs the threads of the parallel Fibonacci on --workers workers of one
+// engine, in a single store.
+void ParallelFibonacciBenchmark(StaticStore* store) {
+  const int64 n = FLAGS_fibonacci_of;
+  Closure* const fibonacci = NewParallelFibonacciProc(
+      store, NewFibonacciProc(store), FLAGS_fibonacci_cutoff);
+  const int64 ncalls = 2 * Fibonacci(n + 1) - 1;
+
+  Engine engine;
+  engine.set_workers(FLAGS_workers);
+  const uint64 free = store->free();
+  const auto start = std::chrono::steady_clock::now();
+  const Value result = Run(store, &engine, fibonacci, n);
+  const double seconds = SecondsSince(start);
+  CHECK_EQ(Fibonacci(n), IntValue(result));
+  Report("parallel fibonacci", ncalls, seconds, free - store->free());
+}
+
+void NativeCallBenchmark(StaticStore* store) {
+  Closure* const countdown = NewCountdownProc(store);
+  const int64 ncalls = FLAGS_native_calls;
+
+  Engine engine;
+  const uint64 free = store->free();
+  const Value result = New::Free(store);
+  Array* const params = Array::New(store, 2, Value::Integer(ncalls));
+  params->Assign(1, result);
+  const auto start = std::chrono::steady_clock::now();
+  New::Thread(store, &engine, countdown, params, store);
+  engine.Run();
+  const double seconds = SecondsSince(start);
+  CHECK_EQ(0, IntValue(result));
+  Report("native decrement", ncalls, seconds, free - store->free());
+}
+
+void TryBlockBenchmark(StaticStore* store) {
+  Closure* const countdown = NewTryCountdownProc(store);
+  const int64 ntries = FLAGS_try_blocks;
+
+  Engine engine;
+  const uint64 free = store->free();
+  const Value result = New::Free(store);
+  Array* const params = Array::New(store, 2, Value::Integer(ntries));
+  params->Assign(1, result);
+  const auto start = std::chrono::steady_clock::now();
+  New::Thread(store, &engine, countdown, params, store);
+  engine.Run();
+  const double seconds = SecondsSince(start);
+  CHECK_EQ(0, IntValue(result));
+  Report("try block", ntries, seconds, free - store->free());
+}
+
+// Runs a benchmark on --workers OS threads, concurrently. Each worker runs
+// its own engine, in its own store.
+void RunOnWorkers(void (*benchmark)(StaticStore*)) {
+  const auto start = std::chrono::steady_clock::now();
+  vector<std::thread> workers;
+  for (int64 i = 0; i < FLAGS_workers; ++i) {
+    workers.emplace_back([benchmark]() {
+      StaticStore store(kStoreSize);
+      benchmark(&store);
+    });
+  }
+  for (std::thread& worker : workers)
+    worker.join();
+  const double seconds = SecondsSince(start);
+  if (FLAGS_workers > 1)
+    printf("%ld workers in %.3fs\n", FLAGS_workers, seconds);
+}
+
+}  // namespace store
+
+int main(int argc, char** argv) {
+  ::google::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  store::RunOnWorkers(&store::RecursiveFactorialBenchmark);
+  store::RunOnWorkers(&store::FibonacciBenchmark);
+  {
+    store::StaticStore store(store::kStoreSize);
+    store::ParallelFibonacciBenchmark(&store);
+  }
+  store::RunOnWorkers(&store::NativeCallBenchmark);
+  store::RunOnWorkers(&store::TryBlockBenchmark);
+  return EXIT_SUCCESS;
+}
@@ -27,14 +27,15 @@ class Cell : public HeapValue {
   // ---------------------------------------------------------------------------
   // Cell specific API
 
+  // Workers access cells in parallel: see Value::AtomicLoad().
   inline
   Value Access() const {
-    return ref_;
+    return Value::AtomicLoad(&ref_);
   }
 
   inline
   void Assign(Value value) {
-    ref_ = value;
+    Value::AtomicStore(&ref_, value);
   }
 
   // ---------------------------------------------------------------------------
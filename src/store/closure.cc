@@ -5,6 +5,7 @@ using boost::format;
 
 #include "store/bytecode.h"
 #include "store/thread.h"
+#include "store/verifier.h"
 
 namespace store {
 
@@ -13,23 +14,54 @@ namespace store {
 
 const Value::ValueType Closure::kType;
 
+// static
+Closure* Closure::New(Store* store,
+                      const shared_ptr<vector<Bytecode> >& bytecode,
+                      int nparams, int nlocals, int nclosures,
+                      vector<string>* errors) {
+  CHECK_NOTNULL(bytecode.get());
+  vector<string> diagnostics;
+  if ((nparams < 0) || (nlocals < 0) || (nclosures < 0)) {
+    diagnostics.push_back(
+        (format("invalid register counts: nparams=%d nlocals=%d "
+                "nclosures=%d") % nparams % nlocals % nclosures).str());
+  } else {
+    VerifyBytecode(*bytecode, nparams, nlocals, nclosures, &diagnostics);
+  }
+  if (!diagnostics.empty()) {
+    if (errors != NULL) {
+      errors->insert(errors->end(), diagnostics.begin(), diagnostics.end());
+    } else {
+      LOG(ERROR) << "Procedure not created: invalid bytecode";
+      for (const string& diagnostic : diagnostics)
+        LOG(ERROR) << "  " << diagnostic;
+    }
+    return NULL;
+  }
+  return new(CHECK_NOTNULL(store->Alloc<Closure>()))
+      Closure(bytecode, nparams, nlocals, nclosures);
+}
+
 Closure::Closure(const shared_ptr<vector<Bytecode> >& bytecode,
                  int nparams, int nlocals, int nclosures)
     : bytecode_(bytecode),
+      packed_code_(new PackedCode(*CHECK_NOTNULL(bytecode.get()))),
       nparams_(nparams),
       nlocals_(nlocals),
       nclosures_(nclosures),
       environment_(NULL) {
-  CHECK_NOTNULL(bytecode.get());
 }
 
 Closure::Closure(const Closure* closure, Array* environment)
     : bytecode_(CHECK_NOTNULL(closure)->bytecode_),
+      packed_code_(closure->packed_code_),
       nparams_(closure->nparams_),
       nlocals_(closure->nlocals_),
       nclosures_(CHECK_NOTNULL(environment)->size()),
       environment_(environment) {
   CHECK(closure->environment_ == NULL);
+  CHECK_GE(environment->size(), static_cast<uint64>(closure->nclosures_))
+      << "Environment smaller than verified";
   CHECK_NOTNULL(bytecode_.get());
 }
 
@@ -60,6 +92,9 @@ Value Closure::Optimize(OptimizeContext* context) {
     OptimizeOperand(&bytecode_->at(i).operand2, context);
     OptimizeOperand(&bytecode_->at(i).operand3, context);
   }
+  vector<Value>* constants = packed_code_->mutable_constants();
+  for (uint64 i = 0; i < constants->size(); ++i)
+    constants->at(i) = context->Optimize(constants->at(i));
   // TODO: Clarify environment_ being NULL-able or not
   if (environment_ != NULL)
     CHECK(context->Optimize(environment_) == environment_);
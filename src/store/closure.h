@@ -20,6 +20,7 @@ namespace store {
 
 class Bytecode;
 struct Operand;
+class PackedCode;
 
 class Closure : public HeapValue {
  public:
@@ -27,12 +28,16 @@ class Closure : public HeapValue {
 
   // ---------------------------------------------------------------------------
   // Factory methods
-  static inline Closure* New(Store* store,
-                             const shared_ptr<vector<Bytecode> >& bytecode,
-                             int nparams, int nlocals, int nclosures) {
-    return new(CHECK_NOTNULL(store->Alloc<Closure>()))
-        Closure(bytecode, nparams, nlocals, nclosures);
-  }
+
+  // Builds an abstract procedure, or a procedure without closure.
+  // @param errors Where to append the diagnostics of VerifyBytecode(), or
+  //     NULL to log them.
+  // @returns NULL if a register count is negative, or if the bytecode does
+  //     not pass VerifyBytecode().
+  static Closure* New(Store* store,
+                      const shared_ptr<vector<Bytecode> >& bytecode,
+                      int nparams, int nlocals, int nclosures,
+                      vector<string>* errors = NULL);
 
   static inline Closure* New(Store* store,
                              const Closure* closure, Array* environment) {
@@ -43,11 +48,26 @@ class Closure : public HeapValue {
   // ---------------------------------------------------------------------------
   // Closure specific interface
 
+  // The bytecode of the procedure, for debugging and serialization.
   const vector<Bytecode>& bytecode() const { return *bytecode_; }
+
+  // The packed form of the bytecode, executed and quickened by the
+  // interpreter.
+  PackedCode* packed_code() const { return packed_code_.get(); }
+
   Array* environment() const { return environment_; }
+  uint64 nparams() const { return nparams_; }
   uint64 nlocals() const { return nlocals_; }
   uint64 nclosures() const { return nclosures_; }
 
+  // @returns Whether a frame of this procedure may be entered with the given
+  //     parameters: the verifier proved the register operands within the
+  //     parameters and the environment the procedure declares.
+  bool CanCall(const Array* parameters) const {
+    return (parameters->size() >= static_cast<uint64>(nparams_))
+        && ((nclosures_ == 0) || (environment_ != NULL));
+  }
+
   // ---------------------------------------------------------------------------
   // Value API
 
@@ -65,7 +85,7 @@ class Closure : public HeapValue {
  private:  // ------------------------------------------------------------------
 
   // Builds an abstract procedure or a procedure without closure.
-  // @param bytecode The bytecode for the procedure.
+  // @param bytecode The verified bytecode for the procedure.
   // @param nparams How many parameters this procedure takes.
   // @param nlocals How many local registers this procedure requires.
   Closure(const shared_ptr<vector<Bytecode> >& bytecode,
@@ -89,6 +109,10 @@ class Closure : public HeapValue {
 
   const shared_ptr<vector<Bytecode> > bytecode_;
 
+  // Packed from bytecode_ when the abstract procedure is built, and shared
+  // with the closures built from it.
+  const shared_ptr<PackedCode> packed_code_;
+
   // Number of parameters.
   const int nparams_;
 
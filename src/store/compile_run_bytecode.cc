@@ -36,8 +36,12 @@ void CompileRun() {
   LOG(INFO) << "Generated closure:\n" << Value(closure).ToString();
 
   Engine engine;
-  // Value thread1 =
-  New::Thread(&store, &engine, closure, Array::EmptyArray, &store);
+  const Value thread =
+      New::Thread(&store, &engine, closure, Array::EmptyArray, &store);
+  if (!thread.IsDefined()) {
+    LOG(ERROR) << "Cannot run the procedure";
+    return;
+  }
 
   engine.Run();
 }
@@ -24,8 +24,9 @@ Closure* Compiler::CompileProcedure(OzValue desc, vector<string>* env) {
   // Creates a nested environment with the procedure parameters.
   NestedEnvironment nested_env(this);
 
-  if (desc.HasFeature("params")) {
-    OzValue params = desc["params"];
+  Value params_value;
+  if (desc.TryGet("params", &params_value)) {
+    OzValue params(params_value);
     CHECK(params.IsTuple()) << "procedure params must be a tuple.";
     const uint64 nparams = params.size();
     for (uint i = 1; i <= nparams; ++i) {
@@ -40,9 +41,8 @@ Closure* Compiler::CompileProcedure(OzValue desc, vector<string>* env) {
   const uint64 nparams = environment_->nparams();
   const uint64 nlocals = environment_->nlocals();
   const uint64 nclosures = environment_->nclosures();
-  Closure* const closure =
-      New::Closure(store_, segment_, nparams, nlocals, nclosures)
-      .as<Closure>();
+  Closure* const closure = CHECK_NOTNULL(
+      Closure::New(store_, segment_, nparams, nlocals, nclosures));
 
   // Fills in the environment linking table.
   const vector<string>&  names = environment_->closure_symbol_names();
@@ -67,8 +67,9 @@ void Compiler::CompileCall(OzValue desc, ExpressionResult* result) {
   ScopedTemp params_temp(environment_);
   Operand params_op;  // Invalid by default.
   // Evaluate the parameters into an array of values
-  if (desc.HasFeature("params")) {
-    OzValue params_desc = desc["params"];
+  Value params_value;
+  if (desc.TryGet("params", &params_value)) {
+    OzValue params_desc(params_value);
     CHECK(params_desc.IsTuple()) << "call params must be a tuple.";
     const uint64 nparams = params_desc.size();
     if (nparams > 0) {
@@ -324,8 +325,9 @@ void Compiler::CompileConditional(OzValue conditional,
         Environment::NestedLocalAllocator nested_env(environment_);
         CompilePattern(match_value_er.value(), pattern_desc, next_pattern_ip);
 
-        if (case_desc.HasFeature("cond")) {
-          OzValue cond_desc = case_desc["cond"];
+        Value cond_value;
+        if (case_desc.TryGet("cond", &cond_value)) {
+          OzValue cond_desc(cond_value);
           ExpressionResult cond_er(environment_);
           CompileExpression(cond_desc, &cond_er);
           // Jump to the next pattern if the condition is not satisfied.
@@ -349,14 +351,15 @@ void Compiler::CompileConditional(OzValue conditional,
                  << branch.value().ToString();
     }
   }
-  if (conditional.HasFeature("else")) {
+  Value else_value;
+  if (conditional.TryGet("else", &else_value)) {
     if (next_case_ip != NULL) {
       Unify(next_case_ip, Value::Integer(segment_->size()));
       next_case_ip = NULL;
     }
     // TODO: Maybe check an expression always has an else?
     // Or the result value should be initialized to a free variable?
-    CompileExpression(conditional["else"], result);
+    CompileExpression(else_value, result);
   }
 
   if (next_case_ip != NULL)
@@ -639,10 +642,13 @@ void Compiler::CompileNewRecord(OzValue desc, ExpressionResult* result) {
   CompileExpression(desc["label"], &label_er);
 
   ExpressionResult arity_er(environment_);
-  if (desc.HasFeature("arity"))
-    CompileExpression(desc["arity"], &arity_er);
-  else if (desc.HasFeature("features"))
-    arity_er.SetValue(Operand(desc["features"].arity()));
+  Value arity_value;
+  Value features_value;
+  const bool has_features = desc.TryGet("features", &features_value);
+  if (desc.TryGet("arity", &arity_value))
+    CompileExpression(arity_value, &arity_er);
+  else if (has_features)
+    arity_er.SetValue(Operand(OzValue(features_value).arity()));
   else
     LOG(FATAL) << "record() requires either 'arity' or 'features'.";
 
@@ -652,9 +658,9 @@ void Compiler::CompileNewRecord(OzValue desc, ExpressionResult* result) {
                                arity_er.value(),
                                label_er.value()));
 
-  if (desc.HasFeature("features")) {
+  if (has_features) {
     // Set record values
-    OzValue features = desc["features"];
+    OzValue features(features_value);
     unique_ptr<Value::ItemIterator> it_deleter(
         features.value().RecordIterItems());
     for (Value::ItemIterator& it = *it_deleter; !it.at_end(); ++it) {
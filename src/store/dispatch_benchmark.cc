@@ -0,0 +1,218 @@
+// Compares the switch and the threaded instruction dispatch of the interpreter:
+//  - on the programs of the compile tests, each run many times;
+//  - on a small integer hot loop, also compiled by the JIT.
+// Also reports how many instruction dispatches the superinstructions save on
+// the programs of the compile tests.
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+#include <boost/format.hpp>
+using boost::format;
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "base/file-util.h"
+#include "combinators/oznode_eval_visitor.h"
+#include "store/compiler.h"
+#include "store/engine.h"
+#include "store/values.h"
+
+DEFINE_string(
+    oz_compile_path,
+    "store/compile_tests",
+    "Path to the directory of the .ozc programs to run."
+);
+
+DEFINE_int64(
+    program_runs,
+    10000,
+    "Number of times each program is run."
+);
+
+DEFINE_int64(
+    hot_loop_count,
+    10000000,
+    "Number of iterations of the small integer hot loop."
+);
+
+namespace store {
+
+// Each run allocates new values: the store is reset between programs.
+const uint64 kStoreSize = 256 * 1024 * 1024;  // 256MB
+
+namespace {
+
+// A 'print' native procedure that records everything.
+class RecordPrint : public NativeInterface {
+ public:
+  virtual void Execute(Array* parameters) {
+    for (uint64 i = 0; i < parameters->size(); ++i)
+      output_.append(parameters->values()[i].ToString());
+  }
+
+  string* output() { return &output_; }
+
+ private:
+  string output_;
+};
+
+// Compiles the Main procedure of an .ozc program.
+// @param expected Set to the expected output of the program.
+Closure* CompileProgram(Store* store, const string& source, string* expected) {
+  combinators::oz::OzParser parser;
+  CHECK(parser.Parse(source)) << "Error parsing:\n" << source;
+  shared_ptr<combinators::oz::OzNodeGeneric> root =
+      std::dynamic_pointer_cast<combinators::oz::OzNodeGeneric>(parser.root());
+  combinators::oz::EvalVisitor visitor(store);
+  for (shared_ptr<combinators::oz::AbstractOzNode> node : root->nodes)
+    visitor.Eval(node.get());
+  *expected = visitor.vars()["Expected"].Deref().as<Atom>()->value();
+
+  Compiler compiler(store, NULL);
+  vector<string> env;
+  Closure* const closure =
+      compiler.CompileProcedure(visitor.vars()["Main"], &env);
+  CHECK(env.empty());
+  return closure;
+}
+
+Operand Local(int index) {
+  return Operand(Register(Register::LOCAL, index));
+}
+
+Operand Immediate(int64 integer) {
+  return Operand(Value::Integer(integer));
+}
+
+// Builds a procedure that counts from N down to 0, in 3 instructions:
+//   l0 := N
+//   while 0 < l0:
+//     l0 := l0 - 1
+Closure* NewHotLoopProc(Store* store, int64 n) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(n)));
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(1), Immediate(0), Local(0)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(0), Local(0),
+               Immediate(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH_IF, Local(1), Immediate(1)));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  return Closure::New(store, code, 0, 2, 0);
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs a procedure in new threads, one at a time.
+// @param print The 'print' native, if the procedure calls it.
+// @param profile Records the executed instructions, when not NULL.
+// @param jit_threshold See Engine::jit_threshold(), disabled by default.
+// @returns The time spent, in seconds.
+double Run(bool threaded, Store* store, Closure* proc, int64 runs,
+           NativeInterface* print, OpcodeProfile* profile = NULL,
+           int64 jit_threshold = -1) {
+  Engine engine;
+  engine.set_threaded_dispatch(threaded);
+  engine.set_opcode_profile(profile);
+  engine.set_jit_threshold(jit_threshold);
+  if (print != NULL) engine.RegisterNative("print", print);
+  const auto start = std::chrono::steady_clock::now();
+  for (int64 i = 0; i < runs; ++i) {
+    New::Thread(store, &engine, proc, Array::EmptyArray, store);
+    engine.Run();
+  }
+  return SecondsSince(start);
+}
+
+const char* DispatchName(bool threaded) {
+  return threaded ? "threaded" : "switch";
+}
+
+}  // namespace
+
+void ProgramBenchmarks() {
+  vector<string> names;
+  util::ListDirPattern(FLAGS_oz_compile_path, ".*\\.ozc", &names);
+  const int64 runs = FLAGS_program_runs;
+
+  for (const string& name : names) {
+    const string source = util::ReadFileToString(
+        (format("%s/%s") % FLAGS_oz_compile_path % name).str());
+    double seconds[2];
+    for (int threaded = 0; threaded <= STORE_THREADED_DISPATCH; ++threaded) {
+      StaticStore store(kStoreSize);
+      string expected;
+      Closure* const main = CompileProgram(&store, source, &expected);
+      RecordPrint print;
+      seconds[threaded] = Run(threaded, &store, main, runs, &print);
+      CHECK_EQ(runs * expected.size(), print.output()->size()) << name;
+    }
+    printf("%-28s %8ld runs: switch %.3fs",
+           name.c_str(), runs, seconds[0]);
+    if (STORE_THREADED_DISPATCH)
+      printf(", threaded %.3fs (x%.2f)", seconds[1], seconds[0] / seconds[1]);
+    printf("\n");
+  }
+}
+
+void SuperinstructionReport() {
+  vector<string> names;
+  util::ListDirPattern(FLAGS_oz_compile_path, ".*\\.ozc", &names);
+  const int64 runs = FLAGS_program_runs;
+
+  for (const string& name : names) {
+    const string source = util::ReadFileToString(
+        (format("%s/%s") % FLAGS_oz_compile_path % name).str());
+    StaticStore store(kStoreSize);
+    string expected;
+    Closure* const main = CompileProgram(&store, source, &expected);
+    RecordPrint print;
+    OpcodeProfile profile;
+    Run(false, &store, main, runs, &print, &profile);
+    printf("%-28s %8ld runs: %ld instructions, %ld dispatches (-%.1f%%)\n",
+           name.c_str(), runs, profile.ninstructions(), profile.ndispatches(),
+           100.0 * profile.nfused() / profile.ninstructions());
+  }
+}
+
+void HotLoopBenchmark() {
+  const int64 n = FLAGS_hot_loop_count;
+  for (int threaded = 0; threaded <= STORE_THREADED_DISPATCH; ++threaded) {
+    StaticStore store(kStoreSize);
+    Closure* const loop = NewHotLoopProc(&store, n);
+    const double seconds = Run(threaded, &store, loop, 1, NULL);
+    // Each iteration executes 3 instructions.
+    printf("hot loop, %-8s dispatch: %ld iterations in %.3fs, "
+           "%.1f Minstr/s\n",
+           DispatchName(threaded), n, seconds, 3.0 * n / seconds / 1e6);
+  }
+  if (STORE_JIT) {
+    StaticStore store(kStoreSize);
+    Closure* const loop = NewHotLoopProc(&store, n);
+    const double seconds = Run(STORE_THREADED_DISPATCH, &store, loop, 1,
+                               NULL, NULL, 0);
+    printf("hot loop, JIT: %ld iterations in %.3fs, %.1f Minstr/s\n",
+           n, seconds, 3.0 * n / seconds / 1e6);
+  }
+}
+
+}  // namespace store
+
+int main(int argc, char** argv) {
+  ::google::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  store::ProgramBenchmarks();
+  store::SuperinstructionReport();
+  store::HotLoopBenchmark();
+  return EXIT_SUCCESS;
+}
@@ -1,12 +1,33 @@
 #include "store/engine.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
 #include <list>
+#include <mutex>
+#include <thread>
+using std::deque;
 using std::list;
 
+#include "store/numeric_kernels.h"
 #include "store/values.h"
 
 namespace store {
 
+// virtual
+void NativeInterface::Execute(Array* parameters) {
+  LOG(FATAL) << "Native does not implement Execute()";
+}
+
+// virtual
+bool NativeInterface::Execute(Store* store, Array* parameters) {
+  Execute(parameters);
+  return true;
+}
+
 namespace native {
 
 class Print: public NativeInterface {
@@ -29,80 +50,945 @@ class PrintLine: public NativeInterface {
   }
 };
 
-class Decrement: public NativeInterface {
- public:
-  virtual void Execute(Array* parameters) {
-    parameters->Assign(0, Value::Integer(IntValue(parameters->Access(0)) - 1));
+// Natives with a fixed number of parameters: see NativeFunction.
+//
+// Integer natives take integers, small or big: other parameters, including
+// unbound variables, are invalid.
+
+Value Decrement(Store* store, Value value) {
+  return Integer::Subtract(store, value.Deref(), Value::Integer(1));
+}
+
+Value IsZero(Value value) {
+  value = value.Deref();
+  if (!value.IsSmallInt() && (value.type() != Value::INTEGER))
+    return Value();
+  // Integers are normalized: a zero is always a small integer.
+  return Boolean::Get(value == Value::Integer(0));
+}
+
+Value Multiply(Store* store, Value value1, Value value2) {
+  return Integer::Multiply(store, value1.Deref(), value2.Deref());
+}
+
+// GetLabel(Record Label)
+Value GetLabel(Value record) {
+  record = record.Deref();
+  if (!(record.caps() & Value::CAP_RECORD)) return Value();
+  return record.RecordLabel();
+}
+
+// -----------------------------------------------------------------------------
+// Numeric arrays
+//
+// Bulk operations use the kernels selected for the CPU, see
+// numeric_kernels.h. Integer reductions that overflow int64 fall back to big
+// integers; elementwise operations that overflow are invalid.
+
+// IntArray(ListOrTuple Array)
+Value NewIntArray(Store* store, Value value) {
+  value = value.Deref();
+  IntArray* array = (value.type() == Value::TUPLE)
+      ? IntArray::FromTuple(store, value)
+      : IntArray::FromList(store, value);
+  if (array == NULL) return Value();
+  return array;
+}
+
+// FloatArray(ListOrTuple Array)
+Value NewFloatArray(Store* store, Value value) {
+  value = value.Deref();
+  FloatArray* array = (value.type() == Value::TUPLE)
+      ? FloatArray::FromTuple(store, value)
+      : FloatArray::FromList(store, value);
+  if (array == NULL) return Value();
+  return array;
+}
+
+// ArrayToList(Array List)
+Value ArrayToList(Store* store, Value array) {
+  array = array.Deref();
+  switch (array.type()) {
+    case Value::INT_ARRAY:
+      return array.as<IntArray>()->ToList(store);
+    case Value::FLOAT_ARRAY:
+      return array.as<FloatArray>()->ToList(store);
+    default:
+      return Value();
   }
-};
+}
 
-class IsZero: public NativeInterface {
- public:
-  virtual void Execute(Array* parameters) {
-    parameters->Assign(0, Boolean::Get(IntValue(parameters->Access(0)) == 0));
+// ArrayToTuple(Array Tuple): the tuple label is '#'.
+Value ArrayToTuple(Store* store, Value array) {
+  array = array.Deref();
+  switch (array.type()) {
+    case Value::INT_ARRAY:
+      return array.as<IntArray>()->ToTuple(store, KAtomTuple());
+    case Value::FLOAT_ARRAY:
+      return array.as<FloatArray>()->ToTuple(store, KAtomTuple());
+    default:
+      return Value();
   }
-};
+}
 
-class Int64Multiply: public NativeInterface {
- public:
-  virtual void Execute(Array* parameters) {
-    const int64 mul =
-        IntValue(parameters->Access(0)) * IntValue(parameters->Access(1));
-    parameters->Assign(0, Value::Integer(mul));
+// ArraySum(Array Sum)
+Value ArraySum(Store* store, Value array) {
+  array = array.Deref();
+  const NumericKernels& kernels = GetNumericKernels();
+  switch (array.type()) {
+    case Value::INT_ARRAY: {
+      const IntArray* ints = array.as<IntArray>();
+      int64 sum;
+      if (kernels.int_sum(ints->values(), ints->size(), &sum))
+        return New::Integer(store, sum);
+      mpz_class exact;
+      for (uint64 i = 0; i < ints->size(); ++i)
+        exact += static_cast<long>(ints->Get(i));
+      return New::Integer(store, exact);
+    }
+    case Value::FLOAT_ARRAY: {
+      const FloatArray* floats = array.as<FloatArray>();
+      return New::Float(store,
+                        kernels.float_sum(floats->values(), floats->size()));
+    }
+    default:
+      return Value();
   }
-};
+}
 
-class GetLabel: public NativeInterface {
- public:
-  virtual void Execute(Array* parameters) {
-    // TODO: How to forward woken-up threads?
-    Unify(parameters->Access(1), parameters->Access(0).RecordLabel());
+// ArrayDot(Array1 Array2 Dot)
+Value ArrayDot(Store* store, Value array1, Value array2) {
+  array1 = array1.Deref();
+  array2 = array2.Deref();
+  if (array1.type() != array2.type()) return Value();
+  switch (array1.type()) {
+    case Value::INT_ARRAY: {
+      const IntArray* ints1 = array1.as<IntArray>();
+      const IntArray* ints2 = array2.as<IntArray>();
+      if (ints1->size() != ints2->size()) return Value();
+      int64 dot;
+      if (IntDot(ints1->values(), ints2->values(), ints1->size(), &dot))
+        return New::Integer(store, dot);
+      mpz_class exact;
+      for (uint64 i = 0; i < ints1->size(); ++i)
+        exact += mpz_class(static_cast<long>(ints1->Get(i)))
+            * static_cast<long>(ints2->Get(i));
+      return New::Integer(store, exact);
+    }
+    case Value::FLOAT_ARRAY: {
+      const FloatArray* floats1 = array1.as<FloatArray>();
+      const FloatArray* floats2 = array2.as<FloatArray>();
+      if (floats1->size() != floats2->size()) return Value();
+      const double dot = GetNumericKernels().float_dot(
+          floats1->values(), floats2->values(), floats1->size());
+      return New::Float(store, dot);
+    }
+    default:
+      return Value();
   }
-};
+}
+
+// ArrayScale(Array Factor Result): the factor has the type of the elements.
+Value ArrayScale(Store* store, Value array, Value factor) {
+  array = array.Deref();
+  factor = factor.Deref();
+  switch (array.type()) {
+    case Value::INT_ARRAY: {
+      if (!factor.IsSmallInt()) return Value();
+      const IntArray* ints = array.as<IntArray>();
+      IntArray* result = IntArray::NewUninitialized(store, ints->size());
+      if (!IntScale(ints->values(), IntValue(factor),
+                    result->mutable_values(), ints->size()))
+        return Value();
+      return result;
+    }
+    case Value::FLOAT_ARRAY: {
+      double scale;
+      if (!Float::GetDouble(factor, &scale)) return Value();
+      const FloatArray* floats = array.as<FloatArray>();
+      FloatArray* result = FloatArray::NewUninitialized(store, floats->size());
+      GetNumericKernels().float_scale(
+          floats->values(), scale, result->mutable_values(), floats->size());
+      return result;
+    }
+    default:
+      return Value();
+  }
+}
+
+typedef bool (*IntElementwiseOp)(const int64*, const int64*, int64*, uint64);
+typedef void (*FloatElementwiseOp)(const double*, const double*, double*,
+                                   uint64);
+
+// Elementwise operation on arrays of the same type and size.
+Value Elementwise(Store* store, Value array1, Value array2,
+                  IntElementwiseOp int_op, FloatElementwiseOp float_op) {
+  array1 = array1.Deref();
+  array2 = array2.Deref();
+  if (array1.type() != array2.type()) return Value();
+  switch (array1.type()) {
+    case Value::INT_ARRAY: {
+      const IntArray* ints1 = array1.as<IntArray>();
+      const IntArray* ints2 = array2.as<IntArray>();
+      if (ints1->size() != ints2->size()) return Value();
+      IntArray* result = IntArray::NewUninitialized(store, ints1->size());
+      if (!int_op(ints1->values(), ints2->values(),
+                  result->mutable_values(), ints1->size()))
+        return Value();
+      return result;
+    }
+    case Value::FLOAT_ARRAY: {
+      const FloatArray* floats1 = array1.as<FloatArray>();
+      const FloatArray* floats2 = array2.as<FloatArray>();
+      if (floats1->size() != floats2->size()) return Value();
+      FloatArray* result =
+          FloatArray::NewUninitialized(store, floats1->size());
+      float_op(floats1->values(), floats2->values(),
+               result->mutable_values(), floats1->size());
+      return result;
+    }
+    default:
+      return Value();
+  }
+}
+
+// ArrayAdd(Array1 Array2 Result)
+Value ArrayAdd(Store* store, Value array1, Value array2) {
+  const NumericKernels& kernels = GetNumericKernels();
+  return Elementwise(store, array1, array2,
+                     kernels.int_add, kernels.float_add);
+}
+
+// ArrayMultiply(Array1 Array2 Result)
+Value ArrayMultiply(Store* store, Value array1, Value array2) {
+  return Elementwise(store, array1, array2,
+                     IntMultiply, GetNumericKernels().float_multiply);
+}
+
+// Reduction of a non-empty array.
+Value Reduce(Store* store, Value array,
+             int64 (*int_op)(const int64*, uint64),
+             double (*float_op)(const double*, uint64)) {
+  array = array.Deref();
+  switch (array.type()) {
+    case Value::INT_ARRAY: {
+      const IntArray* ints = array.as<IntArray>();
+      if (ints->size() == 0) return Value();
+      return New::Integer(store, int_op(ints->values(), ints->size()));
+    }
+    case Value::FLOAT_ARRAY: {
+      const FloatArray* floats = array.as<FloatArray>();
+      if (floats->size() == 0) return Value();
+      return New::Float(store, float_op(floats->values(), floats->size()));
+    }
+    default:
+      return Value();
+  }
+}
+
+// ArrayMin(Array Min)
+Value ArrayMin(Store* store, Value array) {
+  const NumericKernels& kernels = GetNumericKernels();
+  return Reduce(store, array, kernels.int_min, kernels.float_min);
+}
+
+// ArrayMax(Array Max)
+Value ArrayMax(Store* store, Value array) {
+  const NumericKernels& kernels = GetNumericKernels();
+  return Reduce(store, array, kernels.int_max, kernels.float_max);
+}
+
+// ArrayPrefixSum(Array Result): Result[i] = Array[0] + ... + Array[i].
+Value ArrayPrefixSum(Store* store, Value array) {
+  array = array.Deref();
+  switch (array.type()) {
+    case Value::INT_ARRAY: {
+      const IntArray* ints = array.as<IntArray>();
+      IntArray* result = IntArray::NewUninitialized(store, ints->size());
+      if (!IntPrefixSum(ints->values(), result->mutable_values(),
+                        ints->size()))
+        return Value();
+      return result;
+    }
+    case Value::FLOAT_ARRAY: {
+      const FloatArray* floats = array.as<FloatArray>();
+      FloatArray* result = FloatArray::NewUninitialized(store, floats->size());
+      FloatPrefixSum(floats->values(), result->mutable_values(),
+                     floats->size());
+      return result;
+    }
+    default:
+      return Value();
+  }
+}
 
 }  // namespace native
 
-Engine::Engine() {
+const int64 Engine::kTimeSliceSteps;
+
+// A worker: an OS thread running the threads of its run queue.
+struct Engine::Worker {
+  Worker(Engine* engine, int index, CodeContext* code_context)
+      : engine(engine), index(index), code_context(code_context) {}
+
+  Engine* const engine;
+  const int index;
+  CodeContext* const code_context;
+
+  // Guards queue: other workers steal from it.
+  std::mutex mutex;
+  WorkDeque queue;
+};
+
+// static
+thread_local Engine::Worker* Engine::current_worker_ = NULL;
+
+Engine::Engine()
+    : next_thread_id_(0),
+      code_context_(new CodeContext),
+      time_quantum_ns_(0),
+      nworkers_(1),
+      nactive_(0),
+      nqueued_(0),
+      stopping_(false),
+      nidle_(0),
+      has_posted_(false),
+      threaded_dispatch_(STORE_THREADED_DISPATCH),
+      opcode_profile_(NULL),
+      jit_threshold_(-1) {
+  PCHECK(pipe(wakeup_fds_) == 0);
+  for (int fd : wakeup_fds_)
+    PCHECK(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0);
   RegisterNative("println", new native::PrintLine);
   RegisterNative("print", new native::Print);
-  RegisterNative("decrement", new native::Decrement);
-  RegisterNative("is_zero", new native::IsZero);
-  RegisterNative("multiply", new native::Int64Multiply);
-  RegisterNative("get_label", new native::GetLabel);
+  RegisterNative<&native::Decrement>("decrement");
+  RegisterNative<&native::IsZero>("is_zero");
+  RegisterNative<&native::Multiply>("multiply");
+  RegisterNative<&native::GetLabel>("get_label");
+
+  RegisterNative<&native::NewIntArray>("int_array");
+  RegisterNative<&native::NewFloatArray>("float_array");
+  RegisterNative<&native::ArrayToList>("array_to_list");
+  RegisterNative<&native::ArrayToTuple>("array_to_tuple");
+  RegisterNative<&native::ArraySum>("array_sum");
+  RegisterNative<&native::ArrayDot>("array_dot");
+  RegisterNative<&native::ArrayScale>("array_scale");
+  RegisterNative<&native::ArrayAdd>("array_add");
+  RegisterNative<&native::ArrayMultiply>("array_multiply");
+  RegisterNative<&native::ArrayMin>("array_min");
+  RegisterNative<&native::ArrayMax>("array_max");
+  RegisterNative<&native::ArrayPrefixSum>("array_prefix_sum");
+}
+
+namespace {
+
+// Time slices a priority gets for each time slice of the priority below it,
+// while threads of both priorities are ready to run.
+const int kPriorityRatio = 10;
+
+// Time slices a worker runs from the back of its deque before it runs the
+// thread at the front: see Engine::WorkDeque.
+const int kLifoInARow = 16;
+
+// With a time quantum, number of times threads read the clock per quantum:
+// the step budgets of the threads adapt to this rate.
+const int64 kClockReadsPerQuantum = 8;
+
+// Bounds of the adaptive step budgets.
+const uint64 kMinStepBudget = 16;
+const uint64 kMaxStepBudget = 1 << 20;
+
+// @returns The step budget taking about target_ns to run, given that the
+//     last run charged steps in elapsed_ns. Averaged with the current budget
+//     to smooth out the variations of the speed of the thread.
+uint64 AdaptStepBudget(uint64 budget, uint64 steps, int64 elapsed_ns,
+                       int64 target_ns) {
+  if (steps == 0) return budget;
+  const double target =
+      static_cast<double>(steps) * target_ns / std::max<int64>(elapsed_ns, 1);
+  const double adapted = (budget + target) / 2;
+  if (adapted < kMinStepBudget) return kMinStepBudget;
+  if (adapted > kMaxStepBudget) return kMaxStepBudget;
+  return static_cast<uint64>(adapted);
+}
+
+// @returns The priority of the next thread to run, -1 if no thread is ready.
+//     A priority yields a time slice to the lower priorities after
+//     kPriorityRatio time slices in a row.
+// @param ready Whether threads are ready to run, by priority.
+// @param slices_in_a_row Time slices run in a row, by priority, while threads
+//     of lower priorities were ready to run. Updated.
+int NextPriority(const bool ready[PRIORITY_COUNT],
+                 int slices_in_a_row[PRIORITY_COUNT]) {
+  for (int priority = PRIORITY_COUNT - 1; priority >= 0; --priority) {
+    if (!ready[priority]) continue;
+    bool lower_ready = false;
+    for (int lower = 0; lower < priority; ++lower)
+      lower_ready = lower_ready || ready[lower];
+
+    if (!lower_ready) {
+      slices_in_a_row[priority] = 0;
+      return priority;
+    }
+    if (slices_in_a_row[priority] < kPriorityRatio) {
+      ++slices_in_a_row[priority];
+      return priority;
+    }
+    // Yields this time slice to the lower priorities.
+    slices_in_a_row[priority] = 0;
+  }
+  return -1;
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// Run queues
+
+Engine::RunQueue::RunQueue() {
+  for (int priority = 0; priority < PRIORITY_COUNT; ++priority)
+    slices_in_a_row_[priority] = 0;
+}
+
+bool Engine::RunQueue::empty() const {
+  for (int priority = 0; priority < PRIORITY_COUNT; ++priority)
+    if (!ready_[priority].empty()) return false;
+  return true;
+}
+
+void Engine::RunQueue::PushAll(ThreadList* threads) {
+  while (!threads->empty()) {
+    Thread* const thread = threads->PopFront();
+    ready_[thread->priority()].PushBack(thread);
+  }
+}
+
+Thread* Engine::RunQueue::Pop() {
+  bool ready[PRIORITY_COUNT];
+  for (int priority = 0; priority < PRIORITY_COUNT; ++priority)
+    ready[priority] = !ready_[priority].empty();
+  const int priority = NextPriority(ready, slices_in_a_row_);
+  if (priority < 0) return NULL;
+  return ready_[priority].PopFront();
+}
+
+Engine::WorkDeque::WorkDeque() : lifo_in_a_row_(0) {
+  for (int priority = 0; priority < PRIORITY_COUNT; ++priority)
+    slices_in_a_row_[priority] = 0;
+}
+
+void Engine::WorkDeque::PushAll(ThreadList* threads, Thread* preempted) {
+  while (!threads->empty()) {
+    Thread* const thread = threads->PopFront();
+    if (thread == preempted)
+      ready_[thread->priority()].push_front(thread);
+    else
+      ready_[thread->priority()].push_back(thread);
+  }
+}
+
+Thread* Engine::WorkDeque::Pop() {
+  bool ready[PRIORITY_COUNT];
+  for (int priority = 0; priority < PRIORITY_COUNT; ++priority)
+    ready[priority] = !ready_[priority].empty();
+  const int priority = NextPriority(ready, slices_in_a_row_);
+  if (priority < 0) return NULL;
+
+  deque<Thread*>* const threads = &ready_[priority];
+  Thread* thread;
+  if (lifo_in_a_row_ < kLifoInARow) {
+    ++lifo_in_a_row_;
+    thread = threads->back();
+    threads->pop_back();
+  } else {
+    lifo_in_a_row_ = 0;
+    thread = threads->front();
+    threads->pop_front();
+  }
+  return thread;
+}
+
+Thread* Engine::WorkDeque::Steal() {
+  for (int priority = PRIORITY_COUNT - 1; priority >= 0; --priority) {
+    if (ready_[priority].empty()) continue;
+    Thread* const thread = ready_[priority].front();
+    ready_[priority].pop_front();
+    return thread;
+  }
+  return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+Engine::~Engine() {
+  close(wakeup_fds_[0]);
+  close(wakeup_fds_[1]);
+}
+
+uint64 Engine::id() const {
+  return code_context_->id();
+}
+
+CodeContext* Engine::code_context() const {
+  const Worker* const worker = current_worker_;
+  return ((worker != NULL) && (worker->engine == this))
+      ? worker->code_context
+      : code_context_.get();
 }
 
 void Engine::Run() {
-  const int kStepsCount = 1000;  // Execute at most 1k instructions at a time.
-
-  while (!runnable_.empty()) {
-    Thread* thread = runnable_.front();
-    runnable_.pop_front();
-    // The thread scheduling is determined by how woken up suspensions are added
-    // to the runnable_ list.
-    const Thread::ThreadState thread_state =
-        thread->Run(kStepsCount, &runnable_);
-    switch (thread_state) {
-      case Thread::RUNNABLE:
-        runnable_.push_back(thread);
-        break;
-      case Thread::WAITING:
-        break;
-      case Thread::TERMINATED:
-        // Nothing to do.
-        break;
-      default:
-        LOG(FATAL) << "Unexpected thread state: " << thread_state;
+  if (nworkers_ > 1) {
+    RunWorkers();
+  } else {
+    RunWithin(kuint64max, Clock::time_point::max());
+  }
+}
+
+bool Engine::RunFor(uint64 max_steps) {
+  CHECK_EQ(1, nworkers_) << "RunFor() runs on a single worker";
+  return RunWithin(max_steps, Clock::time_point::max());
+}
+
+bool Engine::RunUntil(Clock::time_point deadline) {
+  CHECK_EQ(1, nworkers_) << "RunUntil() runs on a single worker";
+  return RunWithin(kuint64max, deadline);
+}
+
+bool Engine::RunWithin(uint64 max_steps, Clock::time_point deadline) {
+  const bool has_deadline = (deadline != Clock::time_point::max());
+  uint64 steps = 0;
+  for (;;) {
+    if (has_posted_) RunPostedTasks();
+    Thread* const thread = NextThread();
+    if (thread == NULL) {
+      if (!idle_callback_ || !idle_callback_(this)) return false;
+    } else {
+      steps += RunTimeSlice(thread, max_steps - steps, deadline, &runnable_);
     }
+    if ((steps >= max_steps) || (has_deadline && (Clock::now() >= deadline)))
+      return has_runnable_threads();
+  }
+}
+
+bool Engine::has_runnable_threads() const {
+  return !runnable_.empty() || !ready_.empty();
+}
+
+void Engine::Post(const Task& task) {
+  std::lock_guard<std::mutex> lock(posted_mutex_);
+  if (posted_.empty()) {
+    // The pipe holds at most one byte: it cannot fill up.
+    const char byte = 0;
+    PCHECK(write(wakeup_fds_[1], &byte, 1) == 1);
+  }
+  posted_.push_back(task);
+  has_posted_ = true;
+  WakeUpWorkers();
+}
+
+void Engine::PostBind(Value variable, Value value) {
+  Post([variable, value](Engine* engine) {
+    if (!engine->Bind(variable, value))
+      LOG(ERROR) << "Posted binding failed: " << variable.ToString()
+                 << " = " << value.ToString();
+  });
+}
+
+bool Engine::Bind(Value variable, Value value) {
+  ThreadList woken;
+  const bool unified = Unify(variable, value, &woken);
+  QueueThreads(&woken, NULL);
+  return unified;
+}
+
+Value Engine::CloseOpenRecord(Store* store, Value open_record) {
+  ThreadList woken;
+  const Value record = open_record.OpenRecordClose(store, &woken);
+  QueueThreads(&woken, NULL);
+  return record;
+}
+
+void Engine::RunPostedTasks() {
+  vector<Task> tasks;
+  {
+    std::lock_guard<std::mutex> lock(posted_mutex_);
+    tasks.swap(posted_);
+    has_posted_ = false;
+    char byte;
+    while (read(wakeup_fds_[0], &byte, 1) == 1) {}
+  }
+  for (const Task& task : tasks)
+    task(this);
+}
+
+Thread* Engine::NextThread() {
+  // The thread scheduling is determined by how woken up suspensions are added
+  // to the runnable_ list: each batch of suspensions is appended at once.
+  ready_.PushAll(&runnable_);
+  return ready_.Pop();
+}
+
+uint64 Engine::RunTimeSlice(Thread* thread, uint64 max_steps,
+                            Clock::time_point deadline,
+                            ThreadList* runnable) {
+  const uint64 start_steps = thread->steps();
+  Thread::ThreadState thread_state;
+  if (time_quantum_ns_ == 0) {
+    thread_state = thread->Run(std::min<uint64>(kTimeSliceSteps, max_steps),
+                               runnable);
+  } else {
+    // Threads start with a small budget: their speed is not known yet.
+    if (thread->step_budget_ == 0) thread->step_budget_ = kMinStepBudget;
+    const Clock::time_point slice_end = std::min(
+        deadline, Clock::now() + std::chrono::nanoseconds(time_quantum_ns_));
+    Clock::time_point now;
+    do {
+      const Clock::time_point start = Clock::now();
+      const uint64 steps = thread->steps();
+      thread_state = thread->Run(
+          std::min(thread->step_budget_, max_steps - (steps - start_steps)),
+          runnable);
+      now = Clock::now();
+      thread->step_budget_ = AdaptStepBudget(
+          thread->step_budget_, thread->steps() - steps,
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              now - start).count(),
+          time_quantum_ns_ / kClockReadsPerQuantum);
+    } while ((thread_state == Thread::RUNNABLE) && (now < slice_end)
+             && (thread->steps() - start_steps < max_steps));
+  }
+
+  // Once registered in suspensions, the thread may run on another worker.
+  const uint64 steps = thread->steps() - start_steps;
+  switch (thread_state) {
+    case Thread::RUNNABLE:
+      // Queued after the threads it made runnable.
+      runnable->PushBack(thread);
+      break;
+    case Thread::WAITING:
+      Suspend(thread, runnable);
+      break;
+    case Thread::TERMINATED:
+      // Nothing to do.
+      break;
+    default:
+      LOG(FATAL) << "Unexpected thread state: " << thread_state;
+  }
+  return steps;
+}
+
+void Engine::Suspend(Thread* thread, ThreadList* runnable) {
+  std::unique_lock<std::mutex> lock;
+  if (!workers_.empty())
+    lock = std::unique_lock<std::mutex>(binding_mutex_);
+  Variable* const variable = CHECK_NOTNULL(thread->waiting_on_);
+  thread->waiting_on_ = NULL;
+  const Value value = Value(variable).Deref();
+  if (value.type() == Value::VARIABLE) {
+    value.as<Variable>()->AddSuspension(thread);
+  } else {
+    // Bound by another worker in the meantime.
+    runnable->PushBack(thread);
   }
 }
 
 void Engine::AddThread(Thread* thread) {
-  runnable_.push_back(thread);
-  thread_map_[thread->id()] = thread;
+  {
+    std::lock_guard<std::mutex> lock(thread_map_mutex_);
+    thread_map_[thread->id()] = thread;
+  }
+  ThreadList threads;
+  threads.PushBack(thread);
+  QueueThreads(&threads, NULL);
+}
+
+void Engine::QueueThreads(ThreadList* threads, Thread* preempted) {
+  if (threads->empty()) return;
+  if (workers_.empty()) {
+    runnable_.Splice(threads);
+    return;
+  }
+
+  // Tasks posted from other OS threads run on the first worker.
+  Worker* worker = current_worker_;
+  if ((worker == NULL) || (worker->engine != this))
+    worker = workers_[0].get();
+  const int64 nthreads = threads->size();
+  {
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    worker->queue.PushAll(threads, preempted);
+  }
+  nactive_ += nthreads;
+  nqueued_ += nthreads;
+  WakeUpWorkers();
+}
+
+// -----------------------------------------------------------------------------
+// Workers
+
+void Engine::set_workers(int nworkers) {
+  CHECK_GE(nworkers, 1);
+  CHECK(workers_.empty()) << "Workers cannot change while running";
+  nworkers_ = nworkers;
+}
+
+void Engine::RunWorkers() {
+  CHECK(opcode_profile_ == NULL)
+      << "Opcode profiles are recorded with a single worker";
+  while (worker_code_contexts_.size() + 1 < static_cast<uint64>(nworkers_))
+    worker_code_contexts_.emplace_back(new CodeContext);
+  workers_.emplace_back(new Worker(this, 0, code_context_.get()));
+  for (int i = 1; i < nworkers_; ++i) {
+    workers_.emplace_back(
+        new Worker(this, i, worker_code_contexts_[i - 1].get()));
+  }
+
+  // The threads queued so far start on the first worker.
+  ThreadList threads;
+  ready_.PushAll(&runnable_);
+  for (Thread* thread = ready_.Pop(); thread != NULL; thread = ready_.Pop())
+    threads.PushBack(thread);
+  nactive_ = threads.size();
+  nqueued_ = threads.size();
+  workers_[0]->queue.PushAll(&threads, NULL);
+  stopping_ = false;
+
+  vector<std::thread> os_threads;
+  for (int i = 1; i < nworkers_; ++i)
+    os_threads.emplace_back(&Engine::RunWorker, this, workers_[i].get());
+  RunWorker(workers_[0].get());
+  for (std::thread& os_thread : os_threads)
+    os_thread.join();
+
+  // The workers stop once no thread is runnable: their queues are empty.
+  workers_.clear();
+}
+
+void Engine::RunWorker(Worker* worker) {
+  // Natives may run other engines.
+  Worker* const outer_worker = current_worker_;
+  std::mutex* const outer_binding_lock = binding_lock();
+  current_worker_ = worker;
+  set_binding_lock(&binding_mutex_);
+
+  // The first worker runs on the OS thread calling Run().
+  const bool first = (worker->index == 0);
+  for (;;) {
+    if (first && has_posted_) RunPostedTasks();
+    Thread* const thread = NextThread(worker);
+    if (thread != NULL) {
+      ThreadList runnable;
+      RunTimeSlice(thread, kuint64max, Clock::time_point::max(), &runnable);
+      // The thread is counted again when queued, before it is discounted.
+      QueueThreads(&runnable, (runnable.back() == thread) ? thread : NULL);
+      if (--nactive_ == 0) WakeUpWorkers();
+      continue;
+    }
+
+    if (first && (nactive_ == 0)) {
+      if (has_posted_) continue;
+      if (idle_callback_ && idle_callback_(this)) continue;
+      stopping_ = true;
+      WakeUpWorkers();
+      break;
+    }
+    if (stopping_) break;
+    WaitForThreads(worker);
+  }
+
+  set_binding_lock(outer_binding_lock);
+  current_worker_ = outer_worker;
+}
+
+Thread* Engine::NextThread(Worker* worker) {
+  if (nqueued_ == 0) return NULL;
+  // Steals from the front of the other queues: the threads that waited the
+  // longest are the least likely to be in the cache of their worker.
+  for (int i = 0; i < nworkers_; ++i) {
+    Worker* const victim = workers_[(worker->index + i) % nworkers_].get();
+    Thread* thread;
+    {
+      std::lock_guard<std::mutex> lock(victim->mutex);
+      thread = (victim == worker) ? victim->queue.Pop()
+                                  : victim->queue.Steal();
+    }
+    if (thread != NULL) {
+      --nqueued_;
+      return thread;
+    }
+  }
+  return NULL;
+}
+
+void Engine::WaitForThreads(Worker* worker) {
+  const bool first = (worker->index == 0);
+  std::unique_lock<std::mutex> lock(idle_mutex_);
+  ++nidle_;
+  idle_cv_.wait(lock, [this, first]() {
+    return (nqueued_ > 0) || stopping_
+        || (first && ((nactive_ == 0) || has_posted_));
+  });
+  --nidle_;
+}
+
+void Engine::WakeUpWorkers() {
+  // Idle workers count themselves before checking their conditions, under
+  // the lock: they either see the change, or get notified.
+  if (nidle_ == 0) return;
+  std::lock_guard<std::mutex> lock(idle_mutex_);
+  idle_cv_.notify_all();
 }
 
 void Engine::RegisterNative(string name, NativeInterface* native) {
-  native_map_[name] = native;
+  Native entry;
+  entry.object = CHECK_NOTNULL(native);
+  SetNative(name, entry);
+}
+
+void Engine::SetNativeFunction(const string& name, NativeFunction function,
+                               uint64 nparams) {
+  Native entry;
+  entry.function = CHECK_NOTNULL(function);
+  entry.nparams = nparams;
+  SetNative(name, entry);
+}
+
+void Engine::SetNative(const string& name, const Native& native) {
+  const uint64 id = RegisterNativeName(name);
+  if (id >= natives_.size()) natives_.resize(id + 1);
+  natives_[id] = native;
+  // Code that failed to link may link now.
+  std::lock_guard<std::mutex> lock(linked_mutex_);
+  linked_.clear();
+}
+
+namespace {
+
+// Global registry of the native names, shared by the engines of all the OS
+// threads.
+struct NativeRegistry {
+  std::mutex mutex;
+  deque<string> names;  // Native id -> name, never moved
+  UnorderedMap<string, uint64> ids;  // Name -> native id
+};
+
+// Number of native ids cached by each OS thread.
+const uint64 kNativeIdCacheSize = 256;
+
+NativeRegistry* GetNativeRegistry() {
+  static NativeRegistry registry;
+  return &registry;
+}
+
+}  // namespace
+
+// static
+bool Engine::FindNativeId(const string& name, uint64* id) {
+  // Ids last looked up by this OS thread, direct-mapped by name hash: natives
+  // called by a name that is not a constant are looked up on each call.
+  // Entries point to the names of the registry, which are never moved.
+  // Unknown names are not cached, as natives may be registered later.
+  struct CachedId {
+    const string* name;
+    uint64 id;
+  };
+  static thread_local CachedId cache[kNativeIdCacheSize];
+  CachedId* const cached =
+      &cache[std::hash<string>()(name) % kNativeIdCacheSize];
+  if ((cached->name != NULL) && (*cached->name == name)) {
+    *id = cached->id;
+    return true;
+  }
+
+  NativeRegistry* const registry = GetNativeRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  UnorderedMap<string, uint64>::const_iterator it = registry->ids.find(name);
+  if (it == registry->ids.end()) return false;
+  *id = it->second;
+  cached->name = &registry->names[*id];
+  cached->id = *id;
+  return true;
+}
+
+// static
+uint64 Engine::RegisterNativeName(const string& name) {
+  NativeRegistry* const registry = GetNativeRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  UnorderedMap<string, uint64>::const_iterator it = registry->ids.find(name);
+  if (it != registry->ids.end()) return it->second;
+  const uint64 id = registry->names.size();
+  registry->names.push_back(name);
+  registry->ids[name] = id;
+  return id;
+}
+
+// static
+const string& Engine::NativeName(uint64 id) {
+  NativeRegistry* const registry = GetNativeRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  CHECK_LT(id, registry->names.size());
+  return registry->names[id];
+}
+
+bool Engine::Link(const Closure* closure) {
+  std::lock_guard<std::mutex> lock(linked_mutex_);
+  return LinkCode(closure->packed_code());
+}
+
+bool Engine::LinkCode(const PackedCode* code) {
+  // Also stops the recursion on procedures that reference each other.
+  if (!linked_.insert(code).second) return true;
+
+  // The instructions run by the owner of the procedure may change meanwhile.
+  bool linked = true;
+  for (uint64 i = 0; i < code->size(); ++i) {
+    const PackedBytecode& inst = code->generic_code()[i];
+    if (inst.opcode != Bytecode::CALL_NATIVE) continue;
+    string name;
+    const Native* found = NULL;
+    if (inst.operand3.kind() == PackedOperand::NATIVE) {
+      name = NativeName(inst.operand3.index());
+      found = native(inst.operand3.index());
+    } else if (inst.operand1.is_constant()
+               && HasType(code->constants()[inst.operand1.index()],
+                          Value::ATOM)) {
+      // Not resolved when packed.
+      name = code->constants()[inst.operand1.index()].as<Atom>()->value();
+      uint64 id;
+      if (FindNativeId(name, &id)) found = native(id);
+    } else {
+      continue;  // Called by a name only known when run.
+    }
+    if (found == NULL) {
+      LOG(ERROR) << "Unknown native '" << name << "' called at CP=" << i;
+      linked = false;
+    }
+  }
+  for (uint64 i = 0; i < code->nconstants(); ++i) {
+    const Value constant = code->constants()[i];
+    if (HasType(constant, Value::CLOSURE))
+      linked &= LinkCode(constant.as<Closure>()->packed_code());
+  }
+
+  if (!linked) linked_.erase(code);
+  return linked;
+}
+
+void Engine::set_threaded_dispatch(bool threaded) {
+  CHECK(!threaded || STORE_THREADED_DISPATCH)
+      << "Threaded dispatch is not supported by this build.";
+  threaded_dispatch_ = threaded;
+}
+
+void Engine::set_time_quantum_ns(int64 quantum_ns) {
+  CHECK_GE(quantum_ns, 0);
+  time_quantum_ns_ = quantum_ns;
+}
+
+void Engine::set_jit_threshold(int64 threshold) {
+  if ((threshold >= 0) && !STORE_JIT)
+    LOG(WARNING) << "The JIT is not supported on this platform.";
+  jit_threshold_ = threshold;
 }
 
 }  // namespace store
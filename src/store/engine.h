@@ -1,49 +1,538 @@
 #ifndef STORE_ENGINE_H_
 #define STORE_ENGINE_H_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
+using std::deque;
 using std::list;
 using std::map;
 using std::string;
+using std::unique_ptr;
+using std::vector;
 
 #include "base/basictypes.h"
+#include "base/stl-util.h"
+#include "store/thread_list.h"
+
+// Threads dispatch instructions with computed gotos when the compiler supports
+// labels as values (GCC and clang). The switch dispatch is the portable
+// fallback, and may be forced with -DSTORE_SWITCH_DISPATCH.
+#if defined(__GNUC__) && !defined(STORE_SWITCH_DISPATCH)
+#define STORE_THREADED_DISPATCH 1
+#else
+#define STORE_THREADED_DISPATCH 0
+#endif
 
 namespace store {
 
 class Array;
+class Closure;
+class CodeContext;
+class OpcodeProfile;
+class PackedCode;
+class Store;
 class Thread;
+class Value;
 
+// Natives override one of the two Execute() methods.
 class NativeInterface {
  public:
   virtual ~NativeInterface() {}
 
-  virtual void Execute(Array* parameters) = 0;
+  virtual void Execute(Array* parameters);
+
+  // For natives that allocate values in the store.
+  // @returns False if the parameters are invalid.
+  virtual bool Execute(Store* store, Array* parameters);
+};
+
+// Natives with a fixed number of parameters, registered with
+// Engine::RegisterNative<Function>(), take their parameters as Values and
+// return their result. Natives that allocate their result take the store of
+// the calling thread first. They return an undefined Value if the parameters
+// are invalid.
+//
+// The caller still passes a parameter array: the parameters, followed by the
+// variable for the result, as the compilers pass the result of calls in
+// functional notation. The interpreter calls the natives through a
+// trampoline, instantiated for each native, that loads the parameters from
+// the array. It then unifies the result with the last parameter, and
+// schedules the threads waiting on it.
+typedef Value (*NativeFunction)(Store* store, const Value* parameters);
+
+// A native procedure, as registered in an engine.
+struct Native {
+  Native() : object(NULL), function(NULL), nparams(0) {}
+
+  bool defined() const { return (object != NULL) || (function != NULL); }
+
+  // Natives on the parameter array.
+  NativeInterface* object;
+
+  // Natives with a fixed number of parameters.
+  NativeFunction function;
+  uint64 nparams;
+};
+
+// Scheduling priorities of the threads.
+// While threads of several priorities are runnable, each priority gets
+// kPriorityRatio time slices for each time slice of the priority below it:
+// see engine.cc.
+enum ThreadPriority {
+  PRIORITY_LOW,
+  PRIORITY_MEDIUM,
+  PRIORITY_HIGH,
+  PRIORITY_COUNT,
 };
 
 // The engine runs a collection of threads.
+//
+// An engine runs its threads on its workers: by default, on the OS thread
+// calling Run() only. With several workers, the threads run in parallel on
+// the same stores: see Workers.
+// Engines on different OS threads run in parallel too, and may run the same
+// procedures:
+//  - each engine runs procedures in its own code context: the interpreter
+//    quickens instructions and fills inline caches and JIT counters in the
+//    packed code owned by the engine, or in its private copy of the packed
+//    code of another engine, without synchronization (see CodeContext);
+//  - thread ids are allocated by each engine;
+//  - name ids are reserved by each OS thread in blocks, from a global counter;
+//  - atoms, arities and native ids are interned in global tables rather than
+//    per engine: values compare atoms and arities by address, and procedures,
+//    records and constants hold them across engines. Each OS thread caches
+//    its last lookups in tables of fixed size: the global tables are locked
+//    mostly the first time an OS thread looks an atom, an arity or a native
+//    up, never when running quickened or resolved instructions;
+//  - the heap store and the empty array are immutable.
+// Other OS threads reach an engine through Post(): see Embedding.
 class Engine {
  public:
   Engine();
+  ~Engine();
 
-  // Runs as long as there are live threads.
+  // Runs as long as there are runnable threads, or the idle callback asks
+  // for more.
   void Run();
 
+  // ---------------------------------------------------------------------------
+  // Embedding
+  //
+  // A host with its own event loop runs the engine in bounded steps, and
+  // goes on with its own work in between:
+  //
+  //   // Wakes up the loop when other OS threads post to the engine.
+  //   loop.Watch(engine.wakeup_fd(), ...);
+  //   while (loop.Poll(engine.RunFor(10000) ? 0 : timeout)) {
+  //     loop.Dispatch();
+  //   }
+  //
+  // RunFor() and RunUntil() run whole time slices, and return once the
+  // budget is used up or the deadline is passed. They may overrun their
+  // bound by about one time slice, and by the time of the natives and
+  // unifications, which are not preempted.
+  //
+  // A host blocking in Run() instead waits for external events in the idle
+  // callback.
+  //
+  // Tasks posted from any OS thread run on the OS thread of the engine,
+  // before its next time slice. They bind variables and create threads in
+  // the stores of the engine: see Bind() and Thread::New().
+
+  typedef std::chrono::steady_clock Clock;
+
+  // Runs for about max_steps steps, or until no thread is runnable.
+  // @returns True if threads are still runnable.
+  bool RunFor(uint64 max_steps);
+
+  // Runs until about the deadline, or until no thread is runnable.
+  // @returns True if threads are still runnable.
+  bool RunUntil(Clock::time_point deadline);
+
+  // Called when no thread is runnable, after the posted tasks are run. It may
+  // wait for external events and post tasks or bind variables.
+  // @returns True to keep running, false to return from the engine.
+  typedef std::function<bool(Engine* engine)> IdleCallback;
+
+  // Without idle callback, the default, the engine returns when idle.
+  void set_idle_callback(const IdleCallback& callback) {
+    idle_callback_ = callback;
+  }
+
+  // A task run on the OS thread of the engine.
+  typedef std::function<void(Engine* engine)> Task;
+
+  // Posts a task to the engine. May be called from any OS thread.
+  void Post(const Task& task);
+
+  // Posts the binding of a variable: see Bind(). May be called from any OS
+  // thread. The value must not be mutated once posted: an atom or a small
+  // integer, or a value allocated in a store of the engine.
+  void PostBind(Value variable, Value value);
+
+  // File descriptor readable while tasks are posted and not run yet, for
+  // select(), poll() and the like.
+  int wakeup_fd() const { return wakeup_fds_[0]; }
+
+  // Unifies a variable with a value on the OS thread of the engine, between
+  // time slices: from a task or the idle callback for instance. The threads
+  // waiting on the variable become runnable.
+  // @returns False if the values do not unify.
+  bool Bind(Value variable, Value value);
+
+  // Closes an open-record on the OS thread of the engine, as Bind() does.
+  // The threads waiting on the open-record become runnable.
+  // @returns The record: see Value::OpenRecordClose().
+  Value CloseOpenRecord(Store* store, Value open_record);
+
+  // ---------------------------------------------------------------------------
+  // Scheduling
+  //
+  // Runnable threads take turns, by priority, to run for a time slice. They
+  // are preempted at backward branches and calls only, once their time slice
+  // is used up.
+  //
+  // By default, a time slice is a fixed number of steps: kTimeSliceSteps.
+  // With a time quantum, time slices are measured in elapsed time instead.
+  // A thread then runs on a step budget, and reads the clock each time it
+  // runs out of it. The budget of each thread adapts to the time its steps
+  // take, so that the clock is read a few times per quantum: a thread
+  // spending its time in natives or unifications, which are not preempted,
+  // checks the clock more often than a thread running cheap instructions.
+
+  // Steps per time slice, without time quantum.
+  static const int64 kTimeSliceSteps = 1000;
+
+  // Time quantum, in nanoseconds. 0, the default, runs time slices of
+  // kTimeSliceSteps steps: the scheduling of the threads is reproducible.
+  int64 time_quantum_ns() const { return time_quantum_ns_; }
+  void set_time_quantum_ns(int64 quantum_ns);
+
+  // ---------------------------------------------------------------------------
+  // Workers
+  //
+  // With several workers, Run() starts an OS thread for each worker but the
+  // first one, which runs on the OS thread calling Run(). The workers run the
+  // threads in parallel, on the same stores:
+  //  - each worker has its own run queue, a deque. The threads a thread
+  //    creates or wakes up join the back of the deque of the worker running
+  //    it, which runs them next; the thread joins the front when preempted.
+  //    A worker with an empty deque steals from the front of the deque of
+  //    another worker. Priorities are honored within each deque;
+  //  - variables are bound and suspensions registered under the binding lock
+  //    of the engine, and bindings are read without locking: see Unify().
+  //    A thread waiting on a variable is registered in its suspensions only
+  //    once stopped, so that it runs on one worker at a time;
+  //  - each worker runs procedures in its own code context, as engines do:
+  //    the workers quicken instructions, fill inline caches and run the JIT
+  //    each in their own packed code. Opcode profiles are recorded with a
+  //    single worker only;
+  //  - the slots of cells and arrays are loaded and stored atomically, one
+  //    at a time: threads on different workers updating one do not lose or
+  //    tear values, but synchronize through dataflow variables to order
+  //    their updates.
+  // Posted tasks and the idle callback run on the first worker, between time
+  // slices. The idle callback runs once no thread is runnable on any worker.
+  // RunFor() and RunUntil() run on a single worker.
+  // Natives are registered before the workers run.
+
+  // Number of workers, 1 by default.
+  int workers() const { return nworkers_; }
+  void set_workers(int nworkers);
+
   // Registers a native procedure.
   // Override any pre-existing native with the specified name.
   void RegisterNative(string name, NativeInterface* native);
 
+  // Registers a native procedure with a fixed number of parameters:
+  //   engine.RegisterNative<&Decrement>("decrement");
+  // Override any pre-existing native with the specified name.
+  template <Value (*kFunction)(Value)>
+  void RegisterNative(const string& name);
+  template <Value (*kFunction)(Value, Value)>
+  void RegisterNative(const string& name);
+  template <Value (*kFunction)(Value, Value, Value)>
+  void RegisterNative(const string& name);
+  template <Value (*kFunction)(Store*, Value)>
+  void RegisterNative(const string& name);
+  template <Value (*kFunction)(Store*, Value, Value)>
+  void RegisterNative(const string& name);
+  template <Value (*kFunction)(Store*, Value, Value, Value)>
+  void RegisterNative(const string& name);
+
+  // ---------------------------------------------------------------------------
+  // Native linking
+  //
+  // Natives are identified by the index of their name in a global registry,
+  // where engines register the names of their natives. Instructions calling
+  // a native by a constant name are resolved to its id when the procedure is
+  // packed, if the name is registered and its id fits in a packed operand:
+  // see PackedCode. Other calls look the name up. Engines map the ids to
+  // their natives in a table.
+
+  // Looks up the id of a native name, without registering it.
+  // @returns False if no engine registered a native with this name.
+  static bool FindNativeId(const string& name, uint64* id);
+  static const string& NativeName(uint64 id);
+
+  // @returns The native with the given id, or NULL if there is none.
+  const Native* native(uint64 id) const {
+    return ((id < natives_.size()) && natives_[id].defined())
+        ? &natives_[id]
+        : NULL;
+  }
+
+  // Checks that the natives called by a procedure, and by the procedures in
+  // its constants, are registered. Reports the unknown natives.
+  // Called when threads are created.
+  // @returns True if all natives are registered.
+  bool Link(const Closure* closure);
+
+  // @returns The id of the code context of the engine, unique in the process
+  //     and never reused.
+  uint64 id() const;
+
+  // Whether threads dispatch instructions with computed gotos.
+  // Defaults to true when supported.
+  bool threaded_dispatch() const { return threaded_dispatch_; }
+  void set_threaded_dispatch(bool threaded);
+
+  // Records the instructions executed by the threads into a profile, when
+  // not NULL. Profiled threads use the switch dispatch.
+  OpcodeProfile* opcode_profile() const { return opcode_profile_; }
+  void set_opcode_profile(OpcodeProfile* profile) { opcode_profile_ = profile; }
+
+  // Number of calls and loop iterations after which the threads compile a
+  // procedure into native code: see JitCode. 0 compiles procedures when first
+  // entered. The JIT is opt-in: negative thresholds, the default, disable it.
+  // Profiled threads do not run native code.
+  int64 jit_threshold() const { return jit_threshold_; }
+  void set_jit_threshold(int64 threshold);
+
  private:
+  // Threads ready to run, by priority.
+  class RunQueue {
+   public:
+    RunQueue();
+
+    bool empty() const;
+
+    // Queues threads in order, each at its priority.
+    void PushAll(ThreadList* threads);
+
+    // @returns The next thread to run, or NULL if the queue is empty.
+    Thread* Pop();
+
+   private:
+    ThreadList ready_[PRIORITY_COUNT];
+
+    // Time slices run in a row at each priority, while threads of lower
+    // priorities were ready to run.
+    int slices_in_a_row_[PRIORITY_COUNT];
+
+    DISALLOW_COPY_AND_ASSIGN(RunQueue);
+  };
+
+  // Run queue of a worker: deques of threads ready to run, by priority.
+  // The worker runs the threads it queued last first, while they are hot in
+  // its cache, and other workers steal the threads queued first. To bound
+  // the wait of the threads queued first, the worker runs one of them after
+  // kLifoInARow time slices popped from the back.
+  class WorkDeque {
+   public:
+    WorkDeque();
+
+    // Queues threads in order at the back, each at its priority, but the
+    // preempted thread, if any, at the front: it runs after the threads it
+    // made runnable.
+    void PushAll(ThreadList* threads, Thread* preempted);
+
+    // @returns The next thread the worker runs, or NULL if the deque is empty.
+    Thread* Pop();
+
+    // @returns A thread from the front of the deque, for another worker, or
+    //     NULL if the deque is empty.
+    Thread* Steal();
+
+   private:
+    deque<Thread*> ready_[PRIORITY_COUNT];
+
+    // See RunQueue.
+    int slices_in_a_row_[PRIORITY_COUNT];
+
+    // Time slices popped from the back in a row.
+    int lifo_in_a_row_;
+
+    DISALLOW_COPY_AND_ASSIGN(WorkDeque);
+  };
+
+  struct Worker;
+
+  // Queues a new thread: see QueueThreads().
   void AddThread(Thread* thread);
 
+  // Queues runnable threads: to the queue of the worker of the calling OS
+  // thread while workers run, to runnable_ otherwise.
+  // @param preempted The thread of threads that just ran, if any.
+  void QueueThreads(ThreadList* threads, Thread* preempted);
+
+  // Registers a WAITING thread in the suspensions of the variable it waits
+  // on, or appends it to a list of runnable threads if the variable was bound
+  // meanwhile: see Thread::waiting_on().
+  void Suspend(Thread* thread, ThreadList* runnable);
+
+  // @returns A new thread id, unique in this engine.
+  uint64 NewThreadId() { return next_thread_id_++; }
+
+  std::atomic<uint64> next_thread_id_;
+
+  // @returns The code context the threads of the calling worker run
+  //     procedures in.
+  CodeContext* code_context() const;
+
+  // Code context of the first worker, and of the engine with a single one.
+  const std::unique_ptr<CodeContext> code_context_;
+
+  // Code contexts of the other workers, kept across runs.
+  vector<std::unique_ptr<CodeContext> > worker_code_contexts_;
+
+  // @returns The next thread to run, or NULL if no thread is runnable.
+  Thread* NextThread();
+
+  // Runs the workers, until no thread is runnable and the idle callback
+  // returns false.
+  void RunWorkers();
+
+  // Runs the threads on a worker, on the calling OS thread.
+  void RunWorker(Worker* worker);
+
+  // @returns The next thread to run on a worker, from its own queue, or
+  //     stolen from the front of the queue of another worker. NULL if no
+  //     thread is queued.
+  Thread* NextThread(Worker* worker);
+
+  // Blocks an idle worker until threads are queued, or until the workers
+  // stop. The first worker also wakes up when no thread is runnable, and
+  // when tasks are posted.
+  void WaitForThreads(Worker* worker);
+
+  // Wakes up the idle workers, after the conditions of WaitForThreads()
+  // change.
+  void WakeUpWorkers();
+
+  // Runs the threads until max_steps steps are charged, the deadline is
+  // passed, or no thread is runnable and the idle callback returns false.
+  // @returns True if threads are still runnable.
+  bool RunWithin(uint64 max_steps, Clock::time_point deadline);
+
+  // @returns True if threads are runnable.
+  bool has_runnable_threads() const;
+
+  // Runs a thread for a time slice. The time slice ends after about
+  // max_steps steps, or at the deadline, if sooner.
+  // @param runnable Returns the threads made runnable, followed by the thread
+  //     itself if still runnable.
+  // @returns The number of steps charged.
+  uint64 RunTimeSlice(Thread* thread, uint64 max_steps,
+                      Clock::time_point deadline, ThreadList* runnable);
+
+  // Runs the posted tasks.
+  void RunPostedTasks();
+
+  // Guards thread_map_.
+  std::mutex thread_map_mutex_;
   map<uint64, Thread*> thread_map_;
-  list<Thread*> runnable_;
 
-  map<string, NativeInterface*> native_map_;
+  // With a single worker, threads made runnable since the last time slice
+  // started, in order: new threads, woken up suspensions and preempted
+  // threads. They join the queue of their priority before the next thread to
+  // run is chosen.
+  ThreadList runnable_;
+
+  // With a single worker, the threads ready to run.
+  RunQueue ready_;
+
+  int64 time_quantum_ns_;
+
+  int nworkers_;
+
+  // The workers, while they run. Empty otherwise.
+  vector<unique_ptr<Worker> > workers_;
+
+  // The worker run by the calling OS thread, if any.
+  static thread_local Worker* current_worker_;
+
+  // Serializes the bindings of the workers: see binding_lock().
+  std::mutex binding_mutex_;
+
+  // Threads runnable or running on the workers.
+  std::atomic<int64> nactive_;
+
+  // Threads in the run queues of the workers.
+  std::atomic<int64> nqueued_;
+
+  // Whether the workers stop once idle.
+  std::atomic<bool> stopping_;
+
+  // Idle workers wait on the condition variable.
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cv_;
+  std::atomic<int> nidle_;
+
+  IdleCallback idle_callback_;
+
+  // Tasks posted and not run yet, in order.
+  std::mutex posted_mutex_;
+  vector<Task> posted_;
+
+  // Whether posted_ is not empty: read without locking.
+  std::atomic<bool> has_posted_;
+
+  // Pipe written once when tasks are posted, drained when they are run.
+  int wakeup_fds_[2];
+
+  // Registers a native under a name, overriding any pre-existing one.
+  void SetNative(const string& name, const Native& native);
+
+  // @returns The id of a native name, registering the name if needed.
+  static uint64 RegisterNativeName(const string& name);
+
+  // Registers a native with a fixed number of parameters.
+  void SetNativeFunction(const string& name, NativeFunction function,
+                         uint64 nparams);
+
+  // Links the natives of a packed procedure and of the procedures in its
+  // constants, recursively.
+  bool LinkCode(const PackedCode* code);
+
+  // Native id -> native.
+  vector<Native> natives_;
+
+  // Guards linked_: workers link the procedures of the threads they create.
+  std::mutex linked_mutex_;
+
+  // Code already checked by Link(), since the last registration.
+  UnorderedSet<const PackedCode*> linked_;
+
+  bool threaded_dispatch_;
+
+  OpcodeProfile* opcode_profile_;
+
+  int64 jit_threshold_;
 
   friend class Thread;
+
+  DISALLOW_COPY_AND_ASSIGN(Engine);
 };
 
 }  // namespace store
@@ -0,0 +1,79 @@
+#ifndef STORE_ENGINE_INL_H_
+#define STORE_ENGINE_INL_H_
+
+namespace store {
+
+// -----------------------------------------------------------------------------
+// Trampolines of the natives with a fixed number of parameters
+
+template <Value (*kFunction)(Value)>
+Value CallNative(Store* store, const Value* parameters) {
+  return kFunction(parameters[0]);
+}
+
+template <Value (*kFunction)(Value, Value)>
+Value CallNative(Store* store, const Value* parameters) {
+  return kFunction(parameters[0], parameters[1]);
+}
+
+template <Value (*kFunction)(Value, Value, Value)>
+Value CallNative(Store* store, const Value* parameters) {
+  return kFunction(parameters[0], parameters[1], parameters[2]);
+}
+
+template <Value (*kFunction)(Store*, Value)>
+Value CallNative(Store* store, const Value* parameters) {
+  return kFunction(store, parameters[0]);
+}
+
+template <Value (*kFunction)(Store*, Value, Value)>
+Value CallNative(Store* store, const Value* parameters) {
+  return kFunction(store, parameters[0], parameters[1]);
+}
+
+template <Value (*kFunction)(Store*, Value, Value, Value)>
+Value CallNative(Store* store, const Value* parameters) {
+  return kFunction(store, parameters[0], parameters[1], parameters[2]);
+}
+
+// -----------------------------------------------------------------------------
+
+template <Value (*kFunction)(Value)>
+inline
+void Engine::RegisterNative(const string& name) {
+  SetNativeFunction(name, &CallNative<kFunction>, 1);
+}
+
+template <Value (*kFunction)(Value, Value)>
+inline
+void Engine::RegisterNative(const string& name) {
+  SetNativeFunction(name, &CallNative<kFunction>, 2);
+}
+
+template <Value (*kFunction)(Value, Value, Value)>
+inline
+void Engine::RegisterNative(const string& name) {
+  SetNativeFunction(name, &CallNative<kFunction>, 3);
+}
+
+template <Value (*kFunction)(Store*, Value)>
+inline
+void Engine::RegisterNative(const string& name) {
+  SetNativeFunction(name, &CallNative<kFunction>, 1);
+}
+
+template <Value (*kFunction)(Store*, Value, Value)>
+inline
+void Engine::RegisterNative(const string& name) {
+  SetNativeFunction(name, &CallNative<kFunction>, 2);
+}
+
+template <Value (*kFunction)(Store*, Value, Value, Value)>
+inline
+void Engine::RegisterNative(const string& name) {
+  SetNativeFunction(name, &CallNative<kFunction>, 3);
+}
+
+}  // namespace store
+
+#endif  // STORE_ENGINE_INL_H_
@@ -0,0 +1,489 @@
+// Tests for the scheduling of the threads, for engines running on several OS
+// threads, and for the embedding API.
+#include "store/values.h"
+
+#include <poll.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+using std::set;
+using std::shared_ptr;
+using std::vector;
+
+#include <boost/format.hpp>
+using boost::format;
+
+#include <gtest/gtest.h>
+
+#include "store/engine.h"
+
+namespace store {
+
+const uint64 kStoreSize = 16 * 1024 * 1024;
+
+namespace {
+
+Operand Local(int index) {
+  return Operand(Register(Register::LOCAL, index));
+}
+
+Operand Param(int index) {
+  return Operand(Register(Register::PARAM, index));
+}
+
+Operand Immediate(int64 integer) {
+  return Operand(Value::Integer(integer));
+}
+
+// Names of the threads, in the order they finish.
+vector<int64> finished;
+
+Value Finish(Value name) {
+  finished.push_back(IntValue(name));
+  return name;
+}
+
+// Builds a procedure Count(N Name) counting down from N, then reporting
+// Name as finished:
+//   l0 := N
+//   while 0 < l0:
+//     l0 := l0 - 1
+//   finish(Name Name)
+// Each iteration of the loop charges 4 steps.
+Closure* NewCountProc(Store* store) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(Bytecode(Bytecode::LOAD, Local(0), Param(0)));
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(1), Immediate(0), Local(0)));
+  code->push_back(Bytecode(Bytecode::BRANCH_UNLESS, Local(1), Immediate(5)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(0), Local(0),
+               Immediate(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH, Immediate(1)));
+  code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Local(2), Immediate(2), Param(1)));
+  code->push_back(
+      Bytecode(Bytecode::CALL_NATIVE, Operand(Atom::Get("finish")),
+               Local(2)));
+  return Closure::New(store, code, 2, 3, 0);
+}
+
+// Creates a thread running Count(N Name).
+Thread* NewCountThread(Store* store, Engine* engine, Closure* count,
+                       int64 n, int64 name, ThreadPriority priority) {
+  Array* const params = Array::New(store, 2, Value::Integer(n));
+  params->Assign(1, Value::Integer(name));
+  Thread* const thread = Thread::New(store, engine, count, params, store);
+  thread->set_priority(priority);
+  return thread;
+}
+
+// Builds a procedure Sum(N Result), with Result = N + ... + 1.
+Closure* NewSumProc(Store* store) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(0)));
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(1), Immediate(0), Param(0)));
+  code->push_back(Bytecode(Bytecode::BRANCH_UNLESS, Local(1), Immediate(6)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD, Local(0), Local(0), Param(0)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Param(0), Param(0),
+               Immediate(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH, Immediate(1)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(0)));
+  return Closure::New(store, code, 2, 2, 0);
+}
+
+// What a worker of the ConcurrentEngines test observed.
+struct WorkerResults {
+  vector<int64> sums;
+  vector<uint64> thread_ids;
+  vector<Value> names;
+  vector<const Atom*> atoms;
+  vector<const Arity*> arities;
+};
+
+// Runs an engine in its own store, interning atoms and arities as it goes.
+void RunWorker(int nthreads, int natoms, WorkerResults* results) {
+  StaticStore store(kStoreSize);
+  Engine engine;
+  Closure* const sum = NewSumProc(&store);
+  vector<Value> sums;
+  for (int i = 0; i < nthreads; ++i) {
+    const Value result = New::Free(&store);
+    Array* const params = Array::New(&store, 2, Value::Integer(1000 + i));
+    params->Assign(1, result);
+    Thread* const thread = Thread::New(&store, &engine, sum, params, &store);
+    results->thread_ids.push_back(thread->id());
+    sums.push_back(result);
+  }
+  for (int i = 0; i < natoms; ++i) {
+    Atom* const atom = Atom::Get((format("atom%d") % i).str());
+    results->atoms.push_back(atom);
+    results->arities.push_back(Arity::Get(Value(atom), Value::Integer(1)));
+    results->names.push_back(New::Name(&store));
+  }
+  engine.Run();
+  for (const Value& result : sums)
+    results->sums.push_back(IntValue(result.Deref()));
+}
+
+class EngineTest : public ::testing::Test {
+ protected:
+  EngineTest() : store_(kStoreSize), count_(NewCountProc(&store_)) {
+    finished.clear();
+    engine_.RegisterNative<&Finish>("finish");
+  }
+
+  StaticStore store_;
+  Engine engine_;
+  Closure* const count_;
+};
+
+}  // namespace
+
+TEST_F(EngineTest, RoundRobin) {
+  // Both threads need 8 time slices: the first one created finishes first.
+  NewCountThread(&store_, &engine_, count_, 2000, 1, PRIORITY_MEDIUM);
+  NewCountThread(&store_, &engine_, count_, 2000, 2, PRIORITY_MEDIUM);
+  engine_.Run();
+  EXPECT_EQ((vector<int64>{1, 2}), finished);
+}
+
+TEST_F(EngineTest, Priorities) {
+  NewCountThread(&store_, &engine_, count_, 2000, 1, PRIORITY_LOW);
+  NewCountThread(&store_, &engine_, count_, 2000, 2, PRIORITY_MEDIUM);
+  NewCountThread(&store_, &engine_, count_, 2000, 3, PRIORITY_HIGH);
+  engine_.Run();
+  EXPECT_EQ((vector<int64>{3, 2, 1}), finished);
+}
+
+TEST_F(EngineTest, LowerPrioritiesDoNotStarve) {
+  // The high priority thread needs 40 time slices, the low priority thread
+  // only one: it runs after the first 10 time slices of the other thread.
+  Thread* const high =
+      NewCountThread(&store_, &engine_, count_, 10000, 1, PRIORITY_HIGH);
+  Thread* const low =
+      NewCountThread(&store_, &engine_, count_, 100, 2, PRIORITY_LOW);
+  engine_.Run();
+  EXPECT_EQ((vector<int64>{2, 1}), finished);
+  EXPECT_LE(4 * 10000UL, high->steps());
+  EXPECT_LE(4 * 100UL, low->steps());
+}
+
+TEST_F(EngineTest, NewThreadsInheritPriority) {
+  // Spawn(Count N Name) runs Count(N Name) in a new thread.
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Local(0), Immediate(2), Param(1)));
+  code->push_back(
+      Bytecode(Bytecode::ASSIGN_ARRAY, Local(0), Immediate(1), Param(2)));
+  code->push_back(Bytecode(Bytecode::NEW_THREAD, Local(1), Param(0), Local(0)));
+  Closure* const spawn = Closure::New(&store_, code, 3, 2, 0);
+
+  NewCountThread(&store_, &engine_, count_, 2000, 1, PRIORITY_MEDIUM);
+  Array* const params = Array::New(&store_, 3, Value(count_));
+  params->Assign(1, Value::Integer(2000));
+  params->Assign(2, Value::Integer(2));
+  Thread::New(&store_, &engine_, spawn, params, &store_)
+      ->set_priority(PRIORITY_HIGH);
+  engine_.Run();
+  EXPECT_EQ((vector<int64>{2, 1}), finished);
+}
+
+TEST_F(EngineTest, TimeQuantum) {
+  EXPECT_EQ(0, engine_.time_quantum_ns());
+  engine_.set_time_quantum_ns(100 * 1000);  // 100us
+  Thread* const first =
+      NewCountThread(&store_, &engine_, count_, 100000, 1, PRIORITY_MEDIUM);
+  Thread* const second =
+      NewCountThread(&store_, &engine_, count_, 10, 2, PRIORITY_MEDIUM);
+  engine_.Run();
+  // The short thread runs once the first time quantum is over.
+  EXPECT_EQ((vector<int64>{2, 1}), finished);
+  EXPECT_LE(4 * 100000UL, first->steps());
+  EXPECT_LE(4 * 10UL, second->steps());
+}
+
+TEST(Engine, ConcurrentEngines) {
+  const int kWorkers = 4;
+  const int kThreads = 20;
+  const int kAtoms = 1000;
+  vector<WorkerResults> results(kWorkers);
+  vector<std::thread> workers;
+  for (int i = 0; i < kWorkers; ++i)
+    workers.emplace_back(RunWorker, kThreads, kAtoms, &results[i]);
+  for (std::thread& worker : workers)
+    worker.join();
+
+  set<uint64> name_ids;
+  for (const WorkerResults& worker : results) {
+    ASSERT_EQ(static_cast<uint64>(kThreads), worker.sums.size());
+    for (int i = 0; i < kThreads; ++i) {
+      EXPECT_EQ((1000 + i) * (1001 + i) / 2, worker.sums[i]);
+      // Each engine allocates its own thread ids.
+      EXPECT_EQ(static_cast<uint64>(i), worker.thread_ids[i]);
+    }
+    // Atoms and arities are interned once, for all the engines.
+    EXPECT_EQ(results[0].atoms, worker.atoms);
+    EXPECT_EQ(results[0].arities, worker.arities);
+    for (Value name : worker.names)
+      name_ids.insert(name.LiteralHashCode());
+  }
+  // Names are unique across the engines.
+  EXPECT_EQ(static_cast<uint64>(kWorkers * kAtoms), name_ids.size());
+}
+
+// Builds a procedure Call(Proc N Result) calling Proc(N Result).
+Closure* NewCallProc(Store* store) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Local(0), Immediate(2), Param(1)));
+  code->push_back(
+      Bytecode(Bytecode::ASSIGN_ARRAY, Local(0), Immediate(1), Param(2)));
+  code->push_back(Bytecode(Bytecode::CALL, Param(0), Local(0)));
+  return Closure::New(store, code, 3, 1, 0);
+}
+
+TEST(Engine, EnginesShareProcedures) {
+  StaticStore store(kStoreSize);
+  Closure* const sum = NewSumProc(&store);
+  {
+    Engine engine1;
+    EXPECT_TRUE(engine1.Link(sum));
+    const Value result1 = New::Free(&store);
+    Array* const params = Array::New(&store, 2, Value::Integer(10));
+    params->Assign(1, result1);
+    Thread::New(&store, &engine1, sum, params, &store);
+    engine1.Run();
+    EXPECT_EQ(55, IntValue(result1));
+    EXPECT_EQ(engine1.id(), sum->packed_code()->owner());
+
+    // Another live engine runs the procedure in a copy of its packed code,
+    // called directly or from another procedure.
+    Engine engine2;
+    EXPECT_TRUE(engine2.Link(sum));
+    const Value result2 = New::Free(&store);
+    Array* const call_params = Array::New(&store, 3, Value(sum));
+    call_params->Assign(1, Value::Integer(10));
+    call_params->Assign(2, result2);
+    Thread::New(&store, &engine2, NewCallProc(&store), call_params, &store);
+    engine2.Run();
+    EXPECT_EQ(55, IntValue(result2));
+    EXPECT_EQ(engine1.id(), sum->packed_code()->owner());
+  }
+
+  // The packed code is free once its engine is destroyed.
+  Engine engine3;
+  const Value result = New::Free(&store);
+  Array* const params = Array::New(&store, 2, Value::Integer(10));
+  params->Assign(1, result);
+  Thread::New(&store, &engine3, sum, params, &store);
+  engine3.Run();
+  EXPECT_EQ(engine3.id(), sum->packed_code()->owner());
+  EXPECT_EQ(55, IntValue(result));
+}
+
+TEST_F(EngineTest, RunForBoundsSteps) {
+  Thread* const thread =
+      NewCountThread(&store_, &engine_, count_, 10000, 1, PRIORITY_MEDIUM);
+  int runs = 1;
+  uint64 steps = 0;
+  while (engine_.RunFor(1000)) {
+    EXPECT_TRUE(finished.empty());
+    // Loops are preempted at their backward branch.
+    EXPECT_LE(thread->steps(), steps + 1000 + 4);
+    steps = thread->steps();
+    ++runs;
+  }
+  EXPECT_EQ((vector<int64>{1}), finished);
+  EXPECT_LE(40, runs);
+  EXPECT_FALSE(engine_.RunFor(1000));
+}
+
+TEST_F(EngineTest, RunUntilDeadline) {
+  typedef Engine::Clock Clock;
+  engine_.set_time_quantum_ns(100 * 1000);  // 100us
+  NewCountThread(&store_, &engine_, count_, 1000 * 1000 * 1000, 1,
+                 PRIORITY_MEDIUM);
+  const Clock::time_point start = Clock::now();
+  EXPECT_TRUE(engine_.RunUntil(start + std::chrono::milliseconds(1)));
+  EXPECT_GE(Clock::now(), start + std::chrono::milliseconds(1));
+  EXPECT_LT(Clock::now(), start + std::chrono::milliseconds(100));
+  EXPECT_TRUE(finished.empty());
+}
+
+TEST_F(EngineTest, PostFromAnotherThread) {
+  // Count(N 1) waits for N to be bound by another OS thread.
+  const Value n = New::Free(&store_);
+  Array* const params = Array::New(&store_, 2, n);
+  params->Assign(1, Value::Integer(1));
+  Thread::New(&store_, &engine_, count_, params, &store_);
+  EXPECT_FALSE(engine_.RunFor(1000));
+
+  // The host posts once the engine is idle.
+  std::promise<void> idle;
+  std::future<void> engine_idle = idle.get_future();
+  int idle_calls = 0;
+  engine_.set_idle_callback([&idle_calls, &idle](Engine* engine) {
+    if (++idle_calls == 1) idle.set_value();
+    if (finished.size() == 2) return false;
+    struct pollfd wakeup = {engine->wakeup_fd(), POLLIN, 0};
+    EXPECT_EQ(1, poll(&wakeup, 1, 10 * 1000));
+    return true;
+  });
+  std::thread host([this, n, &engine_idle]() {
+    engine_idle.wait();
+    engine_.PostBind(n, Value::Integer(100));
+    engine_.Post([this](Engine* engine) {
+      NewCountThread(&store_, engine, count_, 10, 2, PRIORITY_MEDIUM);
+    });
+  });
+  engine_.Run();
+  host.join();
+
+  EXPECT_EQ((vector<int64>{1, 2}), finished);
+  EXPECT_LE(2, idle_calls);
+  // The posted tasks ran: the wakeup file descriptor is drained.
+  struct pollfd wakeup = {engine_.wakeup_fd(), POLLIN, 0};
+  EXPECT_EQ(0, poll(&wakeup, 1, 0));
+}
+
+TEST(Engine, WorkersShareTheStore) {
+  const int kChains = 20;
+  const int kChainLength = 50;
+  const int kSums = 200;
+  StaticStore store(kStoreSize);
+  Engine engine;
+  engine.set_workers(4);
+  Closure* const sum = NewSumProc(&store);
+
+  // Independent threads, allocating concurrently in the store.
+  vector<Value> sums;
+  for (int i = 0; i < kSums; ++i) {
+    const Value result = New::Free(&store);
+    Array* const params = Array::New(&store, 2, Value::Integer(1000 + i));
+    params->Assign(1, result);
+    Thread::New(&store, &engine, sum, params, &store);
+    sums.push_back(result);
+  }
+
+  // Chains of threads, each Sum(X[j] X[j+1]) waiting for the previous one:
+  // created last to first, they suspend before the heads of the chains run.
+  vector<vector<Value> > chains(kChains);
+  for (vector<Value>& chain : chains) {
+    for (int j = 0; j <= kChainLength; ++j)
+      chain.push_back(New::Free(&store));
+    for (int j = kChainLength - 1; j >= 0; --j) {
+      Array* const params = Array::New(&store, 2, chain[j]);
+      params->Assign(1, chain[j + 1]);
+      Thread::New(&store, &engine, sum, params, &store);
+    }
+  }
+  // Heads of the chains: Sum(1 X[0]).
+  for (const vector<Value>& chain : chains) {
+    Array* const params = Array::New(&store, 2, Value::Integer(1));
+    params->Assign(1, chain[0]);
+    Thread::New(&store, &engine, sum, params, &store);
+  }
+  engine.Run();
+
+  for (int i = 0; i < kSums; ++i)
+    EXPECT_EQ((1000 + i) * (1001 + i) / 2, IntValue(sums[i].Deref()));
+  for (const vector<Value>& chain : chains)
+    EXPECT_EQ(1, IntValue(chain.back().Deref()));
+
+  // The worker that ran the procedure first quickened it in place.
+  EXPECT_NE(0u, sum->packed_code()->owner());
+  EXPECT_TRUE(sum->packed_code()->code()[0].quick());
+}
+
+// Builds a list of 2000 tuples (I [I I+1]), ending with (1999 [1999 Last]).
+Value NewSharedList(Store* store, int64 last) {
+  const int64 kSize = 2000;
+  vector<Value> elements;
+  for (int64 i = 0; i < kSize; ++i) {
+    Value pair[2] = {
+        Value::Integer(i),
+        Value::Integer((i == kSize - 1) ? last : i + 1) };
+    Value values[2] = { Value::Integer(i), New::List(store, 2, pair) };
+    elements.push_back(New::Tuple(store, 2, values));
+  }
+  return New::List(store, kSize, elements.data());
+}
+
+TEST(Engine, WorkersCompareSharedValues) {
+  // Eq(A B Result), with Result = (A == B).
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::TEST_EQUALITY, Local(0), Param(0), Param(1)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(2), Local(0)));
+
+  StaticStore store(kStoreSize);
+  Engine engine;
+  engine.set_workers(4);
+  Closure* const eq = Closure::New(&store, code, 3, 1, 0);
+
+  // The threads hash and compare the same values concurrently: none of them
+  // is hashed yet.
+  const Value list = NewSharedList(&store, 1999);
+  const Value equal = NewSharedList(&store, 1999);
+  const Value unequal = NewSharedList(&store, 0);
+  vector<Value> results;
+  for (int i = 0; i < 100; ++i) {
+    const Value result = New::Free(&store);
+    Array* const params = Array::New(&store, 3, list);
+    params->Assign(1, (i % 2 == 0) ? equal : unequal);
+    params->Assign(2, result);
+    Thread::New(&store, &engine, eq, params, &store);
+    results.push_back(result);
+  }
+  engine.Run();
+
+  for (int i = 0; i < 100; ++i)
+    EXPECT_TRUE(Boolean::Get(i % 2 == 0) == results[i].Deref()) << i;
+  uint32 hash1, hash2;
+  ASSERT_TRUE(list.StructuralHash(&hash1));
+  ASSERT_TRUE(equal.StructuralHash(&hash2));
+  EXPECT_EQ(hash1, hash2);
+  EXPECT_TRUE(Equals(list, equal));
+  EXPECT_FALSE(Equals(list, unequal));
+}
+
+TEST(Engine, WorkersRunPostedTasks) {
+  StaticStore store(kStoreSize);
+  Engine engine;
+  engine.set_workers(4);
+  Closure* const sum = NewSumProc(&store);
+
+  // Sum(N Result) waits for N to be bound by another OS thread.
+  const Value n = New::Free(&store);
+  const Value result = New::Free(&store);
+  Array* const params = Array::New(&store, 2, n);
+  params->Assign(1, result);
+  Thread::New(&store, &engine, sum, params, &store);
+
+  int idle_calls = 0;
+  engine.set_idle_callback([&idle_calls, result](Engine* engine) {
+    ++idle_calls;
+    if (IsDet(result)) return false;
+    struct pollfd wakeup = {engine->wakeup_fd(), POLLIN, 0};
+    EXPECT_EQ(1, poll(&wakeup, 1, 10 * 1000));
+    return true;
+  });
+  std::thread host([&engine, n]() {
+    engine.PostBind(n, Value::Integer(100));
+  });
+  engine.Run();
+  host.join();
+
+  EXPECT_EQ(5050, IntValue(result.Deref()));
+  EXPECT_LE(1, idle_calls);
+}
+
+}  // namespace store
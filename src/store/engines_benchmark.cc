@@ -0,0 +1,129 @@
+// Measures the throughput of independent engines running in parallel, one per
+// OS thread, from 1 engine up to --max_engines.
+// Each engine runs the same number of threads, each calling a native by a name
+// held in a register and branching on booleans: the native and the boolean
+// atoms are looked up by name on each iteration. With each engine running its
+// own packed code, the throughput grows with the number of engines up to the
+// number of cores.
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "store/engine.h"
+#include "store/values.h"
+
+DEFINE_int64(
+    max_engines,
+    64,
+    "Largest number of engines to run in parallel."
+);
+
+DEFINE_int64(
+    threads_per_engine,
+    10,
+    "Number of threads run by each engine."
+);
+
+DEFINE_int64(
+    iterations,
+    200000,
+    "Number of iterations of the loop of each thread."
+);
+
+namespace store {
+
+const uint64 kStoreSize = 16 * 1024 * 1024;
+
+namespace {
+
+Operand Local(int index) {
+  return Operand(Register(Register::LOCAL, index));
+}
+
+Operand Immediate(int64 integer) {
+  return Operand(Value::Integer(integer));
+}
+
+// Builds a procedure decrementing a counter N times through a native called
+// by name. The result parameter of the native holds the expected result:
+// the native call checks it without allocating a variable.
+//   l3 := decrement
+//   l2 := [N N]
+//   l0 := N
+//   do:
+//     l0 := l0 - 1
+//     l2[1] := l0
+//     decrement(l2)
+//     l2[0] := l0
+//   while 0 < l0
+Closure* NewLoopProc(Store* store, int64 n) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::LOAD, Local(3), Operand(Atom::Get("decrement"))));
+  code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Local(2), Immediate(2), Immediate(n)));
+  code->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(n)));
+  const int64 loop = code->size();
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(0), Local(0),
+               Immediate(1)));
+  code->push_back(
+      Bytecode(Bytecode::ASSIGN_ARRAY, Local(2), Immediate(1), Local(0)));
+  code->push_back(Bytecode(Bytecode::CALL_NATIVE, Local(3), Local(2)));
+  code->push_back(
+      Bytecode(Bytecode::ASSIGN_ARRAY, Local(2), Immediate(0), Local(0)));
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(1), Immediate(0), Local(0)));
+  code->push_back(Bytecode(Bytecode::BRANCH_IF, Local(1), Immediate(loop)));
+  return Closure::New(store, code, 0, 4, 0);
+}
+
+// Runs an engine with its threads to completion, in its own store.
+void RunEngine() {
+  StaticStore store(kStoreSize);
+  Engine engine;
+  Closure* const loop = NewLoopProc(&store, FLAGS_iterations);
+  for (int64 i = 0; i < FLAGS_threads_per_engine; ++i)
+    New::Thread(&store, &engine, loop, Array::EmptyArray, &store);
+  engine.Run();
+}
+
+// Runs the given number of engines in parallel, and reports their throughput.
+void RunEngines(int64 nengines) {
+  const auto start = std::chrono::steady_clock::now();
+  vector<std::thread> workers;
+  for (int64 i = 0; i < nengines; ++i)
+    workers.emplace_back(RunEngine);
+  for (std::thread& worker : workers)
+    worker.join();
+  const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+  const double iterations =
+      static_cast<double>(nengines * FLAGS_threads_per_engine)
+      * FLAGS_iterations;
+  printf("%3ld engines: %8.3fs  %8.2f M iterations/s  "
+         "%8.2f M iterations/s per engine\n",
+         nengines, seconds, iterations / seconds / 1e6,
+         iterations / seconds / 1e6 / nengines);
+}
+
+}  // namespace
+
+}  // namespace store
+
+int main(int argc, char** argv) {
+  ::google::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  printf("%u hardware threads\n", std::thread::hardware_concurrency());
+  for (int64 nengines = 1; nengines <= FLAGS_max_engines; nengines *= 2)
+    store::RunEngines(nengines);
+  return EXIT_SUCCESS;
+}
@@ -1,6 +1,9 @@
 // Tests for values equality.
 #include "store/values.h"
 
+#include <vector>
+using std::vector;
+
 #include <gtest/gtest.h>
 
 #include "base/stl-util.h"
@@ -60,6 +63,75 @@ TEST_F(EqualityTest, Records) {
 }
 
 TEST_F(EqualityTest, Lists) {
+  const uint64 kSize = 1000;
+  vector<Value> values(kSize);
+  for (uint64 i = 0; i < kSize; ++i)
+    values[i] = Value::Integer(i);
+  Value list1 = New::List(&store_, kSize, values.data());
+  Value list2 = New::List(&store_, kSize, values.data());
+  EXPECT_TRUE(Equals(list1, list2));
+  values[kSize - 1] = Value::Integer(0);
+  EXPECT_FALSE(Equals(list1, New::List(&store_, kSize, values.data())));
+
+  // Cyclic lists have no structural hash, but can be compared.
+  List* cycle1 = ParseEval("1 | 2 | _", &store_).as<List>();
+  ASSERT_TRUE(Unify(cycle1->Next()->tail(), cycle1));
+  List* cycle2 = ParseEval("1 | 2 | 1 | 2 | _", &store_).as<List>();
+  ASSERT_TRUE(Unify(cycle2->Next()->Next()->Next()->tail(), cycle2));
+  uint32 hash;
+  EXPECT_FALSE(Value(cycle1).StructuralHash(&hash));
+  EXPECT_TRUE(Equals(cycle1, cycle2));
+}
+
+TEST_F(EqualityTest, SharedSubterms) {
+  // Two separate DAGs T(i+1) = '#'(T(i) T(i)), with 2^kDepth paths each:
+  // the compared pairs are tracked, hence each shared pair is compared once.
+  const int kDepth = 40;
+  Value dag1 = Value::Integer(0);
+  Value dag2 = Value::Integer(0);
+  for (int i = 0; i < kDepth; ++i) {
+    Value values1[2] = { dag1, dag1 };
+    Value values2[2] = { dag2, dag2 };
+    dag1 = Tuple::New(&store_, KAtomTuple(), 2, values1);
+    dag2 = Tuple::New(&store_, KAtomTuple(), 2, values2);
+  }
+  EXPECT_TRUE(Equals(dag1, dag2));
+
+  Value values[2] = { dag1, Value::Integer(1) };
+  Value unequal = Tuple::New(&store_, KAtomTuple(), 2, values);
+  values[1] = Value::Integer(2);
+  EXPECT_FALSE(Equals(unequal, Tuple::New(&store_, KAtomTuple(), 2, values)));
+}
+
+TEST_F(EqualityTest, StructuralHash) {
+  Value tuple1 = ParseEval("tuple(x [1 2] r(a:1.5 b:s))", &store_);
+  Value tuple2 = ParseEval("tuple(x [1 2] r(a:1.5 b:s))", &store_);
+  Value tuple3 = ParseEval("tuple(x [1 2] r(a:1.5 b:t))", &store_);
+  uint32 hash1, hash2, hash3;
+  ASSERT_TRUE(tuple1.StructuralHash(&hash1));
+  ASSERT_TRUE(tuple2.StructuralHash(&hash2));
+  ASSERT_TRUE(tuple3.StructuralHash(&hash3));
+  EXPECT_EQ(hash1, hash2);
+  EXPECT_NE(hash1, hash3);
+  EXPECT_TRUE(Equals(tuple1, tuple2));
+  EXPECT_FALSE(Equals(tuple1, tuple3));
+
+  // 0.0 and -0.0 are equal.
+  ASSERT_TRUE(New::Float(&store_, 0.0).StructuralHash(&hash1));
+  ASSERT_TRUE(New::Float(&store_, -0.0).StructuralHash(&hash2));
+  EXPECT_EQ(hash1, hash2);
+
+  // Free variables are not hashable, until they are bound.
+  Value tuple4 = ParseEval("tuple(x _)", &store_);
+  EXPECT_FALSE(tuple4.StructuralHash(&hash1));
+  ASSERT_TRUE(Unify(tuple4.TupleGet(1), Value::Integer(1)));
+  EXPECT_TRUE(tuple4.StructuralHash(&hash1));
+  EXPECT_TRUE(Equals(tuple4, ParseEval("tuple(x 1)", &store_)));
+
+  // Cyclic records are not hashable.
+  Record* record = ParseEval("r(a:_ b:1)", &store_).as<Record>();
+  ASSERT_TRUE(Unify(record->Get("a"), record));
+  EXPECT_FALSE(Value(record).StructuralHash(&hash1));
 }
 
 }  // namespace store
@@ -1,5 +1,7 @@
 #include "store/values.h"
 
+#include <cmath>
+
 #include <boost/format.hpp>
 using boost::format;
 
@@ -10,6 +12,23 @@ namespace store {
 
 const Value::ValueType Float::kType;
 
+// static
+Value Float::FromInteger(Store* store, Value integer) {
+  if (integer.IsSmallInt())
+    return New::Float(store, SmallInteger(integer).value());
+  if (integer.type() != Value::INTEGER) return Value();
+  return New::Float(store, integer.as<Integer>()->mpz().get_d());
+}
+
+// static
+Value Float::ToInteger(Store* store, Value value) {
+  double number;
+  if (!GetDouble(value, &number) || !std::isfinite(number)) return Value();
+  if (fabs(number) < static_cast<double>(kSmallIntMax))
+    return New::Integer(store, static_cast<int64>(number));
+  return New::Integer(store, mpz_class(number));  // truncates
+}
+
 // virtual
 bool Float::UnifyWith(UnificationContext* context, Value value) {
   CHECK_NOTNULL(context);
@@ -22,6 +41,12 @@ bool Float::Equals(EqualityContext* context, Value value) {
   return value_ == value.as<Float>()->value_;
 }
 
+// virtual
+bool Float::StructuralHash(uint32* hash) {
+  *hash = Hash(value_);
+  return true;
+}
+
 // virtual
 void Float::ToASCII(ToASCIIContext* context, string* repr) {
   CHECK_NOTNULL(repr);
@@ -32,7 +57,7 @@ void Float::ToASCII(ToASCIIContext* context, string* repr) {
 void Float::ToProtoBuf(oz_pb::Value* pb) {
   CHECK_NOTNULL(pb);
   pb->mutable_primitive()->set_type(oz_pb::Primitive::FLOAT);
-  LOG(FATAL) << "Not implemented";
+  pb->mutable_primitive()->set_real(value_);
 }
 
 // -----------------------------------------------------------------------------
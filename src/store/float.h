@@ -22,15 +22,60 @@ class Float : public HeapValue {
 
   // ---------------------------------------------------------------------------
   // Factory methods
+
+  // Always boxes the float: use New::Float() for a small float when possible.
   static inline Float* New(Store* store, double value) {
     return new(CHECK_NOTNULL(store->Alloc<Float>())) Float(value);
   }
 
+  // ---------------------------------------------------------------------------
+  // Float specific interface
+  double value() const { return value_; }
+
+  // @returns True if the value is a float, small or boxed.
+  //     In this case, sets the float value in result.
+  static inline bool GetDouble(Value value, double* result);
+
+  // @returns True if the value is a float, small or boxed.
+  static inline bool IsFloat(Value value) {
+    return value.IsSmallFloat() || (value.type() == kType);
+  }
+
+  // @returns The structural hash of a float, small or boxed.
+  //     Floats equal as numbers have the same hash: 0.0 and -0.0 included.
+  static inline uint32 Hash(double value);
+
+  // ---------------------------------------------------------------------------
+  // Arithmetic
+  //
+  // Operands must be dereferenced floats, small or boxed. Results are
+  // normalized, ie. boxed only when they cannot be small floats.
+  //
+  // These return an undefined Value() if an operand is not a float.
+
+  static inline Value Negate(Store* store, Value value);
+  static inline Value Add(Store* store, Value value1, Value value2);
+  static inline Value Subtract(Store* store, Value value1, Value value2);
+  static inline Value Multiply(Store* store, Value value1, Value value2);
+  static inline Value Divide(Store* store, Value value1, Value value2);
+
+  // Comparisons return a boolean.
+  static inline Value LessThan(Value value1, Value value2);
+  static inline Value LessOrEqual(Value value1, Value value2);
+
+  // Converts an integer, small or big, to a float.
+  static Value FromInteger(Store* store, Value integer);
+
+  // Converts a float to an integer, truncating toward zero.
+  // Infinities and NaN cannot be converted.
+  static Value ToInteger(Store* store, Value value);
+
   // ---------------------------------------------------------------------------
   // Value API
   virtual ValueType type() const throw() { return kType; }
   virtual bool UnifyWith(UnificationContext* context, Value value);
   virtual bool Equals(EqualityContext* context, Value value);
+  virtual bool StructuralHash(uint32* hash);
 
   // ---------------------------------------------------------------------------
   // Serialization
@@ -0,0 +1,94 @@
+#ifndef STORE_FLOAT_INL_H_
+#define STORE_FLOAT_INL_H_
+
+namespace store {
+
+// static
+inline
+bool Float::GetDouble(Value value, double* result) {
+  if (value.IsSmallFloat()) {
+    *result = SmallFloat(value).value();
+    return true;
+  }
+  if (value.type() != Value::FLOAT) return false;
+  *result = value.as<Float>()->value_;
+  return true;
+}
+
+// static
+inline
+uint32 Float::Hash(double value) {
+  if (value == 0.0) value = 0.0;
+  uint64 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return MixHash(Value::FLOAT, bits);
+}
+
+// -----------------------------------------------------------------------------
+// Arithmetic
+
+// static
+inline
+Value Float::Negate(Store* store, Value value) {
+  double number;
+  if (!GetDouble(value, &number)) return Value();
+  return New::Float(store, -number);
+}
+
+// static
+inline
+Value Float::Add(Store* store, Value value1, Value value2) {
+  double number1, number2;
+  if (!GetDouble(value1, &number1) || !GetDouble(value2, &number2))
+    return Value();
+  return New::Float(store, number1 + number2);
+}
+
+// static
+inline
+Value Float::Subtract(Store* store, Value value1, Value value2) {
+  double number1, number2;
+  if (!GetDouble(value1, &number1) || !GetDouble(value2, &number2))
+    return Value();
+  return New::Float(store, number1 - number2);
+}
+
+// static
+inline
+Value Float::Multiply(Store* store, Value value1, Value value2) {
+  double number1, number2;
+  if (!GetDouble(value1, &number1) || !GetDouble(value2, &number2))
+    return Value();
+  return New::Float(store, number1 * number2);
+}
+
+// static
+inline
+Value Float::Divide(Store* store, Value value1, Value value2) {
+  double number1, number2;
+  if (!GetDouble(value1, &number1) || !GetDouble(value2, &number2))
+    return Value();
+  return New::Float(store, number1 / number2);
+}
+
+// static
+inline
+Value Float::LessThan(Value value1, Value value2) {
+  double number1, number2;
+  if (!GetDouble(value1, &number1) || !GetDouble(value2, &number2))
+    return Value();
+  return Boolean::Get(number1 < number2);
+}
+
+// static
+inline
+Value Float::LessOrEqual(Value value1, Value value2) {
+  double number1, number2;
+  if (!GetDouble(value1, &number1) || !GetDouble(value2, &number2))
+    return Value();
+  return Boolean::Get(number1 <= number2);
+}
+
+}  // namespace store
+
+#endif  // STORE_FLOAT_INL_H_
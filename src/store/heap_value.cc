@@ -3,10 +3,31 @@
 #include <boost/format.hpp>
 using boost::format;
 
+#include "base/stl-util.h"
+
 namespace store {
 
 // -----------------------------------------------------------------------------
 
+namespace {
+
+// Compound values being hashed by the OS thread: see ValueHeader::StartVisit().
+thread_local UnorderedSet<const void*> visiting;
+
+}  // namespace
+
+// static
+bool ValueHeader::StartVisit(const void* value) {
+  return visiting.insert(value).second;
+}
+
+// static
+void ValueHeader::EndVisit(const void* value) {
+  visiting.erase(value);
+}
+
+// -----------------------------------------------------------------------------
+
 // virtual
 Arity* HeapValue::OpenRecordArity(Store* store) {
   return RecordArity();
@@ -28,7 +49,8 @@ Value HeapValue::OpenRecordGet(Value feature) {
 }
 
 // virtual
-Value HeapValue::OpenRecordClose(Store* store) {
+Value HeapValue::OpenRecordClose(Store* store,
+                                 SuspensionList* new_runnable) {
   return Value(this);
 }
 
@@ -59,6 +81,11 @@ Value HeapValue::RecordGet(Value feature) {
   throw NotImplemented();
 }
 
+// virtual
+LookupStatus HeapValue::TryRecordGet(Value feature, Value* value) {
+  throw NotImplemented();
+}
+
 // virtual
 Value::ItemIterator* HeapValue::RecordIterItems() {
   throw NotImplemented();
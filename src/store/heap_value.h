@@ -1,6 +1,7 @@
 #ifndef STORE_HEAP_VALUE_H_
 #define STORE_HEAP_VALUE_H_
 
+#include <atomic>
 #include <list>
 #include <memory>
 #include <string>
@@ -12,6 +13,46 @@ using std::string;
 
 namespace store {
 
+// -----------------------------------------------------------------------------
+// Header of compound values (records, tuples, lists), caching properties of
+// the value graph they root.
+//
+// The workers of an engine share values: the cached properties are set
+// atomically, and since they only depend on the value graph, concurrent
+// setters agree on them.
+class ValueHeader {
+ public:
+  ValueHeader() : bits_(0) {}
+
+  // Structural hash, valid only when has_hash(): the hash is set with its
+  // flag, in one atomic update.
+  bool has_hash() const { return bits() & kHashKnown; }
+  uint32 hash() const { return static_cast<uint32>(bits() >> 32); }
+  void set_hash(uint32 hash) {
+    Set(kHashKnown | (static_cast<uint64>(hash) << 32));
+  }
+
+  // Sticky property of the value graph: once proven, it holds forever.
+  bool stateless() const { return bits() & kStateless; }
+  void set_stateless() { Set(kStateless); }
+
+  // Marks a compound value as being hashed by the calling OS thread, to
+  // detect cycles. The marks are kept per OS thread, outside the headers:
+  // workers hashing a shared value do not see each other's marks.
+  // @returns False if the value is already being hashed.
+  static bool StartVisit(const void* value);
+  static void EndVisit(const void* value);
+
+ private:
+  static const uint64 kHashKnown = 1 << 0;
+  static const uint64 kStateless = 1 << 2;
+
+  uint64 bits() const { return bits_.load(std::memory_order_acquire); }
+  void Set(uint64 bits) { bits_.fetch_or(bits, std::memory_order_release); }
+
+  std::atomic<uint64> bits_;
+};
+
 // -----------------------------------------------------------------------------
 // Abstract base class for all values represented with objects in the heap.
 
@@ -35,6 +76,9 @@ class HeapValue {
   // @returns Whether this value is determined or not.
   virtual bool IsDetermined() { return true; }
 
+  // @returns The header of compound values, NULL for other values.
+  virtual ValueHeader* header() { return NULL; }
+
   // ---------------------------------------------------------------------------
   // Value graph exploration
 
@@ -106,6 +150,14 @@ class HeapValue {
     return false;
   }
 
+  // Computes the structural hash of this value.
+  // The default behavior hashes the physical entity, as Equals().
+  // @see Value::StructuralHash()
+  virtual bool StructuralHash(uint32* hash) {
+    *hash = MixHash(type(), reinterpret_cast<uint64>(this));
+    return true;
+  }
+
   // ---------------------------------------------------------------------------
   // Statelessness
 
@@ -151,7 +203,8 @@ class HeapValue {
   virtual uint64 OpenRecordWidth();
   virtual bool OpenRecordHas(Value feature);
   virtual Value OpenRecordGet(Value feature);
-  virtual Value OpenRecordClose(Store* store);
+  virtual Value OpenRecordClose(Store* store,
+                                SuspensionList* new_runnable);
 
   // ---------------------------------------------------------------------------
   // Record interface
@@ -160,6 +213,7 @@ class HeapValue {
   virtual uint64 RecordWidth();
   virtual bool RecordHas(Value feature);
   virtual Value RecordGet(Value feature);
+  virtual LookupStatus TryRecordGet(Value feature, Value* value);
 
   // @returns A new iterator on the record items, in order.
   // Caller must take ownership.
@@ -5,10 +5,134 @@ using boost::format;
 
 namespace store {
 
+namespace {
+
+// Converts an integer value, small or big, to a GMP integer.
+// @returns False if the value is not an integer.
+bool GetMpz(Value value, mpz_class* mpz) {
+  if (value.IsSmallInt()) {
+    *mpz = static_cast<long>(SmallInteger(value).value());
+    return true;
+  }
+  if (value.type() != Value::INTEGER) return false;
+  *mpz = value.as<Integer>()->mpz();
+  return true;
+}
+
+// Converts a non-negative integer value to a bit count or an exponent.
+// @returns False if the value is not a non-negative integer, or is too large.
+bool GetULong(Value value, unsigned long* ulong) {
+  if (value.IsSmallInt()) {
+    const int64 small = SmallInteger(value).value();
+    if (small < 0) return false;
+    *ulong = small;
+    return true;
+  }
+  if (value.type() != Value::INTEGER) return false;
+  const mpz_class& mpz = value.as<Integer>()->mpz();
+  if (!mpz.fits_ulong_p()) return false;
+  *ulong = mpz.get_ui();
+  return true;
+}
+
+}  // namespace
+
 // -----------------------------------------------------------------------------
 // Integer
 
 const Value::ValueType Integer::kType;
+const uint64 Integer::kMaxBits;
+
+// static
+Value Integer::Power(Store* store, Value base, Value exponent) {
+  if (base.IsSmallInt() && exponent.IsSmallInt()) {
+    int64 square = SmallInteger(base).value();
+    int64 exp = SmallInteger(exponent).value();
+    if (exp < 0) return Value();
+
+    // Exponentiation by squaring, until the result overflows.
+    int64 result = 1;
+    bool overflow = false;
+    while ((exp > 0) && !overflow) {
+      if (exp & 1)
+        overflow = __builtin_mul_overflow(result, square, &result);
+      exp >>= 1;
+      if (exp > 0)
+        overflow = overflow || __builtin_mul_overflow(square, square, &square);
+    }
+    if (!overflow) return New::Integer(store, result);
+  }
+
+  mpz_class mpz;
+  unsigned long exp;
+  if (!GetMpz(base, &mpz) || !GetULong(exponent, &exp)) return Value();
+  if (mpz_cmpabs_ui(mpz.get_mpz_t(), 1) <= 0) {
+    // 0, 1 and -1 keep their magnitude: only the parity of exp matters.
+    if (exp > 1) exp = 2 - (exp & 1);
+  } else if (exp > kMaxBits / mpz_sizeinbase(mpz.get_mpz_t(), 2)) {
+    return Value();  // The result has more than kMaxBits bits.
+  }
+  mpz_class result;
+  mpz_pow_ui(result.get_mpz_t(), mpz.get_mpz_t(), exp);
+  return New::Integer(store, result);
+}
+
+// static
+Value Integer::Compute(Store* store, Operation op,
+                       Value value1, Value value2) {
+  mpz_class mpz1;
+  if (!GetMpz(value1, &mpz1)) return Value();
+
+  mpz_class result;
+  switch (op) {
+    case NEGATE: {
+      result = -mpz1;
+      return New::Integer(store, result);
+    }
+    case SHIFT_LEFT:
+    case SHIFT_RIGHT: {
+      unsigned long nbits;
+      if (!GetULong(value2, &nbits)) return Value();
+      if (op == SHIFT_LEFT) {
+        if ((sgn(mpz1) != 0)
+            && ((nbits > kMaxBits)
+                || (mpz_sizeinbase(mpz1.get_mpz_t(), 2) > kMaxBits - nbits)))
+          return Value();  // The result has more than kMaxBits bits.
+        mpz_mul_2exp(result.get_mpz_t(), mpz1.get_mpz_t(), nbits);
+      } else {
+        mpz_fdiv_q_2exp(result.get_mpz_t(), mpz1.get_mpz_t(), nbits);
+      }
+      return New::Integer(store, result);
+    }
+    default:
+      break;
+  }
+
+  mpz_class mpz2;
+  if (!GetMpz(value2, &mpz2)) return Value();
+
+  switch (op) {
+    case ADD: result = mpz1 + mpz2; break;
+    case SUBTRACT: result = mpz1 - mpz2; break;
+    case MULTIPLY: result = mpz1 * mpz2; break;
+    case DIVIDE: {
+      if (sgn(mpz2) == 0) return Value();
+      mpz_tdiv_q(result.get_mpz_t(), mpz1.get_mpz_t(), mpz2.get_mpz_t());
+      break;
+    }
+    case MODULO: {
+      if (sgn(mpz2) == 0) return Value();
+      mpz_tdiv_r(result.get_mpz_t(), mpz1.get_mpz_t(), mpz2.get_mpz_t());
+      break;
+    }
+    case BIT_AND: result = mpz1 & mpz2; break;
+    case BIT_OR: result = mpz1 | mpz2; break;
+    case BIT_XOR: result = mpz1 ^ mpz2; break;
+    default:
+      LOG(FATAL) << "Unexpected integer operation: " << op;
+  }
+  return New::Integer(store, result);
+}
 
 // virtual
 bool Integer::UnifyWith(UnificationContext* context, Value ovalue) {
@@ -22,6 +146,27 @@ bool Integer::Equals(EqualityContext* context, Value value) {
   return value_ == value.as<Integer>()->value_;
 }
 
+// virtual
+bool Integer::LiteralLessThan(Value other) {
+  const Value::LiteralClass tclass = LiteralGetClass();
+  const Value::LiteralClass oclass = other.LiteralGetClass();
+  if (oclass != tclass) return (tclass < oclass);
+  // Small integers are integer literals too.
+  if (other.IsSmallInt()) return value_ < SmallInteger(other).value();
+  return value_ < other.as<Integer>()->value_;
+}
+
+// virtual
+bool Integer::StructuralHash(uint32* hash) {
+  const mpz_srcptr mpz = value_.get_mpz_t();
+  uint32 h = MixHash(kType, mpz_sgn(mpz));
+  const size_t nlimbs = mpz_size(mpz);
+  for (size_t i = 0; i < nlimbs; ++i)
+    h = MixHash(h, mpz_getlimbn(mpz, i));
+  *hash = h;
+  return true;
+}
+
 // virtual
 HeapValue* Integer::MoveInternal(Store* store) {
   return Integer::New(store, value_);
@@ -27,12 +27,53 @@ class Integer : public HeapValue {
   int64 value() const { return value_.get_si(); }
   const mpz_class& mpz() const { return value_; }
 
+  // ---------------------------------------------------------------------------
+  // Arithmetic
+  //
+  // Operands must be dereferenced integers, small or big.
+  // Small operands are handled inline, with overflow checks: only overflowing
+  // operations and big operands go through GMP. Results are normalized, ie.
+  // a result that fits in a small integer is never boxed.
+  //
+  // These return an undefined Value() if an operand is not an integer or if
+  // the operation is not defined for the operands (e.g. division by zero).
+
+  static inline Value Negate(Store* store, Value value);
+  static inline Value Add(Store* store, Value value1, Value value2);
+  static inline Value Subtract(Store* store, Value value1, Value value2);
+  static inline Value Multiply(Store* store, Value value1, Value value2);
+
+  // Division truncates toward zero.
+  static inline Value Divide(Store* store, Value value1, Value value2);
+
+  // The remainder of the truncated division: it has the sign of the dividend.
+  static inline Value Modulo(Store* store, Value value1, Value value2);
+
+  // Power() and ShiftLeft() grow their results exponentially with their
+  // operands: they return an undefined Value() rather than compute a result
+  // larger than kMaxBits bits, which would exhaust the memory or abort in GMP.
+  static const uint64 kMaxBits = 64 * 1024 * 1024;
+
+  // The exponent must be non-negative.
+  static Value Power(Store* store, Value base, Value exponent);
+
+  // Bitwise operations use the two's complement representation.
+  static inline Value BitAnd(Store* store, Value value1, Value value2);
+  static inline Value BitOr(Store* store, Value value1, Value value2);
+  static inline Value BitXor(Store* store, Value value1, Value value2);
+
+  // Shifts by a non-negative number of bits.
+  // Shifting right rounds toward negative infinity.
+  static inline Value ShiftLeft(Store* store, Value value, Value nbits);
+  static inline Value ShiftRight(Store* store, Value value, Value nbits);
+
   // ---------------------------------------------------------------------------
   // Value API
   virtual Value::ValueType type() const throw() { return kType; }
   virtual uint64 caps() const { return Value::CAP_LITERAL; }
   virtual bool UnifyWith(UnificationContext* context, Value value);
   virtual bool Equals(EqualityContext* context, Value value);
+  virtual bool StructuralHash(uint32* hash);
   virtual HeapValue* MoveInternal(Store* store);
 
   // ---------------------------------------------------------------------------
@@ -43,13 +84,7 @@ class Integer : public HeapValue {
     return (other.type() == Value::INTEGER)
         && (value_ == other.as<Integer>()->value_);
   }
-  virtual bool LiteralLessThan(Value other) {
-    const Value::LiteralClass tclass = LiteralGetClass();
-    const Value::LiteralClass oclass = other.LiteralGetClass();
-    return (oclass == LiteralGetClass())
-        ? (value_ < other.as<Integer>()->value_)
-        : (tclass < oclass);
-  }
+  virtual bool LiteralLessThan(Value other);
   virtual Value::LiteralClass LiteralGetClass() {
     return Value::LITERAL_CLASS_INTEGER;
   }
@@ -70,6 +105,22 @@ class Integer : public HeapValue {
   virtual ~Integer() {
   }
 
+  // Slow paths of the arithmetic operations, for big or overflowing operands.
+  enum Operation {
+    NEGATE,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    MODULO,
+    BIT_AND,
+    BIT_OR,
+    BIT_XOR,
+    SHIFT_LEFT,
+    SHIFT_RIGHT,
+  };
+  static Value Compute(Store* store, Operation op, Value value1, Value value2);
+
   // ---------------------------------------------------------------------------
   // Memory layout
   mpz_class value_;
@@ -17,6 +17,132 @@ Integer* Integer::New(Store* store, const mpz_class& value) {
   return new(CHECK_NOTNULL(store->Alloc<Integer>())) Integer(value);
 }
 
+// -----------------------------------------------------------------------------
+// Arithmetic fast paths, for small integers
+
+// static
+inline
+Value Integer::Negate(Store* store, Value value) {
+  if (value.IsSmallInt())
+    return New::Integer(store, -SmallInteger(value).value());
+  return Compute(store, NEGATE, value, Value());
+}
+
+// static
+inline
+Value Integer::Add(Store* store, Value value1, Value value2) {
+  int64 result;
+  if (value1.IsSmallInt() && value2.IsSmallInt()
+      && !__builtin_add_overflow(SmallInteger(value1).value(),
+                                 SmallInteger(value2).value(),
+                                 &result))
+    return New::Integer(store, result);
+  return Compute(store, ADD, value1, value2);
+}
+
+// static
+inline
+Value Integer::Subtract(Store* store, Value value1, Value value2) {
+  int64 result;
+  if (value1.IsSmallInt() && value2.IsSmallInt()
+      && !__builtin_sub_overflow(SmallInteger(value1).value(),
+                                 SmallInteger(value2).value(),
+                                 &result))
+    return New::Integer(store, result);
+  return Compute(store, SUBTRACT, value1, value2);
+}
+
+// static
+inline
+Value Integer::Multiply(Store* store, Value value1, Value value2) {
+  int64 result;
+  if (value1.IsSmallInt() && value2.IsSmallInt()
+      && !__builtin_mul_overflow(SmallInteger(value1).value(),
+                                 SmallInteger(value2).value(),
+                                 &result))
+    return New::Integer(store, result);
+  return Compute(store, MULTIPLY, value1, value2);
+}
+
+// static
+inline
+Value Integer::Divide(Store* store, Value value1, Value value2) {
+  if (value1.IsSmallInt() && value2.IsSmallInt()) {
+    const int64 divisor = SmallInteger(value2).value();
+    if (divisor == 0) return Value();
+    return New::Integer(store, SmallInteger(value1).value() / divisor);
+  }
+  return Compute(store, DIVIDE, value1, value2);
+}
+
+// static
+inline
+Value Integer::Modulo(Store* store, Value value1, Value value2) {
+  if (value1.IsSmallInt() && value2.IsSmallInt()) {
+    const int64 divisor = SmallInteger(value2).value();
+    if (divisor == 0) return Value();
+    return New::Integer(store, SmallInteger(value1).value() % divisor);
+  }
+  return Compute(store, MODULO, value1, value2);
+}
+
+// static
+inline
+Value Integer::BitAnd(Store* store, Value value1, Value value2) {
+  if (value1.IsSmallInt() && value2.IsSmallInt())
+    return New::Integer(
+        store, SmallInteger(value1).value() & SmallInteger(value2).value());
+  return Compute(store, BIT_AND, value1, value2);
+}
+
+// static
+inline
+Value Integer::BitOr(Store* store, Value value1, Value value2) {
+  if (value1.IsSmallInt() && value2.IsSmallInt())
+    return New::Integer(
+        store, SmallInteger(value1).value() | SmallInteger(value2).value());
+  return Compute(store, BIT_OR, value1, value2);
+}
+
+// static
+inline
+Value Integer::BitXor(Store* store, Value value1, Value value2) {
+  if (value1.IsSmallInt() && value2.IsSmallInt())
+    return New::Integer(
+        store, SmallInteger(value1).value() ^ SmallInteger(value2).value());
+  return Compute(store, BIT_XOR, value1, value2);
+}
+
+// static
+inline
+Value Integer::ShiftLeft(Store* store, Value value, Value nbits) {
+  int64 result;
+  if (value.IsSmallInt() && nbits.IsSmallInt()) {
+    const int64 shift = SmallInteger(nbits).value();
+    if (shift < 0) return Value();
+    if ((shift < 63)
+        && !__builtin_mul_overflow(SmallInteger(value).value(),
+                                   static_cast<int64>(1) << shift,
+                                   &result))
+      return New::Integer(store, result);
+  }
+  return Compute(store, SHIFT_LEFT, value, nbits);
+}
+
+// static
+inline
+Value Integer::ShiftRight(Store* store, Value value, Value nbits) {
+  if (value.IsSmallInt() && nbits.IsSmallInt()) {
+    const int64 shift = SmallInteger(nbits).value();
+    if (shift < 0) return Value();
+    // Right shifts of signed integers are arithmetic with gcc.
+    const int64 result =
+        SmallInteger(value).value() >> ((shift < 63) ? shift : 63);
+    return New::Integer(store, result);
+  }
+  return Compute(store, SHIFT_RIGHT, value, nbits);
+}
+
 }  // namespace store
 
 #endif  // STORE_INTEGER_INL_H_
@@ -40,4 +40,145 @@ TEST_F(BigIntegerTest, String_2) {
   EXPECT_EQ("~123456789012345678901234567890", i.ToString());
 }
 
+TEST_F(BigIntegerTest, SmallArithmetic) {
+  Value i7 = Value::Integer(7);
+  Value i2 = Value::Integer(2);
+  EXPECT_EQ(Value::Integer(9), Integer::Add(&store_, i7, i2));
+  EXPECT_EQ(Value::Integer(5), Integer::Subtract(&store_, i7, i2));
+  EXPECT_EQ(Value::Integer(14), Integer::Multiply(&store_, i7, i2));
+  EXPECT_EQ(Value::Integer(-7), Integer::Negate(&store_, i7));
+  EXPECT_EQ(Value::Integer(49), Integer::Power(&store_, i7, i2));
+  EXPECT_EQ(Value::Integer(2), Integer::BitAnd(&store_, i7, i2));
+  EXPECT_EQ(Value::Integer(7), Integer::BitOr(&store_, i7, i2));
+  EXPECT_EQ(Value::Integer(5), Integer::BitXor(&store_, i7, i2));
+  EXPECT_EQ(Value::Integer(28), Integer::ShiftLeft(&store_, i7, i2));
+  EXPECT_EQ(Value::Integer(1), Integer::ShiftRight(&store_, i7, i2));
+  EXPECT_EQ(Value::Integer(-2),
+            Integer::ShiftRight(&store_, Value::Integer(-7), i2));
+}
+
+TEST_F(BigIntegerTest, Division) {
+  Value i7 = Value::Integer(7);
+  Value in7 = Value::Integer(-7);
+  Value i2 = Value::Integer(2);
+  Value in2 = Value::Integer(-2);
+
+  // Truncated division: the remainder has the sign of the dividend.
+  EXPECT_EQ(Value::Integer(3), Integer::Divide(&store_, i7, i2));
+  EXPECT_EQ(Value::Integer(-3), Integer::Divide(&store_, in7, i2));
+  EXPECT_EQ(Value::Integer(1), Integer::Modulo(&store_, i7, in2));
+  EXPECT_EQ(Value::Integer(-1), Integer::Modulo(&store_, in7, i2));
+
+  Value big = New::Integer(&store_, mpz_class("-100000000000000000000001"));
+  EXPECT_EQ("~50000000000000000000000",
+            Integer::Divide(&store_, big, i2).ToString());
+  EXPECT_EQ(Value::Integer(-1), Integer::Modulo(&store_, big, i2));
+
+  EXPECT_FALSE(Integer::Divide(&store_, i7, Value::Integer(0)).IsDefined());
+  EXPECT_FALSE(Integer::Modulo(&store_, big, Value::Integer(0)).IsDefined());
+}
+
+TEST_F(BigIntegerTest, Overflow) {
+  Value max = Value::Integer(kSmallIntMax - 1);
+  Value sum = Integer::Add(&store_, max, Value::Integer(1));
+  EXPECT_TRUE(sum.IsA<Integer>());
+  EXPECT_TRUE(sum.as<Integer>()->mpz() == mpz_class(kSmallIntMax));
+
+  // Overflowing int64, not only small integers:
+  Value product = Integer::Multiply(&store_, max, max);
+  EXPECT_TRUE(product.IsA<Integer>());
+  EXPECT_TRUE(product.as<Integer>()->mpz()
+              == mpz_class(kSmallIntMax - 1) * mpz_class(kSmallIntMax - 1));
+
+  Value shifted = Integer::ShiftLeft(&store_, Value::Integer(3),
+                                     Value::Integer(100));
+  EXPECT_EQ("3802951800684688204490109616128", shifted.ToString());
+  EXPECT_EQ(Value::Integer(3),
+            Integer::ShiftRight(&store_, shifted, Value::Integer(100)));
+
+  Value power = Integer::Power(&store_, Value::Integer(2), Value::Integer(64));
+  EXPECT_EQ("18446744073709551616", power.ToString());
+}
+
+TEST_F(BigIntegerTest, Normalization) {
+  Value big = New::Integer(&store_, mpz_class("100000000000000000000"));
+  ASSERT_TRUE(big.IsA<Integer>());
+
+  // Results that fit in a small integer are never boxed:
+  Value diff = Integer::Subtract(&store_, big, big);
+  EXPECT_TRUE(diff.IsSmallInt());
+  EXPECT_EQ(Value::Integer(0), diff);
+  EXPECT_EQ(Value::Integer(1), Integer::Divide(&store_, big, big));
+  EXPECT_EQ(Value::Integer(0),
+            Integer::BitAnd(&store_, big, Value::Integer(1)));
+
+  EXPECT_TRUE(Value::Integer(&store_, mpz_class(42)).IsSmallInt());
+  EXPECT_TRUE(
+      Value::Integer(&store_, mpz_class(kSmallIntMax)).IsA<Integer>());
+}
+
+TEST_F(BigIntegerTest, LiteralOrder) {
+  const Value big = New::Integer(&store_, mpz_class("100000000000000000000"));
+  const Value negative =
+      New::Integer(&store_, mpz_class("-100000000000000000000"));
+  const Value one = Value::Integer(1);
+  EXPECT_TRUE(Literal::LessThan(one, big));
+  EXPECT_FALSE(Literal::LessThan(big, one));
+  EXPECT_TRUE(Literal::LessThan(negative, one));
+  EXPECT_FALSE(Literal::LessThan(one, negative));
+  EXPECT_TRUE(Literal::LessThan(negative, big));
+  EXPECT_TRUE(Literal::LessThan(big, Atom::Get("a")));
+}
+
+TEST_F(BigIntegerTest, InvalidOperands) {
+  Value i1 = Value::Integer(1);
+  EXPECT_FALSE(Integer::Add(&store_, i1, KAtomNil()).IsDefined());
+  EXPECT_FALSE(Integer::Negate(&store_, KAtomNil()).IsDefined());
+  EXPECT_FALSE(Integer::Power(&store_, i1, Value::Integer(-1)).IsDefined());
+  EXPECT_FALSE(
+      Integer::ShiftLeft(&store_, i1, Value::Integer(-1)).IsDefined());
+}
+
+TEST_F(BigIntegerTest, ResultsTooLarge) {
+  const Value i2 = Value::Integer(2);
+  const Value big_exp = Value::Integer(10000000000LL);
+  const Value big_shift = Value::Integer(1LL << 40);
+
+  // 2 ** 10000000000 and 1 << (1 << 40) are invalid, not computed.
+  EXPECT_FALSE(Integer::Power(&store_, i2, big_exp).IsDefined());
+  EXPECT_FALSE(Integer::ShiftLeft(&store_, Value::Integer(1), big_shift)
+               .IsDefined());
+  const Value big = New::Integer(&store_, mpz_class("100000000000000000000"));
+  EXPECT_FALSE(Integer::Power(&store_, big, Value::Integer(1 << 26))
+               .IsDefined());
+  EXPECT_FALSE(Integer::ShiftLeft(&store_, big,
+                                  Value::Integer(Integer::kMaxBits))
+               .IsDefined());
+
+  // Up to kMaxBits bits:
+  const Value shifted = Integer::ShiftLeft(
+      &store_, Value::Integer(1), Value::Integer(Integer::kMaxBits - 1));
+  ASSERT_TRUE(shifted.IsA<Integer>());
+  EXPECT_EQ(Integer::kMaxBits,
+            mpz_sizeinbase(shifted.as<Integer>()->mpz().get_mpz_t(), 2));
+
+  // The magnitude of 0, 1 and -1 does not grow:
+  EXPECT_EQ(Value::Integer(0), Integer::Power(&store_, Value::Integer(0),
+                                              big_exp));
+  EXPECT_EQ(Value::Integer(1), Integer::Power(&store_, Value::Integer(1),
+                                              big_exp));
+  EXPECT_EQ(Value::Integer(1), Integer::Power(&store_, Value::Integer(-1),
+                                              big_exp));
+  EXPECT_EQ(Value::Integer(-1),
+            Integer::Power(&store_, Value::Integer(-1),
+                           Value::Integer(10000000001LL)));
+  EXPECT_EQ(Value::Integer(0),
+            Integer::ShiftLeft(&store_, Value::Integer(0), big_shift));
+
+  // Right shifts do not grow their operand.
+  EXPECT_EQ(Value::Integer(-1),
+            Integer::ShiftRight(&store_, New::Integer(&store_, -mpz_class(
+                "100000000000000000000")), big_shift));
+}
+
 }  // namespace store
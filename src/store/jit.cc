@@ -0,0 +1,617 @@
+#include "store/values.h"
+
+#include <cstddef>
+#include <cstring>
+
+#if STORE_JIT
+#include <sys/mman.h>
+#endif
+
+namespace store {
+
+#if STORE_JIT
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// x86-64 code generation
+
+// Registers, by encoding.
+enum X64Register {
+  RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+  R8 = 8, R9 = 9, R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15,
+};
+
+// Registers holding the frame, loaded by the entry point of the native code.
+// They are callee-saved: calls into the runtime preserve them.
+const X64Register kFrameRegister = RBX;
+const X64Register kLocalsRegister = R12;
+const X64Register kParamsRegister = R13;
+const X64Register kConstantsRegister = R14;
+
+// Condition codes of the conditional jumps.
+enum Condition {
+  CC_OVERFLOW = 0x0,
+  CC_EQUAL = 0x4,
+  CC_NOT_EQUAL = 0x5,
+  CC_LESS = 0xC,
+  CC_LESS_EQUAL = 0xE,
+};
+
+// Encodes the instructions used by the templates, and only them.
+class Assembler {
+ public:
+  uint64 offset() const { return code_.size(); }
+  const vector<uint8>& code() const { return code_; }
+
+  // mov dst, [base + disp]
+  void Load(X64Register dst, X64Register base, int32 disp) {
+    Rex(dst, base);
+    Emit8(0x8B);
+    Memory(dst, base, disp);
+  }
+
+  // mov [base + disp], src
+  void Store(X64Register base, int32 disp, X64Register src) {
+    Rex(src, base);
+    Emit8(0x89);
+    Memory(src, base, disp);
+  }
+
+  // mov dst, imm64
+  void MovImm64(X64Register dst, uint64 imm) {
+    Rex(RAX, dst);
+    Emit8(0xB8 + (dst & 7));
+    Emit64(imm);
+  }
+
+  // mov dst32, imm32: zero-extends to 64 bits.
+  void MovImm32(X64Register dst, uint32 imm) {
+    if (dst >= R8) Emit8(0x41);
+    Emit8(0xB8 + (dst & 7));
+    Emit32(imm);
+  }
+
+  void Mov(X64Register dst, X64Register src) { RegReg(0x89, src, dst); }
+  void Add(X64Register dst, X64Register src) { RegReg(0x01, src, dst); }
+  void Sub(X64Register dst, X64Register src) { RegReg(0x29, src, dst); }
+  void Cmp(X64Register dst, X64Register src) { RegReg(0x39, src, dst); }
+  void Test(X64Register dst, X64Register src) { RegReg(0x85, src, dst); }
+
+  void AndImm8(X64Register dst, int8 imm) { AluImm8(4, dst, imm); }
+  void OrImm8(X64Register dst, int8 imm) { AluImm8(1, dst, imm); }
+  void SubImm8(X64Register dst, int8 imm) { AluImm8(5, dst, imm); }
+  void CmpImm8(X64Register dst, int8 imm) { AluImm8(7, dst, imm); }
+
+  // cmovl dst, src
+  void CmovLess(X64Register dst, X64Register src) {
+    Rex(dst, src);
+    Emit8(0x0F);
+    Emit8(0x4C);
+    Emit8(0xC0 | ((dst & 7) << 3) | (src & 7));
+  }
+
+  // sub qword [base + disp], imm32
+  void SubMemImm32(X64Register base, int32 disp, int32 imm) {
+    Rex(RAX, base);
+    Emit8(0x81);
+    Memory(5, base, disp);
+    Emit32(imm);
+  }
+
+  void Push(X64Register reg) {
+    if (reg >= R8) Emit8(0x41);
+    Emit8(0x50 + (reg & 7));
+  }
+
+  void Pop(X64Register reg) {
+    if (reg >= R8) Emit8(0x41);
+    Emit8(0x58 + (reg & 7));
+  }
+
+  // call reg
+  void Call(X64Register reg) {
+    if (reg >= R8) Emit8(0x41);
+    Emit8(0xFF);
+    Emit8(0xD0 | (reg & 7));
+  }
+
+  // jmp reg
+  void JmpRegister(X64Register reg) {
+    if (reg >= R8) Emit8(0x41);
+    Emit8(0xFF);
+    Emit8(0xE0 | (reg & 7));
+  }
+
+  void Ret() { Emit8(0xC3); }
+
+  // Jumps with a 32 bits displacement, set later with Patch().
+  // @returns The offset of the displacement.
+  uint64 Jmp() {
+    Emit8(0xE9);
+    return EmitDisplacement();
+  }
+
+  uint64 Jcc(Condition condition) {
+    Emit8(0x0F);
+    Emit8(0x80 | condition);
+    return EmitDisplacement();
+  }
+
+  // Sets the displacement of a jump to reach the given offset.
+  void Patch(uint64 displacement_offset, uint64 target) {
+    const int32 displacement = target - (displacement_offset + 4);
+    memcpy(&code_[displacement_offset], &displacement, 4);
+  }
+
+ private:
+  void Emit8(uint8 byte) { code_.push_back(byte); }
+
+  void Emit32(uint32 value) {
+    for (int i = 0; i < 4; ++i) Emit8(value >> (8 * i));
+  }
+
+  void Emit64(uint64 value) {
+    for (int i = 0; i < 8; ++i) Emit8(value >> (8 * i));
+  }
+
+  uint64 EmitDisplacement() {
+    const uint64 displacement_offset = offset();
+    Emit32(0);
+    return displacement_offset;
+  }
+
+  // REX prefix of a 64 bits operation.
+  void Rex(int reg, int rm) {
+    Emit8(0x48 | ((reg >> 3) << 2) | (rm >> 3));
+  }
+
+  // <opcode> rm, reg
+  void RegReg(uint8 opcode, int reg, int rm) {
+    Rex(reg, rm);
+    Emit8(opcode);
+    Emit8(0xC0 | ((reg & 7) << 3) | (rm & 7));
+  }
+
+  // <operation> dst, imm8, with the operation in the ModRM byte.
+  void AluImm8(int operation, X64Register dst, int8 imm) {
+    Rex(RAX, dst);
+    Emit8(0x83);
+    Emit8(0xC0 | (operation << 3) | (dst & 7));
+    Emit8(imm);
+  }
+
+  // ModRM addressing [base + disp32].
+  void Memory(int reg, int base, int32 disp) {
+    Emit8(0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP) Emit8(0x24);  // SIB byte, without index
+    Emit32(disp);
+  }
+
+  vector<uint8> code_;
+};
+
+// -----------------------------------------------------------------------------
+// Slow paths, called from the native code.
+// Values are passed and returned as their bits.
+
+// @returns 1 if the unification succeeds, 0 otherwise.
+uint64 JitUnify(JitFrame* frame, uint64 value1, uint64 value2) {
+  return Unify(Value(value1), Value(value2), frame->new_runnable);
+}
+
+uint64 JitNewVariable(JitFrame* frame) {
+  return New::Free(frame->store).bits();
+}
+
+// Accesses a feature of a Record through the inline cache of the instruction.
+// @returns The value of the feature, or 0 on a cache miss and on any other
+//     record type: the interpreter then fills the cache.
+uint64 JitAccessRecord(RecordAccessCache* cache, uint64 record_bits,
+                       uint64 feature_bits) {
+  const Value record = Value(record_bits).Deref();
+  if (!record.IsHeapValue()
+      || (record.heap_value()->type() != Value::RECORD))
+    return 0;
+  Record* const as_record = static_cast<Record*>(record.heap_value());
+  const int64 slot =
+      cache->Lookup(as_record->arity(), Value(feature_bits).Deref());
+  if (slot < 0) return 0;
+  return as_record->values()[slot].bits();
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// JitCompiler
+//
+// Layout of the native code:
+//  - the entry point, JitCode::run_, then the exit sequence;
+//  - the templates of the instructions, in order, ending with an exit past
+//    the end of the code;
+//  - the exits of the slow paths, one per instruction.
+// An instruction without template is compiled into an exit.
+class JitCompiler {
+ public:
+  JitCompiler(PackedCode* code, JitCode* jit)
+      : code_(code),
+        jit_(jit),
+        labels_(code->size() + 1, 0),
+        compiled_(code->size(), false) {
+  }
+
+  void Compile();
+
+ private:
+  // A jump whose displacement is set once its target is emitted.
+  struct Patch {
+    uint64 displacement_offset;
+    uint64 code_pointer;  // The target instruction, or exit
+  };
+
+  void EmitEntry();
+
+  // @returns False if the instruction has no template. Nothing is emitted.
+  bool EmitInstruction(uint64 code_pointer, const PackedBytecode& inst);
+
+  // Operands of the templates: local registers, parameters and constants.
+  // Destinations are local registers and parameters only.
+  bool IsSource(PackedOperand op);
+  bool IsDestination(PackedOperand op);
+  void LoadOperand(X64Register dst, PackedOperand op);
+  void StoreOperand(PackedOperand op, X64Register src);
+
+  // @returns True if the operand is a constant small integer code pointer.
+  bool IsCodePointer(PackedOperand op);
+  uint64 CodePointer(PackedOperand op);
+
+  // Exits to the interpreter at an instruction, on a condition.
+  void ExitIf(Condition condition, uint64 code_pointer);
+  void ExitUnlessSmallInt(X64Register reg, uint64 code_pointer);
+  void ExitIfEqual(X64Register reg, uint64 bits, uint64 code_pointer);
+
+  // Jumps from an instruction to another. Backward branches charge the step
+  // budget, and exit when it is exhausted.
+  void Branch(uint64 code_pointer, uint64 target);
+
+  void CallRuntime(const void* function);
+
+  PackedCode* const code_;
+  JitCode* const jit_;
+  Assembler assembler_;
+
+  // Offset of the template of each instruction. The last label is the exit
+  // past the end of the code.
+  vector<uint64> labels_;
+  vector<bool> compiled_;
+
+  // Offset of the exit sequence.
+  uint64 exit_;
+
+  vector<Patch> branches_;
+  vector<Patch> exits_;
+};
+
+void JitCompiler::Compile() {
+  EmitEntry();
+
+  const PackedBytecode* const code = code_->code();
+  for (uint64 cp = 0; cp < code_->size(); ++cp) {
+    labels_[cp] = assembler_.offset();
+    compiled_[cp] = EmitInstruction(cp, code[cp]);
+    if (!compiled_[cp]) {
+      assembler_.MovImm32(RAX, cp);
+      assembler_.Patch(assembler_.Jmp(), exit_);
+    }
+  }
+  labels_[code_->size()] = assembler_.offset();
+  assembler_.MovImm32(RAX, code_->size());
+  assembler_.Patch(assembler_.Jmp(), exit_);
+
+  for (const Patch& branch : branches_)
+    assembler_.Patch(branch.displacement_offset, labels_[branch.code_pointer]);
+
+  // One exit per instruction, shared by its slow paths.
+  UnorderedMap<uint64, uint64> exit_offsets;
+  for (const Patch& exit : exits_) {
+    auto it = exit_offsets.find(exit.code_pointer);
+    if (it == exit_offsets.end()) {
+      it = exit_offsets.insert(
+          std::make_pair(exit.code_pointer, assembler_.offset())).first;
+      assembler_.MovImm32(RAX, exit.code_pointer);
+      assembler_.Patch(assembler_.Jmp(), exit_);
+    }
+    assembler_.Patch(exit.displacement_offset, it->second);
+  }
+
+  // Maps the native code into executable memory.
+  const vector<uint8>& native = assembler_.code();
+  void* const memory = mmap(NULL, native.size(), PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  PCHECK(memory != MAP_FAILED) << "Error mapping the native code";
+  memcpy(memory, native.data(), native.size());
+  PCHECK(mprotect(memory, native.size(), PROT_READ | PROT_EXEC) == 0)
+      << "Error protecting the native code";
+
+  uint8* const base = static_cast<uint8*>(memory);
+  jit_->memory_ = memory;
+  jit_->size_ = native.size();
+  jit_->run_ = reinterpret_cast<JitCode::RunFunction>(base);
+  jit_->entries_.resize(code_->size(), NULL);
+  for (uint64 cp = 0; cp < code_->size(); ++cp)
+    if (compiled_[cp]) jit_->entries_[cp] = base + labels_[cp];
+}
+
+void JitCompiler::EmitEntry() {
+  // uint64 run(JitFrame* frame, const void* entry)
+  // Five pushes keep the stack aligned on 16 bytes for the runtime calls.
+  assembler_.Push(RBX);
+  assembler_.Push(R12);
+  assembler_.Push(R13);
+  assembler_.Push(R14);
+  assembler_.Push(R15);
+  assembler_.Mov(kFrameRegister, RDI);
+  assembler_.Load(kLocalsRegister, kFrameRegister,
+                  offsetof(JitFrame, locals));
+  assembler_.Load(kParamsRegister, kFrameRegister,
+                  offsetof(JitFrame, parameters));
+  assembler_.Load(kConstantsRegister, kFrameRegister,
+                  offsetof(JitFrame, constants));
+  assembler_.JmpRegister(RSI);
+
+  // Exit, with the code pointer to resume at in RAX.
+  exit_ = assembler_.offset();
+  assembler_.Pop(R15);
+  assembler_.Pop(R14);
+  assembler_.Pop(R13);
+  assembler_.Pop(R12);
+  assembler_.Pop(RBX);
+  assembler_.Ret();
+}
+
+bool JitCompiler::EmitInstruction(uint64 cp, const PackedBytecode& inst) {
+  // Encoded bounds of the small integers.
+  const uint64 kSmallIntMaxBits =
+      (static_cast<uint64>(kSmallIntMax) << kTagBits) | kSmallIntTag;
+  const uint64 kSmallIntMinBits =
+      (static_cast<uint64>(kSmallIntMin) << kTagBits) | kSmallIntTag;
+  // KAtomTrue() and KAtomFalse() look the atoms up by name.
+  static const uint64 kTrue = Value(KAtomTrue()).bits();
+  static const uint64 kFalse = Value(KAtomFalse()).bits();
+
+  const uint8 opcode = PackedCode::GenericOpcode(inst.opcode);
+  switch (opcode) {
+    case Bytecode::LOAD: {
+      if (!IsDestination(inst.operand1) || !IsSource(inst.operand2))
+        return false;
+      LoadOperand(RAX, inst.operand2);
+      StoreOperand(inst.operand1, RAX);
+      return true;
+    }
+
+    case Bytecode::NUMBER_INT_ADD:
+    case Bytecode::NUMBER_INT_SUBTRACT:
+    case Bytecode::TEST_LESS_THAN: {
+      if (!IsDestination(inst.operand1) || !IsSource(inst.operand2)
+          || !IsSource(inst.operand3))
+        return false;
+      LoadOperand(RAX, inst.operand2);
+      LoadOperand(RDX, inst.operand3);
+      ExitUnlessSmallInt(RAX, cp);
+      ExitUnlessSmallInt(RDX, cp);
+      // Small integers are tagged as (value << 3) | 1: the tagged operations
+      // overflow when the result is not encodable. The bounds of the
+      // encoding are not small integers either: see SmallInteger.
+      if (opcode == Bytecode::NUMBER_INT_ADD) {
+        assembler_.SubImm8(RAX, kSmallIntTag);
+        assembler_.Add(RAX, RDX);
+        ExitIf(CC_OVERFLOW, cp);
+        ExitIfEqual(RAX, kSmallIntMaxBits, cp);
+        ExitIfEqual(RAX, kSmallIntMinBits, cp);
+      } else if (opcode == Bytecode::NUMBER_INT_SUBTRACT) {
+        assembler_.Sub(RAX, RDX);
+        ExitIf(CC_OVERFLOW, cp);
+        assembler_.OrImm8(RAX, kSmallIntTag);
+        ExitIfEqual(RAX, kSmallIntMaxBits, cp);
+        ExitIfEqual(RAX, kSmallIntMinBits, cp);
+      } else {
+        assembler_.Cmp(RAX, RDX);
+        assembler_.MovImm64(RAX, kFalse);
+        assembler_.MovImm64(RCX, kTrue);
+        assembler_.CmovLess(RAX, RCX);
+      }
+      StoreOperand(inst.operand1, RAX);
+      return true;
+    }
+
+    case Bytecode::BRANCH: {
+      if (!IsCodePointer(inst.operand1)) return false;
+      Branch(cp, CodePointer(inst.operand1));
+      return true;
+    }
+
+    case Bytecode::BRANCH_IF:
+    case Bytecode::BRANCH_UNLESS: {
+      if (!IsSource(inst.operand1) || !IsCodePointer(inst.operand2))
+        return false;
+      const bool taken_on = (opcode == Bytecode::BRANCH_IF);
+      LoadOperand(RAX, inst.operand1);
+      assembler_.MovImm64(RCX, taken_on ? kTrue : kFalse);
+      assembler_.Cmp(RAX, RCX);
+      const uint64 not_taken = assembler_.Jcc(CC_NOT_EQUAL);
+      Branch(cp, CodePointer(inst.operand2));
+      assembler_.Patch(not_taken, assembler_.offset());
+      // Conditions other than booleans go through the interpreter.
+      assembler_.MovImm64(RCX, taken_on ? kFalse : kTrue);
+      assembler_.Cmp(RAX, RCX);
+      ExitIf(CC_NOT_EQUAL, cp);
+      return true;
+    }
+
+    case Bytecode::UNIFY: {
+      if (!IsSource(inst.operand1) || !IsSource(inst.operand2)) return false;
+      assembler_.Mov(RDI, kFrameRegister);
+      LoadOperand(RSI, inst.operand1);
+      LoadOperand(RDX, inst.operand2);
+      CallRuntime(reinterpret_cast<const void*>(&JitUnify));
+      // The interpreter reports the failure.
+      assembler_.Test(RAX, RAX);
+      ExitIf(CC_EQUAL, cp);
+      return true;
+    }
+
+    case Bytecode::NEW_VARIABLE: {
+      if (!IsDestination(inst.operand1)) return false;
+      assembler_.Mov(RDI, kFrameRegister);
+      CallRuntime(reinterpret_cast<const void*>(&JitNewVariable));
+      StoreOperand(inst.operand1, RAX);
+      return true;
+    }
+
+    case Bytecode::ACCESS_RECORD: {
+      if (!IsDestination(inst.operand1) || !IsSource(inst.operand2)
+          || !IsSource(inst.operand3))
+        return false;
+      assembler_.MovImm64(
+          RDI, reinterpret_cast<uint64>(code_->record_cache(cp)));
+      LoadOperand(RSI, inst.operand2);
+      LoadOperand(RDX, inst.operand3);
+      CallRuntime(reinterpret_cast<const void*>(&JitAccessRecord));
+      assembler_.Test(RAX, RAX);
+      ExitIf(CC_EQUAL, cp);
+      StoreOperand(inst.operand1, RAX);
+      return true;
+    }
+
+    // Try blocks are in the exception table: see PackedCode.
+    case Bytecode::EXN_PUSH_CATCH:
+    case Bytecode::EXN_PUSH_FINALLY:
+      return true;
+
+    case Bytecode::EXN_POP: {
+      if (inst.operand1.is_constant()) {
+        if (!IsCodePointer(inst.operand1)) return false;
+        Branch(cp, CodePointer(inst.operand1));
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+bool JitCompiler::IsSource(PackedOperand op) {
+  return op.is_constant() || IsDestination(op);
+}
+
+bool JitCompiler::IsDestination(PackedOperand op) {
+  if (op.kind() == Register::LOCAL) {
+    jit_->max_local_ = std::max<int64>(jit_->max_local_, op.index());
+    return true;
+  }
+  if (op.kind() == Register::PARAM) {
+    jit_->max_param_ = std::max<int64>(jit_->max_param_, op.index());
+    return true;
+  }
+  return false;
+}
+
+void JitCompiler::LoadOperand(X64Register dst, PackedOperand op) {
+  const int32 disp = op.index() * sizeof(Value);
+  if (op.is_constant()) {
+    assembler_.Load(dst, kConstantsRegister, disp);
+  } else if (op.kind() == Register::LOCAL) {
+    assembler_.Load(dst, kLocalsRegister, disp);
+  } else {
+    DCHECK_EQ(Register::PARAM, op.kind());
+    assembler_.Load(dst, kParamsRegister, disp);
+  }
+}
+
+void JitCompiler::StoreOperand(PackedOperand op, X64Register src) {
+  const int32 disp = op.index() * sizeof(Value);
+  if (op.kind() == Register::LOCAL) {
+    assembler_.Store(kLocalsRegister, disp, src);
+  } else {
+    DCHECK_EQ(Register::PARAM, op.kind());
+    assembler_.Store(kParamsRegister, disp, src);
+  }
+}
+
+bool JitCompiler::IsCodePointer(PackedOperand op) {
+  return op.is_constant()
+      && code_->constants()[op.index()].IsSmallInt()
+      && (IntValue(code_->constants()[op.index()]) >= 0);
+}
+
+uint64 JitCompiler::CodePointer(PackedOperand op) {
+  return IntValue(code_->constants()[op.index()]);
+}
+
+void JitCompiler::ExitIf(Condition condition, uint64 code_pointer) {
+  Patch exit;
+  exit.displacement_offset = assembler_.Jcc(condition);
+  exit.code_pointer = code_pointer;
+  exits_.push_back(exit);
+}
+
+void JitCompiler::ExitUnlessSmallInt(X64Register reg, uint64 code_pointer) {
+  assembler_.Mov(RCX, reg);
+  assembler_.AndImm8(RCX, kTagBitMask);
+  assembler_.CmpImm8(RCX, kSmallIntTag);
+  ExitIf(CC_NOT_EQUAL, code_pointer);
+}
+
+void JitCompiler::ExitIfEqual(X64Register reg, uint64 bits,
+                              uint64 code_pointer) {
+  assembler_.MovImm64(RCX, bits);
+  assembler_.Cmp(reg, RCX);
+  ExitIf(CC_EQUAL, code_pointer);
+}
+
+void JitCompiler::Branch(uint64 code_pointer, uint64 target) {
+  if (target <= code_pointer) {
+    assembler_.SubMemImm32(kFrameRegister, offsetof(JitFrame, budget),
+                           code_pointer - target + 1);
+    ExitIf(CC_LESS_EQUAL, target);
+  }
+  Patch branch;
+  branch.displacement_offset = assembler_.Jmp();
+  // Branches past the end of the code exit: the interpreter terminates.
+  branch.code_pointer = std::min(target, code_->size());
+  branches_.push_back(branch);
+}
+
+void JitCompiler::CallRuntime(const void* function) {
+  assembler_.MovImm64(RAX, reinterpret_cast<uint64>(function));
+  assembler_.Call(RAX);
+}
+
+// -----------------------------------------------------------------------------
+// JitCode
+
+JitCode::~JitCode() {
+  if (memory_ != NULL) munmap(memory_, size_);
+}
+
+// static
+JitCode* JitCode::Compile(PackedCode* code) {
+  JitCode* const jit = new JitCode;
+  JitCompiler(code, jit).Compile();
+  VLOG(1) << "Compiled " << code->size() << " instructions into "
+          << jit->size() << " bytes of native code";
+  return jit;
+}
+
+#else  // !STORE_JIT
+
+JitCode::~JitCode() {
+}
+
+// static
+JitCode* JitCode::Compile(PackedCode* code) {
+  return NULL;
+}
+
+#endif  // STORE_JIT
+
+}  // namespace store
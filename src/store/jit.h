@@ -0,0 +1,117 @@
+// Baseline JIT: compiles the packed code of a procedure into native code
+#ifndef STORE_JIT_H_
+#define STORE_JIT_H_
+
+#include <vector>
+using std::vector;
+
+#include "base/basictypes.h"
+
+// The JIT generates x86-64 code for Linux. Elsewhere, procedures are always
+// interpreted.
+#if defined(__x86_64__) && defined(__linux__)
+#define STORE_JIT 1
+#else
+#define STORE_JIT 0
+#endif
+
+namespace store {
+
+class PackedCode;
+class Store;
+class ThreadList;
+class Value;
+
+// -----------------------------------------------------------------------------
+// State of the frame running compiled code, shared with the native code.
+struct JitFrame {
+  Value* locals;           // The local registers of the frame
+  Value* parameters;       // The values of the parameter array of the frame
+  const Value* constants;  // The constant pool of the procedure
+
+  // The step budget of the thread. Backward branches charge the length of
+  // the loop they close, as in the interpreter.
+  int64 budget;
+
+  // Runtime state for the slow paths.
+  Store* store;
+  ThreadList* new_runnable;
+};
+
+// -----------------------------------------------------------------------------
+// The native code of a procedure, compiled from its packed code by stitching
+// one template per instruction.
+//
+// Templates inline the small integer and boolean fast paths, and call back
+// into the runtime for unification, allocation and record accesses.
+// Instructions without a template, and instructions whose fast path does not
+// apply (eg. operands that are not small integers, or unbound variables),
+// exit the native code: the interpreter executes them, and suspends the
+// thread if needed. The native code never changes the call stack: calls and
+// returns go through the interpreter too.
+//
+// Code pointers are the same as in the packed code. The native code may be
+// entered at any instruction with a template.
+//
+class JitCode {
+ public:
+  ~JitCode();
+
+  // @returns The native code of a procedure, or NULL if the JIT is not
+  //     supported on this platform.
+  static JitCode* Compile(PackedCode* code);
+
+  // @returns The native code of the instruction at the given code pointer,
+  //     or NULL if the instruction has no template.
+  const void* entry(uint64 code_pointer) const {
+    return (code_pointer < entries_.size()) ? entries_[code_pointer] : NULL;
+  }
+
+  // @returns True if the native code may run on a frame with the given
+  //     number of local registers and parameters: the indexes of the register
+  //     operands are checked when compiling.
+  bool CanRun(uint64 nlocals, uint64 nparams) const {
+    return (max_local_ < static_cast<int64>(nlocals))
+        && (max_param_ < static_cast<int64>(nparams));
+  }
+
+  // Runs the native code from an entry, until it exits.
+  // @returns The code pointer of the instruction the interpreter resumes at.
+  //     It is past the end of the code if the procedure ran to its end.
+  uint64 Run(JitFrame* frame, const void* entry) const {
+    return run_(frame, entry);
+  }
+
+  // Size of the native code, in bytes.
+  uint64 size() const { return size_; }
+
+ private:
+  typedef uint64 (*RunFunction)(JitFrame* frame, const void* entry);
+
+  JitCode() : run_(NULL), memory_(NULL), size_(0),
+              max_local_(-1), max_param_(-1) {}
+
+  // Entry point of the native code: saves the registers, loads the frame
+  // and jumps to an instruction.
+  RunFunction run_;
+
+  // The executable mapping holding the native code.
+  void* memory_;
+  uint64 size_;
+
+  // Native code of each instruction, NULL for instructions without template.
+  vector<const void*> entries_;
+
+  // Highest indexes of the local registers and parameters accessed,
+  // -1 for none.
+  int64 max_local_;
+  int64 max_param_;
+
+  friend class JitCompiler;
+
+  DISALLOW_COPY_AND_ASSIGN(JitCode);
+};
+
+}  // namespace store
+
+#endif  // STORE_JIT_H_
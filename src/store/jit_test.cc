@@ -0,0 +1,218 @@
+// Tests for the baseline JIT.
+#include "store/values.h"
+
+#include <memory>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+#include <gtest/gtest.h>
+
+#include "store/engine.h"
+
+namespace store {
+
+const uint64 kStoreSize = 16 * 1024 * 1024;
+
+namespace {
+
+Operand Local(int index) {
+  return Operand(Register(Register::LOCAL, index));
+}
+
+Operand Param(int index) {
+  return Operand(Register(Register::PARAM, index));
+}
+
+Operand Immediate(int64 integer) {
+  return Operand(Value::Integer(integer));
+}
+
+// Builds a procedure Sum(N Record Result), with
+// Result = (N + Record.a) + ... + (1 + Record.a):
+//   l0 := 0
+//   l1 := N
+//   while 0 < l1:
+//     l0 := l0 + Record.a
+//     l0 := l0 + l1
+//     l1 := l1 - 1
+//   Result = l0
+Closure* NewSumProc(Store* store) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(0)));
+  code->push_back(Bytecode(Bytecode::LOAD, Local(1), Param(0)));
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(2), Immediate(0), Local(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH_UNLESS, Local(2), Immediate(9)));
+  code->push_back(
+      Bytecode(Bytecode::ACCESS_RECORD, Local(3), Param(1),
+               Operand(Atom::Get("a"))));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD, Local(0), Local(0), Local(3)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD, Local(0), Local(0), Local(1)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(1), Local(1),
+               Immediate(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH, Immediate(2)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(2), Local(0)));
+  return Closure::New(store, code, 3, 4, 0);
+}
+
+// Runs Sum(N a(A) Result) in a new thread.
+// @returns The result.
+Value RunSum(Store* store, Engine* engine, Closure* sum, int64 n, int64 a) {
+  Value features[] = { Atom::Get("a") };
+  Value values[] = { Value::Integer(a) };
+  const Value record =
+      Record::New(store, Atom::Get("r"), Arity::Get(1, features), values);
+  const Value result = New::Free(store);
+  Array* const params = Array::New(store, 3, Value::Integer(n));
+  params->Assign(1, record);
+  params->Assign(2, result);
+  New::Thread(store, engine, sum, params, store);
+  engine->Run();
+  return result.Deref();
+}
+
+}  // namespace
+
+TEST(JitCode, Disabled) {
+  StaticStore store(kStoreSize);
+  Closure* const sum = NewSumProc(&store);
+  Engine engine;
+  EXPECT_GT(0, engine.jit_threshold());
+  EXPECT_EQ(55 + 20, IntValue(RunSum(&store, &engine, sum, 10, 2)));
+  EXPECT_TRUE(sum->packed_code()->jit_code() == NULL);
+}
+
+#if STORE_JIT
+
+TEST(JitCode, Loop) {
+  StaticStore store(kStoreSize);
+  Closure* const sum = NewSumProc(&store);
+  const int64 n = 100000;
+
+  Engine engine;
+  engine.set_jit_threshold(0);
+  EXPECT_EQ(n * (n + 1) / 2 + 2 * n,
+            IntValue(RunSum(&store, &engine, sum, n, 2)));
+
+  // All the instructions of the procedure have a template.
+  const PackedCode* const packed = sum->packed_code();
+  const JitCode* const jit = packed->jit_code();
+  ASSERT_TRUE(jit != NULL);
+  for (uint64 cp = 0; cp < packed->size(); ++cp)
+    EXPECT_TRUE(jit->entry(cp) != NULL) << "CP=" << cp;
+  EXPECT_TRUE(jit->CanRun(4, 3));
+  EXPECT_FALSE(jit->CanRun(3, 3));
+
+  // The native code accesses the record through the inline cache.
+  // The first access misses, and goes through the interpreter.
+  EXPECT_EQ(static_cast<uint64>(n - 1),
+            packed->record_cache_stats().monomorphic_hits);
+}
+
+TEST(JitCode, Threshold) {
+  StaticStore store(kStoreSize);
+  Closure* const sum = NewSumProc(&store);
+
+  Engine engine;
+  engine.set_jit_threshold(100);
+  // Iterations of the loop count towards the threshold.
+  EXPECT_EQ(10 * 11 / 2, IntValue(RunSum(&store, &engine, sum, 10, 0)));
+  EXPECT_TRUE(sum->packed_code()->jit_code() == NULL);
+  EXPECT_EQ(200 * 201 / 2, IntValue(RunSum(&store, &engine, sum, 200, 0)));
+  EXPECT_TRUE(sum->packed_code()->jit_code() != NULL);
+}
+
+TEST(JitCode, SlowPaths) {
+  StaticStore store(kStoreSize);
+  Closure* const sum = NewSumProc(&store);
+
+  Engine engine;
+  engine.set_jit_threshold(0);
+  const int64 a = kSmallIntMax - 2;
+  EXPECT_EQ(a + 1, IntValue(RunSum(&store, &engine, sum, 1, a)));
+  // The sum overflows the small integers: the interpreter computes it.
+  const Value big = RunSum(&store, &engine, sum, 2, a);
+  EXPECT_FALSE(big.IsSmallInt());
+  const mpz_class expected = 2 * mpz_class(a) + 3;
+  EXPECT_EQ(Value::Integer(&store, expected).ToString(), big.ToString());
+
+  // The record is not a Record: the interpreter accesses its feature.
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::ACCESS_RECORD, Local(0), Param(0), Immediate(1)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(0)));
+  Closure* const first = Closure::New(&store, code, 2, 1, 0);
+  Value values[] = { Value::Integer(7), Value::Integer(8) };
+  const Value result = New::Free(&store);
+  Array* const params =
+      Array::New(&store, 2, Tuple::New(&store, Atom::Get("t"), 2, values));
+  params->Assign(1, result);
+  New::Thread(&store, &engine, first, params, &store);
+  engine.Run();
+  EXPECT_EQ(7, IntValue(result));
+}
+
+TEST(JitCode, Suspension) {
+  StaticStore store(kStoreSize);
+  // p1 = p0 + 1, compiled.
+  shared_ptr<vector<Bytecode> > add_code(new vector<Bytecode>);
+  add_code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD, Local(0), Param(0), Immediate(1)));
+  add_code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(0)));
+  Closure* const add = Closure::New(&store, add_code, 2, 1, 0);
+
+  // p0 = 41
+  shared_ptr<vector<Bytecode> > bind_code(new vector<Bytecode>);
+  bind_code->push_back(Bytecode(Bytecode::UNIFY, Param(0), Immediate(41)));
+  Closure* const bind = Closure::New(&store, bind_code, 1, 0, 0);
+
+  // The first thread suspends on p0 in the interpreter, and resumes in the
+  // native code once the second thread binds p0.
+  Engine engine;
+  engine.set_jit_threshold(0);
+  const Value x = New::Free(&store);
+  const Value result = New::Free(&store);
+  Array* const params = Array::New(&store, 2, x);
+  params->Assign(1, result);
+  New::Thread(&store, &engine, add, params, &store);
+  New::Thread(&store, &engine, bind, Array::New(&store, 1, x), &store);
+  engine.Run();
+  EXPECT_EQ(42, IntValue(result));
+  EXPECT_TRUE(add->packed_code()->jit_code() != NULL);
+}
+
+TEST(JitCode, Workers) {
+  StaticStore store(kStoreSize);
+  Closure* const sum = NewSumProc(&store);
+  Value features[] = { Atom::Get("a") };
+  Value values[] = { Value::Integer(1) };
+  const Value record =
+      Record::New(&store, Atom::Get("r"), Arity::Get(1, features), values);
+
+  // Each worker compiles the procedure in its own code context.
+  Engine engine;
+  engine.set_workers(4);
+  engine.set_jit_threshold(0);
+  vector<Value> results;
+  for (int64 n = 1000; n < 1100; ++n) {
+    const Value result = New::Free(&store);
+    Array* const params = Array::New(&store, 3, Value::Integer(n));
+    params->Assign(1, record);
+    params->Assign(2, result);
+    New::Thread(&store, &engine, sum, params, &store);
+    results.push_back(result);
+  }
+  engine.Run();
+
+  for (int64 n = 1000; n < 1100; ++n)
+    EXPECT_EQ(n * (n + 1) / 2 + n, IntValue(results[n - 1000])) << n;
+  EXPECT_TRUE(sum->packed_code()->jit_code() != NULL);
+}
+
+#endif  // STORE_JIT
+
+}  // namespace store
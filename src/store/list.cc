@@ -1,11 +1,43 @@
 #include "store/values.h"
 
+#include <algorithm>
+#include <vector>
+using std::vector;
+
 namespace store {
 
 // -----------------------------------------------------------------------------
 // List
 
 /* static */ const Value::ValueType List::kType;
+/* static */ const uint64 List::kChunkSize;
+
+// static
+Value List::New(Store* store, uint64 nvalues, const Value* values,
+                Value tail) {
+  // Chunks are built from the end of the list.
+  while (nvalues > 0) {
+    const uint64 chunk_size = std::min(nvalues, kChunkSize);
+    nvalues -= chunk_size;
+    tail = NewChunk(store, chunk_size, values + nvalues, tail);
+  }
+  return tail;
+}
+
+// static
+List* List::NewChunk(Store* store, uint64 nvalues, const Value* values,
+                     Value tail) {
+  CHECK_GT(nvalues, 0UL);
+  CHECK_LE(nvalues, kChunkSize);
+  const uint64 npacked = nvalues - 1;
+  char* const block = static_cast<char*>(CHECK_NOTNULL(
+      store->Alloc(npacked * sizeof(PackedCell) + sizeof(ConsCell))));
+  PackedCell* const packed = reinterpret_cast<PackedCell*>(block);
+  for (uint64 i = 0; i < npacked; ++i)
+    new(packed + i) PackedCell(values[i]);
+  new(packed + npacked) ConsCell(values[npacked], tail);
+  return packed;
+}
 
 int64 List::GetValuesCount(Value* last) {
   CHECK_NOTNULL(last);
@@ -18,7 +50,7 @@ int64 List::GetValuesCount(Value* last) {
 
 void List::GetValuesCountInternal(
     ReferenceSet* ref_set, int64* count, Value* last) {
-  Value tail = tail_.Deref();
+  Value tail = this->tail().Deref();
   if (tail.type() == Value::LIST) {
     *count += 1;
     if (ref_set->insert(tail).second) {
@@ -36,41 +68,137 @@ void List::GetValuesCountInternal(
 void List::ExploreValue(ReferenceMap* ref_map) {
   CHECK_NOTNULL(ref_map);
   head_.Explore(ref_map);
-  tail_.Explore(ref_map);
+  tail().Explore(ref_map);
 }
 
 // virtual
-Value List::Optimize(OptimizeContext* context) {
+Value List::ConsCell::Optimize(OptimizeContext* context) {
   head_ = context->Optimize(head_);
   tail_ = context->Optimize(tail_);
   return this;
 }
 
+// virtual
+Value List::PackedCell::Optimize(OptimizeContext* context) {
+  head_ = context->Optimize(head_);
+  context->Optimize(tail());  // The tail cannot be replaced.
+  return this;
+}
+
 // virtual
 bool List::UnifyWith(UnificationContext* context, Value ovalue) {
   CHECK_NOTNULL(context);
   if (ovalue.type() != Value::LIST) return false;  // Not a list
   List* olist = ovalue.as<List>();
   return Value::Unify(context, head_, olist->head_)
-      && Value::Unify(context, tail_, olist->tail_);
+      && Value::Unify(context, tail(), olist->tail());
 }
 
 // virtual
 bool List::Equals(EqualityContext* context, Value value) {
   List* list = value.as<List>();
+  if (header_.has_hash() && list->header_.has_hash()
+      && (header_.hash() != list->header_.hash()))
+    return false;
   return context->Equals(head_, list->head_)
-      && context->Equals(tail_, list->tail_);
+      && context->Equals(tail(), list->tail());
+}
+
+// virtual
+bool List::StructuralHash(uint32* hash) {
+  if (header_.has_hash()) {
+    *hash = header_.hash();
+    return true;
+  }
+
+  // Collects the cells whose hash is unknown, iterating on the tails:
+  // hashing a long list does not recurse.
+  vector<List*> cells;
+  uint32 tail_hash = 0;
+  bool hashable = true;
+  Value value = this;
+  while (true) {
+    value = value.Deref();
+    if (value.type() != Value::LIST) {
+      hashable = value.StructuralHash(&tail_hash);
+      break;
+    }
+    List* cell = value.as<List>();
+    if (cell->header_.has_hash()) {
+      tail_hash = cell->header_.hash();
+      break;
+    }
+    if (!ValueHeader::StartVisit(cell)) {
+      hashable = false;  // Cyclic list
+      break;
+    }
+    cells.push_back(cell);
+    value = cell->tail();
+  }
+
+  // Hashes the cells backwards, from the end of the list.
+  for (auto it = cells.rbegin(); it != cells.rend(); ++it) {
+    List* cell = *it;
+    uint32 head_hash;
+    hashable = hashable && cell->head_.StructuralHash(&head_hash);
+    if (hashable) {
+      tail_hash = MixHash(MixHash(kType, head_hash), tail_hash);
+      cell->header_.set_hash(tail_hash);
+    }
+    ValueHeader::EndVisit(cell);
+  }
+  if (!hashable) return false;
+  *hash = tail_hash;
+  return true;
 }
 
 // virtual
 HeapValue* List::MoveInternal(Store* store) {
-  return New(store, head_.Move(store), tail_.Move(store));
+  // Packs the spine starting from this cell into a chunk, up to kChunkSize
+  // cells. The spine stops at the first tail that is not a list cell yet to
+  // be moved.
+  List* cells[kChunkSize];
+  Value values[kChunkSize];
+  uint64 ncells = 0;
+  List* cell = this;
+  Value tail;
+  while (true) {
+    cells[ncells] = cell;
+    values[ncells] = cell->head_;
+    ++ncells;
+    tail = cell->tail();
+    if (ncells == kChunkSize) break;
+    if (!tail.IsHeapValue() || (tail.heap_value()->type() != Value::LIST))
+      break;
+    cell = static_cast<List*>(tail.heap_value());
+    if (std::find(cells, cells + ncells, cell) != cells + ncells) break;
+  }
+
+  // The other cells of the spine are replaced by forwarders to the chunk
+  // before anything is moved: heads and tail may point to cells of the spine.
+  // The chunk holds the values not moved yet until then.
+  List* const chunk = NewChunk(store, ncells, values, tail);
+  PackedCell* const moved = reinterpret_cast<PackedCell*>(chunk);
+  for (uint64 i = 1; i < ncells; ++i) {
+    static_cast<HeapValue*>(cells[i])->~HeapValue();
+    MovedValue::New(cells[i], reinterpret_cast<List*>(moved + i));
+  }
+
+  // The first cell is overwritten by HeapValue::Move().
+  for (uint64 i = 0; i + 1 < ncells; ++i)
+    reinterpret_cast<List*>(moved + i)->head_ = values[i].Move(store);
+  const Value last_head = values[ncells - 1].Move(store);
+  const Value last_tail = tail.Move(store);
+  List* const last = reinterpret_cast<List*>(moved + ncells - 1);
+  static_cast<HeapValue*>(last)->~HeapValue();
+  new(last) ConsCell(last_head, last_tail);
+  return chunk;
 }
 
 // virtual
 bool List::IsStateless(StatelessnessContext* context) {
   return context->IsStateless(head_)
-      && context->IsStateless(tail_);
+      && context->IsStateless(tail());
 }
 
 // virtual
@@ -102,7 +230,7 @@ void List::ToASCII(ToASCIIContext* context, string* repr) {
       context->Encode(current->head_, repr);
     }
     repr->push_back('|');
-    context->Encode(current->tail_, repr);
+    context->Encode(current->tail(), repr);
   }
 }
 
@@ -127,7 +255,16 @@ Value List::RecordGet(Value feature) {
   const uint64 index = SmallInteger(feature).value() - 1;
   if (index >= 2)
     throw FeatureNotFound(feature, RecordArity());
-  return values()[index];
+  return (index == 0) ? head_ : tail();
+}
+
+// virtual
+LookupStatus List::TryRecordGet(Value feature, Value* value) {
+  if (!feature.IsSmallInt()) return LOOKUP_NOT_FOUND;
+  const uint64 index = SmallInteger(feature).value() - 1;
+  if (index >= 2) return LOOKUP_NOT_FOUND;
+  *value = (index == 0) ? head_ : tail();
+  return LOOKUP_FOUND;
 }
 
 // -----------------------------------------------------------------------------
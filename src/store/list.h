@@ -10,25 +10,54 @@ namespace store {
 
 // -----------------------------------------------------------------------------
 // List
-
+//
+// A list cell is either:
+//  - a cons cell, with a head and an explicit tail;
+//  - a packed cell, with a head only, whose tail is the cell that immediately
+//    follows in memory.
+//
+// A chunk is a single memory block containing a sequence of packed cells,
+// terminated by a cons cell:
+//     [packed: h1][packed: h2]...[packed: hN-1][cons: hN, tail]
+// Each cell in a chunk is a regular list value: cells can be referenced,
+// deconstructed and unified individually, without materializing anything.
+// A packed cell is 3 words (vtable, header and head) where a cons cell is 4
+// (with the tail). The value header costs the word a packed cell saves: a
+// chunk uses as much memory per element as the former 3 words list cells
+// (vtable, head and tail). What chunks gain is a contiguous list spine.
+//
+// Chunks are built by the list factories taking an array of values, and when
+// moving lists into another store.
+//
 class List : public HeapValue {
  public:
   static const Value::ValueType kType = Value::LIST;
 
+  // Maximum number of cells in a chunk.
+  static const uint64 kChunkSize = 32;
+
   // ---------------------------------------------------------------------------
   // Factory methods
-  static inline
-  List* New(Store* store, Value head, Value tail) {
-    return new(CHECK_NOTNULL(store->Alloc<List>())) List(head, tail);
-  }
+
+  // Creates a single cons cell.
+  static List* New(Store* store, Value head, Value tail);
+
+  // Creates a list with the given head values, terminated with tail.
+  // The list spine is packed in chunks of up to kChunkSize cells.
+  // @returns The first cell of the list, or tail if nvalues is 0.
+  static Value New(Store* store, uint64 nvalues, const Value* values,
+                   Value tail);
 
   // ---------------------------------------------------------------------------
   // List specific interface
 
   Value head() const { return head_; }
-  Value tail() const { return tail_; }
+  virtual Value tail() const = 0;
 
-  List* Next() const { return tail_.Deref().as<List>(); }
+  // @returns True if this cell is a packed cell, false for a cons cell.
+  virtual bool IsPacked() const = 0;
+
+  List* Next() const { return tail().Deref().as<List>(); }
 
   // Counts the number of values in the list.
   //
@@ -56,12 +85,13 @@ class List : public HeapValue {
   virtual uint64 caps() const { return Value::CAP_RECORD | Value::CAP_TUPLE; }
 
   virtual void ExploreValue(ReferenceMap* ref_map);
-  virtual Value Optimize(OptimizeContext* context);
 
   virtual bool UnifyWith(UnificationContext* context, Value value);
   virtual bool Equals(EqualityContext* context, Value value);
+  virtual bool StructuralHash(uint32* hash);
   virtual HeapValue* MoveInternal(Store* store);
   virtual bool IsStateless(StatelessnessContext* context);
+  virtual ValueHeader* header() { return &header_; }
 
   // ---------------------------------------------------------------------------
   // Record interface
@@ -70,6 +100,7 @@ class List : public HeapValue {
   virtual uint64 RecordWidth() { return 2; }
   virtual bool RecordHas(Value feature);
   virtual Value RecordGet(Value feature);
+  virtual LookupStatus TryRecordGet(Value feature, Value* value);
 
   virtual Value::ItemIterator* RecordIterItems() {
     return new ItemIterator(this);
@@ -83,7 +114,7 @@ class List : public HeapValue {
   virtual Value TupleGet(uint64 index) {
     if (index >= 2)
       throw FeatureNotFound("List tuple has no feature " + index);
-    return values()[index];
+    return (index == 0) ? head_ : tail();
   }
 
   // ---------------------------------------------------------------------------
@@ -91,9 +122,9 @@ class List : public HeapValue {
   virtual void ToASCII(ToASCIIContext* context, string* repr);
   virtual void ToProtoBuf(oz_pb::Value* pb);
 
- private:  // ------------------------------------------------------------------
+ protected:  // ----------------------------------------------------------------
 
-  List(Value head, Value tail) : head_(head), tail_(tail) {
+  explicit List(Value head) : head_(head) {
   }
 
   virtual ~List() {
@@ -101,19 +132,18 @@ class List : public HeapValue {
 
   // ---------------------------------------------------------------------------
   // Memory layout
+  ValueHeader header_;
   Value head_;
-  Value tail_;
 
-  // This should normally be:
-  // union {
-  //   Value values_[2];
-  //   struct {
-  //     Value head_;  // == values_[0]
-  //     Value tail_;  // == values_[1]
-  //   };
-  // };
+ private:  // ------------------------------------------------------------------
 
-  inline const Value* values() const { return &head_; }
+  class ConsCell;
+  class PackedCell;
+
+  // Creates a single chunk with the given head values, terminated with tail.
+  // @param nvalues Number of cells in the chunk, between 1 and kChunkSize.
+  static List* NewChunk(Store* store, uint64 nvalues, const Value* values,
+                        Value tail);
 
   // ---------------------------------------------------------------------------
   class ItemIterator : public Value::ItemIterator {
@@ -128,7 +158,7 @@ class List : public HeapValue {
     virtual ValuePair operator*() {
       CHECK(!at_end());
       return std::make_pair(Value::Integer(index_ + 1),
-                            list_->values()[index_]);
+                            list_->TupleGet(index_));
     }
 
     virtual ItemIterator& operator++() {
@@ -157,7 +187,7 @@ class List : public HeapValue {
 
     virtual Value operator*() {
       CHECK(!at_end());
-      return list_->values()[index_];
+      return list_->TupleGet(index_);
     }
 
     virtual ValueIterator& operator++() {
@@ -176,6 +206,46 @@ class List : public HeapValue {
 
 };
 
+// -----------------------------------------------------------------------------
+// List cell with an explicit tail.
+class List::ConsCell : public List {
+ public:
+  ConsCell(Value head, Value tail) : List(head), tail_(tail) {
+  }
+
+  virtual Value tail() const { return tail_; }
+  virtual bool IsPacked() const { return false; }
+  virtual Value Optimize(OptimizeContext* context);
+
+ private:  // ------------------------------------------------------------------
+
+  virtual ~ConsCell() {
+  }
+
+  // ---------------------------------------------------------------------------
+  // Memory layout
+  Value tail_;
+};
+
+// -----------------------------------------------------------------------------
+// List cell whose tail is the next cell in the chunk.
+class List::PackedCell : public List {
+ public:
+  explicit PackedCell(Value head) : List(head) {
+  }
+
+  virtual Value tail() const {
+    return reinterpret_cast<List*>(const_cast<PackedCell*>(this + 1));
+  }
+  virtual bool IsPacked() const { return true; }
+  virtual Value Optimize(OptimizeContext* context);
+
+ private:  // ------------------------------------------------------------------
+
+  virtual ~PackedCell() {
+  }
+};
+
 }  // namespace store
 
 #endif  // STORE_LIST_H_
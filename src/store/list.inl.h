@@ -3,6 +3,12 @@
 
 namespace store {
 
+// static
+inline
+List* List::New(Store* store, Value head, Value tail) {
+  return new(CHECK_NOTNULL(store->Alloc<ConsCell>())) ConsCell(head, tail);
+}
+
 // virtual
 inline
 Value List::RecordLabel() {
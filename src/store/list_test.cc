@@ -124,4 +124,121 @@ TEST_F(ListTest, Recursive) {
   EXPECT_TRUE(tail.Deref() == l);
 }
 
+TEST_F(ListTest, Chunk) {
+  Value values[3] = {
+    Value::Integer(1), Value::Integer(2), Value::Integer(3),
+  };
+  const uint64 free_before = store_.free();
+  Value list = New::List(&store_, 3, values);
+  // 3 words per packed cell (vtable, header, head), 4 for the last cell.
+  EXPECT_EQ(10 * sizeof(Value), free_before - store_.free());
+  EXPECT_EQ("[1 2 3]", list.ToString());
+
+  List* l1 = list.as<List>();
+  EXPECT_TRUE(l1->IsPacked());
+  EXPECT_TRUE(values[0] == l1->TupleGet(0));
+  EXPECT_TRUE(values[0] == l1->RecordGet(Value::Integer(1)));
+
+  // The tail of a packed cell is the next cell in the chunk.
+  Value tail = l1->RecordGet(Value::Integer(2));
+  EXPECT_TRUE(tail == l1->tail());
+  EXPECT_TRUE(tail == l1->TupleGet(1));
+  List* l2 = tail.as<List>();
+  EXPECT_TRUE(l2->IsPacked());
+  EXPECT_TRUE(values[1] == l2->head());
+  List* l3 = l2->Next();
+  EXPECT_FALSE(l3->IsPacked());
+  EXPECT_TRUE(values[2] == l3->head());
+  EXPECT_TRUE(l3->tail() == KAtomNil());
+
+  EXPECT_TRUE(l1->RecordLabel() == KAtomList());
+  EXPECT_TRUE(l2->RecordArity() == KArityPair());
+
+  Value last = NULL;
+  EXPECT_EQ(3, l1->GetValuesCount(&last));
+  EXPECT_TRUE(last == KAtomNil());
+}
+
+TEST_F(ListTest, LongListIsChunked) {
+  const uint64 kSize = 3 * List::kChunkSize + 1;
+  Value values[kSize];
+  for (uint64 i = 0; i < kSize; ++i)
+    values[i] = Value::Integer(i);
+  Value list = New::List(&store_, kSize, values);
+
+  uint64 npacked = 0;
+  uint64 count = 0;
+  for (Value it = list; it != KAtomNil(); it = it.as<List>()->tail()) {
+    EXPECT_EQ(count, IntValue(it.as<List>()->head()));
+    if (it.as<List>()->IsPacked()) ++npacked;
+    ++count;
+  }
+  EXPECT_EQ(kSize, count);
+  EXPECT_EQ(kSize - 4, npacked);
+}
+
+TEST_F(ListTest, UnifyChunkWithCells) {
+  Value values[3] = {
+    Value::Integer(1), Value::Integer(2), Value::Integer(3),
+  };
+  Value chunk = New::List(&store_, 3, values);
+
+  Variable* x = Variable::New(&store_);
+  Variable* rest = Variable::New(&store_);
+  Value cells =
+      List::New(&store_, Value::Integer(1), List::New(&store_, x, rest));
+  EXPECT_TRUE(Unify(chunk, cells));
+  EXPECT_TRUE(x->Deref() == Value::Integer(2));
+  EXPECT_EQ("[3]", rest->Deref().ToString());
+  EXPECT_TRUE(Equals(chunk, cells));
+
+  Value other = List::New(&store_, Value::Integer(1), KAtomNil());
+  EXPECT_FALSE(Unify(chunk, other));
+}
+
+TEST_F(ListTest, MovePacksSpine) {
+  // Builds a list of cons cells.
+  Value list = KAtomNil();
+  for (int i = 4; i >= 0; --i)
+    list = List::New(&store_, Value::Integer(i), list);
+  Value middle = list.as<List>()->Next()->Next();
+
+  Value values[2] = { list, middle };
+  Value tuple = New::Tuple(&store_, 2, values);
+
+  StaticStore store2(kStoreSize);
+  Value moved = tuple.Move(&store2);
+  Value moved_list = moved.TupleGet(0);
+  Value moved_middle = moved.TupleGet(1);
+  EXPECT_EQ("[0 1 2 3 4]", moved_list.ToString());
+  EXPECT_EQ("[2 3 4]", moved_middle.ToString());
+
+  // The spine is now contiguous, and shared references are preserved.
+  List* cell = moved_list.as<List>();
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(cell->IsPacked());
+    cell = cell->Next();
+  }
+  EXPECT_FALSE(cell->IsPacked());
+  EXPECT_TRUE(moved_middle == moved_list.as<List>()->Next()->Next());
+}
+
+TEST_F(ListTest, MoveKeepsReferencesIntoTheSpine) {
+  // [[2 3] 1 2 3]: the first head is a later cell of the same spine.
+  Value last = List::New(&store_, Value::Integer(3), KAtomNil());
+  Value third = List::New(&store_, Value::Integer(2), last);
+  Value second = List::New(&store_, Value::Integer(1), third);
+  Value list = List::New(&store_, third, second);
+
+  StaticStore store2(kStoreSize);
+  Value moved = list.Move(&store2);
+  List* const cell = moved.as<List>();
+  EXPECT_EQ("[2 3]", cell->head().ToString());
+  EXPECT_EQ("[1 2 3]", Value(cell->Next()).ToString());
+
+  // The head is the third cell of the moved chunk, not a copy of it.
+  EXPECT_TRUE(cell->IsPacked());
+  EXPECT_TRUE(cell->head() == Value(cell->Next()->Next()));
+}
+
 }  // namespace store
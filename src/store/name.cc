@@ -10,12 +10,21 @@ namespace store {
 
 const Value::ValueType Name::kType;
 
+const uint64 Name::kIdBlockSize;
+
 // static
-uint64 Name::next_id_ = 0;
+std::atomic<uint64> Name::next_id_block_(0);
 
 // static
 uint64 Name::GetNextId() {
-  return next_id_++;
+  // Next id and end of the block reserved by this OS thread.
+  static thread_local uint64 next_id = 0;
+  static thread_local uint64 end_id = 0;
+  if (next_id == end_id) {
+    next_id = next_id_block_.fetch_add(kIdBlockSize);
+    end_id = next_id + kIdBlockSize;
+  }
+  return next_id++;
 }
 
 // virtual
@@ -1,6 +1,7 @@
 #ifndef STORE_NAME_H_
 #define STORE_NAME_H_
 
+#include <atomic>
 #include <string>
 using std::string;
 
@@ -12,7 +13,8 @@ namespace store {
 // Names
 //
 // An name is an ID that cannot be forged and guaranteed unique.
-// For now, it is unique within the process.
+// For now, it is unique within the process: each OS thread reserves blocks of
+// ids from a global counter, and allocates the ids of its block in order.
 //
 class Name : public HeapValue {
  public:
@@ -38,6 +40,9 @@ class Name : public HeapValue {
   virtual uint64 RecordWidth() { return 0; }
   virtual bool RecordHas(Value feature) { return false; }
   virtual Value RecordGet(Value feature);
+  virtual LookupStatus TryRecordGet(Value feature, Value* value) {
+    return LOOKUP_NOT_FOUND;
+  }
 
   // @returns A new iterator. The caller must take ownership.
   virtual Value::ItemIterator* RecordIterItems() {
@@ -73,7 +78,11 @@ class Name : public HeapValue {
   virtual void ToProtoBuf(oz_pb::Value* pb);
 
  private:  // ------------------------------------------------------------------
-  static uint64 next_id_;
+  // Ids reserved by an OS thread at once.
+  static const uint64 kIdBlockSize = 1024;
+
+  // Start of the next block of ids to reserve.
+  static std::atomic<uint64> next_id_block_;
   static uint64 GetNextId();
 
   Name() : id_(GetNextId()) {
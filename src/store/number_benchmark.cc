@@ -0,0 +1,145 @@
+// Benchmarks the integer arithmetic instructions of the interpreter:
+//  - a small integer hot loop, which should never leave the fast path;
+//  - an iterative factorial, dominated by big integer multiplications.
+#include <chrono>
+#include <memory>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "store/engine.h"
+#include "store/values.h"
+
+DEFINE_int64(
+    small_int_loop_count,
+    10000000,
+    "Number of iterations of the small integer loop."
+);
+
+DEFINE_int64(
+    factorial_of,
+    1000,
+    "Computes the factorial of this number, with big integers."
+);
+
+DEFINE_int64(
+    factorial_runs,
+    20,
+    "How many times to compute the factorial."
+);
+
+namespace store {
+
+const uint64 kStoreSize = 256 * 1024 * 1024;  // 256MB
+
+namespace {
+
+Operand Local(int index) {
+  return Operand(Register(Register::LOCAL, index));
+}
+
+Operand Param(int index) {
+  return Operand(Register(Register::PARAM, index));
+}
+
+Operand Immediate(int64 integer) {
+  return Operand(Value::Integer(integer));
+}
+
+// Builds a procedure P(N Result) that folds N..1 using the given operation:
+//   l0 := init
+//   l1 := N
+//   while 0 < l1:
+//     l0 := l0 op l1
+//     l1 := l1 - 1
+//   Result = l0
+Closure* NewFoldProc(Store* store, Bytecode::OpcodeType op, int64 init) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(init)));
+  code->push_back(Bytecode(Bytecode::LOAD, Local(1), Param(0)));
+  const int64 loop = code->size();
+  const int64 exit = loop + 5;
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(2), Immediate(0), Local(1)));
+  code->push_back(
+      Bytecode(Bytecode::BRANCH_UNLESS, Local(2), Immediate(exit)));
+  code->push_back(Bytecode(op, Local(0), Local(0), Local(1)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(1), Local(1),
+               Immediate(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH, Immediate(loop)));
+  CHECK_EQ(exit, static_cast<int64>(code->size()));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(0)));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  return Closure::New(store, code, 2, 3, 0);
+}
+
+// Runs the procedure P(N Result) in a new thread until it terminates.
+// @returns The result.
+Value Run(Store* store, Closure* proc, int64 n) {
+  Value result = New::Free(store);
+  Array* params = Array::New(store, 2, result);
+  params->Assign(0, New::Integer(store, n));
+
+  Engine engine;
+  New::Thread(store, &engine, proc, params, store);
+  engine.Run();
+  return result.Deref();
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+void SmallIntLoopBenchmark(Store* store) {
+  Closure* const sum = NewFoldProc(store, Bytecode::NUMBER_INT_ADD, 0);
+  const int64 n = FLAGS_small_int_loop_count;
+
+  const auto start = std::chrono::steady_clock::now();
+  Value result = Run(store, sum, n);
+  const double seconds = SecondsSince(start);
+
+  CHECK(result.IsSmallInt()) << result.ToString();
+  CHECK_EQ(n * (n + 1) / 2, IntValue(result));
+  // Each iteration executes 5 instructions.
+  printf("small int loop: %ld iterations in %.3fs, %.1f Minstr/s\n",
+         n, seconds, 5.0 * n / seconds / 1e6);
+}
+
+void BigIntFactorialBenchmark(Store* store) {
+  Closure* const factorial =
+      NewFoldProc(store, Bytecode::NUMBER_INT_MULTIPLY, 1);
+  const int64 n = FLAGS_factorial_of;
+
+  mpz_class expected;
+  mpz_fac_ui(expected.get_mpz_t(), n);
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int64 i = 0; i < FLAGS_factorial_runs; ++i) {
+    Value result = Run(store, factorial, n);
+    CHECK(Equals(result, New::Integer(store, expected)));
+  }
+  const double seconds = SecondsSince(start);
+
+  printf("big int factorial: %ld! x %ld in %.3fs, %.3fms per factorial\n",
+         n, FLAGS_factorial_runs, seconds,
+         seconds * 1e3 / FLAGS_factorial_runs);
+}
+
+}  // namespace store
+
+int main(int argc, char** argv) {
+  ::google::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  store::StaticStore store(store::kStoreSize);
+  store::SmallIntLoopBenchmark(&store);
+  store::BigIntFactorialBenchmark(&store);
+  return EXIT_SUCCESS;
+}
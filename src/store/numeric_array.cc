@@ -0,0 +1,280 @@
+#include "store/values.h"
+
+#include <string.h>
+
+#include <vector>
+using std::vector;
+
+#include <boost/format.hpp>
+using boost::format;
+
+namespace store {
+
+namespace {
+
+bool GetInt64(Value value, int64* result) {
+  if (value.IsSmallInt()) {
+    *result = IntValue(value);
+    return true;
+  }
+  if (value.type() != Value::INTEGER) return false;
+  const mpz_class& mpz = value.as<Integer>()->mpz();
+  if (!mpz.fits_slong_p()) return false;
+  *result = mpz.get_si();
+  return true;
+}
+
+Value NumberToValue(Store* store, int64 number) {
+  return New::Integer(store, number);
+}
+
+Value NumberToValue(Store* store, double number) {
+  return New::Float(store, number);
+}
+
+// Collects the numbers in a list terminated by nil.
+// The hare moves twice as fast to detect cyclic lists.
+// @returns False if the value is not a determined list of numbers.
+template <typename T>
+bool CollectList(Value list, bool (*get)(Value, T*), vector<T>* numbers) {
+  Value value = list.Deref();
+  Value hare = value;
+  while (value.type() == Value::LIST) {
+    List* cell = value.as<List>();
+    T number;
+    if (!get(cell->head().Deref(), &number)) return false;
+    numbers->push_back(number);
+    value = cell->tail().Deref();
+
+    for (int i = 0; i < 2; ++i)
+      if (hare.type() == Value::LIST)
+        hare = hare.as<List>()->tail().Deref();
+    if ((hare == value) && (value.type() == Value::LIST)) return false;
+  }
+  return value == KAtomNil();
+}
+
+// Collects the numbers in the elements of a tuple.
+// @returns False if the value is not a determined tuple of numbers.
+template <typename T>
+bool CollectTuple(Value value, bool (*get)(Value, T*), vector<T>* numbers) {
+  value = value.Deref();
+  if (value.type() != Value::TUPLE) return false;
+  const Tuple* tuple = value.as<Tuple>();
+  for (uint64 i = 0; i < tuple->size(); ++i) {
+    T number;
+    if (!get(tuple->values()[i].Deref(), &number)) return false;
+    numbers->push_back(number);
+  }
+  return true;
+}
+
+// Builds a list from the end, one chunk at a time.
+template <typename T>
+Value NumbersToList(Store* store, const T* numbers, uint64 size) {
+  Value list = KAtomNil();
+  Value values[List::kChunkSize];
+  uint64 end = size;
+  while (end > 0) {
+    const uint64 begin =
+        (end > List::kChunkSize) ? (end - List::kChunkSize) : 0;
+    for (uint64 i = begin; i < end; ++i)
+      values[i - begin] = NumberToValue(store, numbers[i]);
+    list = List::New(store, end - begin, values, list);
+    end = begin;
+  }
+  return list;
+}
+
+template <typename T>
+Value NumbersToTuple(Store* store, Value label,
+                     const T* numbers, uint64 size) {
+  if (size == 0) return label;
+  vector<Value> values(size);
+  for (uint64 i = 0; i < size; ++i)
+    values[i] = NumberToValue(store, numbers[i]);
+  return Tuple::New(store, label, size, values.data());
+}
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// IntArray
+
+const Value::ValueType IntArray::kType;
+
+// static
+IntArray* IntArray::NewUninitialized(Store* store, uint64 size) {
+  void* block = store->AllocWithNestedArray<IntArray, int64>(size);
+  return new(CHECK_NOTNULL(block)) IntArray(size);
+}
+
+// static
+IntArray* IntArray::New(Store* store, uint64 size, const int64* values) {
+  IntArray* array = NewUninitialized(store, size);
+  memcpy(array->values_, values, size * sizeof(int64));
+  return array;
+}
+
+// static
+IntArray* IntArray::FromList(Store* store, Value list) {
+  vector<int64> numbers;
+  if (!CollectList(list, GetInt64, &numbers)) return NULL;
+  return New(store, numbers.size(), numbers.data());
+}
+
+// static
+IntArray* IntArray::FromTuple(Store* store, Value tuple) {
+  vector<int64> numbers;
+  if (!CollectTuple(tuple, GetInt64, &numbers)) return NULL;
+  return New(store, numbers.size(), numbers.data());
+}
+
+Value IntArray::ToList(Store* store) const {
+  return NumbersToList(store, values_, size_);
+}
+
+Value IntArray::ToTuple(Store* store, Value label) const {
+  return NumbersToTuple(store, label, values_, size_);
+}
+
+// virtual
+bool IntArray::UnifyWith(UnificationContext* context, Value value) {
+  CHECK_NOTNULL(context);
+  return (value.type() == kType) && Equals(NULL, value);
+}
+
+// virtual
+bool IntArray::Equals(EqualityContext* context, Value value) {
+  const IntArray* other = value.as<IntArray>();
+  return (size_ == other->size_)
+      && (memcmp(values_, other->values_, size_ * sizeof(int64)) == 0);
+}
+
+// virtual
+bool IntArray::StructuralHash(uint32* hash) {
+  uint32 h = MixHash(kType, size_);
+  for (uint64 i = 0; i < size_; ++i)
+    h = MixHash(h, values_[i]);
+  *hash = h;
+  return true;
+}
+
+// virtual
+HeapValue* IntArray::MoveInternal(Store* store) {
+  return New(store, size_, values_);
+}
+
+// virtual
+void IntArray::ToASCII(ToASCIIContext* context, string* repr) {
+  CHECK_NOTNULL(repr);
+  repr->append("<IntArray");
+  for (uint64 i = 0; i < size_; ++i)
+    repr->append((format(" %d") % values_[i]).str());
+  repr->append(">");
+}
+
+// virtual
+void IntArray::ToProtoBuf(oz_pb::Value* pb) {
+  CHECK_NOTNULL(pb);
+  oz_pb::List* list = pb->mutable_list();
+  for (uint64 i = 0; i < size_; ++i) {
+    oz_pb::Primitive* primitive = list->add_element()->mutable_primitive();
+    primitive->set_type(oz_pb::Primitive::INTEGER);
+    primitive->set_integer(values_[i]);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// FloatArray
+
+const Value::ValueType FloatArray::kType;
+
+// static
+FloatArray* FloatArray::NewUninitialized(Store* store, uint64 size) {
+  void* block = store->AllocWithNestedArray<FloatArray, double>(size);
+  return new(CHECK_NOTNULL(block)) FloatArray(size);
+}
+
+// static
+FloatArray* FloatArray::New(Store* store, uint64 size, const double* values) {
+  FloatArray* array = NewUninitialized(store, size);
+  memcpy(array->values_, values, size * sizeof(double));
+  return array;
+}
+
+// static
+FloatArray* FloatArray::FromList(Store* store, Value list) {
+  vector<double> numbers;
+  if (!CollectList(list, Float::GetDouble, &numbers)) return NULL;
+  return New(store, numbers.size(), numbers.data());
+}
+
+// static
+FloatArray* FloatArray::FromTuple(Store* store, Value tuple) {
+  vector<double> numbers;
+  if (!CollectTuple(tuple, Float::GetDouble, &numbers)) return NULL;
+  return New(store, numbers.size(), numbers.data());
+}
+
+Value FloatArray::ToList(Store* store) const {
+  return NumbersToList(store, values_, size_);
+}
+
+Value FloatArray::ToTuple(Store* store, Value label) const {
+  return NumbersToTuple(store, label, values_, size_);
+}
+
+// virtual
+bool FloatArray::UnifyWith(UnificationContext* context, Value value) {
+  CHECK_NOTNULL(context);
+  return (value.type() == kType) && Equals(NULL, value);
+}
+
+// virtual
+bool FloatArray::Equals(EqualityContext* context, Value value) {
+  // Compares the floats, not their bits: 0.0 equals -0.0, as small floats.
+  const FloatArray* other = value.as<FloatArray>();
+  if (size_ != other->size_) return false;
+  for (uint64 i = 0; i < size_; ++i)
+    if (values_[i] != other->values_[i]) return false;
+  return true;
+}
+
+// virtual
+bool FloatArray::StructuralHash(uint32* hash) {
+  uint32 h = MixHash(kType, size_);
+  for (uint64 i = 0; i < size_; ++i)
+    h = MixHash(h, Float::Hash(values_[i]));
+  *hash = h;
+  return true;
+}
+
+// virtual
+HeapValue* FloatArray::MoveInternal(Store* store) {
+  return New(store, size_, values_);
+}
+
+// virtual
+void FloatArray::ToASCII(ToASCIIContext* context, string* repr) {
+  CHECK_NOTNULL(repr);
+  repr->append("<FloatArray");
+  for (uint64 i = 0; i < size_; ++i)
+    repr->append((format(" %f") % values_[i]).str());
+  repr->append(">");
+}
+
+// virtual
+void FloatArray::ToProtoBuf(oz_pb::Value* pb) {
+  CHECK_NOTNULL(pb);
+  oz_pb::List* list = pb->mutable_list();
+  for (uint64 i = 0; i < size_; ++i) {
+    oz_pb::Primitive* primitive = list->add_element()->mutable_primitive();
+    primitive->set_type(oz_pb::Primitive::FLOAT);
+    primitive->set_real(values_[i]);
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+}  // namespace store
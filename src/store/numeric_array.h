@@ -0,0 +1,166 @@
+#ifndef STORE_NUMERIC_ARRAY_H_
+#define STORE_NUMERIC_ARRAY_H_
+
+#include <string>
+using std::string;
+
+#include <glog/logging.h>
+
+namespace store {
+
+// -----------------------------------------------------------------------------
+// Numeric arrays
+//
+// Immutable arrays of raw int64 or double numbers, stored inline in the
+// store block. Unlike Array and Tuple, elements are not tagged values: bulk
+// operations run on the raw buffer, with the kernels in numeric_kernels.h.
+//
+// Elements are any int64 or double, including numbers that are boxed as
+// Integer or Float heap values when converted back to values.
+//
+// Two numeric arrays unify if they have the same type and the same elements.
+//
+
+class IntArray : public HeapValue {
+ public:
+  static const ValueType kType = Value::INT_ARRAY;
+
+  // ---------------------------------------------------------------------------
+  // Factory methods
+
+  // Copies the given integers into a new array.
+  static IntArray* New(Store* store, uint64 size, const int64* values);
+
+  // Allocates a new array with uninitialized elements.
+  static IntArray* NewUninitialized(Store* store, uint64 size);
+
+  // Builds an array from a list of integers, terminated by nil.
+  // @returns The new array, or NULL if the value is not a determined list
+  //     of integers that fit in int64.
+  static IntArray* FromList(Store* store, Value list);
+
+  // Builds an array from the elements of a tuple of integers.
+  // @returns The new array, or NULL if the value is not a determined tuple
+  //     of integers that fit in int64.
+  static IntArray* FromTuple(Store* store, Value tuple);
+
+  // ---------------------------------------------------------------------------
+  // IntArray specific interface
+
+  uint64 size() const { return size_; }
+  const int64* values() const { return values_; }
+  int64* mutable_values() { return values_; }
+  int64 Get(uint64 index) const {
+    CHECK_LT(index, size_);
+    return values_[index];
+  }
+
+  // @returns The list of the integers in this array.
+  Value ToList(Store* store) const;
+
+  // @returns The tuple label(I1 ... In), or the label itself if empty.
+  Value ToTuple(Store* store, Value label) const;
+
+  // ---------------------------------------------------------------------------
+  // Value API
+  virtual ValueType type() const throw() { return kType; }
+  virtual bool UnifyWith(UnificationContext* context, Value value);
+  virtual bool Equals(EqualityContext* context, Value value);
+  virtual bool StructuralHash(uint32* hash);
+  virtual HeapValue* MoveInternal(Store* store);
+
+  // ---------------------------------------------------------------------------
+  // Serialization
+  virtual void ToASCII(ToASCIIContext* context, string* repr);
+  virtual void ToProtoBuf(oz_pb::Value* pb);
+
+ private:  // ------------------------------------------------------------------
+
+  explicit IntArray(uint64 size)
+      : size_(size) {
+  }
+
+  virtual ~IntArray() {}
+
+  // ---------------------------------------------------------------------------
+  // Memory layout
+
+  const uint64 size_;
+  int64 values_[];
+};
+
+// -----------------------------------------------------------------------------
+
+class FloatArray : public HeapValue {
+ public:
+  static const ValueType kType = Value::FLOAT_ARRAY;
+
+  // ---------------------------------------------------------------------------
+  // Factory methods
+
+  // Copies the given floats into a new array.
+  static FloatArray* New(Store* store, uint64 size, const double* values);
+
+  // Allocates a new array with uninitialized elements.
+  static FloatArray* NewUninitialized(Store* store, uint64 size);
+
+  // Builds an array from a list of floats, terminated by nil.
+  // @returns The new array, or NULL if the value is not a determined list
+  //     of floats.
+  static FloatArray* FromList(Store* store, Value list);
+
+  // Builds an array from the elements of a tuple of floats.
+  // @returns The new array, or NULL if the value is not a determined tuple
+  //     of floats.
+  static FloatArray* FromTuple(Store* store, Value tuple);
+
+  // ---------------------------------------------------------------------------
+  // FloatArray specific interface
+
+  uint64 size() const { return size_; }
+  const double* values() const { return values_; }
+  double* mutable_values() { return values_; }
+  double Get(uint64 index) const {
+    CHECK_LT(index, size_);
+    return values_[index];
+  }
+
+  // @returns The list of the floats in this array.
+  Value ToList(Store* store) const;
+
+  // @returns The tuple label(F1 ... Fn), or the label itself if empty.
+  Value ToTuple(Store* store, Value label) const;
+
+  // ---------------------------------------------------------------------------
+  // Value API
+  virtual ValueType type() const throw() { return kType; }
+  virtual bool UnifyWith(UnificationContext* context, Value value);
+  virtual bool Equals(EqualityContext* context, Value value);
+  virtual bool StructuralHash(uint32* hash);
+  virtual HeapValue* MoveInternal(Store* store);
+
+  // ---------------------------------------------------------------------------
+  // Serialization
+  virtual void ToASCII(ToASCIIContext* context, string* repr);
+  virtual void ToProtoBuf(oz_pb::Value* pb);
+
+ private:  // ------------------------------------------------------------------
+
+  explicit FloatArray(uint64 size)
+      : size_(size) {
+  }
+
+  virtual ~FloatArray() {}
+
+  // ---------------------------------------------------------------------------
+  // Memory layout
+
+  const uint64 size_;
+  double values_[];
+};
+
+// -----------------------------------------------------------------------------
+
+}  // namespace store
+
+#endif  // STORE_NUMERIC_ARRAY_H_
@@ -0,0 +1,335 @@
+// Tests for numeric arrays and their kernels.
+#include "store/values.h"
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+#include <gtest/gtest.h>
+
+#include "store/engine.h"
+#include "store/numeric_kernels.h"
+
+namespace store {
+
+const uint64 kStoreSize = 1024 * 1024;
+
+class NumericArrayTest : public testing::Test {
+ protected:
+  NumericArrayTest()
+      : store_(kStoreSize) {
+  }
+
+  // Runs the native with the given parameters, in a new thread.
+  // @returns The value of the last parameter.
+  Value RunNative(const string& name, uint64 nparams, const Value* params) {
+    Value result = New::Free(&store_);
+    Array* array = Array::New(&store_, nparams + 1, result);
+    for (uint64 i = 0; i < nparams; ++i)
+      array->Assign(i, params[i]);
+
+    shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+    code->push_back(Bytecode(Bytecode::CALL_NATIVE,
+                             Operand(Value(Atom::Get(name))),
+                             Operand(Value(array))));
+    code->push_back(Bytecode(Bytecode::RETURN));
+    Closure* proc = Closure::New(&store_, code, 0, 0, 0);
+
+    Engine engine;
+    New::Thread(&store_, &engine, proc, Array::EmptyArray, &store_);
+    engine.Run();
+    return result.Deref();
+  }
+
+  StaticStore store_;
+};
+
+TEST_F(NumericArrayTest, KernelsMatchGeneric) {
+  const vector<const NumericKernels*> all_kernels =
+      GetSupportedNumericKernels();
+  ASSERT_LE(1UL, all_kernels.size());
+  const NumericKernels& generic = *all_kernels[0];
+  EXPECT_STREQ("generic", generic.name);
+
+  // Sizes that are not multiples of the vector width exercise the tails.
+  const uint64 kMaxSize = 37;
+  vector<double> floats1(kMaxSize), floats2(kMaxSize);
+  vector<int64> ints1(kMaxSize), ints2(kMaxSize);
+  for (uint64 i = 0; i < kMaxSize; ++i) {
+    floats1[i] = (i * 7919 % 101) / 7.0 - 5.0;
+    floats2[i] = (i * 104729 % 97) / 3.0 - 10.0;
+    ints1[i] = static_cast<int64>(i * 7919 % 1009) - 500;
+    ints2[i] = static_cast<int64>(i * 104729 % 997) - 400;
+  }
+
+  for (const NumericKernels* kernels : all_kernels) {
+    SCOPED_TRACE(kernels->name);
+    for (uint64 size = 0; size <= kMaxSize; ++size) {
+      SCOPED_TRACE(size);
+      EXPECT_NEAR(generic.float_sum(floats1.data(), size),
+                  kernels->float_sum(floats1.data(), size), 1e-9);
+      EXPECT_NEAR(generic.float_dot(floats1.data(), floats2.data(), size),
+                  kernels->float_dot(floats1.data(), floats2.data(), size),
+                  1e-9);
+
+      vector<double> expected(size), actual(size);
+      generic.float_add(floats1.data(), floats2.data(), expected.data(), size);
+      kernels->float_add(floats1.data(), floats2.data(), actual.data(), size);
+      EXPECT_EQ(expected, actual);
+      generic.float_multiply(floats1.data(), floats2.data(),
+                             expected.data(), size);
+      kernels->float_multiply(floats1.data(), floats2.data(),
+                              actual.data(), size);
+      EXPECT_EQ(expected, actual);
+      generic.float_scale(floats1.data(), 1.5, expected.data(), size);
+      kernels->float_scale(floats1.data(), 1.5, actual.data(), size);
+      EXPECT_EQ(expected, actual);
+
+      int64 expected_sum = 0, actual_sum = 0;
+      EXPECT_TRUE(generic.int_sum(ints1.data(), size, &expected_sum));
+      EXPECT_TRUE(kernels->int_sum(ints1.data(), size, &actual_sum));
+      EXPECT_EQ(expected_sum, actual_sum);
+
+      vector<int64> expected_ints(size), actual_ints(size);
+      EXPECT_TRUE(generic.int_add(ints1.data(), ints2.data(),
+                                  expected_ints.data(), size));
+      EXPECT_TRUE(kernels->int_add(ints1.data(), ints2.data(),
+                                   actual_ints.data(), size));
+      EXPECT_EQ(expected_ints, actual_ints);
+
+      if (size == 0) continue;
+      EXPECT_EQ(generic.float_min(floats1.data(), size),
+                kernels->float_min(floats1.data(), size));
+      EXPECT_EQ(generic.float_max(floats1.data(), size),
+                kernels->float_max(floats1.data(), size));
+      EXPECT_EQ(generic.int_min(ints1.data(), size),
+                kernels->int_min(ints1.data(), size));
+      EXPECT_EQ(generic.int_max(ints1.data(), size),
+                kernels->int_max(ints1.data(), size));
+    }
+  }
+}
+
+TEST_F(NumericArrayTest, KernelsReportOverflow) {
+  const int64 kMax = std::numeric_limits<int64>::max();
+  const int64 kMin = std::numeric_limits<int64>::min();
+  // The overflowing pair sits in a vector lane, not in the tail.
+  const int64 ints1[5] = { 1, 2, 3, kMax, 4 };
+  const int64 ints2[5] = { 1, 2, 3, 1, 4 };
+  const int64 mins[5] = { kMin, kMin, 0, 0, 0 };
+
+  for (const NumericKernels* kernels : GetSupportedNumericKernels()) {
+    SCOPED_TRACE(kernels->name);
+    int64 sum;
+    EXPECT_FALSE(kernels->int_sum(ints1, 5, &sum));
+    EXPECT_FALSE(kernels->int_sum(mins, 5, &sum));
+    int64 result[5];
+    EXPECT_FALSE(kernels->int_add(ints1, ints2, result, 5));
+    EXPECT_TRUE(kernels->int_add(ints1, ints2, result, 3));
+    EXPECT_EQ(kMin, kernels->int_min(mins, 5));
+    EXPECT_EQ(kMax, kernels->int_max(ints1, 5));
+  }
+
+  int64 result[5];
+  EXPECT_FALSE(IntMultiply(ints1, ints1, result, 5));
+  EXPECT_FALSE(IntScale(ints1, 2, result, 5));
+  EXPECT_FALSE(IntPrefixSum(ints1, result, 5));
+  EXPECT_TRUE(IntPrefixSum(ints1, result, 3));
+  EXPECT_EQ(6, result[2]);
+}
+
+TEST_F(NumericArrayTest, Conversions) {
+  const int64 ints[3] = { 1, -2, kSmallIntMax + 1 };
+  IntArray* array = IntArray::New(&store_, 3, ints);
+  EXPECT_EQ(3UL, array->size());
+  EXPECT_EQ(
+      (boost::format("<IntArray 1 -2 %d>") % (kSmallIntMax + 1)).str(),
+      Value(array).ToString());
+
+  // Integers outside the small integer range are boxed.
+  Value list = array->ToList(&store_);
+  EXPECT_EQ(Value::INTEGER, list.TupleGet(1).TupleGet(1).TupleGet(0).type());
+  IntArray* from_list = IntArray::FromList(&store_, list);
+  ASSERT_TRUE(from_list != NULL);
+  EXPECT_TRUE(Equals(array, from_list));
+
+  Value tuple = array->ToTuple(&store_, KAtomTuple());
+  EXPECT_EQ(Value::TUPLE, tuple.type());
+  IntArray* from_tuple = IntArray::FromTuple(&store_, tuple);
+  ASSERT_TRUE(from_tuple != NULL);
+  EXPECT_TRUE(Equals(array, from_tuple));
+
+  IntArray* empty = IntArray::FromList(&store_, KAtomNil());
+  ASSERT_TRUE(empty != NULL);
+  EXPECT_EQ(0UL, empty->size());
+  EXPECT_EQ(Value(KAtomTuple()), empty->ToTuple(&store_, KAtomTuple()));
+
+  Value values[2] = { New::Float(&store_, 1.5), New::Float(&store_, 1e300) };
+  Value floats = New::List(&store_, 2, values);
+  FloatArray* float_array = FloatArray::FromList(&store_, floats);
+  ASSERT_TRUE(float_array != NULL);
+  EXPECT_EQ(1e300, float_array->Get(1));
+  EXPECT_TRUE(Equals(floats, float_array->ToList(&store_)));
+
+  // Not numbers of the right type.
+  EXPECT_TRUE(IntArray::FromList(&store_, floats) == NULL);
+  EXPECT_TRUE(FloatArray::FromTuple(&store_, tuple) == NULL);
+
+  // Unterminated list.
+  Value stream = New::List(&store_, Value::Integer(1), New::Free(&store_));
+  EXPECT_TRUE(IntArray::FromList(&store_, stream) == NULL);
+}
+
+TEST_F(NumericArrayTest, ToProtoBuf) {
+  // Numeric arrays serialize as lists of numbers.
+  const int64 ints[2] = { 1, -2 };
+  oz_pb::Value int_pb;
+  IntArray::New(&store_, 2, ints)->ToProtoBuf(&int_pb);
+  ASSERT_EQ(2, int_pb.list().element_size());
+  EXPECT_EQ(oz_pb::Primitive::INTEGER,
+            int_pb.list().element(1).primitive().type());
+  EXPECT_EQ(-2, int_pb.list().element(1).primitive().integer());
+
+  const double floats[3] = { 1.5, -0.0, 1e300 };
+  oz_pb::Value float_pb;
+  FloatArray::New(&store_, 3, floats)->ToProtoBuf(&float_pb);
+  ASSERT_EQ(3, float_pb.list().element_size());
+  for (int i = 0; i < 3; ++i) {
+    const oz_pb::Primitive& primitive = float_pb.list().element(i).primitive();
+    EXPECT_EQ(oz_pb::Primitive::FLOAT, primitive.type());
+    EXPECT_EQ(floats[i], primitive.real());
+  }
+  EXPECT_TRUE(std::signbit(float_pb.list().element(1).primitive().real()));
+  EXPECT_FALSE(float_pb.has_primitive());
+
+  oz_pb::Value empty_pb;
+  FloatArray::New(&store_, 0, floats)->ToProtoBuf(&empty_pb);
+  EXPECT_TRUE(empty_pb.has_list());
+  EXPECT_EQ(0, empty_pb.list().element_size());
+
+  // As the elements of a list of boxed floats.
+  const Value boxed = New::Float(&store_, 1e300);
+  ASSERT_TRUE(boxed.IsA<Float>());
+  oz_pb::Value boxed_pb;
+  boxed.as<Float>()->ToProtoBuf(&boxed_pb);
+  EXPECT_EQ(oz_pb::Primitive::FLOAT, boxed_pb.primitive().type());
+  EXPECT_EQ(1e300, boxed_pb.primitive().real());
+}
+
+TEST_F(NumericArrayTest, Unify) {
+  const double floats[3] = { 0.0, 1.0, 2.0 };
+  const double floats2[3] = { -0.0, 1.0, 2.0 };
+  Value array1 = FloatArray::New(&store_, 3, floats);
+  Value array2 = FloatArray::New(&store_, 3, floats2);
+  Value array3 = FloatArray::New(&store_, 2, floats);
+  EXPECT_TRUE(Unify(array1, array2));
+  EXPECT_FALSE(Unify(array1, array3));
+
+  const int64 ints[3] = { 0, 1, 2 };
+  EXPECT_FALSE(Unify(array1, IntArray::New(&store_, 3, ints)));
+  EXPECT_TRUE(Equals(IntArray::New(&store_, 3, ints),
+                     IntArray::New(&store_, 3, ints)));
+
+  StaticStore store2(kStoreSize);
+  Value moved = array1.Move(&store2);
+  EXPECT_TRUE(Equals(array2, moved));
+}
+
+TEST_F(NumericArrayTest, Natives) {
+  Value ints[5];
+  for (int i = 0; i < 5; ++i) ints[i] = Value::Integer(i + 1);
+  Value list = New::List(&store_, 5, ints);
+
+  Value array = RunNative("int_array", 1, &list);
+  ASSERT_EQ(Value::INT_ARRAY, array.type());
+  EXPECT_EQ("15", RunNative("array_sum", 1, &array).ToString());
+  EXPECT_EQ("1", RunNative("array_min", 1, &array).ToString());
+  EXPECT_EQ("5", RunNative("array_max", 1, &array).ToString());
+  EXPECT_EQ("<IntArray 1 3 6 10 15>",
+            RunNative("array_prefix_sum", 1, &array).ToString());
+
+  Value pair[2] = { array, array };
+  EXPECT_EQ("55", RunNative("array_dot", 2, pair).ToString());
+  EXPECT_EQ("<IntArray 2 4 6 8 10>",
+            RunNative("array_add", 2, pair).ToString());
+  EXPECT_EQ("<IntArray 1 4 9 16 25>",
+            RunNative("array_multiply", 2, pair).ToString());
+
+  Value scale[2] = { array, Value::Integer(3) };
+  EXPECT_EQ("<IntArray 3 6 9 12 15>",
+            RunNative("array_scale", 2, scale).ToString());
+  EXPECT_TRUE(
+      Equals(list, RunNative("array_to_list", 1, &array)));
+
+  // Sums that overflow int64 are exact.
+  const int64 big[2] = { std::numeric_limits<int64>::max(), 1 };
+  Value big_array = IntArray::New(&store_, 2, big);
+  mpz_class expected(std::numeric_limits<int64>::max());
+  expected += 1;
+  EXPECT_TRUE(Equals(New::Integer(&store_, expected),
+                     RunNative("array_sum", 1, &big_array)));
+
+  // Invalid operands: the result remains free.
+  Value mixed[2] = { array, FloatArray::New(&store_, 0, NULL) };
+  EXPECT_FALSE(RunNative("array_add", 2, mixed).IsDetermined());
+
+  Value floats[3] = {
+    New::Float(&store_, 0.5),
+    New::Float(&store_, 1.5),
+    New::Float(&store_, 2.0),
+  };
+  Value tuple = New::Tuple(&store_, 3, floats);
+  Value float_array = RunNative("float_array", 1, &tuple);
+  ASSERT_EQ(Value::FLOAT_ARRAY, float_array.type());
+  EXPECT_EQ("4.000000", RunNative("array_sum", 1, &float_array).ToString());
+  Value double_it[2] = { float_array, New::Float(&store_, 2.0) };
+  EXPECT_EQ("<FloatArray 1.000000 3.000000 4.000000>",
+            RunNative("array_scale", 2, double_it).ToString());
+}
+
+// thread {Wait Sum} end {ArraySum Array Sum}
+TEST_F(NumericArrayTest, NativeResultWakesUpThreads) {
+  const int64 values[3] = { 1, 2, 3 };
+  const Value array = IntArray::New(&store_, 3, values);
+  const Value sum = New::Free(&store_);
+  const Value doubled = New::Free(&store_);
+  Engine engine;
+
+  // p1 = p0 + p0, suspended until p0 is bound.
+  shared_ptr<vector<Bytecode> > wait_code(new vector<Bytecode>);
+  wait_code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD,
+               Operand(Register(Register::LOCAL, 0)),
+               Operand(Register(Register::PARAM, 0)),
+               Operand(Register(Register::PARAM, 0))));
+  wait_code->push_back(
+      Bytecode(Bytecode::UNIFY,
+               Operand(Register(Register::PARAM, 1)),
+               Operand(Register(Register::LOCAL, 0))));
+  wait_code->push_back(Bytecode(Bytecode::RETURN));
+  Array* const wait_params = Array::New(&store_, 2, sum);
+  wait_params->Assign(1, doubled);
+  New::Thread(&store_, &engine,
+              Closure::New(&store_, wait_code, 2, 1, 0), wait_params,
+              &store_);
+  engine.Run();
+  ASSERT_FALSE(doubled.Deref().IsDetermined());
+
+  Array* const params = Array::New(&store_, 2, array);
+  params->Assign(1, sum);
+  shared_ptr<vector<Bytecode> > call_code(new vector<Bytecode>);
+  call_code->push_back(Bytecode(Bytecode::CALL_NATIVE,
+                                Operand(Value(Atom::Get("array_sum"))),
+                                Operand(Value(params))));
+  call_code->push_back(Bytecode(Bytecode::RETURN));
+  New::Thread(&store_, &engine, Closure::New(&store_, call_code, 0, 0, 0),
+              Array::EmptyArray, &store_);
+  engine.Run();
+  EXPECT_EQ("6", sum.Deref().ToString());
+  EXPECT_EQ("12", doubled.Deref().ToString());
+}
+
+}  // namespace store
@@ -0,0 +1,507 @@
+#include "store/numeric_kernels.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace store {
+
+namespace {
+
+// -----------------------------------------------------------------------------
+// Portable kernels
+
+double GenericFloatSum(const double* values, uint64 size) {
+  double sum = 0.0;
+  for (uint64 i = 0; i < size; ++i) sum += values[i];
+  return sum;
+}
+
+double GenericFloatDot(const double* values1, const double* values2,
+                       uint64 size) {
+  double dot = 0.0;
+  for (uint64 i = 0; i < size; ++i) dot += values1[i] * values2[i];
+  return dot;
+}
+
+double GenericFloatMin(const double* values, uint64 size) {
+  double min = values[0];
+  for (uint64 i = 1; i < size; ++i) min = std::min(min, values[i]);
+  return min;
+}
+
+double GenericFloatMax(const double* values, uint64 size) {
+  double max = values[0];
+  for (uint64 i = 1; i < size; ++i) max = std::max(max, values[i]);
+  return max;
+}
+
+void GenericFloatAdd(const double* values1, const double* values2,
+                     double* result, uint64 size) {
+  for (uint64 i = 0; i < size; ++i) result[i] = values1[i] + values2[i];
+}
+
+void GenericFloatMultiply(const double* values1, const double* values2,
+                          double* result, uint64 size) {
+  for (uint64 i = 0; i < size; ++i) result[i] = values1[i] * values2[i];
+}
+
+void GenericFloatScale(const double* values, double factor,
+                       double* result, uint64 size) {
+  for (uint64 i = 0; i < size; ++i) result[i] = values[i] * factor;
+}
+
+bool GenericIntSum(const int64* values, uint64 size, int64* sum) {
+  int64 total = 0;
+  for (uint64 i = 0; i < size; ++i)
+    if (__builtin_add_overflow(total, values[i], &total)) return false;
+  *sum = total;
+  return true;
+}
+
+bool GenericIntAdd(const int64* values1, const int64* values2,
+                   int64* result, uint64 size) {
+  for (uint64 i = 0; i < size; ++i)
+    if (__builtin_add_overflow(values1[i], values2[i], &result[i]))
+      return false;
+  return true;
+}
+
+int64 GenericIntMin(const int64* values, uint64 size) {
+  int64 min = values[0];
+  for (uint64 i = 1; i < size; ++i) min = std::min(min, values[i]);
+  return min;
+}
+
+int64 GenericIntMax(const int64* values, uint64 size) {
+  int64 max = values[0];
+  for (uint64 i = 1; i < size; ++i) max = std::max(max, values[i]);
+  return max;
+}
+
+const NumericKernels kGenericKernels = {
+  "generic",
+  GenericFloatSum,
+  GenericFloatDot,
+  GenericFloatMin,
+  GenericFloatMax,
+  GenericFloatAdd,
+  GenericFloatMultiply,
+  GenericFloatScale,
+  GenericIntSum,
+  GenericIntAdd,
+  GenericIntMin,
+  GenericIntMax,
+};
+
+#if defined(__x86_64__)
+
+// -----------------------------------------------------------------------------
+// SSE2 kernels: 2 lanes of 64 bits.
+//
+// SSE2 is part of x86-64, these are always available.
+// 64 bits integer comparisons require SSE4.2: min/max remain portable.
+
+double SSE2FloatSum(const double* values, uint64 size) {
+  __m128d acc = _mm_setzero_pd();
+  uint64 i = 0;
+  for (; i + 2 <= size; i += 2)
+    acc = _mm_add_pd(acc, _mm_loadu_pd(values + i));
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  double sum = lanes[0] + lanes[1];
+  for (; i < size; ++i) sum += values[i];
+  return sum;
+}
+
+double SSE2FloatDot(const double* values1, const double* values2,
+                    uint64 size) {
+  __m128d acc = _mm_setzero_pd();
+  uint64 i = 0;
+  for (; i + 2 <= size; i += 2)
+    acc = _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(values1 + i),
+                                     _mm_loadu_pd(values2 + i)));
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  double dot = lanes[0] + lanes[1];
+  for (; i < size; ++i) dot += values1[i] * values2[i];
+  return dot;
+}
+
+double SSE2FloatMin(const double* values, uint64 size) {
+  if (size < 2) return values[0];
+  __m128d acc = _mm_loadu_pd(values);
+  uint64 i = 2;
+  for (; i + 2 <= size; i += 2)
+    acc = _mm_min_pd(acc, _mm_loadu_pd(values + i));
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  double min = std::min(lanes[0], lanes[1]);
+  for (; i < size; ++i) min = std::min(min, values[i]);
+  return min;
+}
+
+double SSE2FloatMax(const double* values, uint64 size) {
+  if (size < 2) return values[0];
+  __m128d acc = _mm_loadu_pd(values);
+  uint64 i = 2;
+  for (; i + 2 <= size; i += 2)
+    acc = _mm_max_pd(acc, _mm_loadu_pd(values + i));
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  double max = std::max(lanes[0], lanes[1]);
+  for (; i < size; ++i) max = std::max(max, values[i]);
+  return max;
+}
+
+void SSE2FloatAdd(const double* values1, const double* values2,
+                  double* result, uint64 size) {
+  uint64 i = 0;
+  for (; i + 2 <= size; i += 2)
+    _mm_storeu_pd(result + i, _mm_add_pd(_mm_loadu_pd(values1 + i),
+                                         _mm_loadu_pd(values2 + i)));
+  for (; i < size; ++i) result[i] = values1[i] + values2[i];
+}
+
+void SSE2FloatMultiply(const double* values1, const double* values2,
+                       double* result, uint64 size) {
+  uint64 i = 0;
+  for (; i + 2 <= size; i += 2)
+    _mm_storeu_pd(result + i, _mm_mul_pd(_mm_loadu_pd(values1 + i),
+                                         _mm_loadu_pd(values2 + i)));
+  for (; i < size; ++i) result[i] = values1[i] * values2[i];
+}
+
+void SSE2FloatScale(const double* values, double factor,
+                    double* result, uint64 size) {
+  const __m128d factors = _mm_set1_pd(factor);
+  uint64 i = 0;
+  for (; i + 2 <= size; i += 2)
+    _mm_storeu_pd(result + i, _mm_mul_pd(_mm_loadu_pd(values + i), factors));
+  for (; i < size; ++i) result[i] = values[i] * factor;
+}
+
+// Signed overflow of sum = a + b happened iff the sign of sum differs from
+// the signs of both a and b: the sign bit of (a ^ sum) & (b ^ sum) is set.
+
+bool SSE2IntSum(const int64* values, uint64 size, int64* sum) {
+  __m128i acc = _mm_setzero_si128();
+  __m128i overflow = _mm_setzero_si128();
+  uint64 i = 0;
+  for (; i + 2 <= size; i += 2) {
+    const __m128i v = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(values + i));
+    const __m128i r = _mm_add_epi64(acc, v);
+    overflow = _mm_or_si128(
+        overflow,
+        _mm_and_si128(_mm_xor_si128(acc, r), _mm_xor_si128(v, r)));
+    acc = r;
+  }
+  if (_mm_movemask_pd(_mm_castsi128_pd(overflow)) != 0) return false;
+
+  int64 lanes[2];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+  int64 total = lanes[0];
+  if (__builtin_add_overflow(total, lanes[1], &total)) return false;
+  for (; i < size; ++i)
+    if (__builtin_add_overflow(total, values[i], &total)) return false;
+  *sum = total;
+  return true;
+}
+
+bool SSE2IntAdd(const int64* values1, const int64* values2,
+                int64* result, uint64 size) {
+  __m128i overflow = _mm_setzero_si128();
+  uint64 i = 0;
+  for (; i + 2 <= size; i += 2) {
+    const __m128i a = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(values1 + i));
+    const __m128i b = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(values2 + i));
+    const __m128i r = _mm_add_epi64(a, b);
+    overflow = _mm_or_si128(
+        overflow, _mm_and_si128(_mm_xor_si128(a, r), _mm_xor_si128(b, r)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), r);
+  }
+  if (_mm_movemask_pd(_mm_castsi128_pd(overflow)) != 0) return false;
+  for (; i < size; ++i)
+    if (__builtin_add_overflow(values1[i], values2[i], &result[i]))
+      return false;
+  return true;
+}
+
+const NumericKernels kSSE2Kernels = {
+  "sse2",
+  SSE2FloatSum,
+  SSE2FloatDot,
+  SSE2FloatMin,
+  SSE2FloatMax,
+  SSE2FloatAdd,
+  SSE2FloatMultiply,
+  SSE2FloatScale,
+  SSE2IntSum,
+  SSE2IntAdd,
+  GenericIntMin,
+  GenericIntMax,
+};
+
+// -----------------------------------------------------------------------------
+// AVX2 kernels: 4 lanes of 64 bits.
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 double HorizontalSum(__m256d acc) {
+  double lanes[4];
+  _mm256_storeu_pd(lanes, acc);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+AVX2 double AVX2FloatSum(const double* values, uint64 size) {
+  __m256d acc = _mm256_setzero_pd();
+  uint64 i = 0;
+  for (; i + 4 <= size; i += 4)
+    acc = _mm256_add_pd(acc, _mm256_loadu_pd(values + i));
+  double sum = HorizontalSum(acc);
+  for (; i < size; ++i) sum += values[i];
+  return sum;
+}
+
+AVX2 double AVX2FloatDot(const double* values1, const double* values2,
+                         uint64 size) {
+  __m256d acc = _mm256_setzero_pd();
+  uint64 i = 0;
+  for (; i + 4 <= size; i += 4)
+    acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(values1 + i),
+                                           _mm256_loadu_pd(values2 + i)));
+  double dot = HorizontalSum(acc);
+  for (; i < size; ++i) dot += values1[i] * values2[i];
+  return dot;
+}
+
+AVX2 double AVX2FloatMin(const double* values, uint64 size) {
+  if (size < 4) return GenericFloatMin(values, size);
+  __m256d acc = _mm256_loadu_pd(values);
+  uint64 i = 4;
+  for (; i + 4 <= size; i += 4)
+    acc = _mm256_min_pd(acc, _mm256_loadu_pd(values + i));
+  double lanes[4];
+  _mm256_storeu_pd(lanes, acc);
+  double min = GenericFloatMin(lanes, 4);
+  for (; i < size; ++i) min = std::min(min, values[i]);
+  return min;
+}
+
+AVX2 double AVX2FloatMax(const double* values, uint64 size) {
+  if (size < 4) return GenericFloatMax(values, size);
+  __m256d acc = _mm256_loadu_pd(values);
+  uint64 i = 4;
+  for (; i + 4 <= size; i += 4)
+    acc = _mm256_max_pd(acc, _mm256_loadu_pd(values + i));
+  double lanes[4];
+  _mm256_storeu_pd(lanes, acc);
+  double max = GenericFloatMax(lanes, 4);
+  for (; i < size; ++i) max = std::max(max, values[i]);
+  return max;
+}
+
+AVX2 void AVX2FloatAdd(const double* values1, const double* values2,
+                       double* result, uint64 size) {
+  uint64 i = 0;
+  for (; i + 4 <= size; i += 4)
+    _mm256_storeu_pd(result + i,
+                     _mm256_add_pd(_mm256_loadu_pd(values1 + i),
+                                   _mm256_loadu_pd(values2 + i)));
+  for (; i < size; ++i) result[i] = values1[i] + values2[i];
+}
+
+AVX2 void AVX2FloatMultiply(const double* values1, const double* values2,
+                            double* result, uint64 size) {
+  uint64 i = 0;
+  for (; i + 4 <= size; i += 4)
+    _mm256_storeu_pd(result + i,
+                     _mm256_mul_pd(_mm256_loadu_pd(values1 + i),
+                                   _mm256_loadu_pd(values2 + i)));
+  for (; i < size; ++i) result[i] = values1[i] * values2[i];
+}
+
+AVX2 void AVX2FloatScale(const double* values, double factor,
+                         double* result, uint64 size) {
+  const __m256d factors = _mm256_set1_pd(factor);
+  uint64 i = 0;
+  for (; i + 4 <= size; i += 4)
+    _mm256_storeu_pd(result + i,
+                     _mm256_mul_pd(_mm256_loadu_pd(values + i), factors));
+  for (; i < size; ++i) result[i] = values[i] * factor;
+}
+
+AVX2 bool AVX2IntSum(const int64* values, uint64 size, int64* sum) {
+  __m256i acc = _mm256_setzero_si256();
+  __m256i overflow = _mm256_setzero_si256();
+  uint64 i = 0;
+  for (; i + 4 <= size; i += 4) {
+    const __m256i v = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(values + i));
+    const __m256i r = _mm256_add_epi64(acc, v);
+    overflow = _mm256_or_si256(
+        overflow,
+        _mm256_and_si256(_mm256_xor_si256(acc, r), _mm256_xor_si256(v, r)));
+    acc = r;
+  }
+  if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow)) != 0) return false;
+
+  int64 lanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+  int64 total = 0;
+  for (int lane = 0; lane < 4; ++lane)
+    if (__builtin_add_overflow(total, lanes[lane], &total)) return false;
+  for (; i < size; ++i)
+    if (__builtin_add_overflow(total, values[i], &total)) return false;
+  *sum = total;
+  return true;
+}
+
+AVX2 bool AVX2IntAdd(const int64* values1, const int64* values2,
+                     int64* result, uint64 size) {
+  __m256i overflow = _mm256_setzero_si256();
+  uint64 i = 0;
+  for (; i + 4 <= size; i += 4) {
+    const __m256i a = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(values1 + i));
+    const __m256i b = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(values2 + i));
+    const __m256i r = _mm256_add_epi64(a, b);
+    overflow = _mm256_or_si256(
+        overflow,
+        _mm256_and_si256(_mm256_xor_si256(a, r), _mm256_xor_si256(b, r)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i), r);
+  }
+  if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow)) != 0) return false;
+  for (; i < size; ++i)
+    if (__builtin_add_overflow(values1[i], values2[i], &result[i]))
+      return false;
+  return true;
+}
+
+AVX2 int64 AVX2IntMin(const int64* values, uint64 size) {
+  if (size < 4) return GenericIntMin(values, size);
+  __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values));
+  uint64 i = 4;
+  for (; i + 4 <= size; i += 4) {
+    const __m256i v = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(values + i));
+    acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(acc, v));
+  }
+  int64 lanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+  int64 min = GenericIntMin(lanes, 4);
+  for (; i < size; ++i) min = std::min(min, values[i]);
+  return min;
+}
+
+AVX2 int64 AVX2IntMax(const int64* values, uint64 size) {
+  if (size < 4) return GenericIntMax(values, size);
+  __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values));
+  uint64 i = 4;
+  for (; i + 4 <= size; i += 4) {
+    const __m256i v = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(values + i));
+    acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(v, acc));
+  }
+  int64 lanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+  int64 max = GenericIntMax(lanes, 4);
+  for (; i < size; ++i) max = std::max(max, values[i]);
+  return max;
+}
+
+#undef AVX2
+
+const NumericKernels kAVX2Kernels = {
+  "avx2",
+  AVX2FloatSum,
+  AVX2FloatDot,
+  AVX2FloatMin,
+  AVX2FloatMax,
+  AVX2FloatAdd,
+  AVX2FloatMultiply,
+  AVX2FloatScale,
+  AVX2IntSum,
+  AVX2IntAdd,
+  AVX2IntMin,
+  AVX2IntMax,
+};
+
+#endif  // defined(__x86_64__)
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+
+vector<const NumericKernels*> GetSupportedNumericKernels() {
+  vector<const NumericKernels*> kernels;
+  kernels.push_back(&kGenericKernels);
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  kernels.push_back(&kSSE2Kernels);
+  if (__builtin_cpu_supports("avx2"))
+    kernels.push_back(&kAVX2Kernels);
+#endif
+  return kernels;
+}
+
+const NumericKernels& GetNumericKernels() {
+  static const NumericKernels* const kernels =
+      GetSupportedNumericKernels().back();
+  return *kernels;
+}
+
+// -----------------------------------------------------------------------------
+
+bool IntDot(const int64* values1, const int64* values2, uint64 size,
+            int64* dot) {
+  int64 total = 0;
+  for (uint64 i = 0; i < size; ++i) {
+    int64 product;
+    if (__builtin_mul_overflow(values1[i], values2[i], &product)
+        || __builtin_add_overflow(total, product, &total))
+      return false;
+  }
+  *dot = total;
+  return true;
+}
+
+bool IntMultiply(const int64* values1, const int64* values2,
+                 int64* result, uint64 size) {
+  for (uint64 i = 0; i < size; ++i)
+    if (__builtin_mul_overflow(values1[i], values2[i], &result[i]))
+      return false;
+  return true;
+}
+
+bool IntScale(const int64* values, int64 factor, int64* result, uint64 size) {
+  for (uint64 i = 0; i < size; ++i)
+    if (__builtin_mul_overflow(values[i], factor, &result[i]))
+      return false;
+  return true;
+}
+
+bool IntPrefixSum(const int64* values, int64* result, uint64 size) {
+  int64 total = 0;
+  for (uint64 i = 0; i < size; ++i) {
+    if (__builtin_add_overflow(total, values[i], &total)) return false;
+    result[i] = total;
+  }
+  return true;
+}
+
+void FloatPrefixSum(const double* values, double* result, uint64 size) {
+  double total = 0.0;
+  for (uint64 i = 0; i < size; ++i) {
+    total += values[i];
+    result[i] = total;
+  }
+}
+
+}  // namespace store
@@ -0,0 +1,76 @@
+// Bulk kernels on raw numeric buffers, used by IntArray and FloatArray.
+#ifndef STORE_NUMERIC_KERNELS_H_
+#define STORE_NUMERIC_KERNELS_H_
+
+#include <vector>
+using std::vector;
+
+#include "base/basictypes.h"
+
+namespace store {
+
+// -----------------------------------------------------------------------------
+// Table of the kernels with a vectorized implementation.
+//
+// Integer kernels that may overflow int64 report the overflow instead of
+// wrapping around. Vectorized float reductions (sum, dot product) add the
+// elements in a different order than a sequential loop, hence results may
+// differ in the last bits. Min/max of buffers containing NaN are unspecified.
+//
+struct NumericKernels {
+  // Name of the instruction set, e.g. "avx2".
+  const char* name;
+
+  double (*float_sum)(const double* values, uint64 size);
+  double (*float_dot)(const double* values1, const double* values2,
+                      uint64 size);
+
+  // Requires size > 0.
+  double (*float_min)(const double* values, uint64 size);
+  double (*float_max)(const double* values, uint64 size);
+
+  // Elementwise operations: result[i] = values1[i] op values2[i].
+  // The result may alias the operands.
+  void (*float_add)(const double* values1, const double* values2,
+                    double* result, uint64 size);
+  void (*float_multiply)(const double* values1, const double* values2,
+                         double* result, uint64 size);
+  void (*float_scale)(const double* values, double factor,
+                      double* result, uint64 size);
+
+  // @returns False if the sum overflows int64.
+  bool (*int_sum)(const int64* values, uint64 size, int64* sum);
+
+  // @returns False if any element overflows int64.
+  bool (*int_add)(const int64* values1, const int64* values2,
+                  int64* result, uint64 size);
+
+  // Requires size > 0.
+  int64 (*int_min)(const int64* values, uint64 size);
+  int64 (*int_max)(const int64* values, uint64 size);
+};
+
+// @returns The kernels for the best instruction set supported by the CPU.
+//     Selected once, at the first call.
+const NumericKernels& GetNumericKernels();
+
+// @returns The kernels for all the instruction sets supported by the CPU,
+//     starting with the portable implementation.
+vector<const NumericKernels*> GetSupportedNumericKernels();
+
+// -----------------------------------------------------------------------------
+// Kernels without a vectorized implementation.
+
+// @returns False if the result overflows int64.
+bool IntDot(const int64* values1, const int64* values2, uint64 size,
+            int64* dot);
+bool IntMultiply(const int64* values1, const int64* values2,
+                 int64* result, uint64 size);
+bool IntScale(const int64* values, int64 factor, int64* result, uint64 size);
+bool IntPrefixSum(const int64* values, int64* result, uint64 size);
+
+void FloatPrefixSum(const double* values, double* result, uint64 size);
+
+}  // namespace store
+
+#endif  // STORE_NUMERIC_KERNELS_H_
@@ -0,0 +1,173 @@
+// Measures the time the interpreter spends per instruction, for a few common
+// opcodes: register moves, small integer arithmetic, array, cell and record
+// accesses, and allocations.
+// Each opcode is repeated in the body of a counting loop; the time of the
+// empty loop is subtracted. Comparing a release build (-DNDEBUG) with a debug
+// build reports the cost of the debug-only checks, per opcode.
+#include <chrono>
+#include <memory>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "store/engine.h"
+#include "store/values.h"
+
+DEFINE_int64(
+    opcode_loops,
+    500000,
+    "Number of iterations of the loop repeating each opcode."
+);
+
+namespace store {
+
+// Allocating opcodes fill the store: each opcode runs in a new store.
+const uint64 kStoreSize = 1024 * 1024 * 1024;  // 1GB
+
+// Number of copies of the measured instruction in the loop body.
+const int kUnroll = 16;
+
+namespace {
+
+Operand Local(int index) {
+  return Operand(Register(Register::LOCAL, index));
+}
+
+Operand Param(int index) {
+  return Operand(Register(Register::PARAM, index));
+}
+
+Operand Immediate(int64 integer) {
+  return Operand(Value::Integer(integer));
+}
+
+// Parameters of the loop procedure.
+enum {
+  kParamArray,   // An array of 8 small integers
+  kParamRecord,  // The record r(a:1 b:2)
+  kParamCell,    // A cell
+  kNumParams,
+};
+
+// Builds a procedure repeating an instruction kUnroll times per iteration of
+// a loop counting from N down to 0:
+//   l0 := N
+//   l3 := 1
+//   while 0 < l0:
+//     l0 := l0 - 1
+//     body...
+// The measured instructions may use the parameters and l2, l3 and l4.
+// @param body The instruction to repeat, or NULL for an empty loop.
+Closure* NewLoopProc(Store* store, int64 n, const Bytecode* body) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(n)));
+  code->push_back(Bytecode(Bytecode::LOAD, Local(3), Immediate(1)));
+  const int64 loop = code->size();
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(1), Immediate(0), Local(0)));
+  code->push_back(Bytecode(Bytecode::BRANCH_UNLESS, Local(1), Immediate(-1)));
+  const int64 exit_branch = code->size() - 1;
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(0), Local(0),
+               Immediate(1)));
+  if (body != NULL)
+    for (int i = 0; i < kUnroll; ++i)
+      code->push_back(*body);
+  code->push_back(Bytecode(Bytecode::BRANCH, Immediate(loop)));
+  (*code)[exit_branch].operand2 = Immediate(code->size());
+  code->push_back(Bytecode(Bytecode::RETURN));
+  return Closure::New(store, code, kNumParams, 5, 0);
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs the loop repeating an instruction, in a new store.
+// @returns The time spent, in seconds.
+double RunLoop(const Bytecode* body) {
+  StaticStore store(kStoreSize);
+  Closure* const proc = NewLoopProc(&store, FLAGS_opcode_loops, body);
+
+  Array* const params = Array::New(&store, kNumParams, KAtomNil());
+  params->Assign(kParamArray, New::Array(&store, 8, Value::Integer(0)));
+  Value features[] = { Atom::Get("a"), Atom::Get("b") };
+  Value values[] = { Value::Integer(1), Value::Integer(2) };
+  params->Assign(
+      kParamRecord,
+      Record::New(&store, Atom::Get("r"), Arity::Get(2, features), values));
+  params->Assign(kParamCell, New::Cell(&store, Value::Integer(0)));
+
+  Engine engine;
+  const auto start = std::chrono::steady_clock::now();
+  New::Thread(&store, &engine, proc, params, &store);
+  engine.Run();
+  return SecondsSince(start);
+}
+
+struct OpcodeBenchmark {
+  const char* name;
+  Bytecode body;
+};
+
+void OpcodeBenchmarks() {
+  const OpcodeBenchmark benchmarks[] = {
+    { "LOAD local",
+      Bytecode(Bytecode::LOAD, Local(2), Local(3)) },
+    { "LOAD parameter",
+      Bytecode(Bytecode::LOAD, Local(2), Param(kParamRecord)) },
+    { "NUMBER_INT_ADD",
+      Bytecode(Bytecode::NUMBER_INT_ADD, Local(2), Local(3), Local(3)) },
+    { "TEST_EQUALITY",
+      Bytecode(Bytecode::TEST_EQUALITY, Local(2), Local(3), Immediate(1)) },
+    { "ACCESS_ARRAY",
+      Bytecode(Bytecode::ACCESS_ARRAY, Local(2), Param(kParamArray),
+               Immediate(3)) },
+    { "ASSIGN_ARRAY",
+      Bytecode(Bytecode::ASSIGN_ARRAY, Param(kParamArray), Immediate(3),
+               Local(3)) },
+    { "ACCESS_CELL",
+      Bytecode(Bytecode::ACCESS_CELL, Local(2), Param(kParamCell)) },
+    { "ACCESS_RECORD",
+      Bytecode(Bytecode::ACCESS_RECORD, Local(2), Param(kParamRecord),
+               Operand(Atom::Get("b"))) },
+    { "NEW_CELL",
+      Bytecode(Bytecode::NEW_CELL, Local(2), Local(3)) },
+    { "NEW_TUPLE",
+      Bytecode(Bytecode::NEW_TUPLE, Local(2), Immediate(2),
+               Operand(Atom::Get("t"))) },
+  };
+
+  const double empty_loop = RunLoop(NULL);
+  const double ninstructions =
+      static_cast<double>(FLAGS_opcode_loops) * kUnroll;
+  printf("%-16s %.3fs for %ld iterations\n",
+         "empty loop", empty_loop, FLAGS_opcode_loops);
+  for (const OpcodeBenchmark& benchmark : benchmarks) {
+    const double seconds = RunLoop(&benchmark.body);
+    printf("%-16s %.3fs, %.2f ns/instruction\n",
+           benchmark.name, seconds,
+           (seconds - empty_loop) * 1e9 / ninstructions);
+  }
+}
+
+}  // namespace
+
+}  // namespace store
+
+int main(int argc, char** argv) {
+  ::google::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+#ifdef NDEBUG
+  printf("Release build: debug-only checks disabled\n");
+#else
+  printf("Debug build: debug-only checks enabled\n");
+#endif
+  store::OpcodeBenchmarks();
+  return EXIT_SUCCESS;
+}
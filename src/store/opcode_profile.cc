@@ -0,0 +1,49 @@
+#include "store/values.h"
+
+#include <algorithm>
+
+namespace store {
+
+// -----------------------------------------------------------------------------
+// OpcodeProfile
+
+OpcodeProfile::OpcodeProfile() {
+  Reset();
+}
+
+void OpcodeProfile::Reset() {
+  ninstructions_ = 0;
+  nfused_ = 0;
+  pair_counts_.assign(PairIndex(PackedBytecode::PACKED_OPCODE_COUNT, 0), 0);
+}
+
+vector<OpcodeProfile::PairCount> OpcodeProfile::TopFusablePairs(
+    uint64 npairs) const {
+  vector<PairCount> pairs;
+  for (int first = 0; first < PackedBytecode::PACKED_OPCODE_COUNT; ++first) {
+    if (!PackedCode::IsQuickOpcode(first)) continue;
+    for (int second = 0; second < PackedBytecode::PACKED_OPCODE_COUNT;
+         ++second) {
+      const uint64 pair_count = count(first, second);
+      if (pair_count == 0) continue;
+      PairCount pair = { static_cast<uint8>(first),
+                         static_cast<uint8>(second),
+                         pair_count };
+      pairs.push_back(pair);
+    }
+  }
+
+  // Most frequent first, then in opcode order for a stable output.
+  std::sort(pairs.begin(), pairs.end(),
+            [](const PairCount& a, const PairCount& b) {
+              if (a.count != b.count) return a.count > b.count;
+              if (a.first != b.first) return a.first < b.first;
+              return a.second < b.second;
+            });
+  if (pairs.size() > npairs) pairs.resize(npairs);
+  return pairs;
+}
+
+// -----------------------------------------------------------------------------
+
+}  // namespace store
@@ -0,0 +1,83 @@
+// Dynamic profile of the instructions executed by the interpreter
+#ifndef STORE_OPCODE_PROFILE_H_
+#define STORE_OPCODE_PROFILE_H_
+
+#include <vector>
+using std::vector;
+
+#include "base/basictypes.h"
+
+namespace store {
+
+// -----------------------------------------------------------------------------
+// Counts executed instructions and pairs of consecutive instructions, by
+// opcode. Superinstructions count as the instructions they fuse.
+//
+// Used to pick the superinstructions of the interpreter: see
+// store/superinstruction_generator.cc.
+//
+class OpcodeProfile {
+ public:
+  OpcodeProfile();
+
+  // Records the execution of an instruction.
+  // @param previous The instruction executed before, in the same frame.
+  //     NULL when entering a frame.
+  // @param inst The instruction executed.
+  void Record(const PackedBytecode* previous, const PackedBytecode* inst) {
+    ++ninstructions_;
+    if (previous == NULL) return;
+    if (PackedCode::IsSuperOpcode(previous->opcode)) ++nfused_;
+    if (previous + 1 == inst)
+      ++pair_counts_[PairIndex(PackedCode::Unfuse(previous->opcode),
+                               PackedCode::Unfuse(inst->opcode))];
+  }
+
+  // Number of instructions executed.
+  uint64 ninstructions() const { return ninstructions_; }
+
+  // Number of instructions entered from a superinstruction.
+  uint64 nfused() const { return nfused_; }
+
+  // Number of instructions the threaded dispatch dispatches: superinstructions
+  // jump directly into the second instruction.
+  uint64 ndispatches() const { return ninstructions_ - nfused_; }
+
+  // @returns The number of times the instruction 'second' was executed right
+  //     after the instruction 'first'.
+  uint64 count(uint8 first, uint8 second) const {
+    return pair_counts_[PairIndex(first, second)];
+  }
+
+  struct PairCount {
+    uint8 first;
+    uint8 second;
+    uint64 count;
+  };
+
+  // @returns The most frequent pairs that may be fused into a
+  //     superinstruction, most frequent first: pairs starting with a quick
+  //     instruction.
+  vector<PairCount> TopFusablePairs(uint64 npairs) const;
+
+  void Reset();
+
+ private:
+  static uint64 PairIndex(uint8 first, uint8 second) {
+    return first * PackedBytecode::PACKED_OPCODE_COUNT + second;
+  }
+
+  uint64 ninstructions_;
+  uint64 nfused_;
+
+  // Indexed by PairIndex().
+  vector<uint64> pair_counts_;
+
+  DISALLOW_COPY_AND_ASSIGN(OpcodeProfile);
+};
+
+// -----------------------------------------------------------------------------
+
+}  // namespace store
+
+#endif  // STORE_OPCODE_PROFILE_H_
@@ -97,6 +97,7 @@ class OpenRecord : public HeapValue {
   virtual bool UnifyWith(UnificationContext* context, Value other);
   virtual HeapValue* MoveInternal(Store* store);
   virtual bool IsStateless(StatelessnessContext* context);
+  virtual bool StructuralHash(uint32* hash) { return false; }
 
   // ---------------------------------------------------------------------------
   // OpenRecord interface
@@ -104,7 +105,8 @@ class OpenRecord : public HeapValue {
   virtual uint64 OpenRecordWidth();
   virtual bool OpenRecordHas(Value feature);
   virtual Value OpenRecordGet(Value feature);
-  virtual Value OpenRecordClose(Store* store);
+  virtual Value OpenRecordClose(Store* store,
+                                SuspensionList* new_runnable);
 
   virtual Value::ItemIterator* OpenRecordIterItems();
   virtual Value::ValueIterator* OpenRecordIterValues();
@@ -118,6 +120,7 @@ class OpenRecord : public HeapValue {
   virtual uint64 RecordWidth();
   virtual bool RecordHas(Value feature);
   virtual Value RecordGet(Value feature);
+  virtual LookupStatus TryRecordGet(Value feature, Value* value);
 
   virtual Value::ItemIterator* RecordIterItems();
   virtual Value::ValueIterator* RecordIterValues();
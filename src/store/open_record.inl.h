@@ -29,10 +29,12 @@ Value OpenRecord::OpenRecordGet(Value feature) {
 
 // virtual
 inline
-Value OpenRecord::OpenRecordClose(Store* store) {
+Value OpenRecord::OpenRecordClose(Store* store,
+                                  SuspensionList* new_runnable) {
   Value record = GetRecord(store);
-  // TODO: Should act like a unification → wakes suspensions up
-  ref_->BindTo(record);
+  // Binds through Unify(), under the binding lock of the workers if any:
+  // another worker may close the record concurrently.
+  if (!Unify(ref_, record, new_runnable)) return Value();
   return record;
 }
 
@@ -74,6 +76,14 @@ Value OpenRecord::RecordGet(Value feature) {
   throw SuspendThread(ref_->suspensions());
 }
 
+// virtual
+inline
+LookupStatus OpenRecord::TryRecordGet(Value feature, Value* value) {
+  // Closing the open record binds its reference.
+  *value = ref_;
+  return LOOKUP_SUSPENDED;
+}
+
 // virtual
 inline
 Value::ItemIterator* OpenRecord::RecordIterItems() {
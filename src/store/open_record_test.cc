@@ -3,11 +3,16 @@
 #include "store/values.h"
 
 #include <memory>
+#include <mutex>
+#include <vector>
+using std::shared_ptr;
 using std::unique_ptr;
+using std::vector;
 
 #include <gtest/gtest.h>
 
 #include "base/stl-util.h"
+#include "store/engine.h"
 
 namespace store {
 
@@ -140,4 +145,52 @@ TEST_F(OpenRecordTest, API) {
                      New::Arity(&store_, x, y)));
 }
 
+TEST_F(OpenRecordTest, CloseUnderBindingLock) {
+  // Closing binds the open record as a unification does: under the binding
+  // lock of the workers, and again harmlessly.
+  std::mutex lock;
+  set_binding_lock(&lock);
+  OpenRecord* orecord = OpenRecord::New(&store_, Atom::Get("label"));
+  orecord->Set(1, Value::Integer(12));
+  SuspensionList woken;
+  const Value record = Value(orecord).OpenRecordClose(&store_, &woken);
+  EXPECT_TRUE(orecord->IsDetermined());
+  EXPECT_TRUE(Equals(Deref(orecord), record));
+  EXPECT_TRUE(
+      Equals(Value(orecord).OpenRecordClose(&store_, &woken), record));
+  EXPECT_TRUE(woken.empty());
+  set_binding_lock(NULL);
+}
+
+TEST_F(OpenRecordTest, CloseWakesUpThreads) {
+  Engine engine;
+  OpenRecord* orecord = OpenRecord::New(&store_, Atom::Get("label"));
+  orecord->Set(1, Value::Integer(12));
+
+  // p1 = p0.1, suspended until the open-record p0 is closed.
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::ACCESS_RECORD,
+               Operand(Register(Register::LOCAL, 0)),
+               Operand(Register(Register::PARAM, 0)),
+               Operand(Value::Integer(1))));
+  code->push_back(
+      Bytecode(Bytecode::UNIFY,
+               Operand(Register(Register::PARAM, 1)),
+               Operand(Register(Register::LOCAL, 0))));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  const Value field = New::Free(&store_);
+  Array* const params = Array::New(&store_, 2, orecord);
+  params->Assign(1, field);
+  New::Thread(&store_, &engine, Closure::New(&store_, code, 2, 1, 0), params,
+              &store_);
+  engine.Run();
+  ASSERT_FALSE(field.Deref().IsDetermined());
+
+  const Value record = engine.CloseOpenRecord(&store_, orecord);
+  ASSERT_TRUE(record.IsDefined());
+  engine.Run();
+  EXPECT_EQ(12, IntValue(field));
+}
+
 }  // namespace store
@@ -81,7 +81,10 @@ class OzValue {
   }
 
   template <typename T>
-  T* value() { return value().as<T>(); }
+  T* value() {
+    CHECK_EQ(T::kType, type()) << "Unexpected value: " << value().ToString();
+    return value().as<T>();
+  }
 
   // ---------------------------------------------------------------------------
   // Record interface
@@ -118,6 +121,14 @@ class OzValue {
     return arity()->Has(feature.value());
   }
 
+  // Looks a feature up, in a single lookup.
+  // Assigning an OzValue unifies it: the value is returned as a Value.
+  // @param value Returns the value of the feature, when found.
+  // @returns True if the record has the feature.
+  bool TryGet(const char* atom, Value* value) {
+    return value_.TryRecordGet(Atom::Get(atom), value) == LOOKUP_FOUND;
+  }
+
   OzValue operator[](int64 index) {
     return OzValue(value().RecordGet(Value::Integer(index)));
   }
@@ -135,8 +146,8 @@ class OzValue {
   }
 
   int int_val() { return IntValue(value()); }
-  bool bool_val() { return value().as<Boolean>()->value(); }
-  string atom_val() { return value().as<Atom>()->value(); }
+  bool bool_val() { return this->value<Boolean>()->value(); }
+  string atom_val() { return this->value<Atom>()->value(); }
 
   bool operator==(OzValue& other) {
     return store::Equals(value(), other.value());
@@ -0,0 +1,333 @@
+#include "store/values.h"
+
+#include <mutex>
+
+#include "store/engine.h"
+
+namespace store {
+
+// -----------------------------------------------------------------------------
+// RecordAccessCache
+
+void RecordAccessCache::Insert(const Arity* arity, Value feature,
+                               uint32 slot) {
+  // Once full, replaces the polymorphic entries and keeps the first one.
+  const uint64 index = (nfilled_ < kEntries)
+      ? nfilled_
+      : 1 + (nfilled_ - 1) % (kEntries - 1);
+  Entry* const entry = &entries_[index];
+  entry->arity = arity;
+  entry->feature = feature;
+  entry->slot = slot;
+  ++nfilled_;
+}
+
+// -----------------------------------------------------------------------------
+// PackedCode
+
+PackedCode::PackedCode(const vector<Bytecode>& bytecode)
+    : jit_count_(0),
+      jit_compiled_(false),
+      owner_(0) {
+  UnorderedMap<uint64, uint32> constant_map;
+  // Try blocks whose EXN_POP is not packed yet, innermost last.
+  vector<ExnHandler> open_handlers;
+  code_.resize(bytecode.size());
+  unquickened_.resize(bytecode.size(), false);
+  for (uint64 i = 0; i < bytecode.size(); ++i) {
+    const Bytecode& inst = bytecode[i];
+    PackedBytecode* packed = &code_[i];
+    packed->opcode = inst.opcode;
+    packed->operand1 = Pack(inst.operand1, &constant_map);
+    packed->operand2 = Pack(inst.operand2, &constant_map);
+    packed->operand3 = Pack(inst.operand3, &constant_map);
+
+    // Natives not registered yet, or with ids that do not fit in a packed
+    // operand, are looked up by name when called.
+    uint64 native_id;
+    if ((inst.opcode == Bytecode::CALL_NATIVE)
+        && (inst.operand1.type == Operand::IMMEDIATE)
+        && HasType(inst.operand1.value, Value::ATOM)
+        && Engine::FindNativeId(inst.operand1.value.as<Atom>()->value(),
+                                &native_id)
+        && (native_id <= static_cast<uint64>(PackedOperand::kMaxIndex)))
+      packed->operand3 = PackedOperand(PackedOperand::NATIVE, native_id);
+
+    if ((inst.opcode == Bytecode::ACCESS_RECORD)
+        || (inst.opcode == Bytecode::UNIFY_RECORD_FIELD)) {
+      record_cache_index_.resize(bytecode.size(), 0);
+      record_cache_index_[i] = record_caches_.size();
+      record_caches_.push_back(RecordAccessCache());
+    }
+
+    if ((inst.opcode == Bytecode::EXN_PUSH_CATCH)
+        || (inst.opcode == Bytecode::EXN_PUSH_FINALLY)) {
+      CHECK_EQ(Operand::IMMEDIATE, inst.operand1.type)
+          << "Invalid exception handler at CP=" << i;
+      const Value handler = inst.operand1.value.Deref();
+      CHECK(handler.IsSmallInt())
+          << "Invalid exception handler at CP=" << i;
+      ExnHandler entry;
+      entry.kind = (inst.opcode == Bytecode::EXN_PUSH_FINALLY)
+          ? ExnHandler::FINALLY
+          : ExnHandler::CATCH;
+      entry.begin = i + 1;
+      entry.end = 0;
+      entry.handler = IntValue(handler);
+      open_handlers.push_back(entry);
+    }
+
+    if (inst.opcode == Bytecode::EXN_POP) {
+      CHECK(!open_handlers.empty()) << "Unmatched exn_pop at CP=" << i;
+      ExnHandler entry = open_handlers.back();
+      open_handlers.pop_back();
+      entry.end = i;
+      exn_handlers_.push_back(entry);
+      if (entry.kind == ExnHandler::FINALLY) {
+        packed->operand1 =
+            Pack(Operand(Value::Integer(entry.handler)), &constant_map);
+      }
+    }
+  }
+  CHECK(open_handlers.empty()) << "Unmatched exn_push";
+  generic_code_ = code_;
+}
+
+PackedCode::PackedCode(const PackedCode* prototype)
+    : code_(CHECK_NOTNULL(prototype)->generic_code_),
+      constants_(prototype->constants_),
+      generic_code_(prototype->generic_code_),
+      unquickened_(prototype->generic_code_.size(), false),
+      record_caches_(prototype->record_caches_.size()),
+      record_cache_index_(prototype->record_cache_index_),
+      exn_handlers_(prototype->exn_handlers_),
+      jit_count_(0),
+      jit_compiled_(false),
+      owner_(0) {
+}
+
+InlineCacheStats PackedCode::record_cache_stats() const {
+  InlineCacheStats stats;
+  for (const RecordAccessCache& cache : record_caches_)
+    stats.Add(cache.stats());
+  return stats;
+}
+
+PackedOperand PackedCode::Pack(const Operand& operand,
+                               UnorderedMap<uint64, uint32>* constant_map) {
+  switch (operand.type) {
+    case Operand::INVALID:
+      return PackedOperand();
+
+    case Operand::REGISTER:
+      CHECK_GE(operand.reg.index, 0) << DebugString(operand.reg);
+      return PackedOperand(operand.reg.type, operand.reg.index);
+
+    case Operand::IMMEDIATE: {
+      const uint64 bits = operand.value.bits();
+      UnorderedMap<uint64, uint32>::const_iterator it =
+          constant_map->find(bits);
+      if (it != constant_map->end())
+        return PackedOperand(PackedOperand::CONSTANT, it->second);
+
+      const uint32 index = constants_.size();
+      constants_.push_back(operand.value);
+      (*constant_map)[bits] = index;
+      return PackedOperand(PackedOperand::CONSTANT, index);
+    }
+  }
+  LOG(FATAL) << "Unknown operand type: " << operand.type;
+}
+
+void PackedCode::ResolveNative(uint64 code_pointer, uint64 native_id) {
+  CHECK_LT(code_pointer, code_.size());
+  DCHECK(code_[code_pointer].operand1.is_constant());
+  code_[code_pointer].operand3 =
+      PackedOperand(PackedOperand::NATIVE, native_id);
+}
+
+void PackedCode::Quicken(uint64 code_pointer, uint8 quick_opcode) {
+  CHECK_LT(code_pointer, code_.size());
+  DCHECK(IsQuickOpcode(quick_opcode));
+
+  // Fuses the instruction with the next one.
+  if (code_pointer + 1 < code_.size()) {
+    const uint8 next = Unfuse(code_[code_pointer + 1].opcode);
+    quick_opcode = Fuse(quick_opcode, next);
+  }
+  code_[code_pointer].opcode = quick_opcode;
+
+  // Fuses the previous instruction with this one. A superinstruction ending
+  // with the generic form of this instruction is unfused otherwise, so that
+  // the quick form is dispatched.
+  if (code_pointer > 0) {
+    PackedBytecode* previous = &code_[code_pointer - 1];
+    if (previous->quick())
+      previous->opcode = Fuse(Unfuse(previous->opcode), Unfuse(quick_opcode));
+  }
+}
+
+JitCode* PackedCode::CountJitEntry(int64 threshold) {
+  if (!jit_compiled_) {
+    if (jit_count_ < threshold) {
+      ++jit_count_;
+      return NULL;
+    }
+    jit_compiled_ = true;
+    jit_code_.reset(JitCode::Compile(this));
+  }
+  return jit_code_.get();
+}
+
+// -----------------------------------------------------------------------------
+// CodeContext
+
+namespace {
+
+// Ids of the live code contexts: packed code owned by a destroyed context may
+// be claimed by another one.
+struct ContextRegistry {
+  std::mutex mutex;
+  uint64 next_id = 1;  // 0 is for packed code owned by no context
+  UnorderedSet<uint64> live;
+};
+
+ContextRegistry* GetContextRegistry() {
+  static ContextRegistry registry;
+  return &registry;
+}
+
+uint64 RegisterContext() {
+  ContextRegistry* const registry = GetContextRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  const uint64 id = registry->next_id++;
+  registry->live.insert(id);
+  return id;
+}
+
+}  // namespace
+
+CodeContext::CodeContext()
+    : id_(RegisterContext()) {
+}
+
+CodeContext::~CodeContext() {
+  ContextRegistry* const registry = GetContextRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  registry->live.erase(id_);
+}
+
+bool CodeContext::Claim(const PackedCode* code) {
+  const uint64 owner = code->owner();
+  if (owner == id_) return true;
+
+  // The registry lock orders the last runs of a destroyed context before the
+  // runs of the context taking its packed code over.
+  ContextRegistry* const registry = GetContextRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  if ((owner != 0) && (registry->live.count(owner) > 0)) return false;
+  return code->TransferOwner(owner, id_);
+}
+
+PackedCode* CodeContext::Adopt(PackedCode* code) {
+  UnorderedMap<const PackedCode*, Copy>::const_iterator it =
+      copies_.find(code);
+  if (it != copies_.end()) return it->second.code.get();
+  if (Claim(code)) return code;
+
+  Copy* const copy = &copies_[code];
+  copy->prototype = code->shared_from_this();
+  copy->code.reset(new PackedCode(code));
+  return copy->code.get();
+}
+
+// -----------------------------------------------------------------------------
+// Packed opcodes
+
+uint8 PackedCode::Fuse(uint8 first, uint8 second) {
+#define SUPER_FUSE(First, SecondScope, Second)                          \
+  if ((first == PackedBytecode::First)                                  \
+      && (second == SecondScope::Second))                               \
+    return PackedBytecode::SUPER_##First##_THEN_##Second;
+
+  STORE_SUPERINSTRUCTIONS(SUPER_FUSE)
+#undef SUPER_FUSE
+  return first;
+}
+
+uint8 PackedCode::Unfuse(uint8 opcode) {
+  switch (opcode) {
+#define SUPER_UNFUSE(First, SecondScope, Second)                        \
+    case PackedBytecode::SUPER_##First##_THEN_##Second:                 \
+      return PackedBytecode::First;
+
+    STORE_SUPERINSTRUCTIONS(SUPER_UNFUSE)
+#undef SUPER_UNFUSE
+  }
+  return opcode;
+}
+
+uint8 PackedCode::GenericOpcode(uint8 opcode) {
+  switch (Unfuse(opcode)) {
+#define QUICK_LOAD_GENERIC(D, S)                                        \
+    case PackedBytecode::QUICK_LOAD_##D##S:                             \
+      return Bytecode::LOAD;
+
+    STORE_QUICK_LOADS(QUICK_LOAD_GENERIC)
+#undef QUICK_LOAD_GENERIC
+
+#define QUICK_BINARY_GENERIC(Opcode, D, S1, S2)                         \
+    case PackedBytecode::QUICK_##Opcode##_##D##S1##S2:                  \
+      return Bytecode::Opcode;
+
+    STORE_QUICK_BINARIES(QUICK_BINARY_GENERIC)
+#undef QUICK_BINARY_GENERIC
+
+#define QUICK_BRANCH_GENERIC(Opcode, C)                                 \
+    case PackedBytecode::QUICK_##Opcode##_##C:                          \
+      return Bytecode::Opcode;
+
+    STORE_QUICK_BRANCHES(QUICK_BRANCH_GENERIC)
+#undef QUICK_BRANCH_GENERIC
+  }
+  return Unfuse(opcode);
+}
+
+namespace {
+
+// Names of the packed opcodes, in the order of PackedBytecode::opcode.
+const char* const kPackedOpcodeNames[] = {
+#define GENERIC_NAME(Opcode) #Opcode,
+  STORE_BYTECODE_OPCODES(GENERIC_NAME)
+#undef GENERIC_NAME
+
+#define QUICK_LOAD_NAME(D, S) "QUICK_LOAD_" #D #S,
+  STORE_QUICK_LOADS(QUICK_LOAD_NAME)
+#undef QUICK_LOAD_NAME
+#define QUICK_BINARY_NAME(Opcode, D, S1, S2) "QUICK_" #Opcode "_" #D #S1 #S2,
+  STORE_QUICK_BINARIES(QUICK_BINARY_NAME)
+#undef QUICK_BINARY_NAME
+#define QUICK_BRANCH_NAME(Opcode, C) "QUICK_" #Opcode "_" #C,
+  STORE_QUICK_BRANCHES(QUICK_BRANCH_NAME)
+#undef QUICK_BRANCH_NAME
+
+#define SUPER_NAME(First, SecondScope, Second)                          \
+  "SUPER_" #First "_THEN_" #Second,
+  STORE_SUPERINSTRUCTIONS(SUPER_NAME)
+#undef SUPER_NAME
+};
+
+static_assert(sizeof(kPackedOpcodeNames) / sizeof(kPackedOpcodeNames[0])
+              == PackedBytecode::PACKED_OPCODE_COUNT,
+              "Missing packed opcode names");
+
+}  // namespace
+
+const char* PackedCode::OpcodeName(uint8 opcode) {
+  CHECK_LT(opcode, PackedBytecode::PACKED_OPCODE_COUNT);
+  return kPackedOpcodeNames[opcode];
+}
+
+// -----------------------------------------------------------------------------
+
+}  // namespace store
@@ -0,0 +1,502 @@
+// Compact bytecode representation, executed by the interpreter
+#ifndef STORE_PACKED_CODE_H_
+#define STORE_PACKED_CODE_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+#include "base/basictypes.h"
+#include "base/stl-util.h"
+#include "store/superinstructions.h"
+
+namespace store {
+
+class JitCode;
+
+// -----------------------------------------------------------------------------
+// Operand packed in 32 bits: a register, or a constant of the procedure.
+//
+// The upper 16 bits hold the kind of the operand: a Register::RegisterType,
+// CONSTANT, NATIVE or NONE. The lower 16 bits hold the register index, the
+// index of the constant in the constant pool of the procedure, or the id of
+// a native (see Engine::FindNativeId()). The verifier rejects procedures
+// with more registers or constants: see VerifyBytecode().
+//
+class PackedOperand {
+ public:
+  enum {
+    kIndexBits = 16,
+    kMaxIndex = (1 << kIndexBits) - 1,
+  };
+
+  enum Kind {
+    // Kinds below CONSTANT are register types.
+    CONSTANT = Register::REGISTER_TYPE_COUNT,
+    NATIVE,
+    NONE = 15,
+  };
+
+  PackedOperand() : bits_(NONE << kIndexBits) {}
+
+  PackedOperand(int kind, uint64 index)
+      : bits_((kind << kIndexBits) | index) {
+    CHECK_LE(index, static_cast<uint64>(kMaxIndex))
+        << "Operand index overflows the packed encoding";
+  }
+
+  int kind() const { return bits_ >> kIndexBits; }
+  uint32 index() const { return bits_ & kMaxIndex; }
+
+  bool is_register() const { return kind() < CONSTANT; }
+  bool is_constant() const { return kind() == CONSTANT; }
+
+  Register reg() const {
+    return Register(static_cast<Register::RegisterType>(kind()), index());
+  }
+
+ private:
+  uint32 bits_;
+};
+
+static_assert(PackedOperand::NATIVE < PackedOperand::NONE,
+              "Operand kinds fit in 4 bits");
+
+// -----------------------------------------------------------------------------
+// Quick instructions
+//
+// The interpreter rewrites some instructions in place, after their first
+// execution, into quick variants specialized for the kinds of their operands:
+// L for a local register, P for a parameter and K for a constant.
+// Quick variants access their operands directly and have inline fast paths
+// for small integers and booleans. They fall back to the generic instruction
+// for any other value.
+
+// Destination and source kinds of the quick LOAD instructions.
+#define STORE_QUICK_LOADS(V)                                    \
+  V(L, L) V(L, P) V(L, K)                                       \
+  V(P, L) V(P, P) V(P, K)
+
+// Destination and source kinds of the quick instructions with 2 sources.
+#define STORE_QUICK_BINARY_KINDS(V, Opcode)                     \
+  V(Opcode, L, L, L) V(Opcode, L, L, P) V(Opcode, L, L, K)      \
+  V(Opcode, L, P, L) V(Opcode, L, P, P) V(Opcode, L, P, K)      \
+  V(Opcode, L, K, L) V(Opcode, L, K, P)                         \
+  V(Opcode, P, L, L) V(Opcode, P, L, P) V(Opcode, P, L, K)      \
+  V(Opcode, P, P, L) V(Opcode, P, P, P) V(Opcode, P, P, K)      \
+  V(Opcode, P, K, L) V(Opcode, P, K, P)
+
+#define STORE_QUICK_BINARIES(V)                                 \
+  STORE_QUICK_BINARY_KINDS(V, NUMBER_INT_ADD)                   \
+  STORE_QUICK_BINARY_KINDS(V, NUMBER_INT_SUBTRACT)              \
+  STORE_QUICK_BINARY_KINDS(V, TEST_LESS_THAN)
+
+// Condition kinds of the quick conditional branches.
+// The branch target is a constant.
+#define STORE_QUICK_BRANCHES(V)                                 \
+  V(BRANCH_IF, L) V(BRANCH_IF, P)                               \
+  V(BRANCH_UNLESS, L) V(BRANCH_UNLESS, P)
+
+// -----------------------------------------------------------------------------
+// Superinstructions
+//
+// A superinstruction fuses a quick instruction with the instruction that
+// follows it: it executes the quick instruction, then jumps directly to the
+// handler of the next instruction instead of dispatching it.
+// Only the first instruction of the pair is rewritten: the second one is
+// still a branch target of its own.
+//
+// The pairs are listed in store/superinstructions.h as
+// V(First, SecondScope, Second), where SecondScope is Bytecode for a generic
+// second instruction and PackedBytecode for a quick one. The list is
+// generated from the opcode pair profile of sample programs by
+// store/superinstruction_generator: see OpcodeProfile.
+
+// -----------------------------------------------------------------------------
+// Instruction packed in 16 bytes: one byte of opcode and 3 packed operands.
+struct PackedBytecode {
+  // Quick opcodes follow the opcodes of Bytecode, then superinstructions.
+  enum PackedOpcodeType {
+    QUICK_OPCODE_BASE = Bytecode::OPCODE_TYPE_COUNT - 1,
+
+#define QUICK_LOAD_OPCODE(D, S) QUICK_LOAD_##D##S,
+    STORE_QUICK_LOADS(QUICK_LOAD_OPCODE)
+#undef QUICK_LOAD_OPCODE
+
+#define QUICK_BINARY_OPCODE(Opcode, D, S1, S2) QUICK_##Opcode##_##D##S1##S2,
+    STORE_QUICK_BINARIES(QUICK_BINARY_OPCODE)
+#undef QUICK_BINARY_OPCODE
+
+#define QUICK_BRANCH_OPCODE(Opcode, C) QUICK_##Opcode##_##C,
+    STORE_QUICK_BRANCHES(QUICK_BRANCH_OPCODE)
+#undef QUICK_BRANCH_OPCODE
+
+    QUICK_OPCODE_END,
+    SUPER_OPCODE_BASE = QUICK_OPCODE_END - 1,
+
+#define SUPER_OPCODE(First, SecondScope, Second) SUPER_##First##_THEN_##Second,
+    STORE_SUPERINSTRUCTIONS(SUPER_OPCODE)
+#undef SUPER_OPCODE
+
+    PACKED_OPCODE_COUNT,
+  };
+
+  // @returns True for a quick instruction or a superinstruction.
+  bool quick() const { return opcode >= Bytecode::OPCODE_TYPE_COUNT; }
+
+  // A Bytecode::OpcodeType, or a PackedOpcodeType.
+  uint8 opcode;
+  PackedOperand operand1;
+  PackedOperand operand2;
+  PackedOperand operand3;
+};
+
+static_assert(sizeof(PackedBytecode) == 16, "PackedBytecode is 16 bytes");
+static_assert(PackedBytecode::PACKED_OPCODE_COUNT <= 256,
+              "Packed opcodes fit in one byte");
+
+// -----------------------------------------------------------------------------
+// Hit and miss counts of inline caches.
+struct InlineCacheStats {
+  InlineCacheStats()
+      : monomorphic_hits(0), polymorphic_hits(0), misses(0) {
+  }
+
+  uint64 hits() const { return monomorphic_hits + polymorphic_hits; }
+  uint64 lookups() const { return hits() + misses; }
+
+  // @returns The ratio of lookups that hit the cache, 0 without lookups.
+  double hit_rate() const {
+    return (lookups() == 0)
+        ? 0.0
+        : static_cast<double>(hits()) / lookups();
+  }
+
+  void Add(const InlineCacheStats& stats) {
+    monomorphic_hits += stats.monomorphic_hits;
+    polymorphic_hits += stats.polymorphic_hits;
+    misses += stats.misses;
+  }
+
+  uint64 monomorphic_hits;
+  uint64 polymorphic_hits;
+  uint64 misses;
+};
+
+// -----------------------------------------------------------------------------
+// Inline cache of a record access instruction: ACCESS_RECORD or
+// UNIFY_RECORD_FIELD.
+//
+// Maps the arity of the records accessed by the instruction and the feature
+// to the slot of the feature in the record values. The first entry is the
+// monomorphic cache: most instructions only ever see one arity. The other
+// entries form a small polymorphic cache, refilled round-robin once full.
+//
+// Arities are interned and never move: they are compared by address.
+// Only atom and small integer features are cached, for the same reason.
+//
+class RecordAccessCache {
+ public:
+  enum { kEntries = 4 };
+
+  RecordAccessCache() : nfilled_(0) {}
+
+  // Looks up the slot of a feature in the records of an arity.
+  // Counts the hit or the miss.
+  // @returns The slot of the feature, or -1 on a miss.
+  int64 Lookup(const Arity* arity, Value feature) {
+    if ((entries_[0].arity == arity) && (entries_[0].feature == feature)) {
+      ++stats_.monomorphic_hits;
+      return entries_[0].slot;
+    }
+    for (int i = 1; i < kEntries; ++i) {
+      const Entry& entry = entries_[i];
+      if ((entry.arity == arity) && (entry.feature == feature)) {
+        ++stats_.polymorphic_hits;
+        return entry.slot;
+      }
+    }
+    ++stats_.misses;
+    return -1;
+  }
+
+  // Counts a miss on a value the cache does not apply to, e.g. a tuple.
+  void CountMiss() { ++stats_.misses; }
+
+  // Caches the slot of a feature in the records of an arity, after a miss.
+  void Insert(const Arity* arity, Value feature, uint32 slot);
+
+  const InlineCacheStats& stats() const { return stats_; }
+
+ private:
+  struct Entry {
+    Entry() : arity(NULL), slot(0) {}
+
+    const Arity* arity;  // NULL for an empty entry
+    Value feature;
+    uint32 slot;
+  };
+
+  Entry entries_[kEntries];
+
+  // Number of entries filled so far, including replaced entries.
+  uint64 nfilled_;
+
+  InlineCacheStats stats_;
+};
+
+// -----------------------------------------------------------------------------
+// Entry of the exception table of a procedure: a try block.
+//
+// The try block protects the instructions strictly between its EXN_PUSH_CATCH
+// or EXN_PUSH_FINALLY and its EXN_POP. The handler is not protected by its
+// own entry: an exception raised by the handler goes to the enclosing ones.
+struct ExnHandler {
+  enum Kind {
+    // Finally handlers run on raises, and on returns from the try block.
+    FINALLY = 0,
+
+    // Catch handlers run on raises only.
+    CATCH = 1,
+  };
+
+  bool Protects(uint64 code_pointer) const {
+    return (begin <= code_pointer) && (code_pointer < end);
+  }
+
+  Kind kind;
+  uint32 begin;    // Code pointer of the first protected instruction
+  uint32 end;      // Code pointer of the EXN_POP closing the try block
+  uint32 handler;  // Code pointer of the handler
+};
+
+// -----------------------------------------------------------------------------
+// The packed form of the bytecode of a procedure.
+//
+// Instruction i of the packed code is instruction i of the bytecode: code
+// pointers are the same in both forms. Immediate operands move to a constant
+// pool, where equal immediates share a single entry. CALL_NATIVE with the
+// constant name of a registered native holds the id of the native in its
+// third operand, if the id fits.
+//
+// Try blocks are compiled into a static exception table: the EXN_PUSH_CATCH,
+// EXN_PUSH_FINALLY and EXN_POP instructions only delimit the protected code,
+// and the handlers are looked up in the table when an exception is raised or
+// when a procedure returns. The EXN_POP of a finally block holds the code
+// pointer of the handler as a constant, in its first operand.
+//
+// The bytecode is kept alongside for debugging and serialization. It must not
+// change once packed. The packed code itself changes when the interpreter
+// quickens instructions, fills the inline caches, and counts the entries into
+// the JIT. These updates are not synchronized: the packed code of a procedure
+// is updated by one code context, its owner, and the other contexts run
+// copies of it (see CodeContext).
+//
+class PackedCode : public std::enable_shared_from_this<PackedCode> {
+ public:
+  explicit PackedCode(const vector<Bytecode>& bytecode);
+
+  // Copies a packed code as it was packed: generic instructions, empty inline
+  // caches and JIT counters. Only reads the parts of the prototype that do
+  // not change once run.
+  explicit PackedCode(const PackedCode* prototype);
+
+  const PackedBytecode* code() const { return code_.data(); }
+  uint64 size() const { return code_.size(); }
+
+  // The instructions as packed, before they are quickened or resolved by the
+  // interpreter. Does not change once packed.
+  const PackedBytecode* generic_code() const { return generic_code_.data(); }
+
+  // Rewrites an instruction into one of its quick variants.
+  // Peephole: fuses the instruction with its neighbours into
+  // superinstructions, where possible.
+  void Quicken(uint64 code_pointer, uint8 quick_opcode);
+
+  // Whether the generic instruction at a code pointer had no quick variant
+  // for its operands when first executed. The interpreter does not try to
+  // quicken it again: it stays generic.
+  bool unquickened(uint64 code_pointer) const {
+    return unquickened_[code_pointer];
+  }
+  void set_unquickened(uint64 code_pointer) {
+    DCHECK_LT(code_pointer, unquickened_.size());
+    unquickened_[code_pointer] = true;
+  }
+
+  // Resolves a CALL_NATIVE with a constant name to the id of its native,
+  // once registered: see Engine::FindNativeId().
+  void ResolveNative(uint64 code_pointer, uint64 native_id);
+
+  const Value* constants() const { return constants_.data(); }
+  uint64 nconstants() const { return constants_.size(); }
+
+  // Used by Closure::Optimize() to optimize the constant pool, before the
+  // procedure runs.
+  vector<Value>* mutable_constants() { return &constants_; }
+
+  // @returns The inline cache of the record access instruction at the given
+  //     code pointer.
+  RecordAccessCache* record_cache(uint64 code_pointer) {
+    DCHECK_LT(code_pointer, record_cache_index_.size());
+    return &record_caches_[record_cache_index_[code_pointer]];
+  }
+
+  // @returns The hit and miss counts of the record access inline caches.
+  InlineCacheStats record_cache_stats() const;
+
+  // The exception table, with inner try blocks before the blocks enclosing
+  // them.
+  const vector<ExnHandler>& exn_handlers() const { return exn_handlers_; }
+
+  // @param code_pointer The instruction raising, or returning.
+  // @param finally_only Whether to only look for finally handlers.
+  // @returns The handler of the innermost try block protecting an
+  //     instruction, or NULL.
+  const ExnHandler* FindExnHandler(uint64 code_pointer,
+                                   bool finally_only) const {
+    for (const ExnHandler& handler : exn_handlers_) {
+      if (handler.Protects(code_pointer)
+          && (!finally_only || (handler.kind == ExnHandler::FINALLY)))
+        return &handler;
+    }
+    return NULL;
+  }
+
+  // ---------------------------------------------------------------------------
+  // Baseline JIT
+
+  // Counts a call of the procedure, or an iteration of one of its loops.
+  // Compiles the procedure into native code once the count reaches the
+  // threshold: see Engine::jit_threshold().
+  // @returns The native code of the procedure, or NULL if it is not compiled.
+  JitCode* CountJitEntry(int64 threshold);
+
+  JitCode* jit_code() const { return jit_code_.get(); }
+
+  // ---------------------------------------------------------------------------
+  // Ownership
+
+  // @returns The id of the code context updating the packed code in place,
+  //     0 if none.
+  uint64 owner() const { return owner_.load(std::memory_order_acquire); }
+
+  // Changes the owner of the packed code, if still owned by the given context.
+  // @returns False if the packed code changed owner in the meantime.
+  bool TransferOwner(uint64 from, uint64 to) const {
+    return owner_.compare_exchange_strong(from, to);
+  }
+
+  // ---------------------------------------------------------------------------
+  // Packed opcodes
+
+  static bool IsQuickOpcode(uint8 opcode) {
+    return (opcode >= Bytecode::OPCODE_TYPE_COUNT)
+        && (opcode < PackedBytecode::QUICK_OPCODE_END);
+  }
+
+  static bool IsSuperOpcode(uint8 opcode) {
+    return opcode >= PackedBytecode::QUICK_OPCODE_END;
+  }
+
+  // @returns The superinstruction fusing two instructions, or the first
+  //     opcode if there is none.
+  static uint8 Fuse(uint8 first, uint8 second);
+
+  // @returns The first opcode of a superinstruction, or the opcode itself.
+  static uint8 Unfuse(uint8 opcode);
+
+  // @returns The generic opcode a packed opcode is quickened from.
+  static uint8 GenericOpcode(uint8 opcode);
+
+  // @returns The name of a packed opcode, as in the opcode enums.
+  static const char* OpcodeName(uint8 opcode);
+
+ private:
+  // @param constant_map Maps the bits of the immediates already in the
+  //     constant pool to their index.
+  PackedOperand Pack(const Operand& operand,
+                     UnorderedMap<uint64, uint32>* constant_map);
+
+  vector<PackedBytecode> code_;
+  vector<Value> constants_;
+
+  // See generic_code().
+  vector<PackedBytecode> generic_code_;
+
+  // See unquickened().
+  vector<bool> unquickened_;
+
+  // Inline caches of the record access instructions, and their index by code
+  // pointer. Both are empty when the procedure accesses no record.
+  vector<RecordAccessCache> record_caches_;
+  vector<uint32> record_cache_index_;
+
+  // Ordered by the code pointer of their EXN_POP.
+  vector<ExnHandler> exn_handlers_;
+
+  // Calls and loop iterations counted before compiling.
+  int64 jit_count_;
+  bool jit_compiled_;
+  shared_ptr<JitCode> jit_code_;
+
+  // Id of the code context updating the packed code: see CodeContext::id().
+  mutable std::atomic<uint64> owner_;
+
+  DISALLOW_COPY_AND_ASSIGN(PackedCode);
+};
+
+// -----------------------------------------------------------------------------
+// The packed code run by an engine.
+//
+// The first context running a procedure owns its packed code, and updates it
+// in place. The other contexts run private copies of it, made the first time
+// they run the procedure: engines on different OS threads run the same
+// procedures without sharing their quickened instructions, inline caches and
+// JIT counters. The copies live as long as their context.
+//
+// A context is used by one OS thread at a time. Its id is unique in the
+// process and never reused. The packed code of a destroyed context goes to
+// the next context running it without a copy.
+//
+class CodeContext {
+ public:
+  CodeContext();
+  ~CodeContext();
+
+  uint64 id() const { return id_; }
+
+  // @returns The packed code to run for a procedure in this context: the
+  //     packed code itself if owned by the context, or a copy of it.
+  PackedCode* Code(PackedCode* code) {
+    return (code->owner() == id_) ? code : Adopt(code);
+  }
+
+  // Claims the packed code of a procedure, if no live context owns it.
+  // @returns True if the context owns the packed code.
+  bool Claim(const PackedCode* code);
+
+ private:
+  // @returns The packed code owned by this context, or its copy.
+  PackedCode* Adopt(PackedCode* code);
+
+  const uint64 id_;
+
+  // Copies by packed code. They hold their prototype, so that its address is
+  // not reused while the copy lives.
+  struct Copy {
+    shared_ptr<PackedCode> prototype;
+    std::unique_ptr<PackedCode> code;
+  };
+  UnorderedMap<const PackedCode*, Copy> copies_;
+
+  DISALLOW_COPY_AND_ASSIGN(CodeContext);
+};
+
+// -----------------------------------------------------------------------------
+
+}  // namespace store
+
+#endif  // STORE_PACKED_CODE_H_
@@ -0,0 +1,511 @@
+// Tests for the packed form of the bytecode.
+#include "store/values.h"
+
+#include <memory>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+#include <gtest/gtest.h>
+
+#include "store/engine.h"
+
+namespace store {
+
+const uint64 kStoreSize = 1024 * 1024;
+
+TEST(PackedCode, Operands) {
+  EXPECT_TRUE(PackedOperand().kind() == PackedOperand::NONE);
+  EXPECT_FALSE(PackedOperand().is_register());
+  EXPECT_FALSE(PackedOperand().is_constant());
+
+  const PackedOperand local(Register::LOCAL, PackedOperand::kMaxIndex);
+  EXPECT_TRUE(local.is_register());
+  EXPECT_EQ(Register(Register::LOCAL, PackedOperand::kMaxIndex), local.reg());
+
+  const PackedOperand exn(Register::EXN, 0);
+  EXPECT_TRUE(exn.is_register());
+  EXPECT_EQ(Register(Register::EXN), exn.reg());
+
+  const PackedOperand constant(PackedOperand::CONSTANT, 3);
+  EXPECT_TRUE(constant.is_constant());
+  EXPECT_EQ(3UL, constant.index());
+}
+
+TEST(PackedCode, Pack) {
+  StaticStore store(kStoreSize);
+  const Value str = New::String(&store, "string");
+  const Operand l0(Register(Register::LOCAL, 0));
+  const Operand p1(Register(Register::PARAM, 1));
+
+  vector<Bytecode> bytecode;
+  bytecode.push_back(Bytecode(Bytecode::LOAD, l0, Operand(Value::Integer(1))));
+  bytecode.push_back(Bytecode(Bytecode::NUMBER_INT_ADD, l0, p1,
+                              Operand(Value::Integer(1))));
+  bytecode.push_back(Bytecode(Bytecode::TEST_EQUALITY, l0, p1, Operand(str)));
+  bytecode.push_back(Bytecode(Bytecode::RETURN));
+
+  const PackedCode packed(bytecode);
+  ASSERT_EQ(4UL, packed.size());
+
+  // Equal immediates share a constant.
+  ASSERT_EQ(2UL, packed.nconstants());
+  EXPECT_EQ(Value::Integer(1), packed.constants()[0]);
+  EXPECT_EQ(str, packed.constants()[1]);
+
+  const PackedBytecode* code = packed.code();
+  EXPECT_EQ(Bytecode::LOAD, code[0].opcode);
+  EXPECT_EQ(l0.reg, code[0].operand1.reg());
+  EXPECT_TRUE(code[0].operand2.is_constant());
+  EXPECT_EQ(0UL, code[0].operand2.index());
+  EXPECT_TRUE(code[0].operand3.kind() == PackedOperand::NONE);
+
+  EXPECT_EQ(Bytecode::NUMBER_INT_ADD, code[1].opcode);
+  EXPECT_EQ(p1.reg, code[1].operand2.reg());
+  EXPECT_EQ(0UL, code[1].operand3.index());
+
+  EXPECT_EQ(Bytecode::TEST_EQUALITY, code[2].opcode);
+  EXPECT_EQ(1UL, code[2].operand3.index());
+
+  EXPECT_EQ(Bytecode::RETURN, code[3].opcode);
+}
+
+TEST(PackedCode, SharedByClosures) {
+  StaticStore store(kStoreSize);
+  shared_ptr<vector<Bytecode> > bytecode(new vector<Bytecode>);
+  bytecode->push_back(
+      Bytecode(Bytecode::LOAD, Operand(Register(Register::LOCAL, 0)),
+               Operand(Register(Register::ENVMT, 0))));
+  bytecode->push_back(Bytecode(Bytecode::RETURN));
+
+  Closure* const proc = Closure::New(&store, bytecode, 0, 1, 1);
+  Closure* const closure =
+      Closure::New(&store, proc, Array::New(&store, 1, KAtomNil()));
+  EXPECT_EQ(proc->packed_code(), closure->packed_code());
+  EXPECT_EQ(2UL, closure->packed_code()->size());
+}
+
+namespace {
+
+Operand Local(int index) {
+  return Operand(Register(Register::LOCAL, index));
+}
+
+Operand Param(int index) {
+  return Operand(Register(Register::PARAM, index));
+}
+
+Operand Immediate(int64 integer) {
+  return Operand(Value::Integer(integer));
+}
+
+}  // namespace
+
+TEST(PackedCode, Quicken) {
+  StaticStore store(kStoreSize);
+  // l0 := 10
+  // while 0 < l0:
+  //   l0 := l0 - 1
+  // p0 = l0
+  shared_ptr<vector<Bytecode> > bytecode(new vector<Bytecode>);
+  bytecode->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(10)));
+  bytecode->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(1), Immediate(0), Local(0)));
+  bytecode->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(0), Local(0),
+               Immediate(1)));
+  bytecode->push_back(Bytecode(Bytecode::BRANCH_IF, Local(1), Immediate(1)));
+  bytecode->push_back(Bytecode(Bytecode::UNIFY, Param(0), Local(0)));
+  Closure* const proc = Closure::New(&store, bytecode, 1, 2, 0);
+
+  Engine engine;
+  const Value result = New::Free(&store);
+  New::Thread(&store, &engine, proc, Array::New(&store, 1, result), &store);
+  engine.Run();
+  EXPECT_EQ(-1, IntValue(result));
+
+  const PackedBytecode* code = proc->packed_code()->code();
+  EXPECT_EQ(PackedBytecode::QUICK_LOAD_LK, code[0].opcode);
+  EXPECT_EQ(PackedBytecode::QUICK_TEST_LESS_THAN_LKL, code[1].opcode);
+  EXPECT_EQ(PackedBytecode::QUICK_NUMBER_INT_SUBTRACT_LLK, code[2].opcode);
+  EXPECT_EQ(PackedBytecode::QUICK_BRANCH_IF_L, code[3].opcode);
+  EXPECT_EQ(Bytecode::UNIFY, code[4].opcode);
+}
+
+TEST(PackedCode, QuickFallback) {
+  StaticStore store(kStoreSize);
+  // p1 = p0 + 1
+  shared_ptr<vector<Bytecode> > bytecode(new vector<Bytecode>);
+  bytecode->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD, Local(0), Param(0), Immediate(1)));
+  bytecode->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(0)));
+  Closure* const proc = Closure::New(&store, bytecode, 2, 1, 0);
+
+  // Runs the procedure in a new thread.
+  // @returns The value of p1.
+  auto run = [&store, proc](Value param) {
+    Engine engine;
+    const Value result = New::Free(&store);
+    Array* const params = Array::New(&store, 2, param);
+    params->Assign(1, result);
+    New::Thread(&store, &engine, proc, params, &store);
+    engine.Run();
+    return result.Deref();
+  };
+
+  // Small integers quicken the addition.
+  EXPECT_EQ(3, IntValue(run(Value::Integer(2))));
+  EXPECT_EQ(PackedBytecode::QUICK_NUMBER_INT_ADD_LPK,
+            proc->packed_code()->code()[0].opcode);
+
+  // Overflows and other values fall back to the generic addition.
+  const int64 max = kSmallIntMax - 1;
+  const Value sum = run(Value::Integer(max));
+  EXPECT_EQ(Value::INTEGER, sum.type());
+  EXPECT_EQ(max + 1, IntValue(sum));
+
+  const Value variable = New::Free(&store);
+  CHECK(Unify(variable, Value::Integer(5)));
+  EXPECT_EQ(6, IntValue(run(variable)));
+
+  EXPECT_EQ(PackedBytecode::QUICK_NUMBER_INT_ADD_LPK,
+            proc->packed_code()->code()[0].opcode);
+}
+
+TEST(PackedCode, QuickenedOnce) {
+  StaticStore store(kStoreSize);
+  // p1 = p0 + 1
+  shared_ptr<vector<Bytecode> > bytecode(new vector<Bytecode>);
+  bytecode->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD, Local(0), Param(0), Immediate(1)));
+  bytecode->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(0)));
+  Closure* const proc = Closure::New(&store, bytecode, 2, 1, 0);
+  const PackedCode* const packed = proc->packed_code();
+
+  Engine engine;
+  auto run = [&store, &engine, proc](Value param) {
+    const Value result = New::Free(&store);
+    Array* const params = Array::New(&store, 2, param);
+    params->Assign(1, result);
+    New::Thread(&store, &engine, proc, params, &store);
+    engine.Run();
+    return result.Deref();
+  };
+
+  // A big integer on the first execution: no quick variant.
+  const Value big = Value::Integer(&store, "100000000000000000000");
+  EXPECT_EQ(Value::INTEGER, run(big).type());
+  EXPECT_EQ(Bytecode::NUMBER_INT_ADD, packed->code()[0].opcode);
+  EXPECT_TRUE(packed->unquickened(0));
+
+  // The instruction is not tried again, and stays generic.
+  EXPECT_EQ(3, IntValue(run(Value::Integer(2))));
+  EXPECT_EQ(Bytecode::NUMBER_INT_ADD, packed->code()[0].opcode);
+
+  // UNIFY has no quick variant, and is never tried.
+  EXPECT_FALSE(packed->unquickened(1));
+}
+
+TEST(PackedCode, ManyRegistersAndConstants) {
+  StaticStore store(kStoreSize);
+  // More locals and constants than 12-bit operands hold:
+  //   li := i, for each local i
+  //   p0 = l4999
+  const int kCount = 5000;
+  shared_ptr<vector<Bytecode> > bytecode(new vector<Bytecode>);
+  for (int i = 0; i < kCount; ++i)
+    bytecode->push_back(Bytecode(Bytecode::LOAD, Local(i), Immediate(i)));
+  bytecode->push_back(Bytecode(Bytecode::UNIFY, Param(0), Local(kCount - 1)));
+  bytecode->push_back(Bytecode(Bytecode::RETURN));
+  Closure* const proc = Closure::New(&store, bytecode, 1, kCount, 0);
+  ASSERT_TRUE(proc != NULL);
+
+  const PackedCode* const packed = proc->packed_code();
+  ASSERT_EQ(static_cast<uint64>(kCount), packed->nconstants());
+  EXPECT_EQ(Register(Register::LOCAL, kCount - 1),
+            packed->code()[kCount - 1].operand1.reg());
+  EXPECT_EQ(static_cast<uint32>(kCount - 1),
+            packed->code()[kCount - 1].operand2.index());
+
+  Engine engine;
+  const Value result = New::Free(&store);
+  New::Thread(&store, &engine, proc, Array::New(&store, 1, result), &store);
+  engine.Run();
+  EXPECT_EQ(kCount - 1, IntValue(result));
+}
+
+TEST(CodeContext, CopiesOwnedCode) {
+  StaticStore store(kStoreSize);
+  // l0 := p0 + 1
+  // p1 = l0
+  shared_ptr<vector<Bytecode> > bytecode(new vector<Bytecode>);
+  bytecode->push_back(Bytecode(Bytecode::LOAD, Local(0), Param(0)));
+  bytecode->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD, Local(0), Local(0), Immediate(1)));
+  bytecode->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(0)));
+  Closure* const proc = Closure::New(&store, bytecode, 2, 1, 0);
+  PackedCode* const packed = proc->packed_code();
+  packed->Quicken(1, PackedBytecode::QUICK_NUMBER_INT_ADD_LLK);
+
+  std::unique_ptr<CodeContext> context1(new CodeContext);
+  EXPECT_EQ(packed, context1->Code(packed));
+  EXPECT_EQ(context1->id(), packed->owner());
+
+  // Other contexts run a generic copy, while the owner lives.
+  CodeContext context2;
+  PackedCode* const copy = context2.Code(packed);
+  EXPECT_NE(packed, copy);
+  EXPECT_EQ(copy, context2.Code(packed));
+  EXPECT_EQ(Bytecode::NUMBER_INT_ADD, copy->code()[1].opcode);
+  EXPECT_EQ(packed->nconstants(), copy->nconstants());
+  EXPECT_EQ(context1->id(), packed->owner());
+
+  // A context takes the packed code of a destroyed context over.
+  context1.reset();
+  CodeContext context3;
+  EXPECT_EQ(packed, context3.Code(packed));
+  EXPECT_EQ(context3.id(), packed->owner());
+  EXPECT_EQ(copy, context2.Code(packed));
+}
+
+TEST(PackedCode, Superinstructions) {
+#define EXPECT_SUPERINSTRUCTION(First, SecondScope, Second)             \
+  {                                                                     \
+    const uint8 super = PackedBytecode::SUPER_##First##_THEN_##Second;  \
+    EXPECT_TRUE(PackedCode::IsSuperOpcode(super));                      \
+    EXPECT_TRUE(PackedCode::IsQuickOpcode(PackedBytecode::First));      \
+    EXPECT_EQ(super, PackedCode::Fuse(PackedBytecode::First,            \
+                                      SecondScope::Second));            \
+    EXPECT_EQ(PackedBytecode::First, PackedCode::Unfuse(super));        \
+    EXPECT_STREQ("SUPER_" #First "_THEN_" #Second,                      \
+                 PackedCode::OpcodeName(super));                        \
+  }
+
+  STORE_SUPERINSTRUCTIONS(EXPECT_SUPERINSTRUCTION)
+#undef EXPECT_SUPERINSTRUCTION
+
+  EXPECT_EQ(Bytecode::UNIFY, PackedCode::Unfuse(Bytecode::UNIFY));
+  EXPECT_EQ(PackedBytecode::QUICK_LOAD_LK,
+            PackedCode::Fuse(PackedBytecode::QUICK_LOAD_LK,
+                             Bytecode::NO_OPERATION));
+  EXPECT_STREQ("NUMBER_BOOL_XOR",
+               PackedCode::OpcodeName(Bytecode::NUMBER_BOOL_XOR));
+  EXPECT_STREQ("QUICK_BRANCH_UNLESS_P",
+               PackedCode::OpcodeName(PackedBytecode::QUICK_BRANCH_UNLESS_P));
+}
+
+TEST(PackedCode, FusedLoop) {
+  // l0 := 10
+  // while 0 < l0:
+  //   l0 := l0 - 1
+  // p0 = l0
+  // The test and the branch are fused, if a superinstruction fuses them.
+  const uint8 fused = PackedCode::Fuse(PackedBytecode::QUICK_TEST_LESS_THAN_LKL,
+                                       PackedBytecode::QUICK_BRANCH_IF_L);
+  for (int threaded = 0; threaded <= STORE_THREADED_DISPATCH; ++threaded) {
+    SCOPED_TRACE(threaded);
+    StaticStore store(kStoreSize);
+    shared_ptr<vector<Bytecode> > bytecode(new vector<Bytecode>);
+    bytecode->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(10)));
+    bytecode->push_back(
+        Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(0), Local(0),
+                 Immediate(1)));
+    bytecode->push_back(
+        Bytecode(Bytecode::TEST_LESS_THAN, Local(1), Immediate(0), Local(0)));
+    bytecode->push_back(
+        Bytecode(Bytecode::BRANCH_IF, Local(1), Immediate(1)));
+    bytecode->push_back(Bytecode(Bytecode::UNIFY, Param(0), Local(0)));
+    Closure* const proc = Closure::New(&store, bytecode, 1, 2, 0);
+
+    Engine engine;
+    engine.set_threaded_dispatch(threaded);
+    const Value result = New::Free(&store);
+    New::Thread(&store, &engine, proc, Array::New(&store, 1, result), &store);
+    engine.Run();
+    EXPECT_EQ(0, IntValue(result));
+
+    const PackedBytecode* code = proc->packed_code()->code();
+    EXPECT_EQ(fused, code[2].opcode);
+    EXPECT_EQ(PackedBytecode::QUICK_BRANCH_IF_L, code[3].opcode);
+  }
+}
+
+TEST(OpcodeProfile, HotLoop) {
+  StaticStore store(kStoreSize);
+  // l0 := 10
+  // while 0 < l0:
+  //   l0 := l0 - 1
+  // p0 = l0
+  shared_ptr<vector<Bytecode> > bytecode(new vector<Bytecode>);
+  bytecode->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(10)));
+  bytecode->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(1), Immediate(0), Local(0)));
+  bytecode->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(0), Local(0),
+               Immediate(1)));
+  bytecode->push_back(Bytecode(Bytecode::BRANCH_IF, Local(1), Immediate(1)));
+  bytecode->push_back(Bytecode(Bytecode::UNIFY, Param(0), Local(0)));
+  Closure* const proc = Closure::New(&store, bytecode, 1, 2, 0);
+
+  OpcodeProfile profile;
+  Engine engine;
+  engine.set_opcode_profile(&profile);
+  const Value result = New::Free(&store);
+  New::Thread(&store, &engine, proc, Array::New(&store, 1, result), &store);
+  engine.Run();
+  EXPECT_EQ(-1, IntValue(result));
+
+  // 1 load, 11 iterations of 3 instructions and 1 unification.
+  EXPECT_EQ(35UL, profile.ninstructions());
+  EXPECT_EQ(profile.ninstructions() - profile.nfused(),
+            profile.ndispatches());
+
+  // Each instruction runs once in its generic form, and is quickened before
+  // the next instruction runs.
+  EXPECT_EQ(1UL, profile.count(PackedBytecode::QUICK_LOAD_LK,
+                               Bytecode::TEST_LESS_THAN));
+  EXPECT_EQ(1UL, profile.count(PackedBytecode::QUICK_TEST_LESS_THAN_LKL,
+                               Bytecode::NUMBER_INT_SUBTRACT));
+  EXPECT_EQ(10UL, profile.count(PackedBytecode::QUICK_TEST_LESS_THAN_LKL,
+                                PackedBytecode::QUICK_NUMBER_INT_SUBTRACT_LLK));
+  EXPECT_EQ(10UL, profile.count(PackedBytecode::QUICK_NUMBER_INT_SUBTRACT_LLK,
+                                PackedBytecode::QUICK_BRANCH_IF_L));
+  EXPECT_EQ(1UL, profile.count(PackedBytecode::QUICK_BRANCH_IF_L,
+                               Bytecode::UNIFY));
+  // The backward branch is not a pair of consecutive instructions.
+  EXPECT_EQ(0UL, profile.count(PackedBytecode::QUICK_BRANCH_IF_L,
+                               PackedBytecode::QUICK_TEST_LESS_THAN_LKL));
+
+  const vector<OpcodeProfile::PairCount> pairs = profile.TopFusablePairs(2);
+  ASSERT_EQ(2UL, pairs.size());
+  EXPECT_EQ(10UL, pairs[0].count);
+  EXPECT_EQ(PackedBytecode::QUICK_NUMBER_INT_SUBTRACT_LLK, pairs[0].first);
+  EXPECT_EQ(PackedBytecode::QUICK_BRANCH_IF_L, pairs[0].second);
+  EXPECT_EQ(10UL, pairs[1].count);
+  EXPECT_EQ(PackedBytecode::QUICK_TEST_LESS_THAN_LKL, pairs[1].first);
+}
+
+TEST(RecordAccessCache, Entries) {
+  Arity* const ab = Arity::Get(Atom::Get("a"), Atom::Get("b"));
+  const Value a = Atom::Get("a");
+  const Value b = Atom::Get("b");
+
+  RecordAccessCache cache;
+  EXPECT_EQ(-1, cache.Lookup(ab, a));
+  cache.Insert(ab, a, 0);
+  EXPECT_EQ(0, cache.Lookup(ab, a));
+  EXPECT_EQ(-1, cache.Lookup(ab, b));
+
+  // Once full, the polymorphic entries are replaced and the monomorphic
+  // entry is kept.
+  for (int i = 1; i <= RecordAccessCache::kEntries; ++i) {
+    Arity* const arity = Arity::Get(Value::Integer(100 + i), b);
+    cache.Insert(arity, b, 1);
+  }
+  EXPECT_EQ(0, cache.Lookup(ab, a));
+  EXPECT_EQ(-1, cache.Lookup(Arity::Get(Value::Integer(101), b), b));
+  EXPECT_EQ(1, cache.Lookup(Arity::Get(Value::Integer(102), b), b));
+
+  const InlineCacheStats& stats = cache.stats();
+  EXPECT_EQ(2UL, stats.monomorphic_hits);
+  EXPECT_EQ(1UL, stats.polymorphic_hits);
+  EXPECT_EQ(3UL, stats.misses);
+  EXPECT_DOUBLE_EQ(0.5, stats.hit_rate());
+}
+
+TEST(PackedCode, RecordAccessCache) {
+  StaticStore store(kStoreSize);
+  // p1 = p0.b
+  // p2 = p0.b  (through UNIFY_RECORD_FIELD)
+  // p3 = label of p0
+  const Value b = Atom::Get("b");
+  shared_ptr<vector<Bytecode> > bytecode(new vector<Bytecode>);
+  bytecode->push_back(
+      Bytecode(Bytecode::ACCESS_RECORD, Local(0), Param(0), Operand(b)));
+  bytecode->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(0)));
+  bytecode->push_back(
+      Bytecode(Bytecode::UNIFY_RECORD_FIELD, Param(0), Operand(b), Param(2)));
+  bytecode->push_back(
+      Bytecode(Bytecode::ACCESS_RECORD_LABEL, Local(1), Param(0)));
+  bytecode->push_back(Bytecode(Bytecode::UNIFY, Param(3), Local(1)));
+  Closure* const proc = Closure::New(&store, bytecode, 4, 2, 0);
+
+  // Runs the procedure on a record label(Feature:1 b:2).
+  auto run = [&store, proc, b](Value feature) {
+    Arity* const arity = Arity::Get(feature, b);
+    // The values follow the order of the features in the arity.
+    Value values[2];
+    values[arity->Map(feature)] = Value::Integer(1);
+    values[arity->Map(b)] = Value::Integer(2);
+    const Value label = Atom::Get("label");
+    const Value record = Record::New(&store, label, arity, values);
+
+    Engine engine;
+    Array* const params = Array::New(&store, 4, record);
+    for (int i = 1; i < 4; ++i)
+      params->Assign(i, New::Free(&store));
+    New::Thread(&store, &engine, proc, params, &store);
+    engine.Run();
+    EXPECT_EQ(2, IntValue(params->Access(1)));
+    EXPECT_EQ(2, IntValue(params->Access(2)));
+    EXPECT_EQ(label, params->Access(3).Deref());
+  };
+
+  PackedCode* const packed = proc->packed_code();
+  run(Atom::Get("a"));
+  EXPECT_EQ(0UL, packed->record_cache_stats().hits());
+  EXPECT_EQ(2UL, packed->record_cache_stats().misses);
+
+  run(Atom::Get("a"));
+  EXPECT_EQ(2UL, packed->record_cache_stats().monomorphic_hits);
+
+  // Another arity fills the polymorphic cache.
+  run(Atom::Get("c"));
+  run(Atom::Get("c"));
+  EXPECT_EQ(2UL, packed->record_cache_stats().polymorphic_hits);
+  EXPECT_EQ(4UL, packed->record_cache_stats().misses);
+}
+
+TEST(PackedCode, ExnHandlers) {
+  StaticStore store(kStoreSize);
+  // try { try { l0 := 1 } catch { l0 := 2 } } finally { return }
+  shared_ptr<vector<Bytecode> > bytecode(new vector<Bytecode>);
+  bytecode->push_back(Bytecode(Bytecode::EXN_PUSH_FINALLY, Immediate(6)));
+  bytecode->push_back(Bytecode(Bytecode::EXN_PUSH_CATCH, Immediate(4)));
+  bytecode->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(1)));
+  bytecode->push_back(Bytecode(Bytecode::EXN_POP));
+  bytecode->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(2)));
+  bytecode->push_back(Bytecode(Bytecode::EXN_POP));
+  bytecode->push_back(Bytecode(Bytecode::RETURN));
+  Closure* const proc = Closure::New(&store, bytecode, 0, 1, 0);
+  const PackedCode* const packed = proc->packed_code();
+
+  // Inner try blocks come first.
+  ASSERT_EQ(2UL, packed->exn_handlers().size());
+  const ExnHandler& catch_handler = packed->exn_handlers()[0];
+  EXPECT_EQ(ExnHandler::CATCH, catch_handler.kind);
+  EXPECT_EQ(2U, catch_handler.begin);
+  EXPECT_EQ(3U, catch_handler.end);
+  EXPECT_EQ(4U, catch_handler.handler);
+  const ExnHandler& finally_handler = packed->exn_handlers()[1];
+  EXPECT_EQ(ExnHandler::FINALLY, finally_handler.kind);
+  EXPECT_EQ(1U, finally_handler.begin);
+  EXPECT_EQ(5U, finally_handler.end);
+  EXPECT_EQ(6U, finally_handler.handler);
+
+  EXPECT_EQ(&catch_handler, packed->FindExnHandler(2, false));
+  EXPECT_EQ(&finally_handler, packed->FindExnHandler(2, true));
+  // The catch handler is protected by the finally block only.
+  EXPECT_EQ(&finally_handler, packed->FindExnHandler(4, false));
+  EXPECT_EQ(NULL, packed->FindExnHandler(0, false));
+  EXPECT_EQ(NULL, packed->FindExnHandler(5, false));
+  EXPECT_EQ(NULL, packed->FindExnHandler(6, true));
+
+  // Only the EXN_POP of the finally block branches to its handler.
+  const PackedBytecode* const code = packed->code();
+  EXPECT_TRUE(code[3].operand1.kind() == PackedOperand::NONE);
+  ASSERT_TRUE(code[5].operand1.is_constant());
+  EXPECT_EQ(6, IntValue(packed->constants()[code[5].operand1.index()]));
+}
+
+}  // namespace store
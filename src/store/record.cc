@@ -108,6 +108,9 @@ bool Record::UnifyWith(UnificationContext* context, Value ovalue) {
 // virtual
 bool Record::Equals(EqualityContext* context, Value value) {
   Record* record = value.as<Record>();
+  if (header_.has_hash() && record->header_.has_hash()
+      && (header_.hash() != record->header_.hash()))
+    return false;
   if (!context->Equals(label_, record->label_)) return false;
   if (!context->Equals(arity_, record->arity_)) return false;
   const uint64 nvalues = arity_->size();
@@ -116,6 +119,29 @@ bool Record::Equals(EqualityContext* context, Value value) {
   return true;
 }
 
+// virtual
+bool Record::StructuralHash(uint32* hash) {
+  if (header_.has_hash()) {
+    *hash = header_.hash();
+    return true;
+  }
+  if (!ValueHeader::StartVisit(this)) return false;  // Cyclic value
+  uint32 h = MixHash(kType, arity_->hash());
+  uint32 value_hash;
+  bool hashable = label_.StructuralHash(&value_hash);
+  h = MixHash(h, value_hash);
+  const uint64 nvalues = arity_->size();
+  for (uint64 i = 0; hashable && (i < nvalues); ++i) {
+    hashable = values_[i].StructuralHash(&value_hash);
+    h = MixHash(h, value_hash);
+  }
+  ValueHeader::EndVisit(this);
+  if (!hashable) return false;
+  header_.set_hash(h);
+  *hash = h;
+  return true;
+}
+
 // virtual
 HeapValue* Record::MoveInternal(Store* store) {
   // TODO: We could save the array copy here...
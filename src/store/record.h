@@ -73,8 +73,10 @@ class Record : public HeapValue {
   virtual Value Optimize(OptimizeContext* context);
   virtual bool UnifyWith(UnificationContext* context, Value value);
   virtual bool Equals(EqualityContext* context, Value value);
+  virtual bool StructuralHash(uint32* hash);
   virtual HeapValue* MoveInternal(Store* store);
   virtual bool IsStateless(StatelessnessContext* context);
+  virtual ValueHeader* header() { return &header_; }
 
   // ---------------------------------------------------------------------------
   // Serialization
@@ -88,6 +90,7 @@ class Record : public HeapValue {
   virtual uint64 RecordWidth();
   virtual bool RecordHas(Value feature);
   virtual Value RecordGet(Value feature);
+  virtual LookupStatus TryRecordGet(Value feature, Value* value);
 
   virtual Value::ItemIterator* RecordIterItems() {
     return new ItemIterator(this);
@@ -110,6 +113,7 @@ class Record : public HeapValue {
 
   // ---------------------------------------------------------------------------
   // Memory layout
+  ValueHeader header_;
   Value label_;
   Arity* const arity_;
   Value values_[];
@@ -54,6 +54,15 @@ Value Record::RecordGet(Value feature) {
   return values_[arity_->Map(feature)];
 }
 
+// virtual
+inline
+LookupStatus Record::TryRecordGet(Value feature, Value* value) {
+  uint64 index;
+  if (!arity_->TryMap(feature, &index)) return LOOKUP_NOT_FOUND;
+  *value = values_[index];
+  return LOOKUP_FOUND;
+}
+
 // -----------------------------------------------------------------------------
 
 // virtual
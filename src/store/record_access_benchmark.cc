@@ -0,0 +1,221 @@
+// Benchmarks the record accesses of the interpreter, in a loop reading one
+// feature of a record:
+//  - monomorphic: every run accesses records of the same arity;
+//  - polymorphic: the runs cycle through records of several arities.
+// Reports the hit rate of the record access inline caches.
+//
+// Also benchmarks lookups of missing features, as in a case statement whose
+// branches rarely match: with FeatureNotFound exceptions and with
+// TryRecordGet(), then in a BRANCH_SWITCH_LITERAL loop.
+#include <chrono>
+#include <memory>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "store/engine.h"
+#include "store/values.h"
+
+DEFINE_int64(
+    loop_count,
+    1000000,
+    "Number of record accesses per run."
+);
+
+DEFINE_int64(
+    runs,
+    10,
+    "Number of runs of the loop."
+);
+
+DEFINE_int64(
+    missing_lookups,
+    1000000,
+    "Number of lookups of missing features."
+);
+
+DEFINE_int64(
+    arities,
+    3,
+    "Number of distinct arities of the polymorphic runs."
+);
+
+namespace store {
+
+const uint64 kStoreSize = 64 * 1024 * 1024;  // 64MB
+
+namespace {
+
+Operand Local(int index) {
+  return Operand(Register(Register::LOCAL, index));
+}
+
+Operand Param(int index) {
+  return Operand(Register(Register::PARAM, index));
+}
+
+Operand Immediate(int64 integer) {
+  return Operand(Value::Integer(integer));
+}
+
+// Builds a procedure Loop(Record N Sum), with Sum = N * Record.value:
+//   l0 := N
+//   l1 := 0
+//   while 0 < l0:
+//     l2 := Record.value
+//     l1 := l1 + l2
+//     l0 := l0 - 1
+//   Sum = l1
+Closure* NewLoopProc(Store* store) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(Bytecode(Bytecode::LOAD, Local(0), Param(1)));
+  code->push_back(Bytecode(Bytecode::LOAD, Local(1), Immediate(0)));
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(3), Immediate(0), Local(0)));
+  code->push_back(Bytecode(Bytecode::BRANCH_UNLESS, Local(3), Immediate(8)));
+  code->push_back(
+      Bytecode(Bytecode::ACCESS_RECORD, Local(2), Param(0),
+               Operand(Atom::Get("value"))));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD, Local(1), Local(1), Local(2)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(0), Local(0),
+               Immediate(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH, Immediate(2)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(2), Local(1)));
+  return Closure::New(store, code, 3, 4, 0);
+}
+
+// @returns A record point(value:1 x<i>:0).
+Value NewRecord(Store* store, int64 i) {
+  const Value value = Atom::Get("value");
+  Arity* const arity = Arity::Get(value, Value::Integer(i));
+  Value values[2];
+  values[arity->Map(value)] = Value::Integer(1);
+  values[arity->Map(Value::Integer(i))] = Value::Integer(0);
+  return Record::New(store, Atom::Get("point"), arity, values);
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs the loop procedure on records of the given number of arities.
+void RunLoop(const char* name, int64 narities) {
+  StaticStore store(kStoreSize);
+  Closure* const loop = NewLoopProc(&store);
+  vector<Value> records;
+  for (int64 i = 0; i < narities; ++i)
+    records.push_back(NewRecord(&store, i + 1));
+
+  Engine engine;
+  const auto start = std::chrono::steady_clock::now();
+  for (int64 run = 0; run < FLAGS_runs; ++run) {
+    const Value sum = New::Free(&store);
+    Array* const params = Array::New(&store, 3, records[run % narities]);
+    params->Assign(1, Value::Integer(FLAGS_loop_count));
+    params->Assign(2, sum);
+    New::Thread(&store, &engine, loop, params, &store);
+    engine.Run();
+    CHECK_EQ(FLAGS_loop_count, IntValue(sum));
+  }
+  const double seconds = SecondsSince(start);
+
+  const int64 naccesses = FLAGS_runs * FLAGS_loop_count;
+  const InlineCacheStats stats = loop->packed_code()->record_cache_stats();
+  printf("%s: %ld accesses in %.3fs, %.1f ns per iteration, "
+         "hit rate %.4f (%lu monomorphic, %lu polymorphic, %lu misses)\n",
+         name, naccesses, seconds, seconds * 1e9 / naccesses,
+         stats.hit_rate(), stats.monomorphic_hits, stats.polymorphic_hits,
+         stats.misses);
+}
+
+// Builds a procedure Switch(N Result), switching on a counter that matches
+// no branch until it reaches 0:
+//   l0 := N
+//   loop:
+//     switch l0: 0 -> end
+//     l0 := l0 - 1
+//     branch loop
+//   end:
+//   Result = l0
+Closure* NewSwitchProc(Store* store) {
+  Value zero = Value::Integer(0);
+  Value end = Value::Integer(4);
+  const Value branches =
+      Record::New(store, Atom::Get("branches"), Arity::Get(zero), &end);
+
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(Bytecode(Bytecode::LOAD, Local(0), Param(0)));
+  code->push_back(
+      Bytecode(Bytecode::BRANCH_SWITCH_LITERAL, Local(0), Operand(branches)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(0), Local(0),
+               Immediate(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH, Immediate(1)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(0)));
+  return Closure::New(store, code, 2, 1, 0);
+}
+
+void MissingFeatureLookups() {
+  StaticStore store(kStoreSize);
+  Value record = NewRecord(&store, 1);
+  const Value missing = Atom::Get("missing");
+  const int64 n = FLAGS_missing_lookups;
+
+  int64 nmisses = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int64 i = 0; i < n; ++i) {
+    try {
+      record.RecordGet(missing);
+    } catch (const FeatureNotFound&) {
+      ++nmisses;
+    }
+  }
+  double seconds = SecondsSince(start);
+  CHECK_EQ(n, nmisses);
+  printf("missing feature, FeatureNotFound: %.1f ns per lookup\n",
+         seconds * 1e9 / n);
+
+  nmisses = 0;
+  start = std::chrono::steady_clock::now();
+  for (int64 i = 0; i < n; ++i) {
+    Value value;
+    if (record.TryRecordGet(missing, &value) == LOOKUP_NOT_FOUND) ++nmisses;
+  }
+  seconds = SecondsSince(start);
+  CHECK_EQ(n, nmisses);
+  printf("missing feature, TryRecordGet: %.1f ns per lookup\n",
+         seconds * 1e9 / n);
+
+  Closure* const proc = NewSwitchProc(&store);
+  Engine engine;
+  const Value result = New::Free(&store);
+  Array* const params = Array::New(&store, 2, Value::Integer(n));
+  params->Assign(1, result);
+  start = std::chrono::steady_clock::now();
+  New::Thread(&store, &engine, proc, params, &store);
+  engine.Run();
+  seconds = SecondsSince(start);
+  CHECK_EQ(0, IntValue(result));
+  printf("switch without match: %.1f ns per iteration\n",
+         seconds * 1e9 / n);
+}
+
+}  // namespace
+
+}  // namespace store
+
+int main(int argc, char** argv) {
+  ::google::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  store::RunLoop("monomorphic", 1);
+  store::RunLoop("polymorphic", FLAGS_arities);
+  store::MissingFeatureLookups();
+  return EXIT_SUCCESS;
+}
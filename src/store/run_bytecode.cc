@@ -45,7 +45,12 @@ void RunBytecode() {
   // LOG(INFO) << Value(closure).ToString();
 
   Engine engine;
-  New::Thread(&store, &engine, closure, Array::EmptyArray, &store);
+  const Value thread =
+      New::Thread(&store, &engine, closure, Array::EmptyArray, &store);
+  if (!thread.IsDefined()) {
+    LOG(ERROR) << "Cannot run the procedure";
+    return;
+  }
   engine.Run();
 }
 
@@ -69,13 +69,18 @@ TEST(BytecodeTest, RunTests) {
     // TODO: handle recursive closure!
     VLOG(1) << Value(closure).ToString();
 
-    Engine engine;
-    TestPrint test_print;
-    engine.RegisterNative("print", &test_print);
-    New::Thread(&store, &engine, closure, Array::EmptyArray, &store);
-    engine.Run();
-
-    EXPECT_EQ(expected, test_print.output());
+    // The JIT, forced on, runs the program the same way.
+    for (int jit = 0; jit <= STORE_JIT; ++jit) {
+      SCOPED_TRACE(jit ? "JIT" : "no JIT");
+      Engine engine;
+      engine.set_jit_threshold(jit ? 0 : -1);
+      TestPrint test_print;
+      engine.RegisterNative("print", &test_print);
+      New::Thread(&store, &engine, closure, Array::EmptyArray, &store);
+      engine.Run();
+
+      EXPECT_EQ(expected, test_print.output());
+    }
   }
 }
 
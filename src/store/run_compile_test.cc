@@ -94,13 +94,23 @@ TEST(CompileTest, RunTests) {
     // TODO: handle recursive closure!
     VLOG(1) << Value(closure).ToString();
 
-    Engine engine;
-    TestPrint test_print;
-    engine.RegisterNative("print", &test_print);
-    New::Thread(&store, &engine, closure, Array::EmptyArray, &store);
-    engine.Run();
-
-    EXPECT_EQ(expected, test_print.output());
+    // Both instruction dispatch modes run the program the same way, and so
+    // does the JIT, forced on.
+    for (int threaded = 0; threaded <= STORE_THREADED_DISPATCH; ++threaded) {
+      for (int jit = 0; jit <= STORE_JIT; ++jit) {
+        SCOPED_TRACE(threaded ? "threaded dispatch" : "switch dispatch");
+        SCOPED_TRACE(jit ? "JIT" : "no JIT");
+        Engine engine;
+        engine.set_threaded_dispatch(threaded);
+        engine.set_jit_threshold(jit ? 0 : -1);
+        TestPrint test_print;
+        engine.RegisterNative("print", &test_print);
+        New::Thread(&store, &engine, closure, Array::EmptyArray, &store);
+        engine.Run();
+
+        EXPECT_EQ(expected, test_print.output()) << test_name;
+      }
+    }
   }
 }
 
@@ -0,0 +1,174 @@
+// Measures the scheduling latency of a latency-sensitive thread running
+// alongside compute-bound threads.
+// The ticker thread calls a native in a loop; the native records the time
+// elapsed since its previous call. The gaps between two ticks are the time
+// the ticker waits for its next time slice. The compute-bound threads either
+// run cheap instructions, or spend their time in a slow native, which the
+// engine cannot preempt.
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "store/engine.h"
+#include "store/values.h"
+
+DEFINE_int64(
+    compute_threads,
+    4,
+    "Number of compute-bound threads: half of them call the slow native."
+);
+
+DEFINE_int64(
+    slow_native_us,
+    50,
+    "Time spent in each call to the slow native, in microseconds."
+);
+
+DEFINE_int64(
+    ticks,
+    20000,
+    "Number of ticks of the latency-sensitive thread."
+);
+
+DEFINE_int64(
+    time_quantum_us,
+    1000,
+    "Time quantum of the engine, in microseconds."
+);
+
+namespace store {
+
+const uint64 kStoreSize = 64 * 1024 * 1024;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Calls to the slow native per compute-bound thread.
+const int64 kSlowLoops = 2000;
+
+// Iterations of the loop of the compute-bound threads running cheap
+// instructions.
+const int64 kFastLoops = 4 * 1000 * 1000;
+
+// Busy-waits for the given number of microseconds.
+Value Spin(Value us) {
+  const Clock::time_point end =
+      Clock::now() + std::chrono::microseconds(IntValue(us));
+  while (Clock::now() < end) {}
+  return us;
+}
+
+// Time of the last tick, and gaps between ticks, in microseconds.
+Clock::time_point last_tick;
+vector<double> gaps;
+
+Value Tick(Value value) {
+  const Clock::time_point now = Clock::now();
+  if (last_tick != Clock::time_point())
+    gaps.push_back(
+        std::chrono::duration<double, std::micro>(now - last_tick).count());
+  last_tick = now;
+  return value;
+}
+
+Operand Local(int index) {
+  return Operand(Register(Register::LOCAL, index));
+}
+
+Operand Immediate(int64 integer) {
+  return Operand(Value::Integer(integer));
+}
+
+// Builds a procedure calling a native N times, on its argument and with the
+// argument as the result:
+//   l2 := [argument argument]
+//   l0 := N
+//   while 0 < l0:
+//     l0 := l0 - 1
+//     native(l2)
+Closure* NewLoopProc(Store* store, const char* native, int64 n,
+                     int64 argument) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Local(2), Immediate(2),
+               Immediate(argument)));
+  code->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(n)));
+  const int64 loop = code->size();
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(1), Immediate(0), Local(0)));
+  code->push_back(
+      Bytecode(Bytecode::BRANCH_UNLESS, Local(1), Immediate(loop + 5)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(0), Local(0),
+               Immediate(1)));
+  code->push_back(
+      Bytecode(Bytecode::CALL_NATIVE, Operand(Atom::Get(native)), Local(2)));
+  code->push_back(Bytecode(Bytecode::BRANCH, Immediate(loop)));
+  return Closure::New(store, code, 0, 3, 0);
+}
+
+// @returns The given percentile of sorted values.
+double Percentile(const vector<double>& sorted, double percentile) {
+  if (sorted.empty()) return 0;
+  const uint64 index = static_cast<uint64>(percentile / 100 * sorted.size());
+  return sorted[std::min<uint64>(index, sorted.size() - 1)];
+}
+
+// Runs the ticker with the compute-bound threads, and reports the gaps
+// between ticks.
+void RunScenario(const char* name, int64 time_quantum_ns,
+                 ThreadPriority ticker_priority) {
+  StaticStore store(kStoreSize);
+  Engine engine;
+  engine.RegisterNative<&Spin>("spin");
+  engine.RegisterNative<&Tick>("tick");
+  engine.set_time_quantum_ns(time_quantum_ns);
+
+  Array* const no_params = Array::New(&store, 0, KAtomNil());
+  for (int64 i = 0; i < FLAGS_compute_threads; ++i) {
+    Closure* const compute = (i % 2 == 0)
+        ? NewLoopProc(&store, "spin", kSlowLoops, FLAGS_slow_native_us)
+        : NewLoopProc(&store, "spin", kFastLoops, 0);
+    New::Thread(&store, &engine, compute, no_params, &store);
+  }
+  Closure* const tick = NewLoopProc(&store, "tick", FLAGS_ticks, 0);
+  Thread* const ticker =
+      Thread::New(&store, &engine, tick, no_params, &store);
+  ticker->set_priority(ticker_priority);
+
+  last_tick = Clock::time_point();
+  gaps.clear();
+  const Clock::time_point start = Clock::now();
+  engine.Run();
+  const double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::sort(gaps.begin(), gaps.end());
+  printf("%-36s gaps (us): p50 %8.1f  p99 %8.1f  p99.9 %8.1f  max %8.1f"
+         "  total %.2fs\n",
+         name, Percentile(gaps, 50), Percentile(gaps, 99),
+         Percentile(gaps, 99.9), gaps.empty() ? 0 : gaps.back(), seconds);
+}
+
+}  // namespace
+
+}  // namespace store
+
+int main(int argc, char** argv) {
+  ::google::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  const int64 quantum_ns = FLAGS_time_quantum_us * 1000;
+  store::RunScenario("fixed time slices", 0, store::PRIORITY_MEDIUM);
+  store::RunScenario("time quantum", quantum_ns, store::PRIORITY_MEDIUM);
+  store::RunScenario("time quantum, high priority ticker", quantum_ns,
+                     store::PRIORITY_HIGH);
+  return EXIT_SUCCESS;
+}
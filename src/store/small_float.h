@@ -0,0 +1,111 @@
+#ifndef STORE_SMALL_FLOAT_H_
+#define STORE_SMALL_FLOAT_H_
+
+#include <string.h>
+
+#include <string>
+using std::string;
+
+#include <boost/format.hpp>
+
+#include <glog/logging.h>
+
+namespace store {
+
+// -----------------------------------------------------------------------------
+// Small floats
+//
+// Double precision floats encoded in a value, without heap allocation.
+//
+// The tag bits are taken from the exponent: the 11 bits exponent is reduced
+// to 8 bits, hence only floats with a magnitude roughly between 1e-38 and
+// 1e38 are encoded (and the two zeros). Other floats (including infinities
+// and NaN) are boxed as Float heap values. The mantissa is kept entirely,
+// so no precision is lost.
+//
+// Encoding: the double bits are rotated left by one bit, to move the sign
+// bit to the least significant bit, then the exponent offset is subtracted,
+// leaving the 3 most significant bits null. These are shifted out to make
+// room for the tag.
+//
+// This class is not meant to be stored. It should only be instantiated as a
+// local variable, where it can be optimized/inlined.
+//
+class SmallFloat {
+ public:
+  static const Value::ValueType kType = Value::SMALL_FLOAT;
+
+  // Encoded exponents are in the range kExponentOffset + [1, 255].
+  static const uint64 kExponentOffset = 1023 - 127;
+  static const int kExponentShift = 53;
+
+  // Returns the float encoded in the given value.
+  static inline
+  double ValueToDouble(const Value& value) {
+    CHECK(value.IsSmallFloat());
+    uint64 bits = value.bits() >> kTagBits;
+    if (bits > 1) bits += kExponentOffset << kExponentShift;
+    return BitsToDouble((bits >> 1) | (bits << 63));
+  }
+
+  static inline
+  bool IsSmallFloat(double value) {
+    const uint64 bits = Rotate(DoubleToBits(value));
+    if (bits <= 1) return true;  // 0.0 or -0.0
+    const uint64 exponent = bits >> kExponentShift;
+    return (exponent > kExponentOffset)
+        && (exponent - kExponentOffset <= 255);
+  }
+
+  SmallFloat(const Value& value) : value_(ValueToDouble(value)) {
+  }
+
+  SmallFloat(double value) : value_(value) {
+    CHECK(IsSmallFloat(value));
+  }
+
+  inline
+  double value() const { return value_; }
+
+  inline
+  Value Encode() const {
+    uint64 bits = Rotate(DoubleToBits(value_));
+    if (bits > 1) bits -= kExponentOffset << kExponentShift;
+    return Value((bits << kTagBits) | kSmallFloatTag);
+  }
+
+  inline
+  uint64 caps() const { return Value::CAP_NONE; }
+
+  void ToASCII(string* repr) const {
+    repr->append((boost::format("%f") % value_).str());
+  }
+
+ private:
+  static inline
+  uint64 DoubleToBits(double value) {
+    uint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  static inline
+  double BitsToDouble(uint64 bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  // Moves the sign bit to the least significant bit.
+  static inline
+  uint64 Rotate(uint64 bits) {
+    return (bits << 1) | (bits >> 63);
+  }
+
+  // The small float value.
+  const double value_;
+};
+
+}  // namespace store
+
+#endif  // STORE_SMALL_FLOAT_H_
@@ -0,0 +1,123 @@
+// Tests for small floats.
+#include "store/values.h"
+
+#include <cmath>
+#include <limits>
+
+#include <gtest/gtest.h>
+
+namespace store {
+
+const uint64 kStoreSize = 1024 * 1024;
+
+class SmallFloatTest : public testing::Test {
+ protected:
+  SmallFloatTest()
+      : store_(kStoreSize) {
+  }
+
+  StaticStore store_;
+};
+
+TEST_F(SmallFloatTest, Encoding) {
+  const double values[] = {
+    0.0, -0.0, 1.0, -1.0, 0.1, 3.14159, -2.5e-30, 1e38, 1.2e-38,
+  };
+  for (double value : values) {
+    ASSERT_TRUE(SmallFloat::IsSmallFloat(value)) << value;
+    Value encoded = SmallFloat(value).Encode();
+    EXPECT_TRUE(encoded.IsSmallFloat());
+    EXPECT_EQ(Value::SMALL_FLOAT, encoded.type());
+    EXPECT_EQ(value, SmallFloat(encoded).value());
+    EXPECT_EQ(std::signbit(value), std::signbit(SmallFloat(encoded).value()));
+  }
+  EXPECT_EQ("1.500000", SmallFloat(1.5).Encode().ToString());
+}
+
+TEST_F(SmallFloatTest, Boxing) {
+  const double values[] = {
+    1e300, -1e-300, std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN(),
+    std::numeric_limits<double>::denorm_min(),
+  };
+  for (double value : values) {
+    EXPECT_FALSE(SmallFloat::IsSmallFloat(value)) << value;
+    Value boxed = New::Float(&store_, value);
+    EXPECT_EQ(Value::FLOAT, boxed.type());
+  }
+
+  const uint64 free = store_.free();
+  Value small = New::Float(&store_, 2.5);
+  EXPECT_TRUE(small.IsSmallFloat());
+  EXPECT_EQ(free, store_.free());
+  EXPECT_EQ(2.5, FloatValue(small));
+  EXPECT_EQ(1e300, FloatValue(New::Float(&store_, 1e300)));
+}
+
+TEST_F(SmallFloatTest, UnifyAndEquals) {
+  Value f1 = New::Float(&store_, 1.5);
+  Value f2 = New::Float(&store_, 1.5);
+  Value f3 = New::Float(&store_, 2.5);
+  EXPECT_TRUE(Unify(f1, f2));
+  EXPECT_TRUE(Equals(f1, f2));
+  EXPECT_FALSE(Unify(f1, f3));
+  EXPECT_FALSE(Equals(f1, f3));
+  EXPECT_FALSE(Unify(f1, Value::Integer(1)));
+
+  Value zero = New::Float(&store_, 0.0);
+  Value neg_zero = New::Float(&store_, -0.0);
+  EXPECT_TRUE(Unify(zero, neg_zero));
+  EXPECT_TRUE(Equals(zero, neg_zero));
+
+  Value var = New::Free(&store_);
+  EXPECT_TRUE(Unify(var, f1));
+  EXPECT_EQ(f1, var.Deref());
+  EXPECT_EQ(f1, f1.Move(&store_));
+}
+
+TEST_F(SmallFloatTest, NotLiterals) {
+  Value f1 = New::Float(&store_, 1.5);
+  Value f2 = New::Float(&store_, 2.5);
+  ASSERT_TRUE(f1.IsSmallFloat());
+  EXPECT_TRUE(f1.LiteralEquals(f1));
+  EXPECT_THROW(f1.LiteralEquals(f2), NotImplemented);
+  EXPECT_THROW(f1.LiteralGetClass(), NotImplemented);
+  EXPECT_THROW(f1.LiteralHashCode(), NotImplemented);
+  EXPECT_THROW(Value::Integer(1).LiteralLessThan(f1), NotImplemented);
+}
+
+TEST_F(SmallFloatTest, Arithmetic) {
+  Value f3 = New::Float(&store_, 3.0);
+  Value f2 = New::Float(&store_, 2.0);
+  EXPECT_EQ(5.0, FloatValue(Float::Add(&store_, f3, f2)));
+  EXPECT_EQ(1.0, FloatValue(Float::Subtract(&store_, f3, f2)));
+  EXPECT_EQ(6.0, FloatValue(Float::Multiply(&store_, f3, f2)));
+  EXPECT_EQ(1.5, FloatValue(Float::Divide(&store_, f3, f2)));
+  EXPECT_EQ(-3.0, FloatValue(Float::Negate(&store_, f3)));
+  EXPECT_EQ(Value(KAtomFalse()), Float::LessThan(f3, f2));
+  EXPECT_EQ(Value(KAtomTrue()), Float::LessOrEqual(f2, f2));
+
+  // Results out of the small float range are boxed:
+  Value big = New::Float(&store_, 1e30);
+  EXPECT_EQ(Value::FLOAT, Float::Multiply(&store_, big, big).type());
+  Value inf = Float::Divide(&store_, f3, New::Float(&store_, 0.0));
+  EXPECT_TRUE(std::isinf(FloatValue(inf)));
+
+  EXPECT_FALSE(Float::Add(&store_, f3, Value::Integer(1)).IsDefined());
+}
+
+TEST_F(SmallFloatTest, Conversions) {
+  EXPECT_EQ(3.0, FloatValue(Float::FromInteger(&store_, Value::Integer(3))));
+  Value big = New::Integer(&store_, mpz_class("100000000000000000000"));
+  EXPECT_EQ(1e20, FloatValue(Float::FromInteger(&store_, big)));
+
+  EXPECT_EQ(Value::Integer(-2),
+            Float::ToInteger(&store_, New::Float(&store_, -2.7)));
+  EXPECT_EQ("100000000000000000000",
+            Float::ToInteger(&store_, New::Float(&store_, 1e20)).ToString());
+  Value inf = New::Float(&store_, std::numeric_limits<double>::infinity());
+  EXPECT_FALSE(Float::ToInteger(&store_, inf).IsDefined());
+  EXPECT_FALSE(Float::FromInteger(&store_, inf).IsDefined());
+}
+
+}  // namespace store
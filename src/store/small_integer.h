@@ -25,7 +25,7 @@ class SmallInteger {
   // Returns the small integer encoded in the given value.
   static inline
   int64 ValueToSmallInt(const Value& value) {
-    CHECK(value.IsSmallInt());
+    DCHECK(value.IsSmallInt());
     return ((int64) value.bits()) >> kTagBits;
   }
 
@@ -19,6 +19,7 @@ bool SmallInteger::LiteralLessThan(Value other) const {
   switch (other.tag()) {
     case kHeapValueTag: return value_ < other.as<Integer>()->mpz();
     case kSmallIntTag: return value_ < SmallInteger(other).value();
+    case kSmallFloatTag: break;  // Floats are not literals.
   }
   throw NotImplemented();
 }
@@ -6,9 +6,7 @@
 
 namespace store {
 
-HeapStore::HeapStore()
-    : nallocs_(0),
-      size_(0) {
+HeapStore::HeapStore() {
 }
 
 HeapStore::~HeapStore() {
@@ -16,8 +14,6 @@ HeapStore::~HeapStore() {
 
 // virtual
 void* HeapStore::Alloc(uint64 size) {
-  nallocs_++;
-  size_ += size;
   return new char[size];
 }
 
@@ -27,9 +23,8 @@ HeapStore* const kHeapStore = new HeapStore();
 
 StaticStore::StaticStore(uint64 size)
     : size_(size),
-      free_(size),
       base_(new char[size]),
-      next_(base_) {
+      used_(0) {
   CHECK_NOTNULL(base_);
 }
 
@@ -40,13 +35,17 @@ StaticStore::~StaticStore() {
 void* StaticStore::Alloc(uint64 size) {
   VLOG(3) << __PRETTY_FUNCTION__
           << " size=" << size
-          << " free=" << free_;
-  // TODO: Ensure 8 bytes alignment
-  if (size > free_) return NULL;
-  void* const new_alloc = next_;
-  free_ -= size;
-  next_ += size;
-  return new_alloc;
+          << " free=" << free();
+  // Keep all blocks aligned on 64 bits words, as required by value tags.
+  size = (size + kAllocAlignment - 1) & ~(kAllocAlignment - 1);
+  // The blocks are published to other OS threads through the values
+  // referencing them: relaxed ordering is enough.
+  uint64 used = used_.load(std::memory_order_relaxed);
+  do {
+    if (size > size_ - used) return NULL;
+  } while (!used_.compare_exchange_weak(used, used + size,
+                                        std::memory_order_relaxed));
+  return base_ + used;
 }
 
 void StaticStore::AddRoot(HeapValue* root) {
@@ -5,6 +5,7 @@
 #ifndef STORE_STORE_H_
 #define STORE_STORE_H_
 
+#include <atomic>
 #include <vector>
 
 #include "base/macros.h"
@@ -14,6 +15,9 @@ namespace store {
 
 class HeapValue;
 
+// Alignment of the memory blocks allocated in a store, in bytes.
+const uint64 kAllocAlignment = 8;
+
 // Computes the size of object T with a nested array A[size];
 template <typename T, typename A>
 uint64 SizeOfWithNestedArray(uint64 size) {
@@ -57,6 +61,8 @@ class Store {
 
 // A store that allocates memory in the heap.
 // This is a temporary solution: there is no way to clean values up.
+// The heap store has no state: it is shared by the engines of all the OS
+// threads.
 class HeapStore : public Store {
  public:
   HeapStore();
@@ -65,12 +71,6 @@ class HeapStore : public Store {
   virtual void* Alloc(uint64 size);
 
  private:
-  // Number of allocs.
-  uint64 nallocs_;
-
-  // Number of bytes allocated.
-  uint64 size_;
-
   DISALLOW_COPY_AND_ASSIGN(HeapStore);
 };
 
@@ -79,6 +79,8 @@ extern HeapStore* const kHeapStore;
 // -----------------------------------------------------------------------------
 
 // A fixed size store.
+// The workers of an engine allocate into the same store concurrently: see
+// Engine::set_workers(). Allocation is a lock-free bump of a pointer.
 class StaticStore : public Store {
  public:
   // Initializes a store with the specified size, in bytes.
@@ -91,7 +93,9 @@ class StaticStore : public Store {
   uint64 size() const { return size_; }
 
   // @returns The space left, in bytes.
-  uint64 free() const { return free_; }
+  uint64 free() const {
+    return size_ - used_.load(std::memory_order_relaxed);
+  }
 
   // @returns Whether the pointer belongs to this store or not.
   // @param ptr The pointer to test.
@@ -112,14 +116,11 @@ class StaticStore : public Store {
   // Size of the store, in bytes.
   const uint64 size_;
 
-  // Space left, in bytes.
-  uint64 free_;
-
   // Bottom of the store memory area.
   char* const base_;
 
-  // Position of the next area to allocate.
-  char* next_;
+  // Space allocated, in bytes: the next area to allocate starts there.
+  std::atomic<uint64> used_;
 
   // Set of roots determining the reachable content of the store.
   UnorderedSet<HeapValue*> roots_;
@@ -23,6 +23,12 @@ bool String::Equals(EqualityContext* context, Value value) {
   return value_ == value.as<String>()->value_;
 }
 
+// virtual
+bool String::StructuralHash(uint32* hash) {
+  *hash = MixHash(kType, std::hash<string>()(value_));
+  return true;
+}
+
 // virtual
 void String::ToASCII(ToASCIIContext* context, string* repr) {
   CHECK_NOTNULL(repr);
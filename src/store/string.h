@@ -28,6 +28,7 @@ class String : public HeapValue {
   virtual ValueType type() const throw() { return kType; }
   virtual bool UnifyWith(UnificationContext* context, Value value);
   virtual bool Equals(EqualityContext* context, Value value);
+  virtual bool StructuralHash(uint32* hash);
 
   // ---------------------------------------------------------------------------
   // Serialization
@@ -0,0 +1,181 @@
+// Generates store/superinstructions.h from the opcode pair profile of the
+// programs of the compile tests: the most frequent pairs of consecutive
+// instructions starting with a quick instruction become superinstructions.
+//
+// Regenerate with:
+//   superinstruction_generator --output=store/superinstructions.h
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+#include <boost/format.hpp>
+using boost::format;
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "base/file-util.h"
+#include "combinators/oznode_eval_visitor.h"
+#include "store/compiler.h"
+#include "store/engine.h"
+#include "store/values.h"
+
+DEFINE_string(
+    oz_compile_path,
+    "store/compile_tests",
+    "Path to the directory of the .ozc programs to profile."
+);
+
+DEFINE_int64(
+    program_runs,
+    100,
+    "Number of times each program is run: the first runs quicken the code."
+);
+
+DEFINE_int64(
+    superinstructions,
+    8,
+    "Number of superinstructions to generate."
+);
+
+DEFINE_string(
+    output,
+    "",
+    "Path of the header to generate. Prints to the standard output if empty."
+);
+
+namespace store {
+
+const uint64 kStoreSize = 256 * 1024 * 1024;  // 256MB
+
+namespace {
+
+// A 'print' native procedure that discards everything.
+class NullPrint : public NativeInterface {
+ public:
+  virtual void Execute(Array* parameters) {}
+};
+
+// Compiles the Main procedure of an .ozc program.
+Closure* CompileProgram(Store* store, const string& source) {
+  combinators::oz::OzParser parser;
+  CHECK(parser.Parse(source)) << "Error parsing:\n" << source;
+  shared_ptr<combinators::oz::OzNodeGeneric> root =
+      std::dynamic_pointer_cast<combinators::oz::OzNodeGeneric>(parser.root());
+  combinators::oz::EvalVisitor visitor(store);
+  for (shared_ptr<combinators::oz::AbstractOzNode> node : root->nodes)
+    visitor.Eval(node.get());
+
+  Compiler compiler(store, NULL);
+  vector<string> env;
+  Closure* const closure =
+      compiler.CompileProcedure(visitor.vars()["Main"], &env);
+  CHECK(env.empty());
+  return closure;
+}
+
+// @returns The scope of an opcode enumerator, as expected by
+//     STORE_SUPERINSTRUCTIONS.
+const char* OpcodeScope(uint8 opcode) {
+  return (opcode < Bytecode::OPCODE_TYPE_COUNT)
+      ? "Bytecode"
+      : "PackedBytecode";
+}
+
+}  // namespace
+
+void ProfilePrograms(OpcodeProfile* profile) {
+  vector<string> names;
+  util::ListDirPattern(FLAGS_oz_compile_path, ".*\\.ozc", &names);
+  CHECK(!names.empty()) << "No program in " << FLAGS_oz_compile_path;
+
+  for (const string& name : names) {
+    const string source = util::ReadFileToString(
+        (format("%s/%s") % FLAGS_oz_compile_path % name).str());
+    StaticStore store(kStoreSize);
+    Closure* const main = CompileProgram(&store, source);
+
+    NullPrint print;
+    Engine engine;
+    engine.RegisterNative("print", &print);
+    engine.set_opcode_profile(profile);
+    for (int64 i = 0; i < FLAGS_program_runs; ++i) {
+      New::Thread(&store, &engine, main, Array::EmptyArray, &store);
+      engine.Run();
+    }
+  }
+}
+
+string GenerateHeader(const OpcodeProfile& profile) {
+  const vector<OpcodeProfile::PairCount> pairs =
+      profile.TopFusablePairs(FLAGS_superinstructions);
+
+  string header;
+  header.append(
+      "// Superinstructions: the most frequent pairs of consecutive "
+      "instructions\n"
+      "// starting with a quick instruction, see PackedBytecode.\n"
+      "//\n"
+      "// Generated by store/superinstruction_generator from the programs "
+      "of the\n"
+      "// compile tests. Do not edit.\n"
+      "#ifndef STORE_SUPERINSTRUCTIONS_H_\n"
+      "#define STORE_SUPERINSTRUCTIONS_H_\n"
+      "\n"
+      "// Pair counts, out of ");
+  header.append(
+      (format("%d instructions:\n") % profile.ninstructions()).str());
+  for (const OpcodeProfile::PairCount& pair : pairs) {
+    header.append((format("//   %10d %s, %s\n")
+                   % pair.count
+                   % PackedCode::OpcodeName(pair.first)
+                   % PackedCode::OpcodeName(pair.second)).str());
+  }
+  vector<string> lines;
+  lines.push_back("#define STORE_SUPERINSTRUCTIONS(V)");
+  for (const OpcodeProfile::PairCount& pair : pairs) {
+    lines.push_back((format("  V(%s, %s, %s)")
+                     % PackedCode::OpcodeName(pair.first)
+                     % OpcodeScope(pair.second)
+                     % PackedCode::OpcodeName(pair.second)).str());
+  }
+  // Continuation backslashes are aligned on column 79.
+  for (uint64 i = 0; i < lines.size(); ++i) {
+    header.append(lines[i]);
+    if (i + 1 < lines.size()) {
+      header.append(std::max<int64>(1, 78 - lines[i].size()), ' ');
+      header.append("\\");
+    }
+    header.append("\n");
+  }
+  header.append(
+      "\n"
+      "#endif  // STORE_SUPERINSTRUCTIONS_H_\n");
+  return header;
+}
+
+}  // namespace store
+
+int main(int argc, char** argv) {
+  ::google::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  store::OpcodeProfile profile;
+  store::ProfilePrograms(&profile);
+  const string header = store::GenerateHeader(profile);
+
+  if (FLAGS_output.empty()) {
+    fputs(header.c_str(), stdout);
+  } else {
+    std::ofstream output(FLAGS_output.c_str());
+    output << header;
+    CHECK(output.good()) << "Error writing " << FLAGS_output;
+  }
+  return EXIT_SUCCESS;
+}
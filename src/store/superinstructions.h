@@ -0,0 +1,28 @@
+// Superinstructions: the most frequent pairs of consecutive instructions
+// starting with a quick instruction, see PackedBytecode.
+//
+// Generated by store/superinstruction_generator from the programs of the
+// compile tests. Do not edit.
+#ifndef STORE_SUPERINSTRUCTIONS_H_
+#define STORE_SUPERINSTRUCTIONS_H_
+
+// Pair counts, out of 47600 instructions:
+//         1400 QUICK_BRANCH_UNLESS_L, ACCESS_RECORD_LABEL
+//         1400 QUICK_BRANCH_UNLESS_L, ACCESS_OPEN_RECORD_ARITY
+//         1100 QUICK_BRANCH_UNLESS_L, ACCESS_RECORD
+//          898 QUICK_TEST_LESS_THAN_LKL, QUICK_BRANCH_IF_L
+//          700 QUICK_NUMBER_INT_ADD_LLK, BRANCH
+//          600 QUICK_BRANCH_UNLESS_L, NEW_ARRAY
+//          500 QUICK_BRANCH_IF_L, NEW_ARRAY
+//          400 QUICK_LOAD_LL, ACCESS_RECORD
+#define STORE_SUPERINSTRUCTIONS(V)                                            \
+  V(QUICK_BRANCH_UNLESS_L, Bytecode, ACCESS_RECORD_LABEL)                     \
+  V(QUICK_BRANCH_UNLESS_L, Bytecode, ACCESS_OPEN_RECORD_ARITY)                \
+  V(QUICK_BRANCH_UNLESS_L, Bytecode, ACCESS_RECORD)                           \
+  V(QUICK_TEST_LESS_THAN_LKL, PackedBytecode, QUICK_BRANCH_IF_L)              \
+  V(QUICK_NUMBER_INT_ADD_LLK, Bytecode, BRANCH)                               \
+  V(QUICK_BRANCH_UNLESS_L, Bytecode, NEW_ARRAY)                               \
+  V(QUICK_BRANCH_IF_L, Bytecode, NEW_ARRAY)                                   \
+  V(QUICK_LOAD_LL, Bytecode, ACCESS_RECORD)
+
+#endif  // STORE_SUPERINSTRUCTIONS_H_
@@ -10,113 +10,663 @@ using boost::format;
 
 namespace store {
 
-uint64 Thread::next_id_ = 0;
-
 Thread::~Thread() {
 }
 
-uint64 Thread::GetNextThreadID() {
-  uint64 id = next_id_;
-  ++next_id_;
-  return id;
-}
-
 // @returns True if the current thread suspends on the specified value.
 //     Registers the waiting thread as a suspension of the free variable.
 // @param value A value that has already been dereferenced.
 bool Thread::WaitOn(Value value) {
   // TODO Find a correct way to report suspensions
   if (value.type() != Value::VARIABLE) return false;
-  Variable* var = value.as<Variable>();
-  var->AddSuspension(this);
+  // Registered by the engine: the thread may run again as soon as it is in
+  // the suspensions of the variable, on another worker.
+  waiting_on_ = value.as<Variable>();
   return true;
 }
 
-Thread::ThreadState Thread::Run(
-    uint64 steps_count,
-    list<Thread*>* new_runnable) {
+namespace {
+
+// Operand kinds of the quick instructions.
+const int kKindL = Register::LOCAL;
+const int kKindP = Register::PARAM;
+const int kKindK = PackedOperand::CONSTANT;
+
+// KAtomTrue() and KAtomFalse() look the atoms up by name.
+inline Value QuickBoolean(bool value) {
+  static const Value kTrue = KAtomTrue();
+  static const Value kFalse = KAtomFalse();
+  return value ? kTrue : kFalse;
+}
 
-  for (uint64 i = 0; i < steps_count; ++i) {
+// Small integer fast paths of the quick instructions.
+// @returns False if the generic instruction must compute the result.
+template <int kOpcode>
+bool QuickSmallIntOp(int64 value1, int64 value2, Value* result);
+
+template <>
+inline bool QuickSmallIntOp<Bytecode::NUMBER_INT_ADD>(
+    int64 value1, int64 value2, Value* result) {
+  int64 sum;
+  if (__builtin_add_overflow(value1, value2, &sum)
+      || !SmallInteger::IsSmallInt(sum))
+    return false;
+  *result = Value::Integer(sum);
+  return true;
+}
 
-    // Warning: Do not use cse after call_stack_ has been modified!
-    CallStackEntry* cse = &call_stack_.back();
-    if (cse->code_pointer_ >= cse->proc_->bytecode().size())
-      goto terminated;
-    const Bytecode& inst =
-        cse->proc_->bytecode()[cse->code_pointer_];
-    VLOG(3) << "Executing: "
-            << (format("closure@%p cp=%d ")
-                % cse->proc_ % cse->code_pointer_).str()
-            << inst.GetOpcodeName();
+template <>
+inline bool QuickSmallIntOp<Bytecode::NUMBER_INT_SUBTRACT>(
+    int64 value1, int64 value2, Value* result) {
+  int64 difference;
+  if (__builtin_sub_overflow(value1, value2, &difference)
+      || !SmallInteger::IsSmallInt(difference))
+    return false;
+  *result = Value::Integer(difference);
+  return true;
+}
 
-    int32 next_code_pointer = cse->code_pointer_ + 1;
+template <>
+inline bool QuickSmallIntOp<Bytecode::TEST_LESS_THAN>(
+    int64 value1, int64 value2, Value* result) {
+  *result = QuickBoolean(value1 < value2);
+  return true;
+}
 
-    switch (inst.opcode) {
-      case Bytecode::NO_OPERATION:
-        break;
+// @returns The condition value on which a conditional branch is taken.
+inline bool BranchTakenOn(int opcode) {
+  return opcode == Bytecode::BRANCH_IF;
+}
+
+// Direct accessors to the operands of quick instructions, by operand kind.
+template <int kKind>
+Value GetOperand(const Thread::CallStackEntry& cse, const Value* constants,
+                 PackedOperand op);
+
+template <>
+inline Value GetOperand<kKindL>(const Thread::CallStackEntry& cse,
+                                const Value* constants, PackedOperand op) {
+  DCHECK_LT(op.index(), cse.nlocals_);
+  return cse.local_values_[op.index()];
+}
+
+template <>
+inline Value GetOperand<kKindP>(const Thread::CallStackEntry& cse,
+                                const Value* constants, PackedOperand op) {
+  return cse.parameters_->Access(op.index());
+}
+
+template <>
+inline Value GetOperand<kKindK>(const Thread::CallStackEntry& cse,
+                                const Value* constants, PackedOperand op) {
+  return constants[op.index()];
+}
+
+template <int kKind>
+void SetOperand(Thread::CallStackEntry* cse, PackedOperand op, Value value);
+
+template <>
+inline void SetOperand<kKindL>(Thread::CallStackEntry* cse, PackedOperand op,
+                               Value value) {
+  DCHECK_LT(op.index(), cse->nlocals_);
+  cse->local_values_[op.index()] = value;
+}
+
+template <>
+inline void SetOperand<kKindP>(Thread::CallStackEntry* cse, PackedOperand op,
+                               Value value) {
+  cse->parameters_->Assign(op.index(), value);
+}
+
+// Outcome of the fast path of a quick instruction.
+enum QuickOutcome {
+  QUICK_NEXT,      // Continue with the next instruction.
+  QUICK_JUMP,      // Jump to the returned code pointer.
+  QUICK_FALLBACK,  // Execute the generic instruction instead.
+};
+
+// The fast path of a quick instruction, shared by the quick instruction and
+// the superinstructions starting with it:
+//   enum { kGeneric };  // The opcode of the generic instruction.
+//   static QuickOutcome Execute(Thread::CallStackEntry* cse,
+//                               const Value* constants,
+//                               const PackedBytecode& inst,
+//                               uint64* target);
+template <int kQuickOpcode>
+struct QuickInstruction;
+
+template <int kD, int kS>
+struct QuickLoad {
+  enum { kGeneric = Bytecode::LOAD };
+
+  static QuickOutcome Execute(Thread::CallStackEntry* cse,
+                              const Value* constants,
+                              const PackedBytecode& inst,
+                              uint64* target) {
+    SetOperand<kD>(cse, inst.operand1,
+                   GetOperand<kS>(*cse, constants, inst.operand2));
+    return QUICK_NEXT;
+  }
+};
+
+template <int kOpcode, int kD, int kS1, int kS2>
+struct QuickBinary {
+  enum { kGeneric = kOpcode };
+
+  static QuickOutcome Execute(Thread::CallStackEntry* cse,
+                              const Value* constants,
+                              const PackedBytecode& inst,
+                              uint64* target) {
+    const Value value1 = GetOperand<kS1>(*cse, constants, inst.operand2);
+    const Value value2 = GetOperand<kS2>(*cse, constants, inst.operand3);
+    Value result;
+    if (!value1.IsSmallInt() || !value2.IsSmallInt()
+        || !QuickSmallIntOp<kOpcode>(SmallInteger(value1).value(),
+                                     SmallInteger(value2).value(),
+                                     &result))
+      return QUICK_FALLBACK;
+    SetOperand<kD>(cse, inst.operand1, result);
+    return QUICK_NEXT;
+  }
+};
+
+template <int kOpcode, int kC>
+struct QuickBranch {
+  enum { kGeneric = kOpcode };
+
+  static QuickOutcome Execute(Thread::CallStackEntry* cse,
+                              const Value* constants,
+                              const PackedBytecode& inst,
+                              uint64* target) {
+    const Value cond = GetOperand<kC>(*cse, constants, inst.operand1);
+    const bool taken_on = BranchTakenOn(kOpcode);
+    if (cond == QuickBoolean(taken_on)) {
+      *target = SmallInteger(constants[inst.operand2.index()]).value();
+      return QUICK_JUMP;
+    }
+    if (cond != QuickBoolean(!taken_on)) return QUICK_FALLBACK;
+    return QUICK_NEXT;
+  }
+};
+
+#define QUICK_LOAD_INSTRUCTION(D, S)                                    \
+template <>                                                             \
+struct QuickInstruction<PackedBytecode::QUICK_LOAD_##D##S>              \
+    : public QuickLoad<kKind##D, kKind##S> {};
+
+STORE_QUICK_LOADS(QUICK_LOAD_INSTRUCTION)
+#undef QUICK_LOAD_INSTRUCTION
+
+#define QUICK_BINARY_INSTRUCTION(Opcode, D, S1, S2)                     \
+template <>                                                             \
+struct QuickInstruction<PackedBytecode::QUICK_##Opcode##_##D##S1##S2>   \
+    : public QuickBinary<Bytecode::Opcode, kKind##D, kKind##S1,         \
+                         kKind##S2> {};
+
+STORE_QUICK_BINARIES(QUICK_BINARY_INSTRUCTION)
+#undef QUICK_BINARY_INSTRUCTION
+
+#define QUICK_BRANCH_INSTRUCTION(Opcode, C)                             \
+template <>                                                             \
+struct QuickInstruction<PackedBytecode::QUICK_##Opcode##_##C>           \
+    : public QuickBranch<Bytecode::Opcode, kKind##C> {};
+
+STORE_QUICK_BRANCHES(QUICK_BRANCH_INSTRUCTION)
+#undef QUICK_BRANCH_INSTRUCTION
+
+// -----------------------------------------------------------------------------
+// Record access
+
+// @returns The value as a Record, or NULL if it is not a Record.
+inline Record* AsRecord(Value value) {
+  if (!value.IsHeapValue()) return NULL;
+  HeapValue* const heap_value = value.heap_value();
+  return (heap_value->type() == Value::RECORD)
+      ? static_cast<Record*>(heap_value)
+      : NULL;
+}
+
+// @returns Whether both operands of an integer instruction or a comparison
+//     are floats, small or boxed. The compiler picks the float instructions
+//     for the operands it knows to be floats: the integer instructions and
+//     the comparisons compute on floats too, and reject operands mixing
+//     integers and floats.
+inline bool AreFloats(Value number1, Value number2) {
+  return Float::IsFloat(number1) && Float::IsFloat(number2);
+}
 
-      case Bytecode::LOAD: {
-        RSet(inst.operand1, OpGet(inst.operand2));
+// Accesses a feature of a record through the inline cache of the
+// instruction. Fills the cache on a miss.
+//
+// @param record A determined value with CAP_RECORD.
+// @param as_record The record as a Record, or NULL for any other record type.
+// @param feature A determined value. Features that are not literals are not
+//     found.
+// @param value Returns the value of the feature, or the variable to wait on:
+//     see Value::TryRecordGet().
+inline LookupStatus CachedRecordGet(RecordAccessCache* cache, Value record,
+                                    Record* as_record, Value feature,
+                                    Value* value) {
+  if (as_record == NULL) {
+    cache->CountMiss();
+    if (!(feature.caps() & Value::CAP_LITERAL)) return LOOKUP_NOT_FOUND;
+    return record.TryRecordGet(feature, value);
+  }
+
+  Arity* const arity = as_record->arity();
+  const int64 cached_slot = cache->Lookup(arity, feature);
+  if (cached_slot >= 0) {
+    *value = as_record->values()[cached_slot];
+    return LOOKUP_FOUND;
+  }
+
+  if (!(feature.caps() & Value::CAP_LITERAL)) return LOOKUP_NOT_FOUND;
+  uint64 slot;
+  if (!arity->TryMap(feature, &slot)) return LOOKUP_NOT_FOUND;
+  if (feature.IsSmallInt() || HasType(feature, Value::ATOM))
+    cache->Insert(arity, feature, slot);
+  *value = as_record->values()[slot];
+  return LOOKUP_FOUND;
+}
+
+}  // namespace
+
+Array* Thread::PromoteLocals() {
+  CallStackEntry* const cse = &call_stack_.back();
+  if (cse->locals_ == NULL) {
+    Array* const locals = Array::New(store_, cse->nlocals_, KAtomEmpty());
+    for (uint64 i = 0; i < cse->nlocals_; ++i)
+      locals->Assign(i, cse->local_values_[i]);
+    cse->locals_ = locals;
+    LoadLocals();
+  }
+  return cse->locals_;
+}
+
+uint8 Thread::QuickOpcode(const PackedBytecode& inst,
+                          const Value* constants) {
+  const int kind1 = inst.operand1.kind();
+  const int kind2 = inst.operand2.kind();
+  const int kind3 = inst.operand3.kind();
+
+  switch (inst.opcode) {
+    case Bytecode::LOAD: {
+#define QUICK_LOAD_CASE(D, S)                                           \
+      if ((kind1 == kKind##D) && (kind2 == kKind##S))                   \
+        return PackedBytecode::QUICK_LOAD_##D##S;
+
+      STORE_QUICK_LOADS(QUICK_LOAD_CASE)
+#undef QUICK_LOAD_CASE
+      break;
+    }
+
+    case Bytecode::NUMBER_INT_ADD:
+    case Bytecode::NUMBER_INT_SUBTRACT:
+    case Bytecode::TEST_LESS_THAN: {
+#define QUICK_BINARY_CASE(Opcode, D, S1, S2)                            \
+      if ((inst.opcode == Bytecode::Opcode) && (kind1 == kKind##D)      \
+          && (kind2 == kKind##S1) && (kind3 == kKind##S2)) {            \
+        /* Quickened only when operating on small integers. */         \
+        if (!OpGet(inst.operand2, constants).IsSmallInt()               \
+            || !OpGet(inst.operand3, constants).IsSmallInt())           \
+          break;                                                        \
+        return PackedBytecode::QUICK_##Opcode##_##D##S1##S2;            \
+      }
+
+      STORE_QUICK_BINARIES(QUICK_BINARY_CASE)
+#undef QUICK_BINARY_CASE
+      break;
+    }
+
+    case Bytecode::BRANCH_IF:
+    case Bytecode::BRANCH_UNLESS: {
+      // The branch target must be a constant code pointer.
+      if ((kind2 != kKindK)
+          || !constants[inst.operand2.index()].IsSmallInt())
         break;
+#define QUICK_BRANCH_CASE(Opcode, C)                                    \
+      if ((inst.opcode == Bytecode::Opcode) && (kind1 == kKind##C)) {   \
+        const Value cond = OpGet(inst.operand1, constants);             \
+        if ((cond != QuickBoolean(true))                                \
+            && (cond != QuickBoolean(false)))                           \
+          break;                                                        \
+        return PackedBytecode::QUICK_##Opcode##_##C;                    \
       }
 
-      case Bytecode::UNIFY: {
+      STORE_QUICK_BRANCHES(QUICK_BRANCH_CASE)
+#undef QUICK_BRANCH_CASE
+      break;
+    }
+  }
+  return inst.opcode;
+}
+
+bool Thread::RunJit(PackedCode* packed_code, uint64* code_pointer,
+                    int64* budget, ThreadList* new_runnable) {
+  CallStackEntry* const cse = &call_stack_.back();
+  const JitCode* const jit_code =
+      packed_code->CountJitEntry(engine_->jit_threshold());
+  if (jit_code == NULL) return false;
+  const void* const entry = jit_code->entry(*code_pointer);
+  if ((entry == NULL)
+      || !jit_code->CanRun(cse->nlocals_, cse->parameters_->size()))
+    return false;
+
+  JitFrame frame;
+  frame.locals = cse->local_values_;
+  frame.parameters = cse->parameters_->mutable_values();
+  frame.constants = packed_code->constants();
+  frame.budget = *budget;
+  frame.store = store_;
+  frame.new_runnable = new_runnable;
+  *code_pointer = jit_code->Run(&frame, entry);
+  *budget = frame.budget;
+  return true;
+}
+
+Thread::ThreadState Thread::Run(
+    uint64 steps_count,
+    ThreadList* new_runnable) {
+#if STORE_THREADED_DISPATCH
+  if (engine_->threaded_dispatch() && (engine_->opcode_profile() == NULL))
+    return Execute<true>(steps_count, new_runnable);
+#endif
+  return Execute<false>(steps_count, new_runnable);
+}
+
+// The interpreter loop, shared by both dispatch modes.
+// It executes the packed code of the procedures: see PackedCode.
+//
+// Each instruction handler ends by dispatching the next instruction:
+//  - NEXT() moves to the following instruction;
+//  - JUMP(code_pointer) moves to an instruction of the current frame;
+//  - ENTER_FRAME() resumes the frame on top of the call stack;
+//  - FUSED_NEXT(Opcode) continues a superinstruction with the handler of its
+//    second instruction, without dispatching.
+// With the switch dispatch, handlers go back to the switch. With the threaded
+// dispatch, handlers jump directly to the handler of the next instruction.
+//
+// The current frame and instruction are cached in locals: the code pointer of
+// the frame is written back only when leaving the frame or the loop.
+// The step budget is charged at backward branches and at frame changes only:
+// a backward branch charges the length of the loop it closes.
+//
+// With the JIT enabled, the native code of the procedures runs from the same
+// points: at backward branches and frame changes. It exits back into the
+// interpreter for the instructions it does not handle.
+template <bool kThreaded>
+Thread::ThreadState Thread::Execute(
+    uint64 steps_count,
+    ThreadList* new_runnable) {
+
+  int64 budget = steps_count;
+
+  // Warning: Reload cse with LOAD_FRAME() after call_stack_ is modified!
+  CallStackEntry* cse;
+  PackedCode* packed_code;  // Packed code of the current frame
+  const PackedBytecode* code;
+  uint64 code_size;
+  const PackedBytecode* inst;  // Current instruction
+  const Value* constants;  // Constant pool of the current frame
+
+  // Profiled threads run with the switch dispatch: see Run().
+  OpcodeProfile* const profile = engine_->opcode_profile();
+  const PackedBytecode* previous = NULL;  // Previous profiled instruction
+
+  // Profiled threads do not run native code: see Engine::jit_threshold().
+  const bool jit = (engine_->jit_threshold() >= 0) && (profile == NULL);
+
+  // Procedures run in the packed code of the worker: see CodeContext.
+  CodeContext* const code_context = engine_->code_context();
+
+#define SAVE_FRAME() (cse->code_pointer_ = inst - code)
+
+// The budget is overdrawn when a thread is preempted.
+#define CHARGE_STEPS() (steps_ += static_cast<int64>(steps_count) - budget)
+
+#define LOAD_FRAME()                                   \
+  do {                                                 \
+    cse = &call_stack_.back();                         \
+    packed_code = code_context->Code(cse->proc_->packed_code()); \
+    code = packed_code->code();                        \
+    code_size = packed_code->size();                   \
+    constants = packed_code->constants();              \
+    if (cse->code_pointer_ >= code_size)               \
+      goto terminated;                                 \
+    inst = code + cse->code_pointer_;                  \
+    previous = NULL;                                   \
+  } while (false)
+
+#if STORE_THREADED_DISPATCH
+#define INSTRUCTION(Opcode) case Bytecode::Opcode: op_##Opcode
+#define QUICK_INSTRUCTION(Opcode) case PackedBytecode::Opcode: op_##Opcode
+
+  // Handler addresses, in the order of PackedBytecode::opcode.
+  static const void* const kHandlers[] = {
+#define GENERIC_LABEL(Opcode) &&op_##Opcode,
+    STORE_BYTECODE_OPCODES(GENERIC_LABEL)
+#undef GENERIC_LABEL
+
+    // Quick instructions and superinstructions.
+#define QUICK_LOAD_LABEL(D, S) &&op_QUICK_LOAD_##D##S,
+    STORE_QUICK_LOADS(QUICK_LOAD_LABEL)
+#undef QUICK_LOAD_LABEL
+#define QUICK_BINARY_LABEL(Opcode, D, S1, S2) &&op_QUICK_##Opcode##_##D##S1##S2,
+    STORE_QUICK_BINARIES(QUICK_BINARY_LABEL)
+#undef QUICK_BINARY_LABEL
+#define QUICK_BRANCH_LABEL(Opcode, C) &&op_QUICK_##Opcode##_##C,
+    STORE_QUICK_BRANCHES(QUICK_BRANCH_LABEL)
+#undef QUICK_BRANCH_LABEL
+#define SUPER_LABEL(First, SecondScope, Second)        \
+    &&op_SUPER_##First##_THEN_##Second,
+    STORE_SUPERINSTRUCTIONS(SUPER_LABEL)
+#undef SUPER_LABEL
+  };
+  static_assert(sizeof(kHandlers) / sizeof(kHandlers[0])
+                == PackedBytecode::PACKED_OPCODE_COUNT,
+                "Missing instruction handlers");
+
+#define DISPATCH()                                     \
+  do {                                                 \
+    if (kThreaded) goto *kHandlers[inst->opcode];      \
+    goto dispatch;                                     \
+  } while (false)
+
+// Continues a superinstruction with the handler of its second instruction.
+#define FUSED_NEXT(Second)                             \
+  do {                                                 \
+    ++inst;                                            \
+    if (kThreaded) goto op_##Second;                   \
+    goto dispatch;                                     \
+  } while (false)
+
+#else
+#define INSTRUCTION(Opcode) case Bytecode::Opcode
+#define QUICK_INSTRUCTION(Opcode) case PackedBytecode::Opcode
+#define DISPATCH() goto dispatch
+#define FUSED_NEXT(Second)                             \
+  do {                                                 \
+    ++inst;                                            \
+    goto dispatch;                                     \
+  } while (false)
+#endif
+
+// Instructions the quick variants fall back to.
+#define QUICKENING_INSTRUCTION(Opcode) case Bytecode::Opcode: op_##Opcode
+
+// Rewrites the current instruction into a quick variant, when it has one for
+// the kinds and the values of its operands. Instructions are tried once:
+// those without a quick variant are marked, and stay generic.
+#define QUICKEN()                                                       \
+  do {                                                                  \
+    if (!inst->quick() && !packed_code->unquickened(inst - code)) {     \
+      const uint8 quick = QuickOpcode(*inst, constants);                \
+      if (quick != inst->opcode)                                        \
+        packed_code->Quicken(inst - code, quick);                       \
+      else                                                              \
+        packed_code->set_unquickened(inst - code);                      \
+    }                                                                   \
+  } while (false)
+
+// Executes the generic instruction a quick instruction falls back to.
+#define GOTO_GENERIC(Opcode)                                            \
+  do {                                                                  \
+    switch (static_cast<int>(Opcode)) {                                 \
+      case Bytecode::LOAD: goto op_LOAD;                                \
+      case Bytecode::BRANCH_IF: goto op_BRANCH_IF;                      \
+      case Bytecode::BRANCH_UNLESS: goto op_BRANCH_UNLESS;              \
+      case Bytecode::TEST_LESS_THAN: goto op_TEST_LESS_THAN;            \
+      case Bytecode::NUMBER_INT_ADD: goto op_NUMBER_INT_ADD;            \
+      case Bytecode::NUMBER_INT_SUBTRACT: goto op_NUMBER_INT_SUBTRACT;  \
+    }                                                                   \
+    LOG(FATAL) << "No generic instruction for opcode "                  \
+               << static_cast<int>(inst->opcode);                       \
+  } while (false)
+
+// Executes the fast path of a quick instruction, then continues with the
+// next instruction as specified, or jumps, or falls back to the generic
+// instruction.
+#define QUICK_STEP(QuickOpcode, Continue)                               \
+  do {                                                                  \
+    typedef QuickInstruction<PackedBytecode::QuickOpcode> Quick;        \
+    uint64 quick_target = 0;                                            \
+    switch (Quick::Execute(cse, constants, *inst, &quick_target)) {     \
+      case QUICK_NEXT: Continue;                                        \
+      case QUICK_JUMP: JUMP(quick_target);                              \
+      case QUICK_FALLBACK: GOTO_GENERIC(Quick::kGeneric);               \
+    }                                                                   \
+  } while (false)
+
+#define NEXT()                                         \
+  do {                                                 \
+    ++inst;                                            \
+    if (inst == code + code_size) goto terminated;     \
+    DISPATCH();                                        \
+  } while (false)
+
+// Runs the native code of the current frame from the current instruction,
+// if the procedure is compiled. Resumes where the native code exits.
+#define JIT_ENTER()                                    \
+  do {                                                 \
+    uint64 jit_code_pointer = inst - code;             \
+    if (jit                                            \
+        && RunJit(packed_code, &jit_code_pointer, &budget, new_runnable)) { \
+      if (jit_code_pointer >= code_size) goto terminated; \
+      inst = code + jit_code_pointer;                  \
+      if (budget <= 0) goto preempted;                 \
+    }                                                  \
+  } while (false)
+
+#define JUMP(CodePointer)                              \
+  do {                                                 \
+    const uint64 target = (CodePointer);               \
+    if (target >= code_size) goto terminated;          \
+    if (code + target <= inst) {                       \
+      budget -= inst - (code + target) + 1;            \
+      inst = code + target;                            \
+      if (budget <= 0) goto preempted;                 \
+      JIT_ENTER();                                     \
+    } else {                                           \
+      inst = code + target;                            \
+    }                                                  \
+    DISPATCH();                                        \
+  } while (false)
+
+#define ENTER_FRAME()                                  \
+  do {                                                 \
+    LOAD_FRAME();                                      \
+    if (--budget <= 0) goto preempted;                 \
+    JIT_ENTER();                                       \
+    DISPATCH();                                        \
+  } while (false)
+
+  LOAD_FRAME();
+  JIT_ENTER();
+  DISPATCH();
+
+ dispatch:
+  VLOG(3) << "Executing: "
+          << (format("closure@%p cp=%d ") % cse->proc_ % (inst - code)).str()
+          << cse->proc_->bytecode()[inst - code].ToString();
+  if (!kThreaded && (profile != NULL)) {
+    profile->Record(previous, inst);
+    previous = inst;
+  }
+
+  switch (inst->opcode) {
+      INSTRUCTION(NO_OPERATION): {
+        NEXT();
+      }
+
+      QUICKENING_INSTRUCTION(LOAD): {
+        QUICKEN();
+        RSet(inst->operand1, OpGet(inst->operand2, constants));
+        NEXT();
+      }
+
+      INSTRUCTION(UNIFY): {
         const bool success =
             store::Unify(
-                OpGet(inst.operand1),
-                OpGet(inst.operand2),
+                OpGet(inst->operand1, constants),
+                OpGet(inst->operand2, constants),
                 new_runnable);
         if (!success) {
           // TODO: throw an exception instead
           goto bad_operand;
         }
-        break;
+        NEXT();
       }
 
-      case Bytecode::TRY_UNIFY: {
+      INSTRUCTION(TRY_UNIFY): {
         const bool success =
             store::Unify(
-                OpGet(inst.operand1),
-                OpGet(inst.operand2),
+                OpGet(inst->operand1, constants),
+                OpGet(inst->operand2, constants),
                 new_runnable);
-        RSet(inst.operand3, success ? KAtomTrue() : KAtomFalse());
-        break;
+        RSet(inst->operand3, success ? KAtomTrue() : KAtomFalse());
+        NEXT();
       }
 
-      case Bytecode::UNIFY_RECORD_FIELD: {
-        Value record = OpGet(inst.operand1).Deref();
+      INSTRUCTION(UNIFY_RECORD_FIELD): {
+        Value record = OpGet(inst->operand1, constants).Deref();
         if (WaitOn(record)) goto suspended;
-        if (!(record.caps() & Value::CAP_RECORD)) goto bad_operand;
+        Record* const as_record = AsRecord(record);
+        if ((as_record == NULL) && !(record.caps() & Value::CAP_RECORD))
+          goto bad_operand;
 
-        Value feature = OpGet(inst.operand2).Deref();
+        Value feature = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(feature)) goto suspended;
-        if (!(feature.caps() & Value::CAP_LITERAL)) goto bad_operand;
+        Value field;
+        switch (CachedRecordGet(packed_code->record_cache(inst - code),
+                                record, as_record, feature, &field)) {
+          case LOOKUP_FOUND: break;
+          case LOOKUP_NOT_FOUND: goto bad_operand;
+          case LOOKUP_SUSPENDED: WaitOn(field); goto suspended;
+        }
 
         const bool success =
             store::Unify(
-                record.RecordGet(feature),
-                OpGet(inst.operand3),
+                field,
+                OpGet(inst->operand3, constants),
                 new_runnable);
         if (!success) {
           // TODO: throw an exception instead
           goto bad_operand;
         }
-        break;
+        NEXT();
       }
 
       // -----------------------------------------------------------------------
       // Control-flow
 
-      case Bytecode::BRANCH: {
-        Value bc_pointer = OpGet(inst.operand1).Deref();
-        if (!HasType(bc_pointer, Value::SMALL_INTEGER)) goto bad_operand;
-
-        next_code_pointer = SmallInteger(bc_pointer).value();
-        break;
+      // Branch targets are small integer constants: see VerifyBytecode().
+      INSTRUCTION(BRANCH): {
+        JUMP(SmallInteger(constants[inst->operand1.index()]).value());
       }
 
-      case Bytecode::BRANCH_IF: {
-        Value cond_val = OpGet(inst.operand1).Deref();
+      QUICKENING_INSTRUCTION(BRANCH_IF): {
+        QUICKEN();
+        Value cond_val = OpGet(inst->operand1, constants).Deref();
         if (WaitOn(cond_val)) goto suspended;
         // if (!HasType(cond_val, Value::BOOLEAN)) goto bad_operand;
         bool cond;
@@ -124,19 +674,15 @@ Thread::ThreadState Thread::Run(
         else if (cond_val == KAtomFalse()) cond = false;
         else goto bad_operand;
 
-        // The following check could be statically verified.
-        Value bc_pointer = OpGet(inst.operand2).Deref();
-        if (!HasType(bc_pointer, Value::SMALL_INTEGER)) goto bad_operand;
-
         // const bool cond = cond_val.as<Boolean>()->value();
-        if (cond) {
-          next_code_pointer = SmallInteger(bc_pointer).value();
-        }
-        break;
+        if (cond)
+          JUMP(SmallInteger(constants[inst->operand2.index()]).value());
+        NEXT();
       }
 
-      case Bytecode::BRANCH_UNLESS: {
-        Value cond_val = OpGet(inst.operand1).Deref();
+      QUICKENING_INSTRUCTION(BRANCH_UNLESS): {
+        QUICKEN();
+        Value cond_val = OpGet(inst->operand1, constants).Deref();
         if (WaitOn(cond_val)) goto suspended;
         // if (!HasType(cond_val, Value::BOOLEAN)) goto bad_operand;
         bool cond;
@@ -144,515 +690,765 @@ Thread::ThreadState Thread::Run(
         else if (cond_val == KAtomFalse()) cond = false;
         else goto bad_operand;
 
-        // The following check could be statically verified.
-        Value bc_pointer = OpGet(inst.operand2).Deref();
-        if (!HasType(bc_pointer, Value::SMALL_INTEGER)) goto bad_operand;
-
         // const bool cond = cond_val.as<Boolean>()->value();
-        if (!cond) {
-          next_code_pointer = SmallInteger(bc_pointer).value();
-        }
-        break;
+        if (!cond)
+          JUMP(SmallInteger(constants[inst->operand2.index()]).value());
+        NEXT();
       }
 
-      case Bytecode::BRANCH_SWITCH_LITERAL: {
-        Value branches = OpGet(inst.operand2).Deref();
-        if (!(branches.caps() & Value::CAP_ARITY)) goto bad_operand;
+      INSTRUCTION(BRANCH_SWITCH_LITERAL): {
+        // Branches map literals to code pointers.
+        Value branches = OpGet(inst->operand2, constants).Deref();
+        if (!(branches.caps() & Value::CAP_RECORD)) goto bad_operand;
 
-        Value value = OpGet(inst.operand1).Deref();
+        Value value = OpGet(inst->operand1, constants).Deref();
         if (WaitOn(value)) goto suspended;
         if (!(value.caps() & Value::CAP_LITERAL)) goto bad_operand;
 
-        try {
-          Value bc_pointer = branches.RecordGet(value).Deref();
-          if (!HasType(bc_pointer, Value::SMALL_INTEGER)) goto bad_operand;
-          next_code_pointer = SmallInteger(bc_pointer).value();
-        } catch (FeatureNotFound) {
-          // Move to next instruction
+        Value bc_pointer;
+        switch (branches.TryRecordGet(value, &bc_pointer)) {
+          case LOOKUP_FOUND: break;
+          case LOOKUP_NOT_FOUND: NEXT();  // No branch for the value
+          case LOOKUP_SUSPENDED: WaitOn(bc_pointer); goto suspended;
         }
-        break;
+        bc_pointer = bc_pointer.Deref();
+        if (!HasType(bc_pointer, Value::SMALL_INTEGER)) goto bad_operand;
+        JUMP(SmallInteger(bc_pointer).value());
       }
 
-      case Bytecode::CALL: {
-        Value closure_val = OpGet(inst.operand1).Deref();
+      INSTRUCTION(CALL): {
+        Value closure_val = OpGet(inst->operand1, constants).Deref();
         if (WaitOn(closure_val)) goto suspended;
         if (!HasType(closure_val, Value::CLOSURE)) goto bad_operand;
         Closure* closure = closure_val.as<Closure>();
 
-        Value params_val = OpGet(inst.operand2).Deref();
+        Value params_val = OpGet(inst->operand2, constants).Deref();
         if (!HasType(params_val, Value::ARRAY)) goto bad_operand;
         Array* params = params_val.as<Array>();
+        if (!closure->CanCall(params)) goto bad_operand;
 
-        cse->code_pointer_ = next_code_pointer;
-        call_stack_.push_back(CallStackEntry(store_, closure, params));
-        // Do not use cse after call_stack_ has been modified!
-        continue;
-        break;
+        cse->code_pointer_ = inst - code + 1;
+        PushFrame(closure, params);
+        ENTER_FRAME();
       }
 
-      case Bytecode::RETURN: {
-        const ExnStackEntry* finally_handler = NULL;
-        while (!cse->exn_handlers_.empty()) {
-          const ExnStackEntry& ese = cse->exn_handlers_.back();
-          if (ese.type_ == ExnStackEntry::FINALLY) {
-            finally_handler = &ese;
-            break;
-          }
-          cse->exn_handlers_.pop_back();
-        }
-        if (finally_handler != NULL) {
-          // Finally handler found: branch to it.
-          next_code_pointer = finally_handler->code_pointer_;
-          cse->exn_handlers_.pop_back();
-        } else {
-          // No finally handler in the current call: back to caller.
-          call_stack_.pop_back();
-          if (call_stack_.empty()) goto terminated;
-          // Do not use cse after call_stack_ is modified!
-          continue;
-        }
-        break;
+      INSTRUCTION(RETURN): {
+        // Returning from a try block runs its finally handler first.
+        const ExnHandler* const finally =
+            packed_code->FindExnHandler(inst - code, true);
+        if (finally != NULL) JUMP(finally->handler);
+
+        // No finally handler in the current call: back to caller.
+        PopFrame();
+        if (call_stack_.empty()) goto terminated;
+        ENTER_FRAME();
       }
 
-      case Bytecode::CALL_TAIL: {
-        Value closure_val = OpGet(inst.operand1).Deref();
+      INSTRUCTION(CALL_TAIL): {
+        Value closure_val = OpGet(inst->operand1, constants).Deref();
         if (WaitOn(closure_val)) goto suspended;
         if (!HasType(closure_val, Value::CLOSURE)) goto bad_operand;
         Closure* closure = closure_val.as<Closure>();
 
-        Value params_val = OpGet(inst.operand2).Deref();
+        Value params_val = OpGet(inst->operand2, constants).Deref();
         if (!HasType(params_val, Value::ARRAY)) goto bad_operand;
         Array* params = params_val.as<Array>();
+        if (!closure->CanCall(params)) goto bad_operand;
 
         cse->proc_ = closure;
         cse->parameters_ = params;
-        // keep the existing cse->locals_
+        // Reuse the existing local registers: the register window is resized
+        // for the new procedure, promoted local registers are kept if they
+        // are enough for the new procedure.
+        if ((cse->locals_ != NULL)
+            && (cse->locals_->size() < closure->nlocals()))
+          cse->locals_ = NULL;
+        if (cse->locals_ == NULL) ResizeLocals(closure->nlocals());
         cse->array_ = NULL;
-        cse->exn_handlers_.clear();
-        next_code_pointer = 0;
-        break;
+        cse->code_pointer_ = 0;
+        ENTER_FRAME();
       }
 
-      case Bytecode::CALL_NATIVE: {
-        Value native_val = OpGet(inst.operand1).Deref();
-        if (WaitOn(native_val)) goto suspended;
-        if (!HasType(native_val, Value::ATOM)) goto bad_operand;
-        const string& native_name = native_val.as<Atom>()->value();
+      INSTRUCTION(CALL_NATIVE): {
+        // Natives with a constant name are resolved when packed.
+        uint64 native_id;
+        if (inst->operand3.kind() == PackedOperand::NATIVE) {
+          native_id = inst->operand3.index();
+        } else {
+          Value native_val = OpGet(inst->operand1, constants).Deref();
+          if (WaitOn(native_val)) goto suspended;
+          if (!HasType(native_val, Value::ATOM)) goto bad_operand;
+          const string& name = native_val.as<Atom>()->value();
+          if (!Engine::FindNativeId(name, &native_id)) {
+            LOG(ERROR) << "Unknown native: " << name;
+            goto bad_operand;
+          }
+          // Constant names registered since the procedure was packed.
+          if (inst->operand1.is_constant()
+              && (native_id <= static_cast<uint64>(PackedOperand::kMaxIndex)))
+            packed_code->ResolveNative(inst - code, native_id);
+        }
+        const Native* const native = engine_->native(native_id);
+        if (native == NULL) {
+          LOG(ERROR) << "Unknown native: " << Engine::NativeName(native_id);
+          goto bad_operand;
+        }
 
-        Value params_val = OpGet(inst.operand2).Deref();
+        Value params_val = OpGet(inst->operand2, constants).Deref();
         if (!HasType(params_val, Value::ARRAY)) goto bad_operand;
         Array* params = params_val.as<Array>();
 
-        // TODO: Better implementation for natives?
-        engine_->native_map_[native_name]->Execute(params);
-        break;
+        if (native->function != NULL) {
+          // The parameters are followed by the result.
+          if (params->size() <= native->nparams) goto bad_operand;
+          const Value result = native->function(store_, params->values());
+          if (!result.IsDefined()) goto bad_operand;
+          if (!store::Unify(params->Access(params->size() - 1), result,
+                            new_runnable))
+            goto bad_operand;
+        } else if (!native->object->Execute(store_, params)) {
+          goto bad_operand;
+        }
+        NEXT();
       }
 
       // -----------------------------------------------------------------------
       // Exception handling
 
-      case Bytecode::EXN_PUSH_CATCH: {
-        Value bc_pointer_val = OpGet(inst.operand1);
-        if (!HasType(bc_pointer_val, Value::SMALL_INTEGER)) goto bad_operand;
-        const uint64 bc_pointer = SmallInteger(bc_pointer_val).value();
-
-        cse->exn_handlers_.push_back(
-            ExnStackEntry(ExnStackEntry::CATCH, bc_pointer));
-        break;
-      }
-
-      case Bytecode::EXN_PUSH_FINALLY: {
-        Value bc_pointer_val = OpGet(inst.operand1);
-        if (!HasType(bc_pointer_val, Value::SMALL_INTEGER)) goto bad_operand;
-        const uint64 bc_pointer = SmallInteger(bc_pointer_val).value();
-
-        cse->exn_handlers_.push_back(
-            ExnStackEntry(ExnStackEntry::FINALLY, bc_pointer));
-        break;
+      // Try blocks are delimited by EXN_PUSH_* and EXN_POP, and their
+      // handlers are looked up in the exception table of the packed code:
+      // entering a try block costs nothing.
+      INSTRUCTION(EXN_PUSH_CATCH):
+      INSTRUCTION(EXN_PUSH_FINALLY): {
+        NEXT();
       }
 
-      case Bytecode::EXN_POP: {
-        if (cse->exn_handlers_.empty()) goto bad_operand;
-        const ExnStackEntry& ese = cse->exn_handlers_.back();
-        if (ese.type_ == ExnStackEntry::FINALLY)
-          // Branch to the finally block
-          next_code_pointer = ese.code_pointer_;
-        cse->exn_handlers_.pop_back();
-        break;
+      INSTRUCTION(EXN_POP): {
+        // Leaving a try block runs its finally handler.
+        if (inst->operand1.is_constant())
+          JUMP(SmallInteger(constants[inst->operand1.index()]).value());
+        NEXT();
       }
 
-      case Bytecode::EXN_RERAISE: {
-        Value exn_val = OpGet(inst.operand1);
+      INSTRUCTION(EXN_RERAISE): {
+        Value exn_val = OpGet(inst->operand1, constants);
         if (!exn_val.IsDetermined())
-          break;  // Do not raise!
+          NEXT();  // Do not raise!
         // Fall through EXN_RAISE
       }
 
-      case Bytecode::EXN_RAISE: {
-        Value exn_val = OpGet(inst.operand1);
+      INSTRUCTION(EXN_RAISE): {
+        Value exn_val = OpGet(inst->operand1, constants);
         if (WaitOn(exn_val)) goto suspended;
 
         // RSet(Operand(Register(Register::EXN)), exn_val);
         exception_ = exn_val;
 
-        // Jump to the first reachable exception/finally handler.
-        while ((cse != NULL) && cse->exn_handlers_.empty()) {
-          call_stack_.pop_back();
-          cse = call_stack_.empty() ? NULL : &call_stack_.back();
-        }
-        if (cse == NULL) {
-          LOG(INFO) << "Thread terminated by uncaught exception: "
-                    << exn_val.ToString();
-          goto terminated;
+        // Jump to the handler of the innermost try block protecting the
+        // instruction, in the current frame or in the frames of the callers.
+        const ExnHandler* handler =
+            packed_code->FindExnHandler(inst - code, false);
+        while (handler == NULL) {
+          PopFrame();
+          if (call_stack_.empty()) {
+            LOG(INFO) << "Thread terminated by uncaught exception: "
+                      << exn_val.ToString();
+            goto terminated;
+          }
+          // Callers resume after the instruction calling.
+          cse = &call_stack_.back();
+          handler = cse->proc_->packed_code()->FindExnHandler(
+              cse->code_pointer_ - 1, false);
         }
-        const ExnStackEntry& ese = cse->exn_handlers_.back();
-        cse->code_pointer_ = ese.code_pointer_;
-        cse->exn_handlers_.pop_back();
-        continue;
-        break;
+        cse->code_pointer_ = handler->handler;
+        ENTER_FRAME();
       }
 
-      case Bytecode::EXN_RESET: {
-        RSet(inst.operand1, exception_);
+      INSTRUCTION(EXN_RESET): {
+        RSet(inst->operand1, exception_);
         exception_ = New::Free(store_);
-        break;
+        NEXT();
       }
 
       // -----------------------------------------------------------------------
       // Constructors
 
-      case Bytecode::NEW_VARIABLE: {
-        RSet(inst.operand1, New::Free(store_));
-        break;
+      INSTRUCTION(NEW_VARIABLE): {
+        RSet(inst->operand1, New::Free(store_));
+        NEXT();
       }
 
-      case Bytecode::NEW_NAME: {
-        RSet(inst.operand1, New::Name(store_));
-        break;
+      INSTRUCTION(NEW_NAME): {
+        RSet(inst->operand1, New::Name(store_));
+        NEXT();
       }
 
-      case Bytecode::NEW_CELL: {
-        Value initial_val = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NEW_CELL): {
+        Value initial_val = OpGet(inst->operand2, constants).Deref();
 
-        RSet(inst.operand1, New::Cell(store_, initial_val));
-        break;
+        RSet(inst->operand1, New::Cell(store_, initial_val));
+        NEXT();
       }
 
-      case Bytecode::NEW_ARRAY: {
-        Value size_val = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NEW_ARRAY): {
+        Value size_val = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(size_val)) goto suspended;
         if (!HasType(size_val, Value::SMALL_INTEGER)) goto bad_operand;
         const uint64 array_size = SmallInteger(size_val).value();
 
-        Value initial_val = OpGet(inst.operand3).Deref();
+        Value initial_val = OpGet(inst->operand3, constants).Deref();
 
-        RSet(inst.operand1, New::Array(store_, array_size, initial_val));
-        break;
+        RSet(inst->operand1, New::Array(store_, array_size, initial_val));
+        NEXT();
       }
 
-      case Bytecode::NEW_ARITY: {
-        Value array_val = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NEW_ARITY): {
+        Value array_val = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(array_val)) goto suspended;
         if (!HasType(array_val, Value::ARRAY)) goto bad_operand;
         Array* const array = array_val.as<Array>();
 
-        RSet(inst.operand1, New::Arity(store_, array->size(), array->values()));
-        break;
+        RSet(inst->operand1,
+             New::Arity(store_, array->size(), array->values()));
+        NEXT();
       }
 
-      case Bytecode::NEW_LIST: {
-        Value head_val = OpGet(inst.operand2).Deref();
-        Value tail_val = OpGet(inst.operand3).Deref();
+      INSTRUCTION(NEW_LIST): {
+        Value head_val = OpGet(inst->operand2, constants).Deref();
+        Value tail_val = OpGet(inst->operand3, constants).Deref();
 
-        RSet(inst.operand1, New::List(store_, head_val, tail_val));
-        break;
+        RSet(inst->operand1, New::List(store_, head_val, tail_val));
+        NEXT();
       }
 
-      case Bytecode::NEW_TUPLE: {
-        Value size_val = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NEW_TUPLE): {
+        Value size_val = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(size_val)) goto suspended;
         if (!HasType(size_val, Value::SMALL_INTEGER)) goto bad_operand;
         const uint64 size = SmallInteger(size_val).value();
 
-        Value label_val = OpGet(inst.operand3).Deref();
+        Value label_val = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(label_val)) goto suspended;
         if (!(label_val.caps() & Value::CAP_LITERAL)) goto bad_operand;
 
-        RSet(inst.operand1, New::Tuple(store_, label_val, size));
-        break;
+        RSet(inst->operand1, New::Tuple(store_, label_val, size));
+        NEXT();
       }
 
-      case Bytecode::NEW_RECORD: {
-        Value arity_val = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NEW_RECORD): {
+        Value arity_val = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(arity_val)) goto suspended;
         if (!HasType(arity_val, Value::ARITY)) goto bad_operand;
         Arity* arity = arity_val.as<Arity>();
 
-        Value label_val = OpGet(inst.operand3).Deref();
+        Value label_val = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(label_val)) goto suspended;
         if (!(label_val.caps() & Value::CAP_LITERAL)) goto bad_operand;
 
-        RSet(inst.operand1, New::Record(store_, label_val, arity));
-        break;
+        RSet(inst->operand1, New::Record(store_, label_val, arity));
+        NEXT();
       }
 
-      case Bytecode::NEW_PROC: {
-        Value closure_val = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NEW_PROC): {
+        Value closure_val = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(closure_val)) goto suspended;
         if (!HasType(closure_val, Value::CLOSURE)) goto bad_operand;
         Closure* closure = closure_val.as<Closure>();
 
-        Value env_val = OpGet(inst.operand3).Deref();
+        Value env_val = OpGet(inst->operand3, constants).Deref();
         if (!HasType(env_val, Value::ARRAY)) goto bad_operand;
         Array* env = env_val.as<Array>();
+        // The bytecode of the procedure reads its closure values unchecked.
+        if (env->size() < closure->nclosures()) goto bad_operand;
 
-        RSet(inst.operand1, New::Closure(store_, closure, env));
-        break;
+        RSet(inst->operand1, New::Closure(store_, closure, env));
+        NEXT();
       }
 
-      case Bytecode::NEW_THREAD: {
-        Value closure_val = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NEW_THREAD): {
+        Value closure_val = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(closure_val)) goto suspended;
         if (!HasType(closure_val, Value::CLOSURE)) goto bad_operand;
         Closure* closure = closure_val.as<Closure>();
 
-        Value params_val = OpGet(inst.operand3).Deref();
+        Value params_val = OpGet(inst->operand3, constants).Deref();
         if (!HasType(params_val, Value::ARRAY)) goto bad_operand;
         Array* params = params_val.as<Array>();
 
-        RSet(inst.operand1,
-             New::Thread(store_, engine_, closure, params, store_));
-        break;
+        // Links the procedure and checks the parameters.
+        Thread* const thread =
+            Thread::New(store_, engine_, closure, params, store_);
+        if (thread == NULL) goto bad_operand;
+        thread->set_priority(priority());
+        RSet(inst->operand1, Value(thread));
+        NEXT();
       }
 
       // -----------------------------------------------------------------------
       // Accessors
 
-      case Bytecode::GET_VALUE_TYPE: {
-        Value value = OpGet(inst.operand2).Deref();
-        RSet(inst.operand1, New::Integer(store_, value.type()));
-        break;
+      INSTRUCTION(GET_VALUE_TYPE): {
+        Value value = OpGet(inst->operand2, constants).Deref();
+        RSet(inst->operand1, New::Integer(store_, value.type()));
+        NEXT();
       }
 
-      case Bytecode::ACCESS_CELL: {
-        Value cell_val = OpGet(inst.operand2).Deref();
+      INSTRUCTION(ACCESS_CELL): {
+        Value cell_val = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(cell_val)) goto suspended;
         if (!HasType(cell_val, Value::CELL)) goto bad_operand;
         Cell* cell = cell_val.as<Cell>();
 
-        RSet(inst.operand1, cell->Access());
-        break;
+        RSet(inst->operand1, cell->Access());
+        NEXT();
       }
 
-      case Bytecode::ACCESS_ARRAY: {
-        Value array_val = OpGet(inst.operand2).Deref();
+      INSTRUCTION(ACCESS_ARRAY): {
+        Value array_val = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(array_val)) goto suspended;
         if (!HasType(array_val, Value::ARRAY)) goto bad_operand;
         Array* array = array_val.as<Array>();
 
-        Value index_val = OpGet(inst.operand3).Deref();
+        Value index_val = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(index_val)) goto suspended;
         if (!HasType(index_val, Value::SMALL_INTEGER)) goto bad_operand;
         const uint64 index = SmallInteger(index_val).value();
+        if (index >= array->size()) goto bad_operand;
 
-        RSet(inst.operand1, array->Access(index));
-        break;
+        RSet(inst->operand1, array->Access(index));
+        NEXT();
       }
 
-      case Bytecode::ACCESS_RECORD: {
-        Value record = OpGet(inst.operand2).Deref();
+      INSTRUCTION(ACCESS_RECORD): {
+        Value record = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(record)) goto suspended;
-        if (!(record.caps() & Value::CAP_RECORD)) goto bad_operand;
+        Record* const as_record = AsRecord(record);
+        if ((as_record == NULL) && !(record.caps() & Value::CAP_RECORD))
+          goto bad_operand;
 
-        Value feature = OpGet(inst.operand3).Deref();
+        Value feature = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(feature)) goto suspended;
-        if (!(feature.caps() & Value::CAP_LITERAL)) goto bad_operand;
+        Value field;
+        switch (CachedRecordGet(packed_code->record_cache(inst - code),
+                                record, as_record, feature, &field)) {
+          case LOOKUP_FOUND: break;
+          case LOOKUP_NOT_FOUND: goto bad_operand;
+          case LOOKUP_SUSPENDED: WaitOn(field); goto suspended;
+        }
 
-        RSet(inst.operand1, record.RecordGet(feature));
-        break;
+        RSet(inst->operand1, field);
+        NEXT();
       }
 
-      case Bytecode::ACCESS_RECORD_LABEL: {
-        Value record = OpGet(inst.operand2).Deref();
+      INSTRUCTION(ACCESS_RECORD_LABEL): {
+        Value record = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(record)) goto suspended;
+        // Records need no virtual call to access their label.
+        Record* const as_record = AsRecord(record);
+        if (as_record != NULL) {
+          RSet(inst->operand1, as_record->label());
+          NEXT();
+        }
         if (!(record.caps() & Value::CAP_RECORD)) goto bad_operand;
 
-        RSet(inst.operand1, record.RecordLabel());
-        break;
+        RSet(inst->operand1, record.RecordLabel());
+        NEXT();
       }
 
-      case Bytecode::ACCESS_RECORD_ARITY: {
-        Value record = OpGet(inst.operand2).Deref();
+      INSTRUCTION(ACCESS_RECORD_ARITY): {
+        Value record = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(record)) goto suspended;
         if (!(record.caps() & Value::CAP_RECORD)) goto bad_operand;
 
-        RSet(inst.operand1, record.RecordArity());
-        break;
+        RSet(inst->operand1, record.RecordArity());
+        NEXT();
       }
 
-      case Bytecode::ACCESS_OPEN_RECORD_ARITY: {
-        Value record = OpGet(inst.operand2).Deref();
+      INSTRUCTION(ACCESS_OPEN_RECORD_ARITY): {
+        Value record = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(record)) goto suspended;
         if (!(record.caps() & Value::CAP_RECORD)) goto bad_operand;
 
-        RSet(inst.operand1, record.OpenRecordArity(store_));
-        break;
+        RSet(inst->operand1, record.OpenRecordArity(store_));
+        NEXT();
       }
 
       // -----------------------------------------------------------------------
       // Mutations
 
-      case Bytecode::ASSIGN_CELL: {
-        Value cell_val = OpGet(inst.operand1).Deref();
+      INSTRUCTION(ASSIGN_CELL): {
+        Value cell_val = OpGet(inst->operand1, constants).Deref();
         if (WaitOn(cell_val)) goto suspended;
         if (!HasType(cell_val, Value::CELL)) goto bad_operand;
         Cell* cell = cell_val.as<Cell>();
 
-        Value new_val = OpGet(inst.operand2).Deref();
+        Value new_val = OpGet(inst->operand2, constants).Deref();
 
         cell->Assign(new_val);
-        break;
+        NEXT();
       }
 
-      case Bytecode::ASSIGN_ARRAY: {
-        Value array_val = OpGet(inst.operand1).Deref();
+      INSTRUCTION(ASSIGN_ARRAY): {
+        Value array_val = OpGet(inst->operand1, constants).Deref();
         if (WaitOn(array_val)) goto suspended;
         if (!HasType(array_val, Value::ARRAY)) goto bad_operand;
         Array* const array = array_val.as<Array>();
 
-        Value index_val = OpGet(inst.operand2).Deref();
+        Value index_val = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(index_val)) goto suspended;
         if (!HasType(index_val, Value::SMALL_INTEGER)) goto bad_operand;
         const uint64 index = SmallInteger(index_val).value();
+        if (index >= array->size()) goto bad_operand;
 
-        Value new_val = OpGet(inst.operand3).Deref();
+        Value new_val = OpGet(inst->operand3, constants).Deref();
 
         array->Assign(index, new_val);
-        break;
+        NEXT();
       }
 
       // -----------------------------------------------------------------------
       // Predicates
 
-      case Bytecode::TEST_IS_DET: {
-        Value value = OpGet(inst.operand2).Deref();
-        RSet(inst.operand1, Boolean::Get(store::IsDet(value)));
-        break;
+      INSTRUCTION(TEST_IS_DET): {
+        Value value = OpGet(inst->operand2, constants).Deref();
+        RSet(inst->operand1, Boolean::Get(store::IsDet(value)));
+        NEXT();
       }
 
-      case Bytecode::TEST_IS_RECORD: {
-        Value value = OpGet(inst.operand2).Deref();
-        RSet(inst.operand1, Boolean::Get(value.caps() & Value::CAP_RECORD));
-        break;
+      INSTRUCTION(TEST_IS_RECORD): {
+        Value value = OpGet(inst->operand2, constants).Deref();
+        RSet(inst->operand1, Boolean::Get(value.caps() & Value::CAP_RECORD));
+        NEXT();
       }
 
-      case Bytecode::TEST_ARITY_EXTENDS: {
-        Value super_val = OpGet(inst.operand2).Deref();
+      INSTRUCTION(TEST_ARITY_EXTENDS): {
+        Value super_val = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(super_val)) goto suspended;
         if (!HasType(super_val, Value::ARITY)) goto bad_operand;
-        Value sub_val = OpGet(inst.operand3).Deref();
+        Value sub_val = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(sub_val)) goto suspended;
         if (!HasType(sub_val, Value::ARITY)) goto bad_operand;
         Arity* const super = super_val.as<Arity>();
         Arity* const sub = sub_val.as<Arity>();
-        RSet(inst.operand1, Boolean::Get(sub->LessThan(super)));
-        break;
+        RSet(inst->operand1, Boolean::Get(sub->LessThan(super)));
+        NEXT();
       }
 
-      case Bytecode::TEST_EQUALITY: {
-        Value value1 = OpGet(inst.operand2).Deref();
-        Value value2 = OpGet(inst.operand3).Deref();
-        RSet(inst.operand1, Boolean::Get(store::Equals(value1, value2)));
-        break;
+      INSTRUCTION(TEST_EQUALITY): {
+        Value value1 = OpGet(inst->operand2, constants).Deref();
+        Value value2 = OpGet(inst->operand3, constants).Deref();
+        RSet(inst->operand1, Boolean::Get(store::Equals(value1, value2)));
+        NEXT();
       }
 
-      case Bytecode::TEST_LESS_THAN: {
-        Value value1 = OpGet(inst.operand2).Deref();
+      QUICKENING_INSTRUCTION(TEST_LESS_THAN): {
+        QUICKEN();
+        Value value1 = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(value1)) goto suspended;
-        if (!(value1.caps() & Value::CAP_LITERAL)) goto bad_operand;
-        Value value2 = OpGet(inst.operand3).Deref();
+        Value value2 = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(value2)) goto suspended;
+        if (AreFloats(value1, value2)) {
+          RSet(inst->operand1, Float::LessThan(value1, value2));
+          NEXT();
+        }
+        if (!(value1.caps() & Value::CAP_LITERAL)) goto bad_operand;
         if (!(value2.caps() & Value::CAP_LITERAL)) goto bad_operand;
-        RSet(inst.operand1, Boolean::Get(value1.LiteralLessThan(value2)));
-        break;
+        RSet(inst->operand1, Boolean::Get(value1.LiteralLessThan(value2)));
+        NEXT();
       }
 
-      case Bytecode::TEST_LESS_OR_EQUAL: {
-        Value value1 = OpGet(inst.operand2).Deref();
+      INSTRUCTION(TEST_LESS_OR_EQUAL): {
+        Value value1 = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(value1)) goto suspended;
-        if (!(value1.caps() & Value::CAP_LITERAL)) goto bad_operand;
-        Value value2 = OpGet(inst.operand3).Deref();
+        Value value2 = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(value2)) goto suspended;
+        if (AreFloats(value1, value2)) {
+          RSet(inst->operand1, Float::LessOrEqual(value1, value2));
+          NEXT();
+        }
+        if (!(value1.caps() & Value::CAP_LITERAL)) goto bad_operand;
         if (!(value2.caps() & Value::CAP_LITERAL)) goto bad_operand;
         const bool less_or_equal =
             value1.LiteralLessThan(value2) || value1.LiteralEquals(value2);
-        RSet(inst.operand1, Boolean::Get(less_or_equal));
-        break;
+        RSet(inst->operand1, Boolean::Get(less_or_equal));
+        NEXT();
       }
 
-      case Bytecode::NUMBER_INT_INVERSE: {
-        Value number1 = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NUMBER_INT_INVERSE): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(number1)) goto suspended;
 
-        // TODO: handle big integers
-        RSet(inst.operand1, Value::Integer(-IntValue(number1)));
-        break;
+        Value result = Integer::Negate(store_, number1);
+        if (!result.IsDefined() && Float::IsFloat(number1))
+          result = Float::Negate(store_, number1);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
       }
 
-      case Bytecode::NUMBER_INT_ADD: {
-        Value number1 = OpGet(inst.operand2).Deref();
+      QUICKENING_INSTRUCTION(NUMBER_INT_ADD): {
+        QUICKEN();
+        Value number1 = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(number1)) goto suspended;
 
-        Value number2 = OpGet(inst.operand3).Deref();
+        Value number2 = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(number2)) goto suspended;
 
-        // TODO: handle big integers
-        RSet(inst.operand1,
-             Value::Integer(IntValue(number1) + IntValue(number2)));
-        break;
+        Value result = Integer::Add(store_, number1, number2);
+        if (!result.IsDefined() && AreFloats(number1, number2))
+          result = Float::Add(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
       }
 
-      case Bytecode::NUMBER_INT_SUBTRACT: {
-        Value number1 = OpGet(inst.operand2).Deref();
+      QUICKENING_INSTRUCTION(NUMBER_INT_SUBTRACT): {
+        QUICKEN();
+        Value number1 = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(number1)) goto suspended;
 
-        Value number2 = OpGet(inst.operand3).Deref();
+        Value number2 = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(number2)) goto suspended;
 
-        // TODO: handle big integers
-        RSet(inst.operand1,
-             Value::Integer(IntValue(number1) - IntValue(number2)));
-        break;
+        Value result = Integer::Subtract(store_, number1, number2);
+        if (!result.IsDefined() && AreFloats(number1, number2))
+          result = Float::Subtract(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
       }
 
-      case Bytecode::NUMBER_INT_MULTIPLY: {
-        Value number1 = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NUMBER_INT_MULTIPLY): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(number1)) goto suspended;
 
-        Value number2 = OpGet(inst.operand3).Deref();
+        Value number2 = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(number2)) goto suspended;
 
-        // TODO: handle big integers
-        RSet(inst.operand1,
-             Value::Integer(IntValue(number1) * IntValue(number2)));
-        break;
+        Value result = Integer::Multiply(store_, number1, number2);
+        if (!result.IsDefined() && AreFloats(number1, number2))
+          result = Float::Multiply(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
       }
 
-      case Bytecode::NUMBER_INT_DIVIDE: {
-        Value number1 = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NUMBER_INT_DIVIDE): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(number1)) goto suspended;
 
-        Value number2 = OpGet(inst.operand3).Deref();
+        Value number2 = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(number2)) goto suspended;
 
-        // TODO: handle big integers
-        RSet(inst.operand1,
-             Value::Integer(IntValue(number1) / IntValue(number2)));
-        break;
+        Value result = Integer::Divide(store_, number1, number2);
+        if (!result.IsDefined() && AreFloats(number1, number2))
+          result = Float::Divide(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_INT_MODULO): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value number2 = OpGet(inst->operand3, constants).Deref();
+        if (WaitOn(number2)) goto suspended;
+
+        Value result = Integer::Modulo(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_INT_POWER): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value number2 = OpGet(inst->operand3, constants).Deref();
+        if (WaitOn(number2)) goto suspended;
+
+        Value result = Integer::Power(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_INT_BIT_AND): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value number2 = OpGet(inst->operand3, constants).Deref();
+        if (WaitOn(number2)) goto suspended;
+
+        Value result = Integer::BitAnd(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_INT_BIT_OR): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value number2 = OpGet(inst->operand3, constants).Deref();
+        if (WaitOn(number2)) goto suspended;
+
+        Value result = Integer::BitOr(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_INT_BIT_XOR): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value number2 = OpGet(inst->operand3, constants).Deref();
+        if (WaitOn(number2)) goto suspended;
+
+        Value result = Integer::BitXor(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_INT_SHIFT_LEFT): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value number2 = OpGet(inst->operand3, constants).Deref();
+        if (WaitOn(number2)) goto suspended;
+
+        Value result = Integer::ShiftLeft(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_INT_SHIFT_RIGHT): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value number2 = OpGet(inst->operand3, constants).Deref();
+        if (WaitOn(number2)) goto suspended;
+
+        Value result = Integer::ShiftRight(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_FLOAT_INVERSE): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value result = Float::Negate(store_, number1);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_FLOAT_ADD): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value number2 = OpGet(inst->operand3, constants).Deref();
+        if (WaitOn(number2)) goto suspended;
+
+        Value result = Float::Add(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_FLOAT_SUBTRACT): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value number2 = OpGet(inst->operand3, constants).Deref();
+        if (WaitOn(number2)) goto suspended;
+
+        Value result = Float::Subtract(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_FLOAT_MULTIPLY): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value number2 = OpGet(inst->operand3, constants).Deref();
+        if (WaitOn(number2)) goto suspended;
+
+        Value result = Float::Multiply(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_FLOAT_DIVIDE): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value number2 = OpGet(inst->operand3, constants).Deref();
+        if (WaitOn(number2)) goto suspended;
+
+        Value result = Float::Divide(store_, number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_FLOAT_LESS_THAN): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value number2 = OpGet(inst->operand3, constants).Deref();
+        if (WaitOn(number2)) goto suspended;
+
+        Value result = Float::LessThan(number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_FLOAT_LESS_OR_EQUAL): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value number2 = OpGet(inst->operand3, constants).Deref();
+        if (WaitOn(number2)) goto suspended;
+
+        Value result = Float::LessOrEqual(number1, number2);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_INT_TO_FLOAT): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value result = Float::FromInteger(store_, number1);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
+      }
+
+      INSTRUCTION(NUMBER_FLOAT_TO_INT): {
+        Value number1 = OpGet(inst->operand2, constants).Deref();
+        if (WaitOn(number1)) goto suspended;
+
+        Value result = Float::ToInteger(store_, number1);
+        if (!result.IsDefined()) goto bad_operand;
+        RSet(inst->operand1, result);
+        NEXT();
       }
 
-      case Bytecode::NUMBER_BOOL_NEGATE: {
-        Value boolean = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NUMBER_BOOL_NEGATE): {
+        Value boolean = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(boolean)) goto suspended;
 
         Value negated;
@@ -663,63 +1459,63 @@ Thread::ThreadState Thread::Run(
         } else {
           goto bad_operand;
         }
-        RSet(inst.operand1, negated);
-        break;
+        RSet(inst->operand1, negated);
+        NEXT();
       }
 
-      case Bytecode::NUMBER_BOOL_AND_THEN: {
-        Value bool1 = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NUMBER_BOOL_AND_THEN): {
+        Value bool1 = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(bool1)) goto suspended;
 
         if (bool1 == KAtomTrue()) {
           // Move on
         } else if (bool1 == KAtomFalse()) {
-          RSet(inst.operand1, KAtomFalse());
+          RSet(inst->operand1, KAtomFalse());
         } else {
           goto bad_operand;
         }
 
-        Value bool2 = OpGet(inst.operand3).Deref();
+        Value bool2 = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(bool2)) goto suspended;
 
         if ((bool2 != KAtomTrue()) && (bool2 != KAtomFalse())) {
           goto bad_operand;
         }
-        RSet(inst.operand1, bool2);
-        break;
+        RSet(inst->operand1, bool2);
+        NEXT();
       }
 
-      case Bytecode::NUMBER_BOOL_OR_ELSE: {
-        Value bool1 = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NUMBER_BOOL_OR_ELSE): {
+        Value bool1 = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(bool1)) goto suspended;
 
         if (bool1 == KAtomTrue()) {
-          RSet(inst.operand1, KAtomTrue());
+          RSet(inst->operand1, KAtomTrue());
         } else if (bool1 == KAtomFalse()) {
           // Move on
         } else {
           goto bad_operand;
         }
 
-        Value bool2 = OpGet(inst.operand3).Deref();
+        Value bool2 = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(bool2)) goto suspended;
 
         if ((bool2 != KAtomTrue()) && (bool2 != KAtomFalse())) {
           goto bad_operand;
         }
-        RSet(inst.operand1, bool2);
-        break;
+        RSet(inst->operand1, bool2);
+        NEXT();
       }
 
-      case Bytecode::NUMBER_BOOL_XOR: {
-        Value bool1 = OpGet(inst.operand2).Deref();
+      INSTRUCTION(NUMBER_BOOL_XOR): {
+        Value bool1 = OpGet(inst->operand2, constants).Deref();
         if (WaitOn(bool1)) goto suspended;
 
         if ((bool1 != KAtomTrue()) && (bool1 != KAtomFalse())) {
           goto bad_operand;
         }
 
-        Value bool2 = OpGet(inst.operand3).Deref();
+        Value bool2 = OpGet(inst->operand3, constants).Deref();
         if (WaitOn(bool2)) goto suspended;
 
         if ((bool2 != KAtomTrue()) && (bool2 != KAtomFalse())) {
@@ -727,40 +1523,95 @@ Thread::ThreadState Thread::Run(
         }
 
         Value xored = (bool1 == bool2) ? KAtomFalse() : KAtomTrue();
-        RSet(inst.operand1, xored);
-        break;
+        RSet(inst->operand1, xored);
+        NEXT();
       }
 
       // -----------------------------------------------------------------------
+      // Quick instructions
 
-      default:
-        LOG(FATAL) << "Unknown opcode " << inst.opcode;
+#define QUICK_LOAD_HANDLER(D, S)                                        \
+      QUICK_INSTRUCTION(QUICK_LOAD_##D##S):                             \
+        QUICK_STEP(QUICK_LOAD_##D##S, NEXT());
 
-    }  // switch (inst.opcode)
+      STORE_QUICK_LOADS(QUICK_LOAD_HANDLER)
+#undef QUICK_LOAD_HANDLER
 
-    // This is executed by all instructions that do not modify the call_stack_
-    // explicitly. After call_stack_ is modified (e.g. by push_back()), cse
-    // may be invalid.
-    cse->code_pointer_ = next_code_pointer;
+#define QUICK_BINARY_HANDLER(Opcode, D, S1, S2)                         \
+      QUICK_INSTRUCTION(QUICK_##Opcode##_##D##S1##S2):                  \
+        QUICK_STEP(QUICK_##Opcode##_##D##S1##S2, NEXT());
 
-  }  // for loop
+      STORE_QUICK_BINARIES(QUICK_BINARY_HANDLER)
+#undef QUICK_BINARY_HANDLER
 
-  return RUNNABLE;
+#define QUICK_BRANCH_HANDLER(Opcode, C)                                 \
+      QUICK_INSTRUCTION(QUICK_##Opcode##_##C):                          \
+        QUICK_STEP(QUICK_##Opcode##_##C, NEXT());
+
+      STORE_QUICK_BRANCHES(QUICK_BRANCH_HANDLER)
+#undef QUICK_BRANCH_HANDLER
+
+      // -----------------------------------------------------------------------
+      // Superinstructions
+
+#define SUPER_HANDLER(First, SecondScope, Second)                       \
+      QUICK_INSTRUCTION(SUPER_##First##_THEN_##Second):                 \
+        QUICK_STEP(First, FUSED_NEXT(Second));
+
+      STORE_SUPERINSTRUCTIONS(SUPER_HANDLER)
+#undef SUPER_HANDLER
+
+      // -----------------------------------------------------------------------
+
+      default:
+        LOG(FATAL) << "Unknown opcode " << static_cast<int>(inst->opcode);
+
+  }  // switch (inst->opcode)
+
+  // Handlers always dispatch the next instruction explicitly.
+  LOG(FATAL) << "Instruction handler did not dispatch: "
+             << cse->proc_->bytecode()[inst - code].GetOpcodeName();
 
   //----------------------------------------------------------------------------
 
+preempted:  // The step budget is exhausted.
+  SAVE_FRAME();
+  CHARGE_STEPS();
+  return RUNNABLE;
+
 suspended:  // The thread is suspended on a variable.
-  LOG(INFO) << "Thread " << id_ << " suspended";
+  SAVE_FRAME();
+  CHARGE_STEPS();
+  VLOG(1) << "Thread " << id_ << " suspended";
   return WAITING;
 
 bad_operand:  // An operation encountered a bad operand.
+  SAVE_FRAME();
+  CHARGE_STEPS();
   LOG(INFO) << "Thread " << id_ << " terminated: bad operand at CP="
             << call_stack_.back().code_pointer_;
   return TERMINATED;
 
 terminated:  // The thread is terminated.
-  LOG(INFO) << "Thread " << id_ << " terminated";
+  CHARGE_STEPS();
+  VLOG(1) << "Thread " << id_ << " terminated";
   return TERMINATED;
+
+#undef QUICK_STEP
+#undef GOTO_GENERIC
+#undef QUICKEN
+#undef QUICKENING_INSTRUCTION
+#undef QUICK_INSTRUCTION
+#undef INSTRUCTION
+#undef ENTER_FRAME
+#undef JIT_ENTER
+#undef JUMP
+#undef NEXT
+#undef FUSED_NEXT
+#undef DISPATCH
+#undef CHARGE_STEPS
+#undef LOAD_FRAME
+#undef SAVE_FRAME
 }
 
 }  // namespace store
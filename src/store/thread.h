@@ -2,6 +2,7 @@
 #ifndef STORE_THREAD_H_
 #define STORE_THREAD_H_
 
+#include <atomic>
 #include <list>
 #include <string>
 #include <vector>
@@ -111,8 +112,15 @@ string DebugString(const Operand& op) {
 
 // -----------------------------------------------------------------------------
 
+class PackedOperand;
+struct PackedBytecode;
+
 class Thread : public HeapValue {
  public:
+  // Creates a runnable thread calling a procedure.
+  // @returns NULL if the procedure, or a procedure in its constants, calls
+  //     unknown natives (see Engine::Link()), or if the parameters or the
+  //     environment are too small for the procedure. The errors are logged.
   static
   Thread* New(Store* store,
               Engine* engine,
@@ -129,52 +137,54 @@ class Thread : public HeapValue {
   };
 
   // Executes instructions for this thread.
-  // @param steps_count How many instructions to execute, at most.
+  // @param steps_count The time slice of the thread, in instructions.
+  //     Loops and calls are charged as they execute, so that a thread cannot
+  //     run much longer than its time slice. The steps charged are added to
+  //     steps().
   // @param new_runnable Returns new runnable threads in this list.
   //     Do not include this thread in this list: its runnable state is
   //     determined by the returned ThreadState.
-  // @returns The state of the thread.
-  ThreadState Run(uint64 steps_count, list<Thread*>* new_runnable);
+  // @returns The state of the thread. A WAITING thread is not registered in
+  //     the suspensions of the variable it waits on yet: the engine does it
+  //     once the thread is stopped, see waiting_on().
+  ThreadState Run(uint64 steps_count, ThreadList* new_runnable);
 
   inline Value RGet(const Register& reg);
   inline void RSet(const Register& reg, Value value);
   inline void RSet(const Operand& op, Value value);
   inline Value OpGet(const Operand& operand);
 
-  bool WaitOn(Value value);
+  // Accessors for the operands of the packed code of the current frame.
+  // @param constants The constant pool of the packed code.
+  inline void RSet(PackedOperand op, Value value);
+  inline Value OpGet(PackedOperand op, const Value* constants);
 
-  // ---------------------------------------------------------------------------
-  // Exception handler
-  class ExnStackEntry {
-   public:
-    enum ExnHandlerType {
-      // Finally handlers are always executed.
-      FINALLY = 0,
-
-      // Catch handlers are executed only when the exception register is set.
-      CATCH = 1,
-    };
-
-    ExnStackEntry(ExnHandlerType type, int32 code_pointer)
-        : type_(type),
-          code_pointer_(code_pointer) {
-    }
+  // Suspends the thread on a free variable.
+  // @returns False if the value is not a free variable.
+  bool WaitOn(Value value);
 
-    ExnHandlerType type_;
-    uint64 code_pointer_;
-  };
+  // The variable a WAITING thread waits on, until the engine registers the
+  // suspension. NULL otherwise.
+  Variable* waiting_on() const { return waiting_on_; }
 
   // ---------------------------------------------------------------------------
   // Call stack
+  //
+  // The local registers of a frame live in a register window of the value
+  // stack of the thread, and are popped with the frame. They are promoted to
+  // an array in the store only when the array of the local registers is read,
+  // ie. when the local registers escape the frame.
   class CallStackEntry {
    public:
-    CallStackEntry(Store* store, Closure* closure, Array* parameters)
-        : proc_(closure),
+    CallStackEntry(Closure* closure, Array* parameters, uint64 locals_base)
+        : proc_(CHECK_NOTNULL(closure)),
           parameters_(parameters),
-          locals_(Array::New(store, closure->nlocals(), KAtomEmpty())),
+          locals_(NULL),
+          locals_base_(locals_base),
+          nlocals_(closure->nlocals()),
+          local_values_(NULL),
           array_(NULL),
           code_pointer_(0) {
-      CHECK_NOTNULL(closure);
     }
 
     // Bytecode segment and environment closure
@@ -183,33 +193,98 @@ class Thread : public HeapValue {
     // Call parameters
     Array* parameters_;
 
-    // Local registers
+    // Local registers, once promoted to the store. NULL while the local
+    // registers live in the register window.
     Array* locals_;
 
+    // Offset of the register window in the value stack.
+    uint64 locals_base_;
+
+    // Number of local registers.
+    uint64 nlocals_;
+
+    // The local registers: the register window, or the values of locals_.
+    // Only valid for the frame on top of the call stack, as the value stack
+    // may move when it grows.
+    Value* local_values_;
+
     // Array manipulation registers
     Array* array_;
 
-    // Index of the current bytecode instruction
+    // Index of the current bytecode instruction. In the frames of the
+    // callers, the instruction following the call: exception handlers are
+    // found from it, see PackedCode::FindExnHandler().
     uint64 code_pointer_;
-
-    // The exception handler stack
-    vector<ExnStackEntry> exn_handlers_;
   };
 
   // ---------------------------------------------------------------------------
 
+  // Id of the thread, unique in its engine.
   uint64 id() const { return id_; }
 
+  // Scheduling priority, PRIORITY_MEDIUM by default. Threads inherit the
+  // priority of the thread creating them. A new priority takes effect the
+  // next time the thread is made runnable. Atomic: a new thread may already
+  // run on another worker when its creator sets its priority.
+  ThreadPriority priority() const {
+    return priority_.load(std::memory_order_relaxed);
+  }
+  void set_priority(ThreadPriority priority) {
+    priority_.store(priority, std::memory_order_relaxed);
+  }
+
+  // Number of steps charged to the thread so far: see Run().
+  uint64 steps() const { return steps_; }
+
  private:   // -----------------------------------------------------------------
 
   Thread(Engine* engine, Closure* closure, Array* parameters, Store* store);
   virtual ~Thread();
 
-  // The next thread ID to allocate
-  static uint64 next_id_;
+  // The interpreter loop behind Run().
+  // @param kThreaded Whether to dispatch instructions with computed gotos,
+  //     or with a switch.
+  template <bool kThreaded>
+  ThreadState Execute(uint64 steps_count, ThreadList* new_runnable);
 
-  // Returns a new unique thread ID.
-  static uint64 GetNextThreadID();
+  // ---------------------------------------------------------------------------
+  // Frames
+
+  // Pushes a new frame, with a new register window for its local registers.
+  inline void PushFrame(Closure* closure, Array* parameters);
+
+  // Pops the frame on top of the call stack, and its register window.
+  inline void PopFrame();
+
+  // Resizes the register window of the frame on top of the call stack, for a
+  // tail call to a procedure with a different number of local registers.
+  inline void ResizeLocals(uint64 nlocals);
+
+  // Updates the local registers of the frame on top of the call stack.
+  inline void LoadLocals();
+
+  // Promotes the local registers of the frame on top of the call stack to an
+  // array in the store.
+  // @returns The array of the local registers.
+  Array* PromoteLocals();
+
+  // Chooses the quick variant of an instruction about to be executed, from
+  // the kinds and the current values of its operands.
+  // @param constants The constant pool of the packed code.
+  // @returns The quick opcode, or the opcode of the instruction if it has no
+  //     suitable quick variant.
+  uint8 QuickOpcode(const PackedBytecode& inst, const Value* constants);
+
+  // Runs the native code of the frame on top of the call stack, once the
+  // procedure is compiled: see Engine::jit_threshold().
+  // @param packed_code The packed code of the frame, in the code context of
+  //     the engine.
+  // @param code_pointer The instruction to run from. Returns the instruction
+  //     to resume interpreting at.
+  // @param budget The step budget, charged by the native code.
+  // @returns False if the native code did not run.
+  bool RunJit(PackedCode* packed_code, uint64* code_pointer, int64* budget,
+              ThreadList* new_runnable);
 
   // ---------------------------------------------------------------------------
   // Memory layout
@@ -226,8 +301,30 @@ class Thread : public HeapValue {
   // The call stack.
   vector<CallStackEntry> call_stack_;
 
+  // The register windows of the frames, in the order of the call stack.
+  vector<Value> value_stack_;
+
   // Per-thread exception register.
   Value exception_;
+
+  std::atomic<ThreadPriority> priority_;
+
+  uint64 steps_;
+
+  // Steps the thread runs for between two reads of the clock, adapted by the
+  // engine to the speed of the thread: see Engine::time_quantum_ns().
+  // 0 until the thread first runs with a time quantum.
+  uint64 step_budget_;
+
+  // See waiting_on().
+  Variable* waiting_on_;
+
+  // The next thread in the list this thread belongs to: the suspensions of
+  // the variable it waits on, or the run queue of the engine.
+  Thread* next_;
+
+  friend class Engine;
+  friend class ThreadList;
 };
 
 // -----------------------------------------------------------------------------
@@ -10,6 +10,17 @@ Thread* Thread::New(Store* store,
                     Closure* closure,
                     Array* parameters,
                     Store* thread_store) {
+  CHECK_NOTNULL(closure);
+  CHECK_NOTNULL(parameters);
+  if (!engine->Link(closure)) {
+    LOG(ERROR) << "Thread not created: its procedure calls unknown natives";
+    return NULL;
+  }
+  if (!closure->CanCall(parameters)) {
+    LOG(ERROR) << "Thread not created: procedure called with too few "
+               << "parameters or no environment";
+    return NULL;
+  }
   return new(CHECK_NOTNULL(store->Alloc<Thread>()))
       Thread(engine, closure, parameters, thread_store);
 }
@@ -19,29 +30,83 @@ Thread::Thread(Engine* engine,
                Closure* closure,
                Array* parameters,
                Store* store)
-    : id_(GetNextThreadID()),
+    : id_(engine->NewThreadId()),
       engine_(engine),
       store_(CHECK_NOTNULL(store)),
-      exception_(New::Free(store)) {
-  CHECK_NOTNULL(closure);
-  CHECK_NOTNULL(parameters);
+      exception_(New::Free(store)),
+      priority_(PRIORITY_MEDIUM),
+      steps_(0),
+      step_budget_(0),
+      waiting_on_(NULL),
+      next_(NULL) {
+  // Checked by New().
+  DCHECK(closure->CanCall(parameters));
+  PushFrame(closure, parameters);
+  // Last: other workers may run the thread from now on.
   engine_->AddThread(this);
-  call_stack_.push_back(CallStackEntry(store_, closure, parameters));
+}
+
+inline
+void Thread::PushFrame(Closure* closure, Array* parameters) {
+  // KAtomEmpty() looks the atom up by name.
+  static const Value kEmpty = KAtomEmpty();
+  const uint64 locals_base = value_stack_.size();
+  call_stack_.emplace_back(closure, parameters, locals_base);
+  value_stack_.resize(locals_base + closure->nlocals(), kEmpty);
+  LoadLocals();
+}
+
+inline
+void Thread::PopFrame() {
+  value_stack_.resize(call_stack_.back().locals_base_);
+  call_stack_.pop_back();
+  if (!call_stack_.empty()) LoadLocals();
+}
+
+inline
+void Thread::ResizeLocals(uint64 nlocals) {
+  static const Value kEmpty = KAtomEmpty();
+  CallStackEntry* const cse = &call_stack_.back();
+  CHECK(cse->locals_ == NULL);
+  value_stack_.resize(cse->locals_base_ + nlocals, kEmpty);
+  cse->nlocals_ = nlocals;
+  LoadLocals();
+}
+
+inline
+void Thread::LoadLocals() {
+  CallStackEntry* const cse = &call_stack_.back();
+  cse->local_values_ = (cse->locals_ != NULL)
+      ? cse->locals_->mutable_values()
+      : value_stack_.data() + cse->locals_base_;
+}
+
+// Array registers index an array set by the program: their indexes are
+// checked against its size, in release builds too.
+inline
+Value AccessRegisterArray(const Array* array, int index) {
+  CHECK_LT(static_cast<uint64>(index), array->size());
+  return array->Access(index);
 }
 
 inline
 Value Thread::RGet(const Register& reg) {
   switch (reg.type) {
-    case Register::LOCAL:
-      return call_stack_.back().locals_->Access(reg.index);
+    case Register::LOCAL: {
+      const CallStackEntry& cse = call_stack_.back();
+      DCHECK_LT(static_cast<uint64>(reg.index), cse.nlocals_);
+      return cse.local_values_[reg.index];
+    }
+    // The indexes of the parameters and closure values are verified when the
+    // procedure is built, and frames are entered only with enough of them.
     case Register::PARAM:
       return call_stack_.back().parameters_->Access(reg.index);
     case Register::ENVMT:
       return call_stack_.back().proc_->environment()->Access(reg.index);
     case Register::ARRAY:
-      return call_stack_.back().array_->Access(reg.index);
+      return AccessRegisterArray(call_stack_.back().array_, reg.index);
     case Register::LOCAL_ARRAY:
-      return call_stack_.back().locals_;
+      return PromoteLocals();
     case Register::PARAM_ARRAY:
       return call_stack_.back().parameters_;
     case Register::ENVMT_ARRAY:
@@ -59,38 +124,31 @@ inline
 void Thread::RSet(const Register& reg, Value value) {
   switch (reg.type) {
     case Register::LOCAL: {
-      call_stack_.back().locals_->Assign(reg.index, value);
+      CallStackEntry* const cse = &call_stack_.back();
+      DCHECK_LT(static_cast<uint64>(reg.index), cse->nlocals_);
+      cse->local_values_[reg.index] = value;
       break;
     }
     case Register::PARAM: {
       call_stack_.back().parameters_->Assign(reg.index, value);
       break;
     }
-    case Register::ENVMT: {
-      // TODO: Better error reporting.
-      LOG(FATAL) << "Modifying and environment register.";
-      // call_stack_.back().proc_ ->environment()->Assign(reg.index, value);
+    case Register::ENVMT:
+    case Register::LOCAL_ARRAY:
+    case Register::PARAM_ARRAY:
+    case Register::ENVMT_ARRAY: {
+      LOG(FATAL) << "Modifying read-only register " << DebugString(reg)
+                 << ": rejected by VerifyBytecode()";
     }
     case Register::ARRAY: {
-      call_stack_.back().array_->Assign(reg.index, value);
+      Array* const array = call_stack_.back().array_;
+      CHECK_LT(static_cast<uint64>(reg.index), array->size());
+      array->Assign(reg.index, value);
 
       break;
     }
-    case Register::LOCAL_ARRAY: {
-      call_stack_.back().locals_ = value.as<Array>();
-      break;
-    }
-    case Register::PARAM_ARRAY: {
-      call_stack_.back().parameters_ = value.as<Array>();
-      break;
-    }
-    case Register::ENVMT_ARRAY: {
-      // TODO: Better error reporting.
-      LOG(FATAL) << "Modifying the environment array.";
-      // call_stack_.back().proc_.environment_ = value.as<Array>();
-      break;
-    }
     case Register::ARRAY_ARRAY: {
+      CHECK_EQ(Value::ARRAY, value.type());
       call_stack_.back().array_ = value.as<Array>();
       break;
     }
@@ -119,6 +177,18 @@ Value Thread::OpGet(const Operand& operand) {
   }
 }
 
+inline
+void Thread::RSet(PackedOperand op, Value value) {
+  DCHECK(op.is_register()) << "Invalid packed operand kind " << op.kind();
+  RSet(op.reg(), value);
+}
+
+inline
+Value Thread::OpGet(PackedOperand op, const Value* constants) {
+  if (op.is_constant()) return constants[op.index()];
+  return RGet(op.reg());
+}
+
 // -----------------------------------------------------------------------------
 
 }  // namespace store
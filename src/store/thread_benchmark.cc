@@ -0,0 +1,234 @@
+// Benchmarks thread suspensions and wakeups through dataflow streams:
+//  - a thread ring, where a single token is passed around the threads:
+//    each hop wakes up exactly one suspended thread;
+//  - pipelines of stages, each consuming the stream produced by the previous
+//    stage: stages wake up in batches, as their producer runs ahead.
+// With several workers, the threads of each benchmark run on one engine, over
+// a shared store: the ring measures the cost of passing the token between
+// workers, the independent pipelines how the throughput scales.
+#include <chrono>
+#include <memory>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "store/engine.h"
+#include "store/values.h"
+
+DEFINE_int64(
+    ring_threads,
+    503,
+    "Number of threads in the thread ring."
+);
+
+DEFINE_int64(
+    ring_hops,
+    1000000,
+    "Number of times the token is passed in the thread ring."
+);
+
+DEFINE_int64(
+    pipeline_stages,
+    100,
+    "Number of stages in the pipeline."
+);
+
+DEFINE_int64(
+    pipelines,
+    1,
+    "Number of independent pipelines run together."
+);
+
+DEFINE_int64(
+    pipeline_length,
+    10000,
+    "Number of elements streamed through the pipeline."
+);
+
+DEFINE_int64(
+    workers,
+    1,
+    "Number of OS threads running the threads of the engine."
+);
+
+namespace store {
+
+const uint64 kStoreSize = 512 * 1024 * 1024;  // 512MB
+
+namespace {
+
+Operand Local(int index) {
+  return Operand(Register(Register::LOCAL, index));
+}
+
+Operand Param(int index) {
+  return Operand(Register(Register::PARAM, index));
+}
+
+Operand Immediate(int64 integer) {
+  return Operand(Value::Integer(integer));
+}
+
+// Builds a procedure Relay(In Out) that forwards the integers of the stream
+// In to the stream Out, decremented, and stops after forwarding an integer
+// that is not positive:
+//   l0 := In.1
+//   In := In.2
+//   Out = (l0 - 1) | l2
+//   Out := l2
+//   if 0 < l0: loop
+Closure* NewRelayProc(Store* store) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::ACCESS_RECORD, Local(0), Param(0), Immediate(1)));
+  code->push_back(
+      Bytecode(Bytecode::ACCESS_RECORD, Param(0), Param(0), Immediate(2)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(1), Local(0),
+               Immediate(1)));
+  code->push_back(Bytecode(Bytecode::NEW_VARIABLE, Local(2)));
+  code->push_back(
+      Bytecode(Bytecode::NEW_LIST, Local(3), Local(1), Local(2)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(3)));
+  code->push_back(Bytecode(Bytecode::LOAD, Param(1), Local(2)));
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(4), Immediate(0), Local(0)));
+  code->push_back(Bytecode(Bytecode::BRANCH_IF, Local(4), Immediate(0)));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  return Closure::New(store, code, 2, 5, 0);
+}
+
+// Builds a procedure Produce(N Out) that streams N, N-1, ... 0 to Out:
+//   Out = N | l0
+//   Out := l0
+//   l2 := 0 < N
+//   N := N - 1
+//   if l2: loop
+Closure* NewProduceProc(Store* store) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(Bytecode(Bytecode::NEW_VARIABLE, Local(0)));
+  code->push_back(
+      Bytecode(Bytecode::NEW_LIST, Local(1), Param(0), Local(0)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(1)));
+  code->push_back(Bytecode(Bytecode::LOAD, Param(1), Local(0)));
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(2), Immediate(0), Param(0)));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Param(0), Param(0),
+               Immediate(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH_IF, Local(2), Immediate(0)));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  return Closure::New(store, code, 2, 3, 0);
+}
+
+Array* NewParams(Store* store, Value param1, Value param2) {
+  Array* params = Array::New(store, 2, param1);
+  params->Assign(1, param2);
+  return params;
+}
+
+// @returns The determined elements at the beginning of a stream.
+vector<int64> ReadStream(Value stream) {
+  vector<int64> elements;
+  stream = stream.Deref();
+  while (stream.type() == Value::LIST) {
+    elements.push_back(IntValue(stream.as<List>()->head().Deref()));
+    stream = stream.as<List>()->tail().Deref();
+  }
+  return elements;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+void ThreadRingBenchmark(Store* store) {
+  const int64 nthreads = FLAGS_ring_threads;
+  const int64 nhops = FLAGS_ring_hops;
+  CHECK_LT(0, nthreads);
+  Closure* const relay = NewRelayProc(store);
+
+  // Thread i reads the stream written by thread i-1. The first thread reads
+  // the token, then the stream written by the last thread.
+  Engine engine;
+  engine.set_workers(FLAGS_workers);
+  Value back = New::Free(store);
+  const Value first = New::List(store, Value::Integer(nhops), back);
+  Value in = first;
+  for (int64 i = 0; i < nthreads; ++i) {
+    const Value out = (i == nthreads - 1) ? back : New::Free(store);
+    New::Thread(store, &engine, relay, NewParams(store, in, out), store);
+    in = out;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  engine.Run();
+  const double seconds = SecondsSince(start);
+
+  // The token reaches 0 after nhops hops, then every thread stops.
+  const vector<int64> tokens = ReadStream(first);
+  CHECK_GE(0, tokens.back());
+  const int64 nmessages = nhops + nthreads;
+  printf("thread ring: %ld threads, %ld hops in %.3fs, %.1f ns per hop\n",
+         nthreads, nmessages, seconds, seconds * 1e9 / nmessages);
+}
+
+void PipelineBenchmark(Store* store) {
+  const int64 nstages = FLAGS_pipeline_stages;
+  const int64 length = FLAGS_pipeline_length;
+  CHECK_LE(nstages, length);
+  Closure* const produce = NewProduceProc(store);
+  Closure* const relay = NewRelayProc(store);
+
+  Engine engine;
+  engine.set_workers(FLAGS_workers);
+  vector<Value> outputs;
+  int64 nmessages = 0;
+  for (int64 p = 0; p < FLAGS_pipelines; ++p) {
+    Value stream = New::Free(store);
+    New::Thread(store, &engine, produce,
+                NewParams(store, Value::Integer(length), stream), store);
+    for (int64 i = 1; i <= nstages; ++i) {
+      const Value out = New::Free(store);
+      New::Thread(store, &engine, relay, NewParams(store, stream, out),
+                  store);
+      // Stage i reads length - i + 1, ... 0.
+      nmessages += length - i + 2;
+      stream = out;
+    }
+    outputs.push_back(stream);
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  engine.Run();
+  const double seconds = SecondsSince(start);
+
+  for (const Value& stream : outputs) {
+    const vector<int64> elements = ReadStream(stream);
+    CHECK_EQ(length - nstages + 2, static_cast<int64>(elements.size()));
+    CHECK_EQ(length - nstages, elements.front());
+    CHECK_EQ(-1, elements.back());
+  }
+  printf("pipeline: %ld x %ld stages, %ld messages in %.3fs, "
+         "%.1f ns per message\n",
+         FLAGS_pipelines, nstages, nmessages, seconds,
+         seconds * 1e9 / nmessages);
+}
+
+}  // namespace store
+
+int main(int argc, char** argv) {
+  ::google::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  store::StaticStore store(store::kStoreSize);
+  store::ThreadRingBenchmark(&store);
+  store::PipelineBenchmark(&store);
+  return EXIT_SUCCESS;
+}
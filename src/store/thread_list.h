@@ -0,0 +1,58 @@
+// Intrusive lists of threads
+#ifndef STORE_THREAD_LIST_H_
+#define STORE_THREAD_LIST_H_
+
+#include "base/basictypes.h"
+
+namespace store {
+
+class Thread;
+
+// -----------------------------------------------------------------------------
+// First-in first-out list of threads, linked through the threads themselves.
+//
+// Used for the suspensions of a free variable and for the run queue of the
+// engine. A thread waits on at most one variable at a time, and is never
+// waiting and runnable at the same time: it belongs to at most one list.
+//
+// Appending a thread or a whole list does not allocate, and takes constant
+// time. This makes merging the suspensions of two variables bound together,
+// and waking up all the suspensions of a variable, constant time operations.
+//
+class ThreadList {
+ public:
+  ThreadList() : head_(NULL), tail_(NULL) {}
+
+  bool empty() const { return head_ == NULL; }
+  Thread* front() const { return head_; }
+  Thread* back() const { return tail_; }
+
+  // Counts the threads in the list, in linear time.
+  uint64 size() const;
+
+  // Appends a thread that does not belong to any list.
+  void PushBack(Thread* thread);
+
+  // Removes and returns the first thread of the non-empty list.
+  Thread* PopFront();
+
+  // Appends all the threads of another list to this list.
+  // The other list becomes empty.
+  void Splice(ThreadList* other);
+
+  // Moves the threads after the specified thread to the end of another list.
+  // @param last The last thread kept in this list, NULL to move all threads.
+  void SpliceAfter(Thread* last, ThreadList* other);
+
+ private:
+  Thread* head_;
+  Thread* tail_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadList);
+};
+
+// -----------------------------------------------------------------------------
+
+}  // namespace store
+
+#endif  // STORE_THREAD_LIST_H_
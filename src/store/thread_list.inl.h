@@ -0,0 +1,68 @@
+#ifndef STORE_THREAD_LIST_INL_H_
+#define STORE_THREAD_LIST_INL_H_
+
+namespace store {
+
+inline
+uint64 ThreadList::size() const {
+  uint64 count = 0;
+  for (Thread* thread = head_; thread != NULL; thread = thread->next_)
+    ++count;
+  return count;
+}
+
+inline
+void ThreadList::PushBack(Thread* thread) {
+  DCHECK(thread->next_ == NULL);
+  DCHECK(thread != tail_);
+  if (tail_ == NULL)
+    head_ = thread;
+  else
+    tail_->next_ = thread;
+  tail_ = thread;
+}
+
+inline
+Thread* ThreadList::PopFront() {
+  Thread* const thread = CHECK_NOTNULL(head_);
+  head_ = thread->next_;
+  if (head_ == NULL) tail_ = NULL;
+  thread->next_ = NULL;
+  return thread;
+}
+
+inline
+void ThreadList::Splice(ThreadList* other) {
+  if (other->head_ == NULL) return;
+  if (tail_ == NULL)
+    head_ = other->head_;
+  else
+    tail_->next_ = other->head_;
+  tail_ = other->tail_;
+  other->head_ = NULL;
+  other->tail_ = NULL;
+}
+
+inline
+void ThreadList::SpliceAfter(Thread* last, ThreadList* other) {
+  Thread* const first = (last == NULL) ? head_ : last->next_;
+  if (first == NULL) return;
+
+  if (other->tail_ == NULL)
+    other->head_ = first;
+  else
+    other->tail_->next_ = first;
+  other->tail_ = tail_;
+
+  if (last == NULL)
+    head_ = NULL;
+  else
+    last->next_ = NULL;
+  tail_ = last;
+}
+
+// -----------------------------------------------------------------------------
+
+}  // namespace store
+
+#endif  // STORE_THREAD_LIST_INL_H_
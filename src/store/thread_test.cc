@@ -0,0 +1,559 @@
+// Tests for the frames of the threads.
+#include "store/values.h"
+
+#include <memory>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+#include <boost/format.hpp>
+using boost::format;
+
+#include <gtest/gtest.h>
+
+#include "store/engine.h"
+
+namespace store {
+
+const uint64 kStoreSize = 16 * 1024 * 1024;
+
+namespace {
+
+Operand Local(int index) {
+  return Operand(Register(Register::LOCAL, index));
+}
+
+Operand Param(int index) {
+  return Operand(Register(Register::PARAM, index));
+}
+
+Operand ArrayRegister(int index) {
+  return Operand(Register(Register::ARRAY, index));
+}
+
+Operand Immediate(int64 integer) {
+  return Operand(Value::Integer(integer));
+}
+
+// Builds a recursive procedure Sum(Self N Result), with Result = N + ... + 1:
+//   if 0 < N:
+//     {Self Self N-1 R}
+//     Result = N + R
+//   else:
+//     Result = 0
+Closure* NewSumProc(Store* store) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(0), Immediate(0), Param(1)));
+  code->push_back(Bytecode(Bytecode::BRANCH_IF, Local(0), Immediate(4)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(2), Immediate(0)));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_SUBTRACT, Local(1), Param(1),
+               Immediate(1)));
+  code->push_back(Bytecode(Bytecode::NEW_VARIABLE, Local(2)));
+  code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Operand(Register(Register::ARRAY_ARRAY)),
+               Immediate(3), Immediate(0)));
+  code->push_back(Bytecode(Bytecode::LOAD, ArrayRegister(0), Param(0)));
+  code->push_back(Bytecode(Bytecode::LOAD, ArrayRegister(1), Local(1)));
+  code->push_back(Bytecode(Bytecode::LOAD, ArrayRegister(2), Local(2)));
+  code->push_back(
+      Bytecode(Bytecode::CALL, Param(0),
+               Operand(Register(Register::ARRAY_ARRAY))));
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD, Local(3), Param(1), Local(2)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(2), Local(3)));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  return Closure::New(store, code, 3, 4, 0);
+}
+
+Value Add(Value value1, Value value2) {
+  return Value::Integer(IntValue(value1) + IntValue(value2));
+}
+
+// Invalid for anything but small integers.
+Value Negate(Value value) {
+  value = value.Deref();
+  if (!value.IsSmallInt()) return Value();
+  return Value::Integer(-IntValue(value));
+}
+
+// Runs a procedure with one parameter, in a new thread.
+// @returns The parameter.
+Value RunProc(Store* store, Engine* engine, Closure* proc) {
+  const Value result = New::Free(store);
+  New::Thread(store, engine, proc, Array::New(store, 1, result), store);
+  engine->Run();
+  return result.Deref();
+}
+
+}  // namespace
+
+TEST(Thread, RecursiveCalls) {
+  StaticStore store(kStoreSize);
+  Closure* const sum = NewSumProc(&store);
+  const int64 n = 10000;
+
+  Engine engine;
+  const Value result = New::Free(&store);
+  Array* const params = Array::New(&store, 3, sum);
+  params->Assign(1, Value::Integer(n));
+  params->Assign(2, result);
+  New::Thread(&store, &engine, sum, params, &store);
+  engine.Run();
+  EXPECT_EQ(n * (n + 1) / 2, IntValue(result));
+}
+
+TEST(Thread, LocalsAreNotAllocated) {
+  StaticStore store(kStoreSize);
+  // Callee with many local registers: p0 = 1
+  shared_ptr<vector<Bytecode> > callee_code(new vector<Bytecode>);
+  callee_code->push_back(Bytecode(Bytecode::LOAD, Local(999), Immediate(1)));
+  callee_code->push_back(Bytecode(Bytecode::UNIFY, Param(0), Local(999)));
+  Closure* const callee = Closure::New(&store, callee_code, 1, 1000, 0);
+
+  // Calls the callee with the parameters of the caller.
+  shared_ptr<vector<Bytecode> > caller_code(new vector<Bytecode>);
+  caller_code->push_back(
+      Bytecode(Bytecode::CALL, Operand(Value(callee)),
+               Operand(Register(Register::PARAM_ARRAY))));
+  Closure* const caller = Closure::New(&store, caller_code, 1, 0, 0);
+
+  Engine engine;
+  const Value result = New::Free(&store);
+  Array* const params = Array::New(&store, 1, result);
+  New::Thread(&store, &engine, caller, params, &store);
+  const uint64 free = store.free();
+  engine.Run();
+  EXPECT_EQ(1, IntValue(result));
+  // The register windows of the frames are not allocated in the store.
+  EXPECT_EQ(free, store.free());
+}
+
+TEST(Thread, PromotedLocals) {
+  StaticStore store(kStoreSize);
+  // Callee: p0 := p0 + 1
+  shared_ptr<vector<Bytecode> > callee_code(new vector<Bytecode>);
+  callee_code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD, Param(0), Param(0), Immediate(1)));
+  callee_code->push_back(Bytecode(Bytecode::RETURN));
+  Closure* const callee = Closure::New(&store, callee_code, 1, 0, 0);
+
+  // Caller: l0 := 5, calls the callee with its local registers, then p0 = l0.
+  shared_ptr<vector<Bytecode> > caller_code(new vector<Bytecode>);
+  caller_code->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(5)));
+  caller_code->push_back(
+      Bytecode(Bytecode::CALL, Operand(Value(callee)),
+               Operand(Register(Register::LOCAL_ARRAY))));
+  caller_code->push_back(Bytecode(Bytecode::UNIFY, Param(0), Local(0)));
+  Closure* const caller = Closure::New(&store, caller_code, 1, 1, 0);
+
+  Engine engine;
+  const Value result = New::Free(&store);
+  New::Thread(&store, &engine, caller,
+              Array::New(&store, 1, result), &store);
+  engine.Run();
+  // The callee updated the promoted local registers of the caller.
+  EXPECT_EQ(6, IntValue(result));
+}
+
+TEST(Thread, TailCallResizesLocals) {
+  StaticStore store(kStoreSize);
+  // Callee with 3 local registers: p0 = 3
+  shared_ptr<vector<Bytecode> > callee_code(new vector<Bytecode>);
+  callee_code->push_back(Bytecode(Bytecode::LOAD, Local(2), Immediate(3)));
+  callee_code->push_back(Bytecode(Bytecode::UNIFY, Param(0), Local(2)));
+  Closure* const callee = Closure::New(&store, callee_code, 1, 3, 0);
+
+  // Caller with 1 local register, tail-calls the callee.
+  shared_ptr<vector<Bytecode> > caller_code(new vector<Bytecode>);
+  caller_code->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(1)));
+  caller_code->push_back(
+      Bytecode(Bytecode::CALL_TAIL, Operand(Value(callee)),
+               Operand(Register(Register::PARAM_ARRAY))));
+  Closure* const caller = Closure::New(&store, caller_code, 1, 1, 0);
+
+  Engine engine;
+  const Value result = New::Free(&store);
+  New::Thread(&store, &engine, caller,
+              Array::New(&store, 1, result), &store);
+  engine.Run();
+  EXPECT_EQ(3, IntValue(result));
+}
+
+TEST(Thread, NativeFunctions) {
+  StaticStore store(kStoreSize);
+  Engine engine;
+  engine.RegisterNative<&Add>("add");
+  engine.RegisterNative<&Negate>("negate");
+
+  // l0 := [20 22 l1]
+  // call_native(name:add params:l0)
+  // l2 := [l1 p0]
+  // call_native(name:NameOfNegate params:l2)
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Local(0), Immediate(3), Immediate(20)));
+  code->push_back(
+      Bytecode(Bytecode::ASSIGN_ARRAY, Local(0), Immediate(1), Immediate(22)));
+  code->push_back(Bytecode(Bytecode::NEW_VARIABLE, Local(1)));
+  code->push_back(
+      Bytecode(Bytecode::ASSIGN_ARRAY, Local(0), Immediate(2), Local(1)));
+  code->push_back(
+      Bytecode(Bytecode::CALL_NATIVE, Operand(Atom::Get("add")), Local(0)));
+  code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Local(2), Immediate(2), Local(1)));
+  code->push_back(
+      Bytecode(Bytecode::ASSIGN_ARRAY, Local(2), Immediate(1), Param(0)));
+  code->push_back(Bytecode(Bytecode::CALL_NATIVE, Param(1), Local(2)));
+  Closure* const proc = Closure::New(&store, code, 2, 3, 0);
+
+  // The native with a constant name is resolved when packed.
+  const PackedBytecode& call = proc->packed_code()->code()[4];
+  ASSERT_TRUE(call.operand3.kind() == PackedOperand::NATIVE);
+  uint64 add_id;
+  ASSERT_TRUE(Engine::FindNativeId("add", &add_id));
+  EXPECT_EQ(add_id, call.operand3.index());
+
+  const Value result = New::Free(&store);
+  Array* const params = Array::New(&store, 2, result);
+  params->Assign(1, Atom::Get("negate"));
+  New::Thread(&store, &engine, proc, params, &store);
+  engine.Run();
+  EXPECT_EQ(-42, IntValue(result));
+}
+
+TEST(Thread, NativeResultWakesUpThreads) {
+  StaticStore store(kStoreSize);
+  Engine engine;
+  engine.RegisterNative<&Negate>("negate");
+
+  // p1 = ~p0, suspended until p0 is bound.
+  shared_ptr<vector<Bytecode> > wait_code(new vector<Bytecode>);
+  wait_code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_INVERSE, Local(0), Param(0)));
+  wait_code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(0)));
+  Closure* const wait = Closure::New(&store, wait_code, 2, 1, 0);
+
+  // call_native(name:negate params:[42 p0])
+  shared_ptr<vector<Bytecode> > call_code(new vector<Bytecode>);
+  call_code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Local(0), Immediate(2), Immediate(42)));
+  call_code->push_back(
+      Bytecode(Bytecode::ASSIGN_ARRAY, Local(0), Immediate(1), Param(0)));
+  call_code->push_back(
+      Bytecode(Bytecode::CALL_NATIVE, Operand(Atom::Get("negate")),
+               Local(0)));
+  Closure* const call = Closure::New(&store, call_code, 1, 1, 0);
+
+  const Value result = New::Free(&store);
+  const Value waited = New::Free(&store);
+  Array* const wait_params = Array::New(&store, 2, result);
+  wait_params->Assign(1, waited);
+  New::Thread(&store, &engine, wait, wait_params, &store);
+  engine.Run();
+  ASSERT_EQ(Value::VARIABLE, waited.Deref().type());
+
+  New::Thread(&store, &engine, call, Array::New(&store, 1, result), &store);
+  engine.Run();
+  EXPECT_EQ(-42, IntValue(result));
+  EXPECT_EQ(42, IntValue(waited));
+}
+
+TEST(Thread, IntegerNatives) {
+  StaticStore store(kStoreSize);
+  Engine engine;
+  const mpz_class big("100000000000000000000");
+
+  // Calls a native on the parameters.
+  // @returns The result, unified with the last parameter.
+  auto call = [&](const char* name, vector<Value> inputs) {
+    shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+    code->push_back(
+        Bytecode(Bytecode::CALL_NATIVE, Operand(Atom::Get(name)),
+                 Operand(Register(Register::PARAM_ARRAY))));
+    Closure* const proc = Closure::New(&store, code, inputs.size() + 1, 0, 0);
+    const Value result = New::Free(&store);
+    Array* const params = Array::New(&store, inputs.size() + 1, result);
+    for (uint64 i = 0; i < inputs.size(); ++i)
+      params->Assign(i, inputs[i]);
+    New::Thread(&store, &engine, proc, params, &store);
+    engine.Run();
+    return result.Deref();
+  };
+
+  // Big integers, as operands and as results:
+  const Value product =
+      call("multiply", {New::Integer(&store, big), Value::Integer(3)});
+  ASSERT_TRUE(product.IsA<Integer>());
+  EXPECT_TRUE(product.as<Integer>()->mpz() == big * 3);
+  const Value overflow =
+      call("multiply", {Value::Integer(1LL << 40), Value::Integer(1LL << 40)});
+  ASSERT_TRUE(overflow.IsA<Integer>());
+  EXPECT_TRUE(overflow.as<Integer>()->mpz()
+              == mpz_class(1L << 40) * mpz_class(1L << 40));
+  const Value decremented = call("decrement", {product});
+  ASSERT_TRUE(decremented.IsA<Integer>());
+  EXPECT_TRUE(decremented.as<Integer>()->mpz() == big * 3 - 1);
+  EXPECT_EQ(Value(KAtomFalse()), call("is_zero", {product}));
+  EXPECT_EQ(Value(KAtomTrue()), call("is_zero", {Value::Integer(0)}));
+
+  // Non-integer parameters are bad operands: the thread terminates and
+  // leaves the result unbound.
+  const Value var = Variable::New(&store);
+  EXPECT_EQ(Value::VARIABLE, call("multiply", {var, Value::Integer(3)}).type());
+  EXPECT_EQ(Value::VARIABLE,
+            call("multiply", {KAtomNil(), Value::Integer(3)}).type());
+  EXPECT_EQ(Value::VARIABLE,
+            call("decrement", {New::Float(&store, 0.5)}).type());
+  EXPECT_EQ(Value::VARIABLE, call("is_zero", {var}).type());
+  // So is a parameter array without the result.
+  EXPECT_EQ(Value::VARIABLE, call("decrement", {}).type());
+}
+
+TEST(Thread, UnknownNative) {
+  StaticStore store(kStoreSize);
+  // Calls an unknown native from a nested procedure.
+  shared_ptr<vector<Bytecode> > inner_code(new vector<Bytecode>);
+  inner_code->push_back(
+      Bytecode(Bytecode::CALL_NATIVE, Operand(Atom::Get("unknown_native")),
+               Operand(Register(Register::PARAM_ARRAY))));
+  Closure* const inner = Closure::New(&store, inner_code, 1, 0, 0);
+
+  shared_ptr<vector<Bytecode> > outer_code(new vector<Bytecode>);
+  outer_code->push_back(
+      Bytecode(Bytecode::CALL, Operand(Value(inner)),
+               Operand(Register(Register::PARAM_ARRAY))));
+  Closure* const outer = Closure::New(&store, outer_code, 1, 0, 0);
+
+  // Unknown natives are reported when linked.
+  Engine engine;
+  EXPECT_FALSE(engine.Link(outer));
+  EXPECT_TRUE(Thread::New(&store, &engine, outer,
+                          Array::New(&store, 1, Value::Integer(0)),
+                          &store) == NULL);
+
+  // A thread spawning the procedure terminates: the engine goes on.
+  shared_ptr<vector<Bytecode> > spawn_code(new vector<Bytecode>);
+  spawn_code->push_back(
+      Bytecode(Bytecode::NEW_THREAD, Local(0), Param(0), Param(1)));
+  spawn_code->push_back(
+      Bytecode(Bytecode::UNIFY, Param(2), Immediate(1)));
+  Closure* const spawn = Closure::New(&store, spawn_code, 3, 1, 0);
+  const Value spawned = New::Free(&store);
+  Array* const params = Array::New(&store, 3, Value(outer));
+  params->Assign(1, Array::New(&store, 1, Value::Integer(0)));
+  params->Assign(2, spawned);
+  New::Thread(&store, &engine, spawn, params, &store);
+  engine.Run();
+  EXPECT_EQ(Value::VARIABLE, spawned.Deref().type());
+
+  engine.RegisterNative<&Negate>("unknown_native");
+  EXPECT_TRUE(engine.Link(outer));
+
+  // Invalid parameters terminate the thread.
+  EXPECT_EQ(Value::VARIABLE, RunProc(&store, &engine, outer).type());
+}
+
+TEST(Thread, NativesResolvedWhenCalled) {
+  StaticStore store(kStoreSize);
+  // call_native(name:NameOfNative params:[p1 p0])
+  shared_ptr<vector<Bytecode> > by_name_code(new vector<Bytecode>);
+  by_name_code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Local(0), Immediate(2), Param(1)));
+  by_name_code->push_back(
+      Bytecode(Bytecode::ASSIGN_ARRAY, Local(0), Immediate(1), Param(0)));
+  by_name_code->push_back(Bytecode(Bytecode::CALL_NATIVE, Param(2), Local(0)));
+  Closure* const by_name = Closure::New(&store, by_name_code, 3, 1, 0);
+
+  // Names called but never registered get no id.
+  Engine engine;
+  const Value result = New::Free(&store);
+  Array* params = Array::New(&store, 3, result);
+  params->Assign(1, Value::Integer(1));
+  params->Assign(2, Atom::Get("never_registered"));
+  New::Thread(&store, &engine, by_name, params, &store);
+  engine.Run();
+  EXPECT_EQ(Value::VARIABLE, result.Deref().type());
+  uint64 id;
+  EXPECT_FALSE(Engine::FindNativeId("never_registered", &id));
+
+  // call_native(name:Name params:[42 p0]), with a constant Name.
+  auto new_call_proc = [&store](const string& name) {
+    shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+    code->push_back(
+        Bytecode(Bytecode::NEW_ARRAY, Local(0), Immediate(2), Immediate(42)));
+    code->push_back(
+        Bytecode(Bytecode::ASSIGN_ARRAY, Local(0), Immediate(1), Param(0)));
+    code->push_back(
+        Bytecode(Bytecode::CALL_NATIVE, Operand(Atom::Get(name)), Local(0)));
+    return Closure::New(&store, code, 1, 1, 0);
+  };
+
+  // Natives registered after the procedure was packed are resolved when
+  // first called.
+  Closure* const late = new_call_proc("late");
+  EXPECT_FALSE(late->packed_code()->code()[2].operand3.kind()
+               == PackedOperand::NATIVE);
+  EXPECT_FALSE(engine.Link(late));
+  engine.RegisterNative<&Negate>("late");
+  EXPECT_EQ(-42, IntValue(RunProc(&store, &engine, late)));
+  EXPECT_TRUE(late->packed_code()->code()[2].operand3.kind()
+              == PackedOperand::NATIVE);
+
+  // Natives with large ids are resolved when packed too.
+  const int kNatives = 5000;
+  const string last = (format("native%d") % (kNatives - 1)).str();
+  for (int i = 0; i < kNatives; ++i)
+    engine.RegisterNative<&Negate>((format("native%d") % i).str());
+  ASSERT_TRUE(Engine::FindNativeId(last, &id));
+  ASSERT_LE(static_cast<uint64>(kNatives - 1), id);
+  Closure* const proc = new_call_proc(last);
+  EXPECT_TRUE(proc->packed_code()->code()[2].operand3.kind()
+              == PackedOperand::NATIVE);
+  EXPECT_TRUE(engine.Link(proc));
+  EXPECT_EQ(-42, IntValue(RunProc(&store, &engine, proc)));
+  EXPECT_EQ(-42, IntValue(RunProc(&store, &engine, proc)));
+}
+
+TEST(Thread, SwitchLiteral) {
+  StaticStore store(kStoreSize);
+  // switch p0: a -> p1 = 1, b -> p1 = 2, else p1 = 0
+  Value features[] = { Atom::Get("a"), Atom::Get("b") };
+  Value targets[] = { Value::Integer(3), Value::Integer(4) };
+  const Value branches =
+      Record::New(&store, Atom::Get("branches"), Arity::Get(2, features),
+                  targets);
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::BRANCH_SWITCH_LITERAL, Param(0), Operand(branches)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Immediate(0)));
+  code->push_back(Bytecode(Bytecode::RETURN));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Immediate(1)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Immediate(2)));
+  Closure* const proc = Closure::New(&store, code, 2, 0, 0);
+
+  auto run = [&store, proc](Value value) {
+    Engine engine;
+    const Value result = New::Free(&store);
+    Array* const params = Array::New(&store, 2, value);
+    params->Assign(1, result);
+    New::Thread(&store, &engine, proc, params, &store);
+    engine.Run();
+    return result.Deref();
+  };
+  EXPECT_EQ(1, IntValue(run(Atom::Get("a"))));
+  EXPECT_EQ(2, IntValue(run(Atom::Get("b"))));
+  // No branch matches.
+  EXPECT_EQ(0, IntValue(run(Atom::Get("c"))));
+  EXPECT_EQ(0, IntValue(run(Value::Integer(1))));
+}
+
+TEST(Thread, ExnHandlers) {
+  StaticStore store(kStoreSize);
+  // Raises 42.
+  shared_ptr<vector<Bytecode> > raise_code(new vector<Bytecode>);
+  raise_code->push_back(Bytecode(Bytecode::EXN_RAISE, Immediate(42)));
+  Closure* const raise = Closure::New(&store, raise_code, 1, 0, 0);
+
+  // try { {Raise} } catch { p0 = exn }
+  shared_ptr<vector<Bytecode> > catch_code(new vector<Bytecode>);
+  catch_code->push_back(Bytecode(Bytecode::EXN_PUSH_CATCH, Immediate(4)));
+  catch_code->push_back(
+      Bytecode(Bytecode::CALL, Operand(Value(raise)),
+               Operand(Register(Register::PARAM_ARRAY))));
+  catch_code->push_back(Bytecode(Bytecode::EXN_POP));
+  catch_code->push_back(Bytecode(Bytecode::RETURN));
+  catch_code->push_back(Bytecode(Bytecode::EXN_RESET, Local(0)));
+  catch_code->push_back(Bytecode(Bytecode::UNIFY, Param(0), Local(0)));
+  Closure* const catch_proc = Closure::New(&store, catch_code, 1, 1, 0);
+
+  Engine engine;
+  // The exception raised by the callee is caught by the caller.
+  EXPECT_EQ(42, IntValue(RunProc(&store, &engine, catch_proc)));
+
+  // try { return } finally { p0 = 1 }
+  shared_ptr<vector<Bytecode> > finally_code(new vector<Bytecode>);
+  finally_code->push_back(
+      Bytecode(Bytecode::EXN_PUSH_FINALLY, Immediate(3)));
+  finally_code->push_back(Bytecode(Bytecode::RETURN));
+  finally_code->push_back(Bytecode(Bytecode::EXN_POP));
+  finally_code->push_back(Bytecode(Bytecode::UNIFY, Param(0), Immediate(1)));
+  Closure* const finally_proc = Closure::New(&store, finally_code, 1, 0, 0);
+
+  // Returning from the try block runs the finally handler.
+  EXPECT_EQ(1, IntValue(RunProc(&store, &engine, finally_proc)));
+}
+
+TEST(Thread, IntegerInstructionsOnFloats) {
+  StaticStore store(kStoreSize);
+  Engine engine;
+
+  // Runs p0 = p1 <op> p2.
+  auto run = [&](Bytecode::OpcodeType opcode, Value number1, Value number2) {
+    shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+    code->push_back(Bytecode(opcode, Local(0), Param(1), Param(2)));
+    code->push_back(Bytecode(Bytecode::UNIFY, Param(0), Local(0)));
+    Closure* const proc = Closure::New(&store, code, 3, 1, 0);
+    const Value result = New::Free(&store);
+    Array* const params = Array::New(&store, 3, result);
+    params->Assign(1, number1);
+    params->Assign(2, number2);
+    New::Thread(&store, &engine, proc, params, &store);
+    engine.Run();
+    return result.Deref();
+  };
+
+  // Operands of unknown types in the compiler: small and boxed floats.
+  const Value x = New::Float(&store, 1.5);
+  const Value y = New::Float(&store, 0.5);
+  const Value big = New::Float(&store, 1e300);
+  ASSERT_TRUE(x.IsSmallFloat());
+  ASSERT_FALSE(big.IsSmallFloat());
+  EXPECT_EQ("2.000000", run(Bytecode::NUMBER_INT_ADD, x, y).ToString());
+  EXPECT_EQ("1.000000", run(Bytecode::NUMBER_INT_SUBTRACT, x, y).ToString());
+  EXPECT_EQ("0.750000", run(Bytecode::NUMBER_INT_MULTIPLY, x, y).ToString());
+  EXPECT_EQ("3.000000", run(Bytecode::NUMBER_INT_DIVIDE, x, y).ToString());
+  EXPECT_EQ(Value::FLOAT,
+            run(Bytecode::NUMBER_INT_MULTIPLY, big, x).type());
+  EXPECT_EQ(Value(KAtomTrue()), run(Bytecode::TEST_LESS_THAN, y, x));
+  EXPECT_EQ(Value(KAtomFalse()), run(Bytecode::TEST_LESS_OR_EQUAL, big, x));
+  EXPECT_EQ(5, IntValue(run(Bytecode::NUMBER_INT_ADD, Value::Integer(2),
+                            Value::Integer(3))));
+
+  // Integers and floats do not mix: the thread terminates on a bad operand.
+  EXPECT_EQ(Value::VARIABLE,
+            run(Bytecode::NUMBER_INT_ADD, x, Value::Integer(1)).type());
+  EXPECT_EQ(Value::VARIABLE,
+            run(Bytecode::NUMBER_FLOAT_MULTIPLY, Value::Integer(2),
+                New::Float(&store, 2.0)).type());
+  EXPECT_EQ(Value::VARIABLE,
+            run(Bytecode::TEST_LESS_THAN, Value::Integer(1), x).type());
+}
+
+TEST(Thread, ArrayIndexOutOfRange) {
+  StaticStore store(kStoreSize);
+  Engine engine;
+  // l0 := {NewArray 2 0}  l1 := l0.I  p0 = l1
+  for (int64 index = 1; index <= 2; ++index) {
+    shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+    code->push_back(
+        Bytecode(Bytecode::NEW_ARRAY, Local(0), Immediate(2), Immediate(0)));
+    code->push_back(
+        Bytecode(Bytecode::ACCESS_ARRAY, Local(1), Local(0),
+                 Immediate(index)));
+    code->push_back(Bytecode(Bytecode::UNIFY, Param(0), Local(1)));
+    Closure* const proc = Closure::New(&store, code, 1, 2, 0);
+    const Value result = RunProc(&store, &engine, proc);
+    if (index < 2) {
+      EXPECT_EQ(0, IntValue(result));
+    } else {
+      // Indexes computed by the program are checked in release builds too:
+      // the thread terminates on a bad operand.
+      EXPECT_EQ(Value::VARIABLE, result.type());
+    }
+  }
+}
+
+}  // namespace store
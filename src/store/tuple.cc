@@ -32,7 +32,7 @@ bool Tuple::UnifyWith(UnificationContext* context, Value ovalue) {
   if (size_ != otuple->size_) return false;
   if (!Value::Unify(context, label_, otuple->label_)) return false;
   for (uint64 i = 0; i < size_; ++i)
-    if (!Value::Unify(context, values_[i], otuple->TupleGet(i))) return false;
+    if (!Value::Unify(context, values_[i], otuple->values_[i])) return false;
   return true;
 }
 
@@ -40,12 +40,37 @@ bool Tuple::UnifyWith(UnificationContext* context, Value ovalue) {
 bool Tuple::Equals(EqualityContext* context, Value value) {
   Tuple* tuple = value.as<Tuple>();
   if (size_ != tuple->size_) return false;
+  if (header_.has_hash() && tuple->header_.has_hash()
+      && (header_.hash() != tuple->header_.hash()))
+    return false;
   if (!context->Equals(label_, tuple->label_)) return false;
   for (uint64 i = 0; i < size_; ++i)
     if (!context->Equals(values_[i], tuple->values_[i])) return false;
   return true;
 }
 
+// virtual
+bool Tuple::StructuralHash(uint32* hash) {
+  if (header_.has_hash()) {
+    *hash = header_.hash();
+    return true;
+  }
+  if (!ValueHeader::StartVisit(this)) return false;  // Cyclic value
+  uint32 h = MixHash(kType, size_);
+  uint32 value_hash;
+  bool hashable = label_.StructuralHash(&value_hash);
+  h = MixHash(h, value_hash);
+  for (uint64 i = 0; hashable && (i < size_); ++i) {
+    hashable = values_[i].StructuralHash(&value_hash);
+    h = MixHash(h, value_hash);
+  }
+  ValueHeader::EndVisit(this);
+  if (!hashable) return false;
+  header_.set_hash(h);
+  *hash = h;
+  return true;
+}
+
 // virtual
 HeapValue* Tuple::MoveInternal(Store* store) {
   const uint64 nvalues = size();
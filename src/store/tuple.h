@@ -45,6 +45,7 @@ class Tuple : public HeapValue {
   virtual uint64 RecordWidth() { return size_; }
   virtual bool RecordHas(Value feature);
   virtual Value RecordGet(Value feature);
+  virtual LookupStatus TryRecordGet(Value feature, Value* value);
 
   virtual Value::ItemIterator* RecordIterItems() {
     return new ItemIterator(this);
@@ -64,8 +65,10 @@ class Tuple : public HeapValue {
   virtual Value Optimize(OptimizeContext* context);
   virtual bool UnifyWith(UnificationContext* context, Value ovalue);
   virtual bool Equals(EqualityContext* context, Value value);
+  virtual bool StructuralHash(uint32* hash);
   virtual HeapValue* MoveInternal(Store* store);
   virtual bool IsStateless(StatelessnessContext* context);
+  virtual ValueHeader* header() { return &header_; }
 
   // ---------------------------------------------------------------------------
   // Serialization
@@ -80,6 +83,7 @@ class Tuple : public HeapValue {
   // ---------------------------------------------------------------------------
   // Memory layout
 
+  ValueHeader header_;
   Value label_;
   const uint64 size_;
   Value values_[];
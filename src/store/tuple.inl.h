@@ -44,7 +44,7 @@ Tuple::Tuple(Value label, uint64 size, Value* values)
 
 inline
 Value Tuple::Get(Value int_value) const {
-  return Get(int_value.as<Integer>()->value());
+  return Get(static_cast<uint64>(IntValue(int_value)));
 }
 
 inline
@@ -82,10 +82,20 @@ Value Tuple::RecordGet(Value feature) {
   return Get(ifeat);
 }
 
+// virtual
+inline
+LookupStatus Tuple::TryRecordGet(Value feature, Value* value) {
+  if (!feature.IsSmallInt()) return LOOKUP_NOT_FOUND;
+  const uint64 index = SmallInteger(feature).value() - 1;
+  if (index >= size_) return LOOKUP_NOT_FOUND;
+  *value = values_[index];
+  return LOOKUP_FOUND;
+}
+
 // virtual
 inline
 Value Tuple::TupleGet(uint64 index) {
-  if (index > size_)
+  if (index >= size_)
     throw FeatureNotFound(Value::Integer(index), Arity::GetTuple(size_));
   return values_[index];
 }
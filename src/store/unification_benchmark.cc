@@ -0,0 +1,144 @@
+// Benchmarks the unification of common value shapes:
+//  - a free variable with a small integer;
+//  - two equal atoms, two equal boxed integers;
+//  - two small records, binding their free fields;
+//  - two long lists;
+//  - two records that fail to unify, after binding variables (rollback).
+#include <chrono>
+#include <functional>
+#include <vector>
+using std::function;
+using std::vector;
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "store/values.h"
+
+DEFINE_int64(
+    unify_iterations,
+    1000000,
+    "Number of unifications per benchmark."
+);
+
+DEFINE_int64(
+    list_length,
+    1000,
+    "Length of the lists in the list benchmark."
+);
+
+namespace store {
+
+// Each iteration allocates new values: the store is reset regularly.
+const uint64 kStoreSize = 64 * 1024 * 1024;  // 64MB
+const uint64 kMinFreeSize = 1024 * 1024;  // 1MB
+
+namespace {
+
+// Runs a unification benchmark.
+// @param setup Allocates the values to unify in the given store.
+// @param expected The expected unification result.
+void RunBenchmark(const char* name, int64 iterations,
+                  function<void(Store*, Value*, Value*)> setup,
+                  bool expected) {
+  std::chrono::steady_clock::duration elapsed(0);
+  StaticStore* store = new StaticStore(kStoreSize);
+  for (int64 i = 0; i < iterations; ++i) {
+    if (store->free() < kMinFreeSize) {
+      delete store;
+      store = new StaticStore(kStoreSize);
+    }
+    Value value1, value2;
+    setup(store, &value1, &value2);
+
+    const auto start = std::chrono::steady_clock::now();
+    const bool unified = Unify(value1, value2);
+    elapsed += std::chrono::steady_clock::now() - start;
+    CHECK_EQ(expected, unified) << name;
+  }
+  delete store;
+
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  printf("%-26s %10ld unifications in %.3fs, %8.1f ns per unification\n",
+         name, iterations, seconds, seconds * 1e9 / iterations);
+}
+
+}  // namespace
+
+void UnificationBenchmarks() {
+  const int64 n = FLAGS_unify_iterations;
+
+  RunBenchmark(
+      "variable = integer", n,
+      [](Store* store, Value* v1, Value* v2) {
+        *v1 = New::Free(store);
+        *v2 = Value::Integer(42);
+      },
+      true);
+
+  RunBenchmark(
+      "atom = atom", n,
+      [](Store* store, Value* v1, Value* v2) {
+        *v1 = Atom::Get("atom");
+        *v2 = Atom::Get("atom");
+      },
+      true);
+
+  RunBenchmark(
+      "big integer = big integer", n,
+      [](Store* store, Value* v1, Value* v2) {
+        *v1 = Integer::New(store, kSmallIntMax + 1);
+        *v2 = Integer::New(store, kSmallIntMax + 1);
+      },
+      true);
+
+  RunBenchmark(
+      "small tuple", n,
+      [](Store* store, Value* v1, Value* v2) {
+        Value values1[3] = {
+          New::Free(store), Value::Integer(2), New::Free(store),
+        };
+        Value values2[3] = {
+          Value::Integer(1), New::Free(store), Atom::Get("c"),
+        };
+        *v1 = New::Tuple(store, 3, values1);
+        *v2 = New::Tuple(store, 3, values2);
+      },
+      true);
+
+  const int64 length = FLAGS_list_length;
+  RunBenchmark(
+      "long list", std::max<int64>(1, n / length),
+      [length](Store* store, Value* v1, Value* v2) {
+        vector<Value> values(length);
+        for (int64 i = 0; i < length; ++i)
+          values[i] = Value::Integer(i);
+        *v1 = List::New(store, length, values.data(), KAtomNil());
+        *v2 = List::New(store, length, values.data(), New::Free(store));
+      },
+      true);
+
+  RunBenchmark(
+      "small tuple rollback", n,
+      [](Store* store, Value* v1, Value* v2) {
+        Value values1[3] = {
+          New::Free(store), New::Free(store), Value::Integer(3),
+        };
+        Value values2[3] = {
+          Value::Integer(1), Value::Integer(2), Value::Integer(4),
+        };
+        *v1 = New::Tuple(store, 3, values1);
+        *v2 = New::Tuple(store, 3, values2);
+      },
+      false);
+}
+
+}  // namespace store
+
+int main(int argc, char** argv) {
+  ::google::ParseCommandLineFlags(&argc, &argv, true);
+  ::google::InitGoogleLogging(argv[0]);
+
+  store::UnificationBenchmarks();
+  return EXIT_SUCCESS;
+}
@@ -3,9 +3,18 @@
 #include "store/value.h"
 #include "store/values.h"
 
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+using std::set;
+using std::shared_ptr;
+using std::vector;
+
 #include <gtest/gtest.h>
 
 #include "base/stl-util.h"
+#include "store/engine.h"
 #include "combinators/oznode_eval_visitor.h"
 
 using combinators::oz::ParseEval;
@@ -236,4 +245,165 @@ TEST_F(UnifyTest, OpenRecord) {
   }
 }
 
+TEST_F(UnifyTest, DerefChain) {
+  Variable* v1 = Variable::New(&store_);
+  Variable* v2 = Variable::New(&store_);
+  Variable* v3 = Variable::New(&store_);
+  ASSERT_TRUE(Unify(v1, v2));
+  ASSERT_TRUE(Unify(v2, v3));
+  ASSERT_TRUE(Unify(v3, Value::Integer(42)));
+  EXPECT_EQ(42, IntValue(Deref(v1)));
+  EXPECT_TRUE(IsDet(v1));
+}
+
+TEST_F(UnifyTest, RollbackRestoresSuspensions) {
+  // The threads terminate immediately: they are only moved around between
+  // the suspension lists afterwards.
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(Bytecode(Bytecode::RETURN));
+  Closure* proc = Closure::New(&store_, code, 0, 0, 0);
+  Engine engine;
+  Thread* const t1 = Thread::New(&store_, &engine, proc, Array::EmptyArray,
+                                 &store_);
+  Thread* const t2 = Thread::New(&store_, &engine, proc, Array::EmptyArray,
+                                 &store_);
+  Thread* const t3 = Thread::New(&store_, &engine, proc, Array::EmptyArray,
+                                 &store_);
+  engine.Run();
+
+  Variable* a = Variable::New(&store_);
+  Variable* b = Variable::New(&store_);
+  a->AddSuspension(t1);
+  a->AddSuspension(t2);
+  b->AddSuspension(t3);
+
+  // a is bound to b, then b to 1, then the unification fails on 3 = 4.
+  Value values1[3] = { a, b, Value::Integer(3) };
+  Value values2[3] = { b, Value::Integer(1), Value::Integer(4) };
+  SuspensionList runnable;
+  EXPECT_FALSE(Unify(New::Tuple(&store_, 3, values1),
+                     New::Tuple(&store_, 3, values2),
+                     &runnable));
+  EXPECT_TRUE(runnable.empty());
+
+  EXPECT_TRUE(a->IsFree());
+  EXPECT_TRUE(b->IsFree());
+  EXPECT_EQ(2UL, a->suspensions()->size());
+  EXPECT_EQ(t1, a->suspensions()->front());
+  EXPECT_EQ(t2, a->suspensions()->back());
+  EXPECT_EQ(1UL, b->suspensions()->size());
+  EXPECT_EQ(t3, b->suspensions()->front());
+
+  // Without the failure, all the threads are woken up.
+  values1[2] = Value::Integer(4);
+  EXPECT_TRUE(Unify(New::Tuple(&store_, 3, values1),
+                    New::Tuple(&store_, 3, values2),
+                    &runnable));
+  EXPECT_EQ(1, IntValue(Deref(a)));
+  EXPECT_TRUE(a->suspensions()->empty());
+  EXPECT_TRUE(b->suspensions()->empty());
+  ASSERT_EQ(3UL, runnable.size());
+  set<Thread*> woken;
+  while (!runnable.empty())
+    woken.insert(runnable.PopFront());
+  EXPECT_EQ((set<Thread*>{ t1, t2, t3 }), woken);
+}
+
+TEST_F(UnifyTest, ThreadList) {
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(Bytecode(Bytecode::RETURN));
+  Closure* proc = Closure::New(&store_, code, 0, 0, 0);
+  Engine engine;
+  vector<Thread*> threads;
+  for (int i = 0; i < 4; ++i)
+    threads.push_back(Thread::New(&store_, &engine, proc, Array::EmptyArray,
+                                  &store_));
+  engine.Run();
+
+  ThreadList list1, list2;
+  list1.PushBack(threads[0]);
+  list1.PushBack(threads[1]);
+  list2.PushBack(threads[2]);
+  list2.PushBack(threads[3]);
+  list1.Splice(&list2);
+  EXPECT_TRUE(list2.empty());
+  EXPECT_EQ(4UL, list1.size());
+  EXPECT_EQ(threads[3], list1.back());
+
+  // Moves the last two threads back.
+  list1.SpliceAfter(threads[1], &list2);
+  EXPECT_EQ(2UL, list1.size());
+  EXPECT_EQ(threads[1], list1.back());
+  EXPECT_EQ(threads[2], list2.front());
+  EXPECT_EQ(threads[3], list2.back());
+
+  // Nothing after the last thread.
+  list1.SpliceAfter(threads[1], &list2);
+  EXPECT_EQ(2UL, list2.size());
+
+  list2.SpliceAfter(NULL, &list1);
+  EXPECT_TRUE(list2.empty());
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(threads[i], list1.PopFront());
+  EXPECT_TRUE(list1.empty());
+  EXPECT_TRUE(list1.back() == NULL);
+}
+
+TEST_F(UnifyTest, LargeAtomicFailure) {
+  // More variables and pairs than the context keeps inline.
+  const uint64 kSize = 100;
+  vector<Value> vars(kSize);
+  vector<Value> ints(kSize);
+  for (uint64 i = 0; i < kSize; ++i) {
+    vars[i] = Variable::New(&store_);
+    ints[i] = Value::Integer(i);
+  }
+  Value list1 = List::New(&store_, kSize, vars.data(), KAtomNil());
+  Value list2 = List::New(&store_, kSize, ints.data(), Atom::Get("x"));
+  EXPECT_FALSE(Unify(list1, list2));
+  for (uint64 i = 0; i < kSize; ++i)
+    EXPECT_FALSE(IsDet(vars[i]));
+
+  list2 = List::New(&store_, kSize, ints.data(), KAtomNil());
+  EXPECT_TRUE(Unify(list1, list2));
+  EXPECT_EQ(kSize - 1, IntValue(vars[kSize - 1]));
+}
+
+TEST_F(UnifyTest, DeferredBindings) {
+  // Under a binding lock, the variables are bound only once the unification
+  // succeeds, past the bindings the context keeps inline too.
+  std::mutex lock;
+  set_binding_lock(&lock);
+  const uint64 kSize = 100;
+  vector<Value> vars(kSize);
+  vector<Value> ints(kSize);
+  for (uint64 i = 0; i < kSize; ++i) {
+    vars[i] = Variable::New(&store_);
+    ints[i] = Value::Integer(i);
+  }
+  // Each variable is bound to the next one, then the last one to 0.
+  vector<Value> shifted(vars.begin() + 1, vars.end());
+  shifted.push_back(Value::Integer(0));
+  Value list1 = List::New(&store_, kSize, vars.data(), KAtomNil());
+  Value list2 = List::New(&store_, kSize, shifted.data(), Atom::Get("x"));
+  EXPECT_FALSE(Unify(list1, list2));
+  for (uint64 i = 0; i < kSize; ++i)
+    EXPECT_TRUE(vars[i].as<Variable>()->IsFree());
+
+  // The bindings are seen through the earlier ones during the unification.
+  list2 = List::New(&store_, kSize, shifted.data(), KAtomNil());
+  Value values1[2] = { list1, List::New(&store_, kSize, ints.data(),
+                                         KAtomNil()) };
+  Value values2[2] = { list2, list1 };
+  EXPECT_FALSE(Unify(New::Tuple(&store_, 2, values1),
+                     New::Tuple(&store_, 2, values2)));
+  for (uint64 i = 0; i < kSize; ++i)
+    EXPECT_TRUE(vars[i].as<Variable>()->IsFree());
+
+  EXPECT_TRUE(Unify(list1, list2));
+  for (uint64 i = 0; i < kSize; ++i)
+    EXPECT_EQ(0, IntValue(vars[i]));
+  set_binding_lock(NULL);
+}
+
 }  // namespace store
@@ -33,10 +33,10 @@ void ToASCIIContext::Encode(Value value, string* repr) {
   value = value.Deref();
   ReferenceMap::iterator it = ref_map.find(value);
   if ((it != ref_map.end()) && it->second
-      // Write atoms and integers directly.
+      // Write atoms, numbers and other immediate values directly.
+      && value.IsHeapValue()
       && !(value.IsA<Atom>()
-           || value.IsA<Integer>()
-           || value.IsA<SmallInteger>()))
+           || value.IsA<Integer>()))
     repr->append((format("V%p") % value.heap_value()).str());
   else
     value.ToASCII(this, repr);
@@ -65,6 +65,7 @@ void Value::ToASCII(ToASCIIContext* context, string* repr) const {
   switch (tag()) {
     case kHeapValueTag: heap_value_->ToASCII(context, repr); return;
     case kSmallIntTag: SmallInteger(*this).ToASCII(repr); return;
+    case kSmallFloatTag: SmallFloat(*this).ToASCII(repr); return;
   }
   LOG(FATAL) << "Unexpected value type: tag=" << tag();
 }
@@ -76,23 +77,123 @@ void Value::ToProtoBuf(oz_pb::Value* value) const {
 // -----------------------------------------------------------------------------
 // Value unification
 
-void UnificationContext::AddMutation(Variable* var) {
-  shared_ptr<SuspensionList>& initial_suspensions = mutations[var];
-  if (initial_suspensions == NULL) {
-    initial_suspensions.reset(
-        new SuspensionList(*CHECK_NOTNULL(var->suspensions())));
+const uint64 UnificationContext::kInlinePairs;
+const uint64 UnificationContext::kInlineTrail;
+
+bool UnificationContext::Add(Value value1, Value value2) {
+  const SymmetricValuePair pair(value1, value2);
+  const uint64 ninline = std::min(npairs_, kInlinePairs);
+  for (uint64 i = 0; i < ninline; ++i)
+    if (inline_pairs_[i] == pair) return false;
+  if (npairs_ < kInlinePairs) {
+    inline_pairs_[npairs_++] = pair;
+    return true;
+  }
+  if (!pairs_.insert(pair).second) return false;
+  ++npairs_;
+  return true;
+}
+
+void UnificationContext::Trail(Variable* var,
+                               SuspensionList* moved_to, Thread* last) {
+  const TrailEntry entry = { var, moved_to, last, Value() };
+  if (ntrail_ < kInlineTrail)
+    inline_trail_[ntrail_] = entry;
+  else
+    trail_.push_back(entry);
+  ++ntrail_;
+}
+
+void UnificationContext::Defer(Variable* var, Value value) {
+  DCHECK(deferred_);
+  const TrailEntry entry = { var, NULL, NULL, value };
+  if (ntrail_ < kInlineTrail) {
+    inline_trail_[ntrail_] = entry;
   } else {
-    // The variable initial state is already saved in the mutation pool.
+    trail_.push_back(entry);
+    deferred_bindings_[var] = value;
   }
+  ++ntrail_;
 }
 
+Value UnificationContext::DerefDeferred(Value value) {
+  while (value.type() == Value::VARIABLE) {
+    Variable* const var = value.as<Variable>();
+    Value bound;
+    for (uint64 i = 0; i < std::min(ntrail_, kInlineTrail); ++i) {
+      if (inline_trail_[i].var == var) {
+        bound = inline_trail_[i].value;
+        break;
+      }
+    }
+    if (!bound.IsDefined() && !deferred_bindings_.empty()) {
+      UnorderedMap<Variable*, Value>::const_iterator it =
+          deferred_bindings_.find(var);
+      if (it != deferred_bindings_.end()) bound = it->second;
+    }
+    if (!bound.IsDefined()) break;
+    value = bound.Deref();
+  }
+  return value;
+}
+
+void UnificationContext::Commit() {
+  if (!deferred_) return;
+  // A variable is bound by the transaction only while it is free in the
+  // transaction: each binding finds its variable free.
+  for (uint64 i = 0; i < ntrail_; ++i) {
+    const TrailEntry& entry = TrailAt(i);
+    if (entry.var->BindTo(entry.value))
+      new_runnable.Splice(entry.var->suspensions());
+  }
+  ntrail_ = 0;
+  trail_.clear();
+  deferred_bindings_.clear();
+}
+
+void UnificationContext::Rollback() {
+  if (deferred_) {
+    ntrail_ = 0;
+    trail_.clear();
+    deferred_bindings_.clear();
+    return;
+  }
+  while (ntrail_ > 0) {
+    --ntrail_;
+    const TrailEntry& entry = TrailAt(ntrail_);
+    entry.var->RevertToFree(entry.moved_to, entry.last);
+  }
+  trail_.clear();
+}
+
+namespace {
+
+// @returns True for the values unified structurally, through which
+//     unification may go through a cycle.
+inline
+bool IsStructural(Value value) {
+  if (!value.IsHeapValue()) return false;
+  switch (value.type()) {
+    case Value::RECORD:
+    case Value::TUPLE:
+    case Value::LIST:
+    case Value::OPEN_RECORD:
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
 // static
 bool Value::Unify(UnificationContext* context, Value value1, Value value2) {
   CHECK_NOTNULL(context);
-  value1 = value1.Deref();
-  value2 = value2.Deref();
+  value1 = context->Deref(value1);
+  value2 = context->Deref(value2);
   if (value1 == value2) return true;
-  if (!context->Add(value1, value2))
+  if (IsStructural(value1) && IsStructural(value2)
+      && !context->Add(value1, value2))
     return true;
   // Favor UnboundValue->UnifyWith(BoundValue).
   if (value1.IsDetermined()) {
@@ -106,13 +207,38 @@ bool Value::UnifyWith(UnificationContext* context, Value ovalue) {
   switch (tag()) {
     case kHeapValueTag: return heap_value_->UnifyWith(context, ovalue);
     case kSmallIntTag: return false;  // bits equality
+    case kSmallFloatTag:
+      // 0.0 and -0.0 are equal, but their bits differ.
+      return ovalue.IsSmallFloat()
+          && (SmallFloat(*this).value() == SmallFloat(ovalue).value());
   }
   LOG(FATAL) << "Unexpected value type: tag=" << tag();
 }
 
+namespace {
+
+// Binding lock of the OS thread: see binding_lock().
+thread_local std::mutex* current_binding_lock = NULL;
+
+}  // namespace
+
+std::mutex* binding_lock() {
+  return current_binding_lock;
+}
+
+void set_binding_lock(std::mutex* lock) {
+  current_binding_lock = lock;
+}
+
 bool Unify(Value value1, Value value2, SuspensionList* suspensions) {
   CHECK_NOTNULL(suspensions);
 
+  // Values are dereferenced under the lock: no other OS thread binds them
+  // until the unification is done.
+  std::unique_lock<std::mutex> lock;
+  if (current_binding_lock != NULL)
+    lock = std::unique_lock<std::mutex>(*current_binding_lock);
+
   value1 = value1.Deref();
   value2 = value2.Deref();
   if (value1 == value2) return true;
@@ -120,29 +246,27 @@ bool Unify(Value value1, Value value2, SuspensionList* suspensions) {
   if (value1.type() == Value::VARIABLE) {
     Variable* var1 = value1.as<Variable>();
     if (var1->BindTo(value2)) {
-      suspensions->splice(suspensions->end(), *var1->suspensions());
+      suspensions->Splice(var1->suspensions());
     }
     return true;
 
   } else if (value2.type() == Value::VARIABLE) {
     Variable* var2 = value2.as<Variable>();
     if (var2->BindTo(value1)) {
-      suspensions->splice(suspensions->end(), *var2->suspensions());
+      suspensions->Splice(var2->suspensions());
     }
     return true;
 
   } else {
-    UnificationContext context;
+    UnificationContext context(lock.owns_lock());
     if (Value::Unify(&context, value1, value2)) {
-      suspensions->splice(suspensions->end(), context.new_runnable);
+      context.Commit();
+      suspensions->Splice(&context.new_runnable);
       return true;
 
     } else {
       // Unification failed
-      for (auto it = context.mutations.begin();
-	   it != context.mutations.end();
-	   ++it)
-        it->first->RevertToFree(it->second.get());
+      context.Rollback();
       return false;
     }
   }
@@ -166,12 +290,38 @@ bool Value::Equals(EqualityContext* context, Value value) const {
   switch (tag()) {
     case kHeapValueTag: return heap_value_->Equals(context, value);
     case kSmallIntTag: return false;
+    case kSmallFloatTag:
+      return SmallFloat(*this).value() == SmallFloat(value).value();
+  }
+  LOG(FATAL) << "Unexpected value type: tag=" << tag();
+}
+
+bool Value::StructuralHash(uint32* hash) const {
+  switch (tag()) {
+    case kHeapValueTag: return heap_value_->StructuralHash(hash);
+    case kSmallIntTag: *hash = MixHash(SMALL_INTEGER, bits_); return true;
+    case kSmallFloatTag:
+      *hash = Float::Hash(SmallFloat(*this).value());
+      return true;
   }
   LOG(FATAL) << "Unexpected value type: tag=" << tag();
 }
 
 bool Equals(Value value1, Value value2) {
   EqualityContext context;
+
+  // Compound values cache their structural hash: unequal values are
+  // rejected in O(1) after the first comparison, and nested compound values
+  // with unequal cached hashes are rejected without being traversed.
+  // The value pairs are still tracked: equal values may share subterms.
+  value1 = value1.Deref();
+  value2 = value2.Deref();
+  if (IsStructural(value1) && (value1.type() == value2.type())) {
+    uint32 hash1, hash2;
+    if (value1.StructuralHash(&hash1) && value2.StructuralHash(&hash2)
+        && (hash1 != hash2))
+      return false;
+  }
   return context.Equals(value1, value2);
 }
 
@@ -179,10 +329,20 @@ bool Equals(Value value1, Value value2) {
 // Stateless-ness test
 
 bool StatelessnessContext::IsStateless(Value value) {
+  if (!value.IsHeapValue()) return true;  // Small integers and floats
+  const ValueHeader* header = value.heap_value()->header();
+  if ((header != NULL) && header->stateless()) return true;
   return !ref_map_.insert(value).second
       || value.IsStateless(this);
 }
 
+void StatelessnessContext::MarkStateless() {
+  for (Value value : ref_map_) {
+    ValueHeader* header = value.heap_value()->header();
+    if (header != NULL) header->set_stateless();
+  }
+}
+
 bool Value::IsStateless(StatelessnessContext* context) const {
   CHECK(IsHeapValue());
   return heap_value_->IsStateless(context);
@@ -190,7 +350,9 @@ bool Value::IsStateless(StatelessnessContext* context) const {
 
 bool IsStateless(Value value) {
   StatelessnessContext context;
-  return context.IsStateless(value);
+  if (!context.IsStateless(value)) return false;
+  context.MarkStateless();
+  return true;
 }
 
 // -----------------------------------------------------------------------------
@@ -206,6 +368,7 @@ Value OptimizeContext::Optimize(Value value) {
 Value Value::Optimize(OptimizeContext* context) {
   switch (tag()) {
     case kSmallIntTag: return *this;
+    case kSmallFloatTag: return *this;
     case kHeapValueTag: return heap_value_->Optimize(context);
   }
   LOG(FATAL) << "Unexpected value type: tag=" << tag();
@@ -219,17 +382,26 @@ Value Optimize(Value value) {
 // -----------------------------------------------------------------------------
 
 Value Value::Move(Store* store) {
-  CHECK(IsHeapValue());
+  // Small integers and floats are not stored in the heap.
+  if (!IsHeapValue()) return *this;
   return heap_value_->Move(store);
 }
 
 int64 IntValue(Value value) {
   value = value.Deref();
-  switch (value.tag()) {
-    case kSmallIntTag: return SmallInteger(value).value();
-    case kHeapValueTag: return value.as<Integer>()->value();
-  }
-  LOG(FATAL) << "Unexpected value type: tag=" << value.tag();
+  if (value.IsSmallInt()) return SmallInteger(value).value();
+  CHECK_EQ(Value::INTEGER, value.type())
+      << "Not an integer: " << value.ToString();
+  const mpz_class& mpz = value.as<Integer>()->mpz();
+  CHECK(mpz.fits_slong_p()) << "Integer out of int64 range: " << mpz;
+  return mpz.get_si();
+}
+
+double FloatValue(Value value) {
+  double number;
+  CHECK(Float::GetDouble(value.Deref(), &number))
+      << "Not a float: " << value.ToString();
+  return number;
 }
 
 // -----------------------------------------------------------------------------
@@ -4,6 +4,7 @@
 #include <exception>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 using std::list;
@@ -19,6 +20,7 @@ using std::vector;
 #include "base/real.h"
 #include "base/stl-util.h"
 #include "proto/store.pb.h"
+#include "store/thread_list.h"
 
 
 namespace store {
@@ -39,6 +41,9 @@ class Integer;
 class Atom;
 class Float;
 class String;
+class ByteString;
+class IntArray;
+class FloatArray;
 
 class Arity;
 class ArityMap;
@@ -69,7 +74,8 @@ class NotImplemented : public std::exception {
 class IteratorAtEnd : public std::exception {
 };
 
-typedef list<Thread*> SuspensionList;
+// Threads suspended on a free variable.
+typedef ThreadList SuspensionList;
 
 // Raised when an operation results in suspensing the current thread.
 class SuspendThread : public std::exception {
@@ -82,6 +88,17 @@ class SuspendThread : public std::exception {
   SuspensionList* suspensions;
 };
 
+// Outcome of the record lookups that do not throw: see Value::TryRecordGet().
+enum LookupStatus {
+  LOOKUP_FOUND,
+
+  // The record has no such feature.
+  LOOKUP_NOT_FOUND,
+
+  // The record is open: the lookup must wait until it is closed.
+  LOOKUP_SUSPENDED,
+};
+
 // Raised when resolving a feature that does not exist.
 class FeatureNotFound : public std::exception {
  public:
@@ -127,6 +144,7 @@ const uint64 kTagBitMask = (1 << kTagBits) - 1;
 enum ValueTag {
   kHeapValueTag = 0x00,
   kSmallIntTag = 0x01,
+  kSmallFloatTag = 0x02,
 };
 
 const int kSignedIntBits = kWordSize - 1;
@@ -177,6 +195,13 @@ class Value {
     TYPE_VARIABLE = 18,
 
     SMALL_INTEGER = 19,  // Not a heap value
+
+    BYTE_STRING = 21,
+
+    SMALL_FLOAT = 22,  // Not a heap value
+
+    INT_ARRAY   = 23,
+    FLOAT_ARRAY = 24,
   };
 
   struct ValueHash {
@@ -217,7 +242,8 @@ class Value {
   explicit Value(uint64 bits) : bits_(bits) {}
   Value(const Value& other) : bits_(other.bits_) {}
   Value(HeapValue* heap_value) : heap_value_(heap_value) {
-    CHECK_EQ(kHeapValueTag, tag());
+    // Stores align all blocks on 64 bits words: the tag bits are clear.
+    DCHECK_EQ(kHeapValueTag, tag());
   }
 
   inline
@@ -229,7 +255,7 @@ class Value {
   inline
   Value& operator=(HeapValue* heap_value) {
     heap_value_ = heap_value;
-    CHECK_EQ(kHeapValueTag, tag());
+    DCHECK_EQ(kHeapValueTag, tag());
     return *this;
   }
 
@@ -250,6 +276,8 @@ class Value {
   template <class T>
   bool IsA() const;
 
+  // The value must be a T, which is only checked in debug builds: callers
+  // check the type of values they do not control, as IntValue() does.
   template <class T>
   T* as() const;
 
@@ -265,6 +293,7 @@ class Value {
 
   inline bool IsHeapValue() const { return tag() == kHeapValueTag; }
   inline bool IsSmallInt() const { return tag() == kSmallIntTag; }
+  inline bool IsSmallFloat() const { return tag() == kSmallFloatTag; }
 
   // Dereferences this value.
   // @returns The dereferenced value.
@@ -276,10 +305,20 @@ class Value {
   // @returns This value as a raw uint64.
   inline uint64 bits() const { return bits_; }
 
+  // Loads and stores a mutable slot read and written by the workers of an
+  // engine in parallel (see Engine::set_workers()). The store publishes the
+  // value to the workers loading it: on x86-64, both are plain moves.
+  static inline Value AtomicLoad(const Value* slot) {
+    return Value(__atomic_load_n(&slot->bits_, __ATOMIC_ACQUIRE));
+  }
+  static inline void AtomicStore(Value* slot, Value value) {
+    __atomic_store_n(&slot->bits_, value.bits_, __ATOMIC_RELEASE);
+  }
+
   // May return NULL.
   inline
   HeapValue* heap_value() const {
-    CHECK(IsHeapValue());
+    DCHECK(IsHeapValue());
     return heap_value_;
   }
 
@@ -361,6 +400,16 @@ class Value {
   // @returns True if this and value are equals.
   bool Equals(EqualityContext* context, Value value) const;
 
+  // Computes a hash of this value consistent with Equals():
+  // equal values have equal structural hashes.
+  //
+  // Only determined acyclic values have a structural hash.
+  // Compound values cache their hash once computed.
+  //
+  // @param hash Set to the structural hash, if any.
+  // @returns True if this value is hashable.
+  bool StructuralHash(uint32* hash) const;
+
   // ---------------------------------------------------------------------------
   // Statelessness
 
@@ -435,8 +484,11 @@ class Value {
   // Looks a feature from the open-record up. Non-blocking.
   Value OpenRecordGet(Value feature);
 
-  // Closes this open-record.
-  Value OpenRecordClose(Store* store);
+  // Closes this open-record: binds it to a record of its current features,
+  // as Unify() does. The threads waiting on it join new_runnable.
+  // @returns The record, or an undefined Value if the open-record was closed
+  //     concurrently with other features.
+  Value OpenRecordClose(Store* store, SuspensionList* new_runnable);
 
   // ---------------------------------------------------------------------------
   // Record interface
@@ -460,6 +512,13 @@ class Value {
   //     Blocks for an open-record until it is closed.
   Value RecordGet(Value feature);
 
+  // Looks a feature from the record up, without throwing FeatureNotFound or
+  // SuspendThread: missing features and open records are ordinary outcomes
+  // of pattern matching.
+  // @param value Returns the value of the feature when found, or the
+  //     variable to wait on when the lookup suspends.
+  LookupStatus TryRecordGet(Value feature, Value* value);
+
   // @returns A new iterator on the record items, in order.
   // Caller must take ownership.
   ItemIterator* RecordIterItems();
@@ -552,35 +611,96 @@ class ToASCIIContext {
 
 class UnificationContext {
  public:
-  UnificationContext() {}
+  // @param deferred Whether to bind the variables only when the unification
+  //     succeeds: see Commit().
+  explicit UnificationContext(bool deferred = false)
+      : deferred_(deferred), npairs_(0), ntrail_(0) {}
+
+  // Whether the bindings are deferred until the unification succeeds.
+  // Deferred bindings are recorded on the trail instead of in the variables,
+  // and are visible through Deref() only.
+  bool deferred() const { return deferred_; }
+
+  // Dereferences a value, through the deferred bindings.
+  Value Deref(Value value) {
+    value = value.Deref();
+    if (deferred_) value = DerefDeferred(value);
+    return value;
+  }
+
+  // Records the deferred binding of a variable free in this transaction.
+  void Defer(Variable* var, Value value);
+
+  // Makes the deferred bindings, in the order they were recorded, once the
+  // unification succeeds. The suspensions woken up join new_runnable.
+  void Commit();
 
   // Adds a value pair in the unification context.
   // All value pairs already registered in the context are assumed
   // done already and will not be processed again.
   //
+  // Only pairs of structural values need to be registered, as they are the
+  // only ones that can form cycles. The first pairs are kept inline: unifying
+  // small values does not allocate.
+  //
   // @param value1, value2 The value pair.
   // @returns True if the pair (value1, value2) was unknown before
   //     and has to be processed.
-  bool Add(Value value1, Value value2) {
-    return done.insert(SymmetricValuePair(value1, value2)).second;
-  }
-
-  // Adds the given variable to the mutation pool.
-  // No-op if the variable already exists in the pool.
-  void AddMutation(Variable* var);
+  bool Add(Value value1, Value value2);
 
-  // All the pair of values that have been examined already.
-  SymmetricValuePairSet done;
+  // Records on the trail that a free variable has been bound.
+  //
+  // @param var The variable bound as part of the unification transaction.
+  // @param moved_to The list its suspensions were appended to.
+  // @param last The last thread of moved_to before its suspensions were
+  //     appended, or NULL if moved_to was empty.
+  void Trail(Variable* var, SuspensionList* moved_to, Thread* last);
 
-  // Set of variables modified as part of the unification transaction.
-  // Modified variable are mapped to their initial suspensions list.
-  typedef UnorderedMap<Variable*, shared_ptr<SuspensionList> > MutationMap;
-  MutationMap mutations;
+  // Aborts the unification transaction: reverts the bindings recorded on the
+  // trail, in reverse order, and returns the suspensions to their variables.
+  // Deferred bindings are dropped.
+  void Rollback();
 
   // Threads to wake up if the unification succeeds.
   SuspensionList new_runnable;
 
  private:
+  static const uint64 kInlinePairs = 16;
+  static const uint64 kInlineTrail = 16;
+
+  struct TrailEntry {
+    Variable* var;
+    SuspensionList* moved_to;
+    Thread* last;
+    Value value;  // The deferred binding of var
+  };
+
+  // Follows the deferred bindings from a dereferenced value.
+  Value DerefDeferred(Value value);
+
+  const bool deferred_;
+
+  TrailEntry& TrailAt(uint64 index) {
+    return (index < kInlineTrail)
+        ? inline_trail_[index]
+        : trail_[index - kInlineTrail];
+  }
+
+  // The pairs of values that have been examined already:
+  // the first pairs inline, the other ones in the hash-set.
+  uint64 npairs_;
+  SymmetricValuePair inline_pairs_[kInlinePairs];
+  SymmetricValuePairSet pairs_;
+
+  // Append-only log of the variables bound during the unification:
+  // the first entries inline, the other ones in the vector.
+  uint64 ntrail_;
+  TrailEntry inline_trail_[kInlineTrail];
+  vector<TrailEntry> trail_;
+
+  // Deferred bindings of the variables of trail_, by variable.
+  UnorderedMap<Variable*, Value> deferred_bindings_;
+
   DISALLOW_COPY_AND_ASSIGN(UnificationContext);
 };
 
@@ -608,8 +728,14 @@ class StatelessnessContext {
   StatelessnessContext() {}
 
   // @return True if the given value is stateless.
+  //     Values already proven stateless are not traversed again.
   bool IsStateless(Value value);
 
+  // Records in their header that the compound values traversed so far are
+  // stateless. Valid only if the traversal proved its root stateless, as
+  // every value traversed is reachable from the root.
+  void MarkStateless();
+
  private:
   UnorderedSet<Value> ref_map_;
 
@@ -682,17 +808,26 @@ void Initialize();
 // Unifies two arbitrary Oz values.
 //
 // The unification operation is transactional (all or nothing).
+// Under a binding lock, the bindings of a unification are only made once it
+// succeeds: other OS threads never see the bindings of a failed unification.
 //
 // @param value1 A value (maybe unbound).
 // @param value2 Another value (maybe unbound).
 // @param suspensions Fills this list with the suspensions to wake up.
 // @returns True if successful.
-bool Unify(Value value1, Value value2, list<Thread*>* suspensions);
+bool Unify(Value value1, Value value2, SuspensionList* suspensions);
+
+// The lock serializing the bindings of the variables and the registrations of
+// suspensions, on the OS threads running the workers of an engine: see
+// Engine::set_workers(). Unify() holds it while binding variables.
+// NULL, the default, binds variables without locking.
+std::mutex* binding_lock();
+void set_binding_lock(std::mutex* lock);
 
 // Simplified Unify() when threads are not involved.
 inline
 bool Unify(Value value1, Value value2) {
-  list<Thread*> suspensions;
+  SuspensionList suspensions;
   const bool unified = Unify(value1, value2, &suspensions);
   CHECK(suspensions.empty());
   return unified;
@@ -725,6 +860,7 @@ bool IsDet(Value value) {
 
 // Tests whether the given value graph is stateless.
 // A value is stateless if it is determined and immutable.
+// Once proven, the property is cached in the compound values of the graph.
 bool IsStateless(Value value);
 
 // Optimizes the given value graph.
@@ -737,9 +873,21 @@ Value Optimize(Value value);
 // not alter values to make them equals.
 bool Equals(Value value1, Value value2);
 
-// @returns The value of an Oz integer.
+// Mixes a 64 bits word into a structural hash.
+inline
+uint32 MixHash(uint32 hash, uint64 word) {
+  uint64 mixed = (word ^ hash) * 0x9E3779B97F4A7C15ULL;
+  mixed ^= mixed >> 29;
+  return static_cast<uint32>(mixed ^ (mixed >> 32));
+}
+
+// @returns The value of an Oz integer, which must fit in an int64.
+//     Other values abort, in release builds too.
 int64 IntValue(Value value);
 
+// @returns The value of an Oz float.
+double FloatValue(Value value);
+
 // -----------------------------------------------------------------------------
 
 Atom* KAtomEmpty();
@@ -79,7 +79,7 @@ Value Value::Integer(Store* store, int64 integer) {
 inline
 Value Value::Integer(Store* store, const mpz_class& integer) {
   if (integer.fits_slong_p())
-    return Integer(integer.get_si());
+    return Integer(store, integer.get_si());
   return Integer::New(store, integer);
 }
 
@@ -139,7 +139,7 @@ template <class T>
 inline
 T* Value::as() const {
   HeapValue* const value = heap_value();
-  CHECK_EQ(T::kType, value->type());
+  DCHECK_EQ(T::kType, value->type());
   return static_cast<T*>(value);
 }
 
@@ -148,6 +148,7 @@ Value::ValueType Value::type() const {
   switch (tag()) {
     case kHeapValueTag: return heap_value_->type();
     case kSmallIntTag: return SmallInteger::kType;
+    case kSmallFloatTag: return SmallFloat::kType;
   }
   LOG(FATAL) << "Unexpected value type: tag=" << tag();
 }
@@ -157,6 +158,7 @@ Value Value::Deref() const {
   switch (tag()) {
     case kHeapValueTag: return heap_value_->Deref();
     case kSmallIntTag: return *this;
+    case kSmallFloatTag: return *this;
   }
   LOG(FATAL) << "Unexpected value type: tag=" << tag();
 }
@@ -166,6 +168,7 @@ bool Value::IsDetermined() {
   switch (tag()) {
     case kHeapValueTag: return heap_value_->IsDetermined();
     case kSmallIntTag: return true;
+    case kSmallFloatTag: return true;
   }
   LOG(FATAL) << "Unexpected value type: tag=" << tag();
 }
@@ -175,6 +178,7 @@ uint64 Value::caps() const {
   switch (tag()) {
     case kHeapValueTag: return heap_value_->caps();
     case kSmallIntTag: return SmallInteger(*this).caps();
+    case kSmallFloatTag: return SmallFloat(*this).caps();
   }
   LOG(FATAL) << "Unexpected value type: tag=" << tag();
 }
@@ -207,9 +211,9 @@ Value Value::OpenRecordGet(Value feature) {
 }
 
 inline
-Value Value::OpenRecordClose(Store* store) {
+Value Value::OpenRecordClose(Store* store, SuspensionList* new_runnable) {
   CHECK(IsHeapValue());
-  return heap_value_->OpenRecordClose(store);
+  return heap_value_->OpenRecordClose(store, new_runnable);
 }
 
 // -----------------------------------------------------------------------------
@@ -245,6 +249,12 @@ Value Value::RecordGet(Value feature) {
   return heap_value_->RecordGet(feature);
 }
 
+inline
+LookupStatus Value::TryRecordGet(Value feature, Value* value) {
+  CHECK(IsHeapValue());
+  return heap_value_->TryRecordGet(feature, value);
+}
+
 inline
 Value::ItemIterator* Value::RecordIterItems() {
   CHECK(IsHeapValue());
@@ -274,6 +284,7 @@ uint64 Value::LiteralHashCode() {
   switch (tag()) {
     case kHeapValueTag: return heap_value_->LiteralHashCode();
     case kSmallIntTag: return SmallInteger(*this).LiteralHashCode();
+    case kSmallFloatTag: break;  // Floats are not literals.
   }
   throw NotImplemented();
 }
@@ -285,6 +296,7 @@ bool Value::LiteralEquals(Value other) {
   switch (tag()) {
     case kHeapValueTag: return heap_value_->LiteralEquals(other.heap_value_);
     case kSmallIntTag: return false;
+    case kSmallFloatTag: throw NotImplemented();  // Floats are not literals.
   }
   LOG(FATAL) << "Unexpected value type: tag=" << tag();
 }
@@ -297,6 +309,7 @@ bool Value::LiteralLessThan(Value other) {
     switch (tag()) {
       case kHeapValueTag: return heap_value_->LiteralLessThan(other);
       case kSmallIntTag: return SmallInteger(*this).LiteralLessThan(other);
+      case kSmallFloatTag: break;  // Floats are not literals.
     }
     throw NotImplemented();
   } else {
@@ -309,6 +322,7 @@ Value::LiteralClass Value::LiteralGetClass() {
   switch (tag()) {
     case kHeapValueTag: return heap_value_->LiteralGetClass();
     case kSmallIntTag: return LITERAL_CLASS_INTEGER;
+    case kSmallFloatTag: break;  // Floats are not literals.
   }
   throw NotImplemented();
 }
@@ -362,10 +376,23 @@ class New {
     return store::String::Get(store, str);
   }
 
+  static inline
+  Value ByteString(Store* store, const StringPiece& bytes) {
+    return store::ByteString::New(store, bytes);
+  }
+
+  // Small floats are not boxed.
+  static inline
+  Value Float(Store* store, double value) {
+    if (SmallFloat::IsSmallFloat(value))
+      return SmallFloat(value).Encode();
+    return store::Float::New(store, value);
+  }
+
+  // Rounds an arbitrary precision float to the nearest double.
   static inline
   Value Real(Store* store, const base::real::Real& real) {
-    LOG(FATAL) << "not implemented";
-    // return store::String::Real(store, real);
+    return Float(store, real.ToDouble());
   }
 
   static inline
@@ -447,10 +474,7 @@ class New {
 
   static inline
   Value List(Store* store, uint64 nvalues, Value* values) {
-    Value value = KAtomNil();
-    for (int64 i = nvalues - 1; i >= 0; --i)
-      value = List(store, values[i], value);
-    return value;
+    return store::List::New(store, nvalues, values, KAtomNil());
   }
 
   static inline
@@ -463,11 +487,15 @@ class New {
     return store::Array::New(store, size, initial);
   }
 
+  // @returns An undefined value if the bytecode is invalid
+  //     (see store::Closure::New()).
   static inline
   Value Closure(Store* store,
                 const shared_ptr<vector<Bytecode> >& bytecode,
-                int nparams, int nlocals, int nclosures) {
-    return store::Closure::New(store, bytecode, nparams, nlocals, nclosures);
+                int nparams, int nlocals, int nclosures,
+                vector<string>* errors = NULL) {
+    return store::Closure::New(store, bytecode, nparams, nlocals, nclosures,
+                               errors);
   }
 
   static inline
@@ -477,6 +505,8 @@ class New {
     return store::Closure::New(store, closure, environment);
   }
 
+  // @returns An undefined value if the thread cannot be created
+  //     (see store::Thread::New()).
   static inline
   Value Thread(Store* store, Engine* engine, Value closure_val,
                store::Array* parameters, Store* thread_store) {
@@ -13,10 +13,12 @@
 // Primitive values
 #include "store/atom.h"
 #include "store/boolean.h"
+#include "store/byte_string.h"
 #include "store/float.h"
 #include "store/integer.h"
 #include "store/name.h"
 #include "store/small_integer.h"
+#include "store/small_float.h"
 #include "store/string.h"
 
 // Compound values
@@ -27,24 +29,31 @@
 #include "store/cell.h"
 #include "store/closure.h"
 #include "store/list.h"
+#include "store/numeric_array.h"
 #include "store/open_record.h"
 #include "store/record.h"
 #include "store/tuple.h"
 
 #include "store/thread.h"
 #include "store/bytecode.h"
+#include "store/packed_code.h"
+#include "store/jit.h"
+#include "store/opcode_profile.h"
 
 // Inlined declarations
 
 #include "store/value.inl.h"
 #include "store/arity.inl.h"
 #include "store/small_integer.inl.h"
+#include "store/float.inl.h"
 #include "store/integer.inl.h"
 #include "store/list.inl.h"
 #include "store/open_record.inl.h"
 #include "store/tuple.inl.h"
 #include "store/record.inl.h"
 
+#include "store/engine.inl.h"
 #include "store/thread.inl.h"
+#include "store/thread_list.inl.h"
 
 #endif  // STORE_VALUES_H_
@@ -91,4 +91,121 @@ TEST_F(ToStringTest, Lists) {
             ParseEval("[1 {NewName} 3]", &store_).ToString());
 }
 
+// -----------------------------------------------------------------------------
+// Statelessness and deep determinacy
+
+class StatelessnessTest : public testing::Test {
+ protected:
+  StatelessnessTest()
+      : store_(kStoreSize) {
+  }
+
+  StaticStore store_;
+};
+
+TEST_F(StatelessnessTest, Stateless) {
+  EXPECT_TRUE(IsStateless(Value::Integer(1)));
+  EXPECT_TRUE(IsStateless(Atom::Get("atom")));
+  EXPECT_FALSE(IsStateless(New::Cell(&store_, Value::Integer(1))));
+  EXPECT_FALSE(IsStateless(New::Free(&store_)));
+
+  Value values[3] = {
+    Value::Integer(1), New::Free(&store_), Atom::Get("c"),
+  };
+  Value tuple = New::Tuple(&store_, 3, values);
+  Value list = New::List(&store_, 3, values);
+  EXPECT_FALSE(IsStateless(tuple));
+  EXPECT_FALSE(IsStateless(list));
+  EXPECT_FALSE(tuple.as<Tuple>()->header()->stateless());
+
+  // The statelessness is cached once proven.
+  EXPECT_TRUE(Unify(values[1], ParseEval("f(x:[1 2])", &store_)));
+  EXPECT_TRUE(IsStateless(tuple));
+  EXPECT_TRUE(IsStateless(list));
+  EXPECT_TRUE(tuple.as<Tuple>()->header()->stateless());
+  Value record = Deref(values[1]);
+  EXPECT_TRUE(record.as<Record>()->header()->stateless());
+
+  Value cell_values[2] = { Value::Integer(1), New::Cell(&store_, tuple) };
+  EXPECT_FALSE(IsStateless(New::Tuple(&store_, 2, cell_values)));
+}
+
+TEST_F(StatelessnessTest, Cycles) {
+  // A cyclic stateless value, and the same cycle through a cell.
+  Value x = New::Free(&store_);
+  Value cyclic = New::List(&store_, Value::Integer(1), x);
+  EXPECT_TRUE(Unify(x, cyclic));
+  EXPECT_TRUE(IsStateless(cyclic));
+
+  // b is traversed through a, while the cycle is not proven stateless yet:
+  // b must not be marked stateless, as it reaches the cell.
+  Value y = New::Free(&store_);
+  Value b_values[1] = { y };
+  Value b = New::Tuple(&store_, 1, b_values);
+  Value a_values[2] = { b, New::Cell(&store_, Value::Integer(1)) };
+  Value a = New::Tuple(&store_, 2, a_values);
+  EXPECT_TRUE(Unify(y, a));
+  EXPECT_FALSE(IsStateless(a));
+  EXPECT_FALSE(b.as<Tuple>()->header()->stateless());
+  EXPECT_FALSE(IsStateless(b));
+}
+
+TEST(RecordLookup, TryRecordGet) {
+  StaticStore store(kStoreSize);
+  Value a = Atom::Get("a");
+  const Value b = Atom::Get("b");
+  Value value;
+
+  Value record = ParseEval("f(a:1 b:2)", &store);
+  EXPECT_EQ(LOOKUP_FOUND, record.TryRecordGet(b, &value));
+  EXPECT_EQ(2, IntValue(value));
+  EXPECT_EQ(LOOKUP_NOT_FOUND, record.TryRecordGet(Atom::Get("c"), &value));
+
+  uint64 index = 0;
+  EXPECT_TRUE(record.RecordArity()->TryMap(b, &index));
+  EXPECT_EQ(1UL, index);
+  EXPECT_FALSE(record.RecordArity()->TryMap(Value::Integer(1), &index));
+
+  Value tuple = ParseEval("f(1 2)", &store);
+  EXPECT_EQ(LOOKUP_FOUND, tuple.TryRecordGet(Value::Integer(2), &value));
+  EXPECT_EQ(2, IntValue(value));
+  EXPECT_EQ(LOOKUP_NOT_FOUND, tuple.TryRecordGet(Value::Integer(3), &value));
+  EXPECT_EQ(LOOKUP_NOT_FOUND, tuple.TryRecordGet(a, &value));
+
+  Value list = ParseEval("[1 2]", &store);
+  EXPECT_EQ(LOOKUP_FOUND, list.TryRecordGet(Value::Integer(1), &value));
+  EXPECT_EQ(1, IntValue(value));
+  EXPECT_EQ(LOOKUP_NOT_FOUND, list.TryRecordGet(Value::Integer(0), &value));
+
+  EXPECT_EQ(LOOKUP_NOT_FOUND, a.TryRecordGet(a, &value));
+
+  // Lookups on an open record wait until the record is closed.
+  Value orecord = OpenRecord::New(&store, Atom::Get("f"));
+  orecord.as<OpenRecord>()->Set(a, Value::Integer(1));
+  EXPECT_EQ(LOOKUP_SUSPENDED, orecord.TryRecordGet(a, &value));
+  EXPECT_EQ(Value::VARIABLE, value.type());
+
+  // Small integer features index tuples directly.
+  EXPECT_EQ(2, IntValue(tuple.as<Tuple>()->Get(Value::Integer(2))));
+}
+
+// Values of the wrong type are never read as another type: IntValue() checks
+// the type in release builds too, Value::as<T>() in debug builds only.
+TEST(ValueDeathTest, TypeChecks) {
+  StaticStore store(kStoreSize);
+  const Value var = Variable::New(&store);
+  const Value big_float = New::Float(&store, 1e300);
+  const Value big_int = Value::Integer(&store, "123456789012345678901234567890");
+
+  EXPECT_DEBUG_DEATH(var.as<Integer>(), "");
+  EXPECT_DEBUG_DEATH(big_float.as<Integer>(), "");
+  EXPECT_DEBUG_DEATH(Value::Integer(1).heap_value(), "");
+
+  EXPECT_DEATH(IntValue(var), "Not an integer");
+  EXPECT_DEATH(IntValue(big_float), "Not an integer");
+  EXPECT_DEATH(IntValue(New::Float(&store, 1.5)), "Not an integer");
+  EXPECT_DEATH(IntValue(big_int), "out of int64 range");
+  EXPECT_EQ(42, IntValue(Value::Integer(&store, 42)));
+}
+
 }  // namespace store
@@ -16,36 +16,48 @@ const Value::ValueType Variable::kType;
 
 // virtual
 Value Variable::Deref() {
-  return ref_.IsDefined() ? ref_ : this;
+  const Value ref = this->ref();
+  return ref.IsDefined() ? ref.Deref() : this;
 }
 
 // virtual
 Value Variable::Optimize(OptimizeContext* context) {
-  return ref_.IsDefined()
-      ? context->Optimize(ref_)
+  const Value ref = this->ref();
+  return ref.IsDefined()
+      ? context->Optimize(ref)
       : this;
 }
 
 // virtual
 void Variable::ExploreValue(ReferenceMap* ref_map) {
   CHECK_NOTNULL(ref_map);
-  if (ref_.IsDefined())
-    ref_.Explore(ref_map);
+  const Value ref = this->ref();
+  if (ref.IsDefined())
+    ref.Explore(ref_map);
 }
 
 // virtual
 bool Variable::IsStateless(StatelessnessContext* context) {
-  return ref_.IsDefined() && context->IsStateless(ref_);
+  const Value ref = this->ref();
+  return ref.IsDefined() && context->IsStateless(ref);
+}
+
+// virtual
+bool Variable::StructuralHash(uint32* hash) {
+  // Free variables are not hashable: they may become anything.
+  const Value ref = this->ref();
+  return ref.IsDefined() && ref.StructuralHash(hash);
 }
 
 // virtual
 void Variable::ToASCII(ToASCIIContext* context, string* repr) {
   CHECK_NOTNULL(context);
   CHECK_NOTNULL(repr);
-  if (!ref_.IsDefined())
+  const Value ref = this->ref();
+  if (!ref.IsDefined())
     repr->append("_");
   else
-    context->Encode(ref_, repr);
+    context->Encode(ref, repr);
 }
 
 // virtual
@@ -57,39 +69,41 @@ void Variable::ToProtoBuf(oz_pb::Value* pb) {
 // virtual
 bool Variable::UnifyWith(UnificationContext* context, Value ovalue) {
   CHECK_NOTNULL(context);
-  CHECK(!ref_.IsDefined());
+  CHECK(IsFree());
   CHECK(ovalue != this);
 
-  // Save this variable state.
-  context->AddMutation(this);
+  if (context->deferred()) {
+    // Already bound by the transaction, through an open record for instance.
+    const Value bound = context->Deref(this);
+    if (bound != Value(this)) return Value::Unify(context, bound, ovalue);
+    context->Defer(this, ovalue);
+    return true;
+  }
 
-  ref_ = ovalue;
+  set_ref(ovalue);
+  // Transfer suspensions to the other free variable, or wake them up if the
+  // unification succeeds. The trail records where they went.
+  SuspensionList* moved_to = &context->new_runnable;
   if (ovalue.type() == Value::VARIABLE) {
     Variable* ovar = ovalue.as<Variable>();
-    CHECK(!ovar->ref_.IsDefined());
-    // Save this other variable state too.
-    context->AddMutation(ovar);
-
-    // Transfer suspensions to the other free variable.
-    ovar->suspensions()->splice(ovar->suspensions()->end(), suspensions_);
-
-  } else {
-    // Wake up suspensions if the unification succeeds.
-    context->new_runnable.splice(context->new_runnable.end(), suspensions_);
+    CHECK(ovar->IsFree());
+    moved_to = ovar->suspensions();
   }
+  context->Trail(this, moved_to, moved_to->back());
+  moved_to->Splice(&suspensions_);
   return true;
 }
 
 bool Variable::BindTo(Value value) {
-  CHECK(!ref_.IsDefined());
+  CHECK(IsFree());
   CHECK(value != this);
-  ref_ = value;
+  set_ref(value);
   if (value.type() == Value::VARIABLE) {
     Variable* ovar = value.as<Variable>();
-    CHECK(!ovar->ref_.IsDefined());
+    CHECK(ovar->IsFree());
     // Merge this free variable into the other free variable:
     // transfer its suspensions into the other variable.
-    ovar->suspensions_.splice(ovar->suspensions_.end(), suspensions_);
+    ovar->suspensions_.Splice(&suspensions_);
     return false;
 
   } else {
@@ -98,9 +112,10 @@ bool Variable::BindTo(Value value) {
   }
 }
 
-void Variable::RevertToFree(SuspensionList* suspensions) {
-  ref_ = NULL;
-  suspensions_.swap(*suspensions);
+void Variable::RevertToFree(SuspensionList* moved_to, Thread* last) {
+  CHECK(suspensions_.empty());
+  set_ref(Value());
+  moved_to->SpliceAfter(last, &suspensions_);
 }
 
 }  // namespace store
@@ -1,6 +1,7 @@
 #ifndef STORE_VARIABLE_H_
 #define STORE_VARIABLE_H_
 
+#include <atomic>
 #include <list>
 #include <string>
 
@@ -10,6 +11,11 @@ using std::string;
 namespace store {
 
 // Free variable with suspensions.
+//
+// The workers of an engine read the bindings of the variables without
+// locking: a binding is published atomically, with the value it references.
+// The bindings themselves and the suspensions are updated under the binding
+// lock of the engine: see Unify() and Engine::set_workers().
 class Variable : public HeapValue {
  public:
   static const Value::ValueType kType = Value::VARIABLE;
@@ -45,18 +51,20 @@ class Variable : public HeapValue {
   //     false if the variable is still undetermined after the operation.
  bool BindTo(Value value);
 
-  // Reverts the changes from an aborted unification.
-  // The variable becomes free again if it was bound during the unification.
-  // The suspensions list is reverted.
-  // @param suspensions The initial suspensions list to revert to.
-  void RevertToFree(list<Thread*>* suspensions);
+  // Reverts the binding of this variable, from an aborted unification.
+  // The variable becomes free again, and gets its suspensions back.
+  // Bindings must be reverted in the reverse order of the unification.
+  // @param moved_to The list the suspensions of this variable were moved to.
+  // @param last The last thread of moved_to before the suspensions of this
+  //     variable were appended, or NULL if they start moved_to.
+  void RevertToFree(SuspensionList* moved_to, Thread* last);
 
-  bool IsFree() const { return ref_ == NULL; }
-  Value ref() const { return ref_; }
+  bool IsFree() const { return !ref().IsDefined(); }
+  Value ref() const { return Value(ref_.load(std::memory_order_acquire)); }
 
   SuspensionList* suspensions() { return &suspensions_; }
   void AddSuspension(Thread* thread) {
-    suspensions_.push_back(thread);
+    suspensions_.PushBack(thread);
   }
 
   // ---------------------------------------------------------------------------
@@ -69,6 +77,7 @@ class Variable : public HeapValue {
   virtual bool UnifyWith(UnificationContext* context, Value value);
   virtual bool IsDetermined() { return !IsFree(); }
   virtual bool IsStateless(StatelessnessContext* context);
+  virtual bool StructuralHash(uint32* hash);
 
   // ---------------------------------------------------------------------------
   // Serialization
@@ -78,14 +87,19 @@ class Variable : public HeapValue {
  private:  // ------------------------------------------------------------------
 
   // Initializes a new free variable.
-  Variable() : ref_((HeapValue*) NULL) {}
+  Variable() : ref_(0) {}
   virtual ~Variable() {}
 
+  void set_ref(Value value) {
+    ref_.store(value.bits(), std::memory_order_release);
+  }
+
   // ---------------------------------------------------------------------------
   // Memory layout
 
-  // NULL as long as the value is unbound.
-  Value ref_;
+  // The bits of the value bound to the variable, 0 as long as the variable is
+  // unbound.
+  std::atomic<uint64> ref_;
 
   // List of the threads suspended on this value.
   SuspensionList suspensions_;
@@ -0,0 +1,325 @@
+#include "store/values.h"
+
+#include "store/verifier.h"
+
+#include <boost/format.hpp>
+using boost::format;
+
+namespace store {
+
+namespace {
+
+// @returns The operand an instruction writes its result to, from 1 to 3, or
+//     0 if the instruction has no destination operand.
+// Lists every opcode, so that the compiler warns about new opcodes.
+int DestinationOperand(Bytecode::OpcodeType opcode) {
+  switch (opcode) {
+    case Bytecode::NO_OPERATION:
+    case Bytecode::UNIFY:
+    case Bytecode::UNIFY_RECORD_FIELD:
+    case Bytecode::BRANCH:
+    case Bytecode::BRANCH_IF:
+    case Bytecode::BRANCH_UNLESS:
+    case Bytecode::BRANCH_SWITCH_LITERAL:
+    case Bytecode::CALL:
+    case Bytecode::CALL_TAIL:
+    case Bytecode::CALL_NATIVE:
+    case Bytecode::RETURN:
+    case Bytecode::EXN_PUSH_CATCH:
+    case Bytecode::EXN_PUSH_FINALLY:
+    case Bytecode::EXN_POP:
+    case Bytecode::EXN_RAISE:
+    case Bytecode::EXN_RERAISE:
+    case Bytecode::ASSIGN_CELL:
+    case Bytecode::ASSIGN_ARRAY:
+      return 0;
+
+    case Bytecode::LOAD:
+    case Bytecode::EXN_RESET:
+      return 1;
+
+    case Bytecode::TRY_UNIFY:
+      return 3;
+
+    // Constructors, accessors, predicates and number operations return their
+    // result in their first operand.
+    case Bytecode::NEW_VARIABLE:
+    case Bytecode::NEW_NAME:
+    case Bytecode::NEW_CELL:
+    case Bytecode::NEW_ARRAY:
+    case Bytecode::NEW_ARITY:
+    case Bytecode::NEW_LIST:
+    case Bytecode::NEW_TUPLE:
+    case Bytecode::NEW_RECORD:
+    case Bytecode::NEW_PROC:
+    case Bytecode::NEW_THREAD:
+    case Bytecode::GET_VALUE_TYPE:
+    case Bytecode::ACCESS_CELL:
+    case Bytecode::ACCESS_ARRAY:
+    case Bytecode::ACCESS_RECORD:
+    case Bytecode::ACCESS_RECORD_LABEL:
+    case Bytecode::ACCESS_RECORD_ARITY:
+    case Bytecode::ACCESS_OPEN_RECORD_ARITY:
+    case Bytecode::TEST_IS_DET:
+    case Bytecode::TEST_IS_RECORD:
+    case Bytecode::TEST_EQUALITY:
+    case Bytecode::TEST_LESS_THAN:
+    case Bytecode::TEST_LESS_OR_EQUAL:
+    case Bytecode::TEST_ARITY_EXTENDS:
+    case Bytecode::NUMBER_INT_INVERSE:
+    case Bytecode::NUMBER_INT_ADD:
+    case Bytecode::NUMBER_INT_SUBTRACT:
+    case Bytecode::NUMBER_INT_MULTIPLY:
+    case Bytecode::NUMBER_INT_DIVIDE:
+    case Bytecode::NUMBER_INT_MODULO:
+    case Bytecode::NUMBER_INT_POWER:
+    case Bytecode::NUMBER_INT_BIT_AND:
+    case Bytecode::NUMBER_INT_BIT_OR:
+    case Bytecode::NUMBER_INT_BIT_XOR:
+    case Bytecode::NUMBER_INT_SHIFT_LEFT:
+    case Bytecode::NUMBER_INT_SHIFT_RIGHT:
+    case Bytecode::NUMBER_FLOAT_INVERSE:
+    case Bytecode::NUMBER_FLOAT_ADD:
+    case Bytecode::NUMBER_FLOAT_SUBTRACT:
+    case Bytecode::NUMBER_FLOAT_MULTIPLY:
+    case Bytecode::NUMBER_FLOAT_DIVIDE:
+    case Bytecode::NUMBER_FLOAT_LESS_THAN:
+    case Bytecode::NUMBER_FLOAT_LESS_OR_EQUAL:
+    case Bytecode::NUMBER_INT_TO_FLOAT:
+    case Bytecode::NUMBER_FLOAT_TO_INT:
+    case Bytecode::NUMBER_BOOL_NEGATE:
+    case Bytecode::NUMBER_BOOL_AND_THEN:
+    case Bytecode::NUMBER_BOOL_OR_ELSE:
+    case Bytecode::NUMBER_BOOL_XOR:
+      return 1;
+
+    case Bytecode::OPCODE_TYPE_COUNT:
+      break;
+  }
+  LOG(FATAL) << "Invalid opcode: " << opcode;
+  return 0;
+}
+
+// @returns The operand holding the code pointer an instruction jumps to,
+//     from 1 to 3, or 0 if the instruction has no static target.
+int TargetOperand(Bytecode::OpcodeType opcode) {
+  switch (opcode) {
+    case Bytecode::BRANCH:
+    case Bytecode::EXN_PUSH_CATCH:
+    case Bytecode::EXN_PUSH_FINALLY:
+      return 1;
+    case Bytecode::BRANCH_IF:
+    case Bytecode::BRANCH_UNLESS:
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+class Verifier {
+ public:
+  Verifier(const vector<Bytecode>& bytecode,
+           uint64 nparams, uint64 nlocals, uint64 nclosures,
+           vector<string>* errors)
+      : bytecode_(bytecode),
+        nparams_(nparams),
+        nlocals_(nlocals),
+        nclosures_(nclosures),
+        errors_(errors),
+        valid_(true) {
+  }
+
+  bool Verify();
+
+ private:
+  void VerifyOperand(uint64 code_pointer, int ioperand);
+  void VerifyDestination(uint64 code_pointer, int ioperand);
+  void VerifyTarget(uint64 code_pointer, int ioperand);
+
+  // Adds an immediate to the constant pool the packed code will have.
+  void AddConstant(uint64 code_pointer, Value value);
+
+  // Reports an error on an instruction.
+  void Error(uint64 code_pointer, const string& error);
+
+  const Operand& operand(uint64 code_pointer, int ioperand) const {
+    const Bytecode& inst = bytecode_[code_pointer];
+    switch (ioperand) {
+      case 1: return inst.operand1;
+      case 2: return inst.operand2;
+      default: return inst.operand3;
+    }
+  }
+
+  const vector<Bytecode>& bytecode_;
+  const uint64 nparams_;
+  const uint64 nlocals_;
+  const uint64 nclosures_;
+  vector<string>* const errors_;
+  bool valid_;
+
+  // Bits of the distinct immediates: see PackedCode.
+  UnorderedSet<uint64> constants_;
+};
+
+bool Verifier::Verify() {
+  // Code pointers of the try blocks not closed yet, innermost last.
+  vector<uint64> open_try_blocks;
+  for (uint64 cp = 0; cp < bytecode_.size(); ++cp) {
+    const Bytecode& inst = bytecode_[cp];
+    if ((inst.opcode < 0) || (inst.opcode >= Bytecode::OPCODE_TYPE_COUNT)) {
+      Error(cp, (format("invalid opcode %d") % inst.opcode).str());
+      continue;
+    }
+    for (int i = 1; i <= 3; ++i) {
+      VerifyOperand(cp, i);
+      const Operand& op = operand(cp, i);
+      if (op.type == Operand::IMMEDIATE) AddConstant(cp, op.value);
+    }
+
+    const int destination = DestinationOperand(inst.opcode);
+    if (destination != 0) VerifyDestination(cp, destination);
+    const int target = TargetOperand(inst.opcode);
+    if (target != 0) VerifyTarget(cp, target);
+
+    if ((inst.opcode == Bytecode::EXN_PUSH_CATCH)
+        || (inst.opcode == Bytecode::EXN_PUSH_FINALLY))
+      open_try_blocks.push_back(cp);
+    // The EXN_POP of a finally block holds its handler as a constant.
+    if ((inst.opcode == Bytecode::EXN_PUSH_FINALLY)
+        && (inst.operand1.type == Operand::IMMEDIATE)
+        && inst.operand1.value.Deref().IsSmallInt())
+      AddConstant(cp, Value::Integer(IntValue(inst.operand1.value.Deref())));
+    if (inst.opcode == Bytecode::EXN_POP) {
+      if (open_try_blocks.empty())
+        Error(cp, "no try block to close");
+      else
+        open_try_blocks.pop_back();
+    }
+  }
+  for (uint64 cp : open_try_blocks)
+    Error(cp, "try block not closed");
+  return valid_;
+}
+
+void Verifier::VerifyOperand(uint64 code_pointer, int ioperand) {
+  const Operand& op = operand(code_pointer, ioperand);
+  if (op.type != Operand::REGISTER) return;
+
+  const Register& reg = op.reg;
+  uint64 nregisters;
+  const char* registers;
+  switch (reg.type) {
+    case Register::LOCAL:
+      nregisters = nlocals_;
+      registers = "local registers";
+      break;
+    case Register::PARAM:
+      nregisters = nparams_;
+      registers = "parameters";
+      break;
+    case Register::ENVMT:
+      nregisters = nclosures_;
+      registers = "closure values";
+      break;
+    case Register::ARRAY:
+      // Array registers index an array set by the program: they are checked
+      // when executed.
+      nregisters = PackedOperand::kMaxIndex + 1;
+      registers = "array registers";
+      break;
+    case Register::LOCAL_ARRAY:
+    case Register::PARAM_ARRAY:
+    case Register::ENVMT_ARRAY:
+    case Register::ARRAY_ARRAY:
+    case Register::EXN:
+      return;
+    default:
+      Error(code_pointer,
+            (format("operand %d: invalid register type %d")
+             % ioperand % reg.type).str());
+      return;
+  }
+  if ((reg.index < 0) || (static_cast<uint64>(reg.index) >= nregisters)) {
+    Error(code_pointer,
+          (format("operand %d: register %s out of range (%d %s)")
+           % ioperand % DebugString(reg) % nregisters % registers).str());
+  } else if (reg.index > PackedOperand::kMaxIndex) {
+    Error(code_pointer,
+          (format("operand %d: register %s does not fit in a packed operand "
+                  "(%d %s at most)")
+           % ioperand % DebugString(reg) % (PackedOperand::kMaxIndex + 1)
+           % registers).str());
+  }
+}
+
+void Verifier::VerifyDestination(uint64 code_pointer, int ioperand) {
+  const Operand& op = operand(code_pointer, ioperand);
+  if (op.type != Operand::REGISTER) {
+    Error(code_pointer,
+          (format("operand %d: destination is not a register") % ioperand)
+          .str());
+    return;
+  }
+  switch (op.reg.type) {
+    case Register::ENVMT:
+    case Register::ENVMT_ARRAY:
+    case Register::LOCAL_ARRAY:
+    case Register::PARAM_ARRAY:
+      Error(code_pointer,
+            (format("operand %d: register %s is read-only")
+             % ioperand % DebugString(op.reg)).str());
+      return;
+    default:
+      return;
+  }
+}
+
+void Verifier::VerifyTarget(uint64 code_pointer, int ioperand) {
+  const Operand& op = operand(code_pointer, ioperand);
+  if ((op.type != Operand::IMMEDIATE) || !op.value.Deref().IsSmallInt()) {
+    Error(code_pointer,
+          (format("operand %d: code pointer is not a small integer immediate")
+           % ioperand).str());
+    return;
+  }
+  const int64 target = IntValue(op.value.Deref());
+  if ((target < 0) || (static_cast<uint64>(target) > bytecode_.size())) {
+    Error(code_pointer,
+          (format("operand %d: code pointer %d out of range "
+                  "(%d instructions)")
+           % ioperand % target % bytecode_.size()).str());
+  }
+}
+
+void Verifier::AddConstant(uint64 code_pointer, Value value) {
+  const uint64 max_constants = PackedOperand::kMaxIndex + 1;
+  // Reports the first constant beyond the packed operands only.
+  if (constants_.insert(value.bits()).second
+      && (constants_.size() == max_constants + 1)) {
+    Error(code_pointer,
+          (format("too many constants (%d at most)") % max_constants).str());
+  }
+}
+
+void Verifier::Error(uint64 code_pointer, const string& error) {
+  valid_ = false;
+  if (errors_ == NULL) return;
+  const Bytecode& inst = bytecode_[code_pointer];
+  const string opcode =
+      ((inst.opcode >= 0) && (inst.opcode < Bytecode::OPCODE_TYPE_COUNT))
+      ? inst.GetOpcodeName()
+      : string("?");
+  errors_->push_back(
+      (format("CP=%d %s: %s") % code_pointer % opcode % error).str());
+}
+
+}  // namespace
+
+bool VerifyBytecode(const vector<Bytecode>& bytecode,
+                    uint64 nparams, uint64 nlocals, uint64 nclosures,
+                    vector<string>* errors) {
+  return Verifier(bytecode, nparams, nlocals, nclosures, errors).Verify();
+}
+
+}  // namespace store
@@ -0,0 +1,47 @@
+// Ahead of time checks of the bytecode of a procedure
+#ifndef STORE_VERIFIER_H_
+#define STORE_VERIFIER_H_
+
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+#include "base/basictypes.h"
+
+namespace store {
+
+struct Bytecode;
+
+// -----------------------------------------------------------------------------
+// Bytecode verifier
+//
+// Proves the static invariants of the bytecode of a procedure once, when the
+// procedure is built, so that the interpreter does not check them again on
+// every instruction:
+//  - opcodes are valid;
+//  - local, parameter and environment registers are below the number of
+//    local registers, parameters and closure values of the procedure;
+//  - destination operands are registers, other than the environment
+//    registers, and the arrays of the local registers and parameters are
+//    never replaced;
+//  - branch targets and exception handlers are small integer immediates
+//    within the code: a target at the end of the code terminates the thread;
+//  - try blocks are well nested;
+//  - register indexes and the number of distinct immediates fit in the
+//    packed operands: see PackedOperand.
+//
+// The interpreter relies on these invariants as long as frames are entered
+// with at least as many parameters and closure values as the procedure
+// declares: see Closure::CanCall().
+//
+// Appends a diagnostic for each error found, in the form
+// "CP=<code pointer> <opcode>: <error>".
+// @returns True if the bytecode is valid.
+bool VerifyBytecode(const vector<Bytecode>& bytecode,
+                    uint64 nparams, uint64 nlocals, uint64 nclosures,
+                    vector<string>* errors);
+
+}  // namespace store
+
+#endif  // STORE_VERIFIER_H_
@@ -0,0 +1,234 @@
+// Tests for the bytecode verifier.
+#include "store/values.h"
+
+#include "store/verifier.h"
+
+#include <memory>
+#include <vector>
+using std::shared_ptr;
+using std::vector;
+
+#include <gtest/gtest.h>
+
+#include "store/engine.h"
+
+namespace store {
+
+const uint64 kStoreSize = 16 * 1024 * 1024;
+
+namespace {
+
+Operand Local(int index) {
+  return Operand(Register(Register::LOCAL, index));
+}
+
+Operand Param(int index) {
+  return Operand(Register(Register::PARAM, index));
+}
+
+Operand Envmt(int index) {
+  return Operand(Register(Register::ENVMT, index));
+}
+
+Operand Immediate(int64 integer) {
+  return Operand(Value::Integer(integer));
+}
+
+// Verifies the bytecode of a procedure with 2 parameters, 2 local registers
+// and 1 closure value.
+// @returns The diagnostics, empty if the bytecode is valid.
+vector<string> Verify(const vector<Bytecode>& code) {
+  vector<string> errors;
+  const bool valid = VerifyBytecode(code, 2, 2, 1, &errors);
+  EXPECT_EQ(valid, errors.empty());
+  return errors;
+}
+
+}  // namespace
+
+TEST(Verifier, Valid) {
+  vector<Bytecode> code;
+  code.push_back(Bytecode(Bytecode::LOAD, Local(0), Envmt(0)));
+  code.push_back(
+      Bytecode(Bytecode::TEST_LESS_THAN, Local(1), Local(0), Param(0)));
+  code.push_back(Bytecode(Bytecode::BRANCH_UNLESS, Local(1), Immediate(5)));
+  code.push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(0)));
+  // A target at the end of the code terminates the thread.
+  code.push_back(Bytecode(Bytecode::BRANCH, Immediate(6)));
+  code.push_back(Bytecode(Bytecode::UNIFY, Param(1), Param(0)));
+  EXPECT_TRUE(Verify(code).empty());
+}
+
+TEST(Verifier, RegisterOutOfRange) {
+  vector<Bytecode> code;
+  code.push_back(Bytecode(Bytecode::LOAD, Local(2), Param(0)));
+  code.push_back(Bytecode(Bytecode::LOAD, Local(0), Param(2)));
+  code.push_back(Bytecode(Bytecode::LOAD, Local(0), Envmt(1)));
+  code.push_back(Bytecode(Bytecode::LOAD, Local(-1), Param(0)));
+  const vector<string> errors = Verify(code);
+  ASSERT_EQ(4UL, errors.size());
+  EXPECT_EQ("CP=0 load: operand 1: register l2 out of range "
+            "(2 local registers)", errors[0]);
+  EXPECT_EQ("CP=1 load: operand 2: register p2 out of range (2 parameters)",
+            errors[1]);
+  EXPECT_EQ("CP=2 load: operand 2: register e1 out of range "
+            "(1 closure values)", errors[2]);
+  EXPECT_EQ("CP=3 load: operand 1: register l-1 out of range "
+            "(2 local registers)", errors[3]);
+}
+
+TEST(Verifier, ReadOnlyRegisters) {
+  vector<Bytecode> code;
+  code.push_back(Bytecode(Bytecode::LOAD, Envmt(0), Local(0)));
+  code.push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Operand(Register(Register::LOCAL_ARRAY)),
+               Immediate(3), Immediate(0)));
+  code.push_back(Bytecode(Bytecode::LOAD, Immediate(1), Local(0)));
+  // Parameters and array registers are writable.
+  code.push_back(Bytecode(Bytecode::LOAD, Param(0), Local(0)));
+  code.push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Operand(Register(Register::ARRAY_ARRAY)),
+               Immediate(3), Immediate(0)));
+  const vector<string> errors = Verify(code);
+  ASSERT_EQ(3UL, errors.size());
+  EXPECT_EQ("CP=0 load: operand 1: register e0 is read-only", errors[0]);
+  EXPECT_EQ("CP=1 array: operand 1: register l* is read-only",
+            errors[1]);
+  EXPECT_EQ("CP=2 load: operand 1: destination is not a register", errors[2]);
+}
+
+TEST(Verifier, BranchTargets) {
+  vector<Bytecode> code;
+  code.push_back(Bytecode(Bytecode::BRANCH, Local(0)));
+  code.push_back(Bytecode(Bytecode::BRANCH_IF, Local(0), Immediate(5)));
+  code.push_back(Bytecode(Bytecode::BRANCH_UNLESS, Local(0), Immediate(-1)));
+  code.push_back(
+      Bytecode(Bytecode::BRANCH, Operand(Atom::Get("label"))));
+  const vector<string> errors = Verify(code);
+  ASSERT_EQ(4UL, errors.size());
+  EXPECT_EQ("CP=0 branch: operand 1: code pointer is not a small integer "
+            "immediate", errors[0]);
+  EXPECT_EQ("CP=1 branch_if: operand 2: code pointer 5 out of range "
+            "(4 instructions)", errors[1]);
+  EXPECT_EQ("CP=2 branch_unless: operand 2: code pointer -1 out of range "
+            "(4 instructions)", errors[2]);
+  EXPECT_EQ("CP=3 branch: operand 1: code pointer is not a small integer "
+            "immediate", errors[3]);
+}
+
+TEST(Verifier, TryBlocks) {
+  vector<Bytecode> code;
+  code.push_back(Bytecode(Bytecode::EXN_PUSH_CATCH, Immediate(3)));
+  code.push_back(Bytecode(Bytecode::EXN_POP));
+  code.push_back(Bytecode(Bytecode::EXN_POP));
+  code.push_back(Bytecode(Bytecode::EXN_PUSH_FINALLY, Immediate(4)));
+  const vector<string> errors = Verify(code);
+  ASSERT_EQ(2UL, errors.size());
+  EXPECT_EQ("CP=2 exn_pop: no try block to close", errors[0]);
+  EXPECT_EQ("CP=3 exn_push_finally: try block not closed", errors[1]);
+}
+
+TEST(Verifier, InvalidOpcode) {
+  // Bytecode built from a protocol buffer, for instance.
+  vector<Bytecode> code(1);
+  code[0].opcode = Bytecode::OPCODE_TYPE_COUNT;
+  const vector<string> errors = Verify(code);
+  ASSERT_EQ(1UL, errors.size());
+  EXPECT_EQ("CP=0 ?: invalid opcode " +
+            std::to_string(Bytecode::OPCODE_TYPE_COUNT), errors[0]);
+}
+
+TEST(Verifier, ClosureRejectsInvalidBytecode) {
+  StaticStore store(kStoreSize);
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(Bytecode(Bytecode::LOAD, Local(2), Param(0)));
+  code->push_back(Bytecode(Bytecode::BRANCH, Immediate(3)));
+  const uint64 free = store.free();
+  vector<string> errors;
+  EXPECT_TRUE(Closure::New(&store, code, 2, 2, 0, &errors) == NULL);
+  ASSERT_EQ(2UL, errors.size());
+  EXPECT_EQ("CP=0 load: operand 1: register l2 out of range "
+            "(2 local registers)", errors[0]);
+  EXPECT_EQ("CP=1 branch: operand 1: code pointer 3 out of range "
+            "(2 instructions)", errors[1]);
+  // Nothing is allocated for the rejected procedure.
+  EXPECT_EQ(free, store.free());
+
+  errors.clear();
+  EXPECT_TRUE(Closure::New(&store, code, 2, -1, 0, &errors) == NULL);
+  ASSERT_EQ(1UL, errors.size());
+  EXPECT_EQ("invalid register counts: nparams=2 nlocals=-1 nclosures=0",
+            errors[0]);
+
+  // Without a list of errors, the diagnostics are logged.
+  EXPECT_FALSE(New::Closure(&store, code, 2, 2, 0).IsDefined());
+}
+
+TEST(Verifier, PackedOperandLimits) {
+  StaticStore store(kStoreSize);
+  const int max_index = PackedOperand::kMaxIndex;
+  const string limit = std::to_string(max_index + 1);
+
+  // Registers beyond the packed operands.
+  vector<Bytecode> code;
+  code.push_back(Bytecode(Bytecode::LOAD, Local(max_index), Param(0)));
+  code.push_back(Bytecode(Bytecode::LOAD, Local(0), Param(max_index + 1)));
+  vector<string> errors;
+  EXPECT_FALSE(
+      VerifyBytecode(code, max_index + 2, max_index + 1, 0, &errors));
+  ASSERT_EQ(1UL, errors.size());
+  EXPECT_EQ("CP=1 load: operand 2: register p" + limit + " does not fit in "
+            "a packed operand (" + limit + " parameters at most)", errors[0]);
+
+  // One distinct immediate more than the constant pool holds.
+  shared_ptr<vector<Bytecode> > constants(new vector<Bytecode>);
+  for (int i = 0; i < max_index; ++i)
+    constants->push_back(Bytecode(Bytecode::LOAD, Local(0), Immediate(i)));
+  constants->push_back(
+      Bytecode(Bytecode::LOAD, Local(0), Immediate(max_index)));
+  errors.clear();
+  EXPECT_TRUE(VerifyBytecode(*constants, 0, 1, 0, &errors));
+  constants->push_back(
+      Bytecode(Bytecode::LOAD, Local(0), Immediate(max_index + 1)));
+  EXPECT_TRUE(Closure::New(&store, constants, 0, 1, 0, &errors) == NULL);
+  ASSERT_EQ(1UL, errors.size());
+  EXPECT_EQ("CP=" + limit + " load: too many constants (" + limit +
+            " at most)", errors[0]);
+}
+
+TEST(Verifier, FrameEntry) {
+  StaticStore store(kStoreSize);
+  // p1 = p0 + e0
+  shared_ptr<vector<Bytecode> > code(new vector<Bytecode>);
+  code->push_back(
+      Bytecode(Bytecode::NUMBER_INT_ADD, Local(0), Param(0), Envmt(0)));
+  code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Local(0)));
+  Closure* const abstract = Closure::New(&store, code, 2, 1, 1);
+  EXPECT_EQ(2UL, abstract->nparams());
+  // The closure value is missing.
+  EXPECT_FALSE(abstract->CanCall(Array::New(&store, 2, Value::Integer(1))));
+
+  Closure* const add = Closure::New(
+      &store, abstract, Array::New(&store, 1, Value::Integer(41)));
+  EXPECT_TRUE(add->CanCall(Array::New(&store, 2, Value::Integer(1))));
+  EXPECT_TRUE(add->CanCall(Array::New(&store, 3, Value::Integer(1))));
+  EXPECT_FALSE(add->CanCall(Array::New(&store, 1, Value::Integer(1))));
+
+  // {Add 1} terminates the calling thread without running Add.
+  shared_ptr<vector<Bytecode> > call_code(new vector<Bytecode>);
+  call_code->push_back(
+      Bytecode(Bytecode::NEW_ARRAY, Local(0), Immediate(1), Immediate(1)));
+  call_code->push_back(Bytecode(Bytecode::CALL, Param(0), Local(0)));
+  call_code->push_back(Bytecode(Bytecode::UNIFY, Param(1), Immediate(0)));
+  Closure* const call = Closure::New(&store, call_code, 2, 1, 0);
+
+  Engine engine;
+  const Value result = New::Free(&store);
+  Array* const params = Array::New(&store, 2, Value(add));
+  params->Assign(1, result);
+  New::Thread(&store, &engine, call, params, &store);
+  engine.Run();
+  EXPECT_EQ(Value::VARIABLE, result.Deref().type());
+}
+
+}  // namespace store